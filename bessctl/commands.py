@@ -1020,6 +1020,16 @@ def _show_worker(cli, w):
         w.num_tcs,
         w.silent_drops))
 
+    if w.HasField('packet_cache'):
+        c = w.packet_cache
+        total = c.hits + c.misses
+        hit_rate = 100.0 * c.hits / total if total else 0.0
+        cli.fout.write('  %10s packet cache %d/%d, hit rate %.2f%%, '
+                       'mempool gets/puts %d/%d, from/to other workers '
+                       '%d/%d\n' % ('', c.cnt, c.depth, hit_rate,
+                                     c.mempool_gets, c.mempool_puts,
+                                     c.remote_in, c.remote_out))
+
 
 @cmd('show worker', 'Show the status of all worker threads')
 def show_worker_all(cli):
@@ -1394,6 +1404,23 @@ def _show_port(cli, port):
     cli.fout.write('bytes: {:<20,}\n'.format(stats.out.bytes))
     cli.fout.write('{:<14} dropped: {:<20,}\n'.format('', stats.out.dropped))
 
+    def write_queues(direction, queues):
+        for qid, queue in enumerate(queues):
+            calls = sum(queue.burst_hist)
+            if calls == 0:
+                continue
+            avg = float(sum(i * n for i, n in enumerate(queue.burst_hist)))
+            avg /= calls
+            cli.fout.write('{:>10} q{:<3} packets: {:<20,}avg burst: {:.1f}'
+                           .format(direction, qid, queue.stat.packets, avg))
+            if direction == 'RX':
+                cli.fout.write(' (empty polls {:.1f}%)'.format(
+                    100.0 * queue.burst_hist[0] / calls))
+            cli.fout.write('\n')
+
+    write_queues('RX', stats.inc_queues)
+    write_queues('TX', stats.out_queues)
+
 
 @cmd('show port', 'Show the status of all ports')
 def show_port_all(cli):
@@ -1427,6 +1454,19 @@ def _show_module(cli, module_name):
 
     cli.fout.write('  %s::%s(%s)\n' % (info.name, info.mclass, info.desc))
 
+    if info.socket >= 0:
+        cli.fout.write('    Memory placement: socket %d' % info.socket)
+        if info.mem_socket >= 0 and info.mem_socket != info.socket:
+            cli.fout.write(' (currently on socket %d)' % info.mem_socket)
+        cli.fout.write('\n')
+
+    if info.HasField('arena'):
+        arena = info.arena
+        cli.fout.write('    Arena: %d/%d bytes used (peak %d, overflow %d)' %
+                       (arena.used, arena.capacity, arena.peak,
+                        arena.overflow))
+        cli.fout.write(' on hugepages\n' if arena.hugepage else '\n')
+
     if len(info.metadata) > 0:
         cli.fout.write('    Per-packet metadata fields:\n')
         for field in info.metadata:
@@ -1960,6 +2000,56 @@ def interactive(cli):
     cli.interactive = False
 
 
+@cmd('show pool', 'Show the occupancy of all packet pools')
+def show_pool(cli):
+    pools = cli.bess.list_packet_pools().pools
+
+    cli.fout.write('  %-16s %10s %6s %10s %10s %10s %14s\n' %
+                   ('Pool', 'Data size', 'Socket', 'Buffers', 'Available',
+                    'In use', 'Alloc failures'))
+    for pool in pools:
+        for s in pool.sockets:
+            cli.fout.write('  %-16s %10d %6d %10d %10d %10d %14d\n' %
+                           (pool.name, pool.data_size, s.socket, s.size,
+                            s.available, s.in_use, s.alloc_failures))
+
+
+def _show_profile(cli, reset):
+    resp = cli.bess.get_module_profile(reset)
+
+    if not resp.enabled:
+        cli.fout.write('  Hardware counters are not collected '
+                       '(run bessd with --profile_modules)\n')
+
+    cli.fout.write('  %-20s %-16s %12s %14s %10s %6s %10s %10s %10s\n' %
+                   ('Module', 'Class', 'Calls', 'Packets', 'Cycles/pkt',
+                    'IPC', 'LLC/pkt', 'dTLB/pkt', 'Memory KB'))
+
+    # most expensive first
+    modules = sorted(resp.modules, key=lambda m: m.cycles, reverse=True)
+    for m in modules:
+        pkts = max(m.packets, 1)
+        ipc = float(m.instructions) / m.cycles if m.cycles else 0.0
+        cli.fout.write('  %-20s %-16s %12d %14d %10.1f %6.2f %10.3f %10.3f '
+                       '%10d\n' %
+                       (m.name, m.mclass, m.calls, m.packets,
+                        float(m.cycles) / pkts, ipc,
+                        float(m.llc_misses) / pkts,
+                        float(m.dtlb_misses) / pkts,
+                        m.memory_bytes // 1024))
+
+
+@cmd('show profile', 'Show the per-module cost (CPU counters and memory)')
+def show_profile(cli):
+    _show_profile(cli, False)
+
+
+@cmd('show profile reset',
+     'Show the per-module cost, then clear the counters')
+def show_profile_reset(cli):
+    _show_profile(cli, True)
+
+
 @cmd('show system packets [SOCKET]', 'Dump the mempool of one or more sockets')
 def show_system_packets(cli, socket):
     if socket is None:
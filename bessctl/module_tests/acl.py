@@ -79,6 +79,61 @@ class BessAclTest(BessModuleTestCase):
         self.assertEquals(len(pkt_outs[0]), 1)
         self.assertSamePackets(pkt_outs[0][0], pkt_in2)
 
+    def test_acl_cache(self):
+        fw = ACL(rules=[{'src_ip': '96.0.0.0/8', 'drop': False}],
+                 cache_size=64)
+        pkt_in1 = get_tcp_packet(sip='22.22.22.22', dip='22.22.22.22')
+        pkt_in2 = get_tcp_packet(sip='96.22.22.22', dip='22.22.22.22')
+
+        for _ in range(2):
+            pkt_outs = self.run_module(fw, 0, [pkt_in1], [0])
+            self.assertEquals(len(pkt_outs[0]), 0)
+            pkt_outs = self.run_module(fw, 0, [pkt_in2], [0])
+            self.assertEquals(len(pkt_outs[0]), 1)
+
+        stats = fw.get_cache_stats()
+        self.assertEquals(stats.hits, 2)
+        self.assertEquals(stats.misses, 2)
+
+        # New rules must take effect for cached flows
+        fw.clear()
+        fw.add(rules=[{'src_ip': '22.0.0.0/8', 'drop': False}])
+        pkt_outs = self.run_module(fw, 0, [pkt_in1], [0])
+        self.assertEquals(len(pkt_outs[0]), 1)
+        pkt_outs = self.run_module(fw, 0, [pkt_in2], [0])
+        self.assertEquals(len(pkt_outs[0]), 0)
+
+    def test_acl_trie(self):
+        rules = [{'src_ip': '96.22.22.0/24', 'dst_port': 80, 'drop': True},
+                 {'src_ip': '96.0.0.0/8', 'drop': False},
+                 {'dst_ip': '33.33.33.33/32', 'src_port': 1234,
+                  'drop': False}]
+        fw = ACL(rules=rules, backend='trie')
+        pkt_in1 = get_tcp_packet(sip='96.22.22.22', dip='22.22.22.22',
+                                 dport=80)
+        pkt_in2 = get_tcp_packet(sip='96.22.22.22', dip='22.22.22.22',
+                                 dport=81)
+        pkt_in3 = get_tcp_packet(sip='22.22.22.22', dip='33.33.33.33',
+                                 sport=1234)
+        pkt_in4 = get_tcp_packet(sip='22.22.22.22', dip='33.33.33.33',
+                                 sport=1235)
+
+        pkt_outs = self.run_module(fw, 0, [pkt_in1, pkt_in2, pkt_in3,
+                                           pkt_in4], [0])
+        self.assertEquals(len(pkt_outs[0]), 2)
+        self.assertSamePackets(pkt_outs[0][0], pkt_in2)
+        self.assertSamePackets(pkt_outs[0][1], pkt_in3)
+
+        # Rule changes are compiled in the background; packets must see the
+        # new rules whether or not the rebuild has finished
+        fw.add(rules=[{'src_ip': '22.0.0.0/8', 'drop': False}])
+        pkt_outs = self.run_module(fw, 0, [pkt_in4], [0])
+        self.assertEquals(len(pkt_outs[0]), 1)
+
+        fw.clear()
+        pkt_outs = self.run_module(fw, 0, [pkt_in2], [0])
+        self.assertEquals(len(pkt_outs[0]), 0)
+
     def test_run_acl_custom(self):
         fw = ACL(rules=[{'src_ip': '172.12.0.0/16',
                          'drop': False},
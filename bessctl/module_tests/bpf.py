@@ -99,6 +99,44 @@ class BessBpfTest(BessModuleTestCase):
         self.assertEquals(len(pkt_outs[2]), 1)
         self.assertSamePackets(pkt_outs[2][0], pkt1)
 
+    # Many rules are merged into one program
+    def test_bpf_many_rules(self):
+        bpf = BPF()
+        for i in range(20):
+            bpf.add(filters=[{"priority": 100 - i,
+                              "filter": "tcp dst port %d" % (1000 + i),
+                              "gate": 1 + i}])
+        bpf.add(filters=[{"priority": 0, "filter": "udp", "gate": 30}])
+
+        for i in [0, 7, 19]:
+            pkt = get_tcp_packet(sip='12.34.56.78', dip='12.34.56.78',
+                                 dport=1000 + i)
+            pkt_outs = self.run_module(bpf, 0, [pkt], [1 + i])
+            self.assertEquals(len(pkt_outs[1 + i]), 1)
+            self.assertSamePackets(pkt_outs[1 + i][0], pkt)
+
+        pkt1 = get_udp_packet(sip='12.34.56.78', dip='12.34.56.78',
+                              dport=1000)
+        pkt2 = get_tcp_packet(sip='12.34.56.78', dip='12.34.56.78',
+                              dport=2000)
+        pkt_outs = self.run_module(bpf, 0, [pkt1, pkt2], [0, 30])
+        self.assertEquals(len(pkt_outs[30]), 1)
+        self.assertSamePackets(pkt_outs[30][0], pkt1)
+        self.assertEquals(len(pkt_outs[0]), 1)
+        self.assertSamePackets(pkt_outs[0][0], pkt2)
+
+    # Reading past the end of a packet only fails the rule that does it
+    def test_bpf_short_packet(self):
+        bpf = BPF()
+        bpf.add(filters=[{"priority": 2, "filter": "ether[200] == 1",
+                          "gate": 1}])
+        bpf.add(filters=[{"priority": 1, "filter": filters[0], "gate": 2}])
+
+        pkt = get_tcp_packet(sip='12.34.56.78', dip='12.34.56.78', sport=92)
+        pkt_outs = self.run_module(bpf, 0, [pkt], [0, 1, 2])
+        self.assertEquals(len(pkt_outs[2]), 1)
+        self.assertSamePackets(pkt_outs[2][0], pkt)
+
 suite = unittest.TestLoader().loadTestsFromTestCase(BessBpfTest)
 results = unittest.TextTestRunner(verbosity=2).run(suite)
 
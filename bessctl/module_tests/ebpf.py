@@ -0,0 +1,118 @@
+# Copyright (c) 2016-2017, Nefeli Networks, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# * Redistributions of source code must retain the above copyright notice, this
+# list of conditions and the following disclaimer.
+#
+# * Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation
+# and/or other materials provided with the distribution.
+#
+# * Neither the names of the copyright holders nor the names of their
+# contributors may be used to endorse or promote products derived from this
+# software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+import struct
+
+from test_utils import *
+
+
+def insn(code, dst=0, src=0, off=0, imm=0):
+    return struct.pack('<BBhi', code, (src << 4) | dst, off, imm)
+
+
+def exit_insn():
+    return insn(0x95)
+
+# r0 = ctx->len & 1
+parity = insn(0x61, dst=0, src=1, off=16) + \
+    insn(0x57, dst=0, imm=1) + \
+    exit_insn()
+
+# Counts packets in entry 0 of map 0, and sends them out of gate 0
+counter = insn(0xb7, dst=2, imm=0) + \
+    insn(0x63, dst=10, src=2, off=-4) + \
+    insn(0xbf, dst=2, src=10) + \
+    insn(0x07, dst=2, imm=-4) + \
+    insn(0x18, dst=1, src=1, imm=0) + insn(0) + \
+    insn(0x85, imm=1) + \
+    insn(0x15, dst=0, off=2, imm=0) + \
+    insn(0xb7, dst=1, imm=1) + \
+    insn(0xdb, dst=0, src=1) + \
+    insn(0xb7, dst=0, imm=0) + \
+    exit_insn()
+
+# Reads the first packet byte without checking data_end
+unchecked = insn(0x79, dst=2, src=1, off=0) + \
+    insn(0x71, dst=0, src=2, off=0) + \
+    exit_insn()
+
+
+class BessEbpfTest(BessModuleTestCase):
+
+    def test_run_ebpf(self):
+        ebpf = EBPF(code=parity)
+        self.run_for(ebpf, [0, 1], 3)
+        self.assertBessAlive()
+
+    def test_ebpf_gate(self):
+        for no_jit in [False, True]:
+            ebpf = EBPF(code=parity, no_jit=no_jit)
+            pkt = get_tcp_packet(sip='1.2.3.4', dip='5.6.7.8')
+            odd = pkt / 'x' * (1 - len(bytes(pkt)) % 2)
+            even = pkt / 'x' * (len(bytes(pkt)) % 2)
+
+            pkt_outs = self.run_module(ebpf, 0, [even, odd], [0, 1])
+            self.assertEquals(len(pkt_outs[0]), 1)
+            self.assertEquals(len(pkt_outs[1]), 1)
+            self.assertSamePackets(pkt_outs[0][0], even)
+            self.assertSamePackets(pkt_outs[1][0], odd)
+
+    def test_ebpf_map(self):
+        ebpf = EBPF(code=counter,
+                    maps=[{'name': 'count', 'type': 'array',
+                           'key_size': 4, 'value_size': 8,
+                           'max_entries': 1}])
+        key = struct.pack('<I', 0)
+
+        pkt = get_tcp_packet(sip='1.2.3.4', dip='5.6.7.8')
+        pkt_outs = self.run_module(ebpf, 0, [pkt] * 3, [0])
+        self.assertEquals(len(pkt_outs[0]), 3)
+
+        ret = ebpf.map_lookup(map='count', key=key)
+        self.assertEquals(struct.unpack('<Q', ret.value)[0], 3)
+
+        ebpf.map_update(map='count', key=key, value=struct.pack('<Q', 10))
+        self.run_module(ebpf, 0, [pkt], [0])
+        ret = ebpf.map_lookup(map='count', key=key)
+        self.assertEquals(struct.unpack('<Q', ret.value)[0], 11)
+
+        with self.assertRaises(bess.Error):
+            ebpf.map_lookup(map='count', key=struct.pack('<I', 1))
+
+    def test_ebpf_reject(self):
+        with self.assertRaises(bess.Error):
+            EBPF(code=unchecked)
+        with self.assertRaises(bess.Error):
+            EBPF(code=parity[:-1])
+
+suite = unittest.TestLoader().loadTestsFromTestCase(BessEbpfTest)
+results = unittest.TextTestRunner(verbosity=2).run(suite)
+
+if results.failures or results.errors:
+    sys.exit(1)
@@ -0,0 +1,109 @@
+# Copyright (c) 2016-2017, Nefeli Networks, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# * Redistributions of source code must retain the above copyright notice, this
+# list of conditions and the following disclaimer.
+#
+# * Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation
+# and/or other materials provided with the distribution.
+#
+# * Neither the names of the copyright holders nor the names of their
+# contributors may be used to endorse or promote products derived from this
+# software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+from test_utils import *
+
+
+def segment(seq, payload_len, flags='A', ip_id=1, window=8192):
+    eth = scapy.Ether(src='02:1e:67:9f:4d:ae', dst='06:16:3e:1b:72:32')
+    ip = scapy.IP(src='10.0.0.1', dst='10.0.0.2', id=ip_id)
+    tcp = scapy.TCP(sport=1234, dport=80, seq=seq, ack=1, flags=flags,
+                    window=window)
+    payload = ''.join(chr(ord('a') + (seq + i) % 26)
+                      for i in range(payload_len))
+    return eth / ip / tcp / payload
+
+# Flows are held until a flush condition, not until the end of a batch
+TIMEOUT_NS = 10 * 1000 * 1000 * 1000
+
+
+class BessGroTest(BessModuleTestCase):
+
+    def test_run_gro(self):
+        gro = GRO()
+        self.run_for(gro, [0], 3)
+        self.assertBessAlive()
+
+    def test_gro_merge(self):
+        gro = GRO(timeout_ns=TIMEOUT_NS)
+        pkts = [segment(1000, 100), segment(1100, 100), segment(1200, 100),
+                segment(1300, 100, flags='PA')]
+
+        # A pushed segment ends the burst
+        pkt_outs = self.run_module(gro, 0, pkts, [0])
+        self.assertEquals(len(pkt_outs[0]), 1)
+        self.assertSamePackets(pkt_outs[0][0],
+                               segment(1000, 400, flags='PA'))
+
+    def test_gro_short_segment(self):
+        gro = GRO(timeout_ns=TIMEOUT_NS)
+        pkts = [segment(1000, 100), segment(1100, 100), segment(1200, 50)]
+
+        pkt_outs = self.run_module(gro, 0, pkts, [0])
+        self.assertEquals(len(pkt_outs[0]), 1)
+        self.assertSamePackets(pkt_outs[0][0], segment(1000, 250))
+
+    def test_gro_max_size(self):
+        # IP + TCP headers + 3 segments
+        gro = GRO(max_size=40 + 300, timeout_ns=TIMEOUT_NS)
+        pkts = [segment(1000 + i * 100, 100) for i in range(4)]
+        pkts.append(segment(1400, 100, flags='PA'))
+
+        pkt_outs = self.run_module(gro, 0, pkts, [0])
+        self.assertEquals(len(pkt_outs[0]), 2)
+        self.assertSamePackets(pkt_outs[0][0], segment(1000, 300))
+        self.assertSamePackets(pkt_outs[0][1],
+                               segment(1300, 200, flags='PA'))
+
+    def test_gro_out_of_order(self):
+        gro = GRO(timeout_ns=TIMEOUT_NS)
+        pkts = [segment(1000, 100), segment(1200, 100, flags='PA')]
+
+        # The gap flushes the held segment, and both go out unchanged
+        pkt_outs = self.run_module(gro, 0, pkts, [0])
+        self.assertEquals(len(pkt_outs[0]), 2)
+        self.assertSamePackets(pkt_outs[0][0], pkts[0])
+        self.assertSamePackets(pkt_outs[0][1], pkts[1])
+
+    def test_gro_flags(self):
+        gro = GRO(timeout_ns=TIMEOUT_NS)
+        pkts = [segment(999, 0, flags='S'), segment(1000, 100),
+                segment(1100, 100, flags='FA')]
+
+        # SYN and FIN segments are never merged, and flush the flow first
+        pkt_outs = self.run_module(gro, 0, pkts, [0])
+        self.assertEquals(len(pkt_outs[0]), 3)
+        for i in range(3):
+            self.assertSamePackets(pkt_outs[0][i], pkts[i])
+
+suite = unittest.TestLoader().loadTestsFromTestCase(BessGroTest)
+results = unittest.TextTestRunner(verbosity=2).run(suite)
+
+if results.failures or results.errors:
+    sys.exit(1)
@@ -0,0 +1,98 @@
+# Copyright (c) 2016-2017, Nefeli Networks, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# * Redistributions of source code must retain the above copyright notice, this
+# list of conditions and the following disclaimer.
+#
+# * Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation
+# and/or other materials provided with the distribution.
+#
+# * Neither the names of the copyright holders nor the names of their
+# contributors may be used to endorse or promote products derived from this
+# software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+from test_utils import *
+
+
+def segment(seq, payload_len, flags='A', ip_id=1):
+    eth = scapy.Ether(src='02:1e:67:9f:4d:ae', dst='06:16:3e:1b:72:32')
+    ip = scapy.IP(src='10.0.0.1', dst='10.0.0.2', id=ip_id)
+    tcp = scapy.TCP(sport=1234, dport=80, seq=seq, ack=1, flags=flags)
+    payload = ''.join(chr(ord('a') + (seq + i) % 26)
+                      for i in range(payload_len))
+    return eth / ip / tcp / payload
+
+
+class BessGsoTest(BessModuleTestCase):
+
+    def test_run_gso(self):
+        gso = GSO()
+        self.run_for(gso, [0], 3)
+        self.assertBessAlive()
+
+    def test_gso_invalid_mss(self):
+        with self.assertRaises(bess.Error):
+            GSO(mss=10)
+
+    def test_gso_segment(self):
+        gso = GSO(mss=300)
+
+        # FIN/PSH stay on the last segment, CWR on the first one
+        pkt = segment(1000, 1000, flags='CFPA', ip_id=7)
+        pkt_outs = self.run_module(gso, 0, [pkt], [0])
+        self.assertEquals(len(pkt_outs[0]), 4)
+        self.assertSamePackets(pkt_outs[0][0],
+                               segment(1000, 300, flags='CA', ip_id=7))
+        self.assertSamePackets(pkt_outs[0][1],
+                               segment(1300, 300, flags='A', ip_id=8))
+        self.assertSamePackets(pkt_outs[0][2],
+                               segment(1600, 300, flags='A', ip_id=9))
+        self.assertSamePackets(pkt_outs[0][3],
+                               segment(1900, 100, flags='FPA', ip_id=10))
+
+    def test_gso_passthrough(self):
+        gso = GSO(mss=300)
+        small = segment(1000, 300, flags='PA')
+        udp = get_udp_packet(sip='10.0.0.1', dip='10.0.0.2', pkt_len=1000)
+
+        pkt_outs = self.run_module(gso, 0, [small, udp], [0])
+        self.assertEquals(len(pkt_outs[0]), 2)
+        self.assertSamePackets(pkt_outs[0][0], small)
+        self.assertSamePackets(pkt_outs[0][1], udp)
+
+    # More segments than fit in a batch: GRO builds a 40-segment packet,
+    # and GSO must split it back into the original segments
+    def test_gso_many_segments(self):
+        gro = GRO(timeout_ns=10 * 1000 * 1000 * 1000)
+        gso = GSO(mss=88)
+        gro -> gso
+
+        pkts = [segment(1000 + i * 88, 88, ip_id=1 + i) for i in range(40)]
+        pkts[-1] = segment(1000 + 39 * 88, 88, flags='PA', ip_id=40)
+
+        pkt_outs = self.run_pipeline(gro, gso, 0, pkts, [0])
+        self.assertEquals(len(pkt_outs[0]), 40)
+        for i in range(40):
+            self.assertSamePackets(pkt_outs[0][i], pkts[i])
+
+suite = unittest.TestLoader().loadTestsFromTestCase(BessGsoTest)
+results = unittest.TextTestRunner(verbosity=2).run(suite)
+
+if results.failures or results.errors:
+    sys.exit(1)
@@ -48,6 +48,51 @@ class BessL2ForwardTest(BessModuleTestCase):
         with self.assertRaises(bess.Error):
             l2fib.delete(addrs=['00:01:02:03:04:05'])
 
+    def test_l2forward_learn(self):
+        l2fib = L2Forward(learn=True, flood_gates=[0, 1, 2])
+        l2fib.add(entries=[{'addr': '02:00:00:00:00:09', 'gate': 2}])
+
+        def packet(src, dst):
+            eth = scapy.Ether(src=src, dst=dst)
+            ip = scapy.IP(src='1.2.3.4', dst='5.6.7.8')
+            return eth / ip / scapy.UDP() / ('x' * 20)
+
+        # Unknown destination: flooded to all but the input gate
+        pkt = packet('02:00:00:00:00:01', '02:00:00:00:00:02')
+        pkt_outs = self.run_module(l2fib, 0, [pkt], range(3))
+        self.assertEquals(len(pkt_outs[0]), 0)
+        self.assertEquals(len(pkt_outs[1]), 1)
+        self.assertEquals(len(pkt_outs[2]), 1)
+        self.assertSamePackets(pkt_outs[1][0], pkt)
+
+        # The reply goes out the gate the first packet came in from, and
+        # teaches the address of its sender
+        pkt = packet('02:00:00:00:00:02', '02:00:00:00:00:01')
+        pkt_outs = self.run_module(l2fib, 1, [pkt], range(3))
+        self.assertEquals(len(pkt_outs[0]), 1)
+        self.assertEquals(len(pkt_outs[2]), 0)
+
+        pkt = packet('02:00:00:00:00:01', '02:00:00:00:00:02')
+        pkt_outs = self.run_module(l2fib, 0, [pkt], range(3))
+        self.assertEquals(len(pkt_outs[1]), 1)
+        self.assertEquals(len(pkt_outs[2]), 0)
+
+        # Broadcast always floods; static entries win over learned ones
+        pkt = packet('02:00:00:00:00:09', 'ff:ff:ff:ff:ff:ff')
+        pkt_outs = self.run_module(l2fib, 0, [pkt], range(3))
+        self.assertEquals(len(pkt_outs[1]), 1)
+        self.assertEquals(len(pkt_outs[2]), 1)
+
+        pkt = packet('02:00:00:00:00:01', '02:00:00:00:00:09')
+        pkt_outs = self.run_module(l2fib, 0, [pkt], range(3))
+        self.assertEquals(len(pkt_outs[2]), 1)
+
+        l2fib.flush_learned()
+        pkt = packet('02:00:00:00:00:01', '02:00:00:00:00:02')
+        pkt_outs = self.run_module(l2fib, 0, [pkt], range(3))
+        self.assertEquals(len(pkt_outs[1]), 1)
+        self.assertEquals(len(pkt_outs[2]), 1)
+
 suite = unittest.TestLoader().loadTestsFromTestCase(BessL2ForwardTest)
 results = unittest.TextTestRunner(verbosity=2).run(suite)
 
@@ -106,6 +106,29 @@ class BessNatTest(BessModuleTestCase):
         nat = NAT(ext_addrs=nat_config)
         self._test_l4(nat, scapy.ICMP(), '192.168.1.1')
 
+    # VLANPop moves the headers after Parse, so NAT must not use the offsets
+    # that Parse stored for the tagged frame
+    def test_nat_parse_vlan_pop(self):
+        parse = Parse()
+        nat = NAT(ext_addrs=[{'ext_addr': '192.168.1.1'}])
+        parse -> VLANPop() -> nat
+
+        eth = scapy.Ether(src='02:1e:67:9f:4d:ae', dst='06:16:3e:1b:72:32')
+        udp = scapy.UDP(sport=56797, dport=53)
+        l7 = 'helloworld'
+        pkt = eth / scapy.Dot1Q(vlan=5) / \
+            scapy.IP(src='172.16.0.2', dst='8.8.8.8') / udp / l7
+
+        pkt_outs = self.run_pipeline(parse, nat, 0, [pkt], [0])
+        self.assertEquals(len(pkt_outs[0]), 1)
+        pkt_natted = pkt_outs[0][0]
+
+        udp_natted = udp.copy()
+        udp_natted.sport = pkt_natted[scapy.UDP].sport
+        self.assertSamePackets(
+            eth / scapy.IP(src='192.168.1.1', dst='8.8.8.8') / udp_natted / l7,
+            pkt_natted)
+
     def test_nat_selfconfig(self):
         # Send initial conf unsorted, see that it comes back sorted
         # (note that this is a bit different from other modules
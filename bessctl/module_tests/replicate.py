@@ -59,6 +59,26 @@ class BessReplicateTest(BessModuleTestCase):
         self.assertEquals(len(pkt_outs[2]), 1)
         self.assertSamePackets(pkt_outs[2][0], pkt_in)
 
+    # Replicas share the data beyond the first 64 bytes. The short packet
+    # fits in the private bytes, so it is copied instead.
+    def test_replicate_zero_copy(self):
+        rep3 = Replicate(gates=[0, 1, 2], zero_copy=True, private_len=64)
+        pkt_long = get_tcp_packet(sip='22.22.22.22', dip='33.33.33.33',
+                                  pkt_len=1000)
+        pkt_short = get_tcp_packet(sip='22.22.22.22', dip='33.33.33.33',
+                                   pkt_len=60)
+
+        pkt_outs = self.run_module(rep3, 0, [pkt_long, pkt_short], [0, 1, 2])
+
+        for gate in [0, 1, 2]:
+            self.assertEquals(len(pkt_outs[gate]), 2)
+            self.assertSamePackets(pkt_outs[gate][0], pkt_long)
+            self.assertSamePackets(pkt_outs[gate][1], pkt_short)
+
+    def test_replicate_invalid_private_len(self):
+        with self.assertRaises(bess.Error):
+            Replicate(gates=[0, 1], zero_copy=True, private_len=65536)
+
 suite = unittest.TestLoader().loadTestsFromTestCase(BessReplicateTest)
 results = unittest.TextTestRunner(verbosity=2).run(suite)
 
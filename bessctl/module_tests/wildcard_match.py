@@ -101,6 +101,68 @@ class BessWildcardMatchTest(BessModuleTestCase):
         self.assertEquals(len(pkt_outs[3]), 1)
         self.assertSamePackets(pkt_outs[3][0], pkt_nomatch)
 
+    def test_wildcardmatch_cache(self):
+        wm = WildcardMatch(fields=[{'offset': 26, 'num_bytes': 4}],
+                           cache_size=64)
+        mask = vstring([0xff, 0xff, 0xff, 0xff])
+        value = [{'value_bin': socket.inet_aton('65.43.21.00')}]
+        wm.add(gate=1, priority=0, masks=mask, values=value)
+        wm.set_default_gate(gate=0)
+
+        # Same source address, so both are served by one cache entry
+        pkt1 = get_tcp_packet(sip='65.43.21.00', dip='12.34.56.78')
+        pkt2 = get_tcp_packet(sip='65.43.21.00', dip='87.65.43.21')
+        pkt_nomatch = get_tcp_packet(sip='00.12.33.56', dip='12.34.56.78')
+
+        for pkt in [pkt1, pkt2]:
+            pkt_outs = self.run_module(wm, 0, [pkt], range(3))
+            self.assertEquals(len(pkt_outs[1]), 1)
+        stats = wm.get_cache_stats(reset=True)
+        self.assertEquals(stats.hits, 1)
+        self.assertEquals(stats.misses, 1)
+
+        # The default gate is not baked into cached entries
+        pkt_outs = self.run_module(wm, 0, [pkt_nomatch], range(3))
+        self.assertEquals(len(pkt_outs[0]), 1)
+        wm.set_default_gate(gate=2)
+        pkt_outs = self.run_module(wm, 0, [pkt_nomatch], range(3))
+        self.assertEquals(len(pkt_outs[2]), 1)
+
+        # Rule updates invalidate the cache
+        wm.delete(masks=mask, values=value)
+        pkt_outs = self.run_module(wm, 0, [pkt1], range(3))
+        self.assertEquals(len(pkt_outs[2]), 1)
+
+    def test_wildcardmatch_update(self):
+        wm = WildcardMatch(fields=[{'offset': 26, 'num_bytes': 4}])
+        mask = vstring([0xff, 0xff, 0xff, 0xff])
+        value1 = [{'value_bin': socket.inet_aton('65.43.21.00')}]
+        value2 = [{'value_bin': socket.inet_aton('00.12.34.56')}]
+        wm.add(gate=1, priority=0, masks=mask, values=value1)
+        wm.set_default_gate(gate=0)
+
+        pkt1 = get_tcp_packet(sip='65.43.21.00', dip='12.34.56.78')
+        pkt2 = get_tcp_packet(sip='00.12.34.56', dip='12.34.56.78')
+
+        ret = wm.update(deletes=[{'masks': mask, 'values': value1}],
+                        adds=[{'gate': 2, 'priority': 0, 'masks': mask,
+                               'values': value2}])
+        self.assertEquals(ret.num_tuples, 1)
+
+        pkt_outs = self.run_module(wm, 0, [pkt1, pkt2], range(3))
+        self.assertEquals(len(pkt_outs[0]), 1)
+        self.assertSamePackets(pkt_outs[0][0], pkt1)
+        self.assertEquals(len(pkt_outs[2]), 1)
+        self.assertSamePackets(pkt_outs[2][0], pkt2)
+
+        # A batch with a bad entry has no effect at all
+        with self.assertRaises(bess.Error):
+            wm.update(deletes=[{'masks': mask, 'values': value1}],
+                      adds=[{'gate': 1, 'priority': 0, 'masks': mask,
+                             'values': value1}])
+        pkt_outs = self.run_module(wm, 0, [pkt1], range(3))
+        self.assertEquals(len(pkt_outs[0]), 1)
+
     def test_wildcardmatch_with_metadata(self):
         # One wildcard match field
         mask = vstring([0xff, 0xff])
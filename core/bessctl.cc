@@ -48,12 +48,16 @@
 #include "gate.h"
 #include "gate_hooks/tcpdump.h"
 #include "gate_hooks/track.h"
+#include "mem_alloc.h"
 #include "message.h"
 #include "metadata.h"
 #include "module.h"
 #include "module_graph.h"
+#include "module_profiler.h"
 #include "opts.h"
 #include "packet.h"
+#include "packet_cache.h"
+#include "packet_pool.h"
 #include "port.h"
 #include "resume_hook.h"
 #include "scheduler.h"
@@ -440,6 +444,7 @@ class BESSControlImpl final : public BESSControl::Service {
                    EmptyResponse*) override {
     if (!is_any_worker_running()) {
       attach_orphans();
+      ModuleGraph::UpdateMemoryPlacement();
     }
 
     bess::run_global_resume_hooks();
@@ -476,6 +481,20 @@ class BESSControlImpl final : public BESSControl::Service {
       status->set_core(workers[wid]->core());
       status->set_num_tcs(workers[wid]->scheduler()->NumTcs());
       status->set_silent_drops(workers[wid]->silent_drops());
+
+      // Racy, but the counters are only informational
+      if (const bess::PacketCache* cache = bess::PacketCache::ForWorker(wid)) {
+        auto* info = status->mutable_packet_cache();
+        const bess::PacketCache::Stats& stats = cache->stats();
+        info->set_depth(cache->depth());
+        info->set_cnt(cache->cnt());
+        info->set_hits(stats.hits);
+        info->set_misses(stats.misses);
+        info->set_mempool_gets(stats.mempool_gets);
+        info->set_mempool_puts(stats.mempool_puts);
+        info->set_remote_in(stats.remote_in);
+        info->set_remote_out(stats.remote_out);
+      }
     }
     return Status::OK;
   }
@@ -1021,6 +1040,24 @@ class BESSControlImpl final : public BESSControl::Service {
     response->mutable_out()->set_dropped(stats.out.dropped);
     response->mutable_out()->set_bytes(stats.out.bytes);
 
+    for (int dir = 0; dir < PACKET_DIRS; dir++) {
+      ::Port* port = it->second;
+      for (queue_t qid = 0; qid < port->num_queues[dir]; qid++) {
+        uint64_t hist[QueueCounters::kBurstHistSize];
+        QueueStats q = port->GetQueueStats(static_cast<packet_dir_t>(dir), qid,
+                                           hist);
+        GetPortStatsResponse::QueueStat* qs =
+            (dir == PACKET_DIR_INC) ? response->add_inc_queues()
+                                    : response->add_out_queues();
+        qs->mutable_stat()->set_packets(q.packets);
+        qs->mutable_stat()->set_dropped(q.dropped);
+        qs->mutable_stat()->set_bytes(q.bytes);
+        for (uint64_t cnt : hist) {
+          qs->add_burst_hist(cnt);
+        }
+      }
+    }
+
     response->set_timestamp(get_epoch_time());
 
     return Status::OK;
@@ -1159,6 +1196,16 @@ class BESSControlImpl final : public BESSControl::Service {
     response->set_name(m->name());
     response->set_mclass(m->module_builder()->class_name());
     response->set_desc(m->GetDesc());
+    response->set_socket(m->socket());
+    response->set_mem_socket(mem_socket(m));
+    if (const bess::utils::Arena* arena = m->arena()) {
+      GetModuleInfoResponse_Arena* info = response->mutable_arena();
+      info->set_capacity(arena->capacity());
+      info->set_used(arena->used());
+      info->set_peak(arena->peak());
+      info->set_overflow(arena->overflow());
+      info->set_hugepage(arena->hugepage());
+    }
 
     collect_igates(m, response);
     collect_ogates(m, response);
@@ -1285,6 +1332,103 @@ class BESSControlImpl final : public BESSControl::Service {
     return Status::OK;
   }
 
+  Status CreatePacketPool(ServerContext*,
+                          const CreatePacketPoolRequest* request,
+                          EmptyResponse* response) override {
+    const std::string& name = request->name();
+    if (name.empty()) {
+      return return_with_error(response, EINVAL, "Missing 'name' field");
+    }
+    if (bess::PacketPool::Find(name)) {
+      return return_with_error(response, EEXIST,
+                               "Packet pool '%s' already exists",
+                               name.c_str());
+    }
+
+    uint64_t data_size = request->data_size();
+    if (data_size < bess::PacketPool::kMinDataSize ||
+        data_size > bess::PacketPool::kMaxDataSize) {
+      return return_with_error(response, EINVAL,
+                               "'data_size' must be [%zu, %zu]",
+                               bess::PacketPool::kMinDataSize,
+                               bess::PacketPool::kMaxDataSize);
+    }
+
+    uint64_t count = request->count();
+    if (count < bess::PacketPool::kMinCount) {
+      return return_with_error(response, EINVAL,
+                               "'count' must be at least %zu",
+                               bess::PacketPool::kMinCount);
+    }
+
+    int64_t socket = request->socket();
+    if (socket < -1 || socket >= RTE_MAX_NUMA_NODES) {
+      return return_with_error(response, EINVAL, "Invalid socket %d",
+                               static_cast<int>(socket));
+    }
+
+    int err;
+    if (!bess::PacketPool::Create(name, data_size, count, socket, &err)) {
+      return return_with_error(response, err,
+                               "Failed to allocate packet pool '%s': %s",
+                               name.c_str(), strerror(err));
+    }
+
+    return Status::OK;
+  }
+
+  Status ListPacketPools(ServerContext*, const EmptyRequest*,
+                         ListPacketPoolsResponse* response) override {
+    for (const auto& it : bess::PacketPool::all()) {
+      const bess::PacketPool* pool = it.second;
+      auto* status = response->add_pools();
+      status->set_name(pool->name());
+      status->set_data_size(pool->data_size());
+
+      for (int socket = 0; socket < RTE_MAX_NUMA_NODES; socket++) {
+        struct rte_mempool* mp = pool->local_mempool(socket);
+        if (!mp) {
+          continue;
+        }
+
+        auto* s = status->add_sockets();
+        s->set_socket(socket);
+        s->set_size(mp->size);
+        s->set_available(rte_mempool_avail_count(mp));
+        s->set_in_use(rte_mempool_in_use_count(mp));
+        s->set_alloc_failures(bess::PacketPool::alloc_failures(mp));
+      }
+    }
+    return Status::OK;
+  }
+
+  Status GetModuleProfile(ServerContext*,
+                          const GetModuleProfileRequest* request,
+                          GetModuleProfileResponse* response) override {
+    response->set_enabled(bess::ModuleProfiler::enabled());
+
+    for (const auto& pair : ModuleGraph::GetAllModules()) {
+      Module* m = pair.second;
+      const bess::ModuleProfile profile = bess::ModuleProfiler::Aggregate(m);
+
+      auto* p = response->add_modules();
+      p->set_name(m->name());
+      p->set_mclass(m->module_builder()->class_name());
+      p->set_calls(profile.calls);
+      p->set_packets(profile.packets);
+      p->set_cycles(profile.cycles);
+      p->set_instructions(profile.instructions);
+      p->set_llc_misses(profile.llc_misses);
+      p->set_dtlb_misses(profile.dtlb_misses);
+      p->set_memory_bytes(m->MemoryUsage());
+
+      if (request->reset()) {
+        bess::ModuleProfiler::Reset(m);
+      }
+    }
+    return Status::OK;
+  }
+
   Status ListGateHooks(ServerContext*, const EmptyRequest*,
                        ListGateHooksResponse* response) override {
     for (const auto& pair : ModuleGraph::GetAllModules()) {
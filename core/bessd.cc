@@ -51,6 +51,7 @@
 #include <tuple>
 
 #include "debug.h"
+#include "module_profiler.h"
 #include "opts.h"
 #include "port.h"
 
@@ -144,6 +145,10 @@ void ProcessCommandLineArgs() {
   if (FLAGS_f) {
     google::LogToStderr();
   }
+
+  if (FLAGS_profile_modules) {
+    bess::ModuleProfiler::Enable();
+  }
 }
 
 void CheckRunningAsRoot() {
@@ -127,7 +127,7 @@ int PCAPPort::SendPackets(queue_t, bess::Packet** pkts, int cnt) {
                               sbuf->total_len());
     } else if (sbuf->total_len() <= PCAP_SNAPLEN) {
       unsigned char tx_pcap_data[PCAP_SNAPLEN];
-      GatherData(tx_pcap_data, sbuf);
+      sbuf->CopyOut(tx_pcap_data, 0, sbuf->total_len());
       pcap_handle_.SendPacket(tx_pcap_data, sbuf->total_len());
     }
 
@@ -138,13 +138,4 @@ int PCAPPort::SendPackets(queue_t, bess::Packet** pkts, int cnt) {
   return sent;
 }
 
-void PCAPPort::GatherData(unsigned char* data, bess::Packet* pkt) {
-  while (pkt) {
-    bess::utils::CopyInlined(data, pkt->head_data(), pkt->head_len());
-
-    data += pkt->head_len();
-    pkt = reinterpret_cast<bess::Packet*>(pkt->next());
-  }
-}
-
 ADD_DRIVER(PCAPPort, "pcap_port", "libpcap live packet capture from Linux port")
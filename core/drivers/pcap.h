@@ -52,7 +52,6 @@ class PCAPPort final : public Port {
   int RecvPackets(queue_t qid, bess::Packet **pkts, int cnt) override;
 
  private:
-  void GatherData(unsigned char *data, bess::Packet *pkt);
   PcapHandle pcap_handle_;
 };
 
@@ -32,15 +32,20 @@
 
 #include <rte_ethdev_pci.h>
 
+#include <vector>
+
+#include "../packet_pool.h"
+#include "../utils/bits.h"
 #include "../utils/ether.h"
 #include "../utils/format.h"
+#include "../utils/ip.h"
+
+// Default RSS hash key length, used if the PMD does not report one.
+static const uint8_t kDefaultRssKeyLen = 40;
 
-/*!
- * The following are deprecated. Ignore us.
- */
-#define SN_TSO_SG 0
-#define SN_HW_RXCSUM 0
-#define SN_HW_TXCSUM 0
+static const uint32_t kTxOffloadChecksum =
+    DEV_TX_OFFLOAD_IPV4_CKSUM | DEV_TX_OFFLOAD_UDP_CKSUM |
+    DEV_TX_OFFLOAD_TCP_CKSUM;
 
 static const struct rte_eth_conf default_eth_conf() {
   struct rte_eth_conf ret = rte_eth_conf();
@@ -50,12 +55,11 @@ static const struct rte_eth_conf default_eth_conf() {
   ret.rxmode.mq_mode = ETH_MQ_RX_RSS;
   ret.rxmode.ignore_offload_bitfield = 1;
   ret.rxmode.offloads |= DEV_RX_OFFLOAD_CRC_STRIP;
-  ret.rxmode.offloads |= (SN_HW_RXCSUM ? DEV_RX_OFFLOAD_CHECKSUM : 0x0);
 
+  // Masked with the device capability in PMDPort::Init()
   ret.rx_adv_conf.rss_conf = {
       .rss_key = nullptr,
-      .rss_key_len = 40,
-      /* TODO: query rte_eth_dev_info_get() to set this*/
+      .rss_key_len = kDefaultRssKeyLen,
       .rss_hf = ETH_RSS_IP | ETH_RSS_UDP | ETH_RSS_TCP | ETH_RSS_SCTP,
   };
 
@@ -91,6 +95,13 @@ void PMDPort::InitDriver() {
               << dev_info.driver_name << ")   RXQ " << dev_info.max_rx_queues
               << " TXQ " << dev_info.max_tx_queues << "  " << lladdr.ToString()
               << "  " << pci_info << " numa_node " << numa_node;
+    LOG(INFO) << bess::utils::Format(
+        "  offloads rx 0x%" PRIx64 " tx 0x%" PRIx64 "  rss_hf 0x%" PRIx64
+        " reta_size %hu hash_key_size %hhu",
+        static_cast<uint64_t>(dev_info.rx_offload_capa),
+        static_cast<uint64_t>(dev_info.tx_offload_capa),
+        static_cast<uint64_t>(dev_info.flow_type_rss_offloads),
+        dev_info.reta_size, dev_info.hash_key_size);
   }
 }
 
@@ -192,6 +203,194 @@ static CommandResponse find_dpdk_vdev(const std::string &vdev,
   return CommandSuccess();
 }
 
+// Checks that "queues" can fill the RSS redirection table of the device.
+static CommandResponse validate_rss_reta(
+    uint16_t reta_size,
+    const google::protobuf::RepeatedField<uint64_t> &queues, int num_rxq) {
+  if (reta_size == 0) {
+    return CommandFailure(ENOTSUP, "Device does not support RSS RETA update");
+  }
+
+  for (uint64_t qid : queues) {
+    if (qid >= static_cast<uint64_t>(num_rxq)) {
+      return CommandFailure(EINVAL, "Invalid RX queue %" PRIu64 " in rss_reta",
+                            qid);
+    }
+  }
+
+  return CommandSuccess();
+}
+
+// Fills the RSS redirection table of the device with "queues", repeating the
+// list as many times as needed to cover all "reta_size" entries. The
+// arguments must have passed validate_rss_reta().
+static CommandResponse update_rss_reta(
+    dpdk_port_t port_id, uint16_t reta_size,
+    const google::protobuf::RepeatedField<uint64_t> &queues) {
+  std::vector<struct rte_eth_rss_reta_entry64> reta_conf(
+      (reta_size + RTE_RETA_GROUP_SIZE - 1) / RTE_RETA_GROUP_SIZE);
+
+  for (uint16_t i = 0; i < reta_size; i++) {
+    struct rte_eth_rss_reta_entry64 &group = reta_conf[i / RTE_RETA_GROUP_SIZE];
+    group.mask |= 1ull << (i % RTE_RETA_GROUP_SIZE);
+    group.reta[i % RTE_RETA_GROUP_SIZE] = queues.Get(i % queues.size());
+  }
+
+  int ret = rte_eth_dev_rss_reta_update(port_id, reta_conf.data(), reta_size);
+  if (ret != 0) {
+    return CommandFailure(-ret, "rte_eth_dev_rss_reta_update() failed");
+  }
+
+  return CommandSuccess();
+}
+
+// Parses "a.b.c.d/len" into an address and a mask
+static bool parse_ipv4_prefix(const std::string &str, bess::utils::be32_t *addr,
+                              bess::utils::be32_t *mask) {
+  size_t delim_pos = str.find('/');
+  if (delim_pos == std::string::npos ||
+      !bess::utils::ParseIpv4Address(str.substr(0, delim_pos), addr)) {
+    return false;
+  }
+
+  std::string len_str = str.substr(delim_pos + 1);
+  if (len_str.empty() || len_str.size() > 2 ||
+      len_str.find_first_not_of("0123456789") != std::string::npos) {
+    return false;
+  }
+
+  int len = std::stoi(len_str);
+  if (len > 32) {
+    return false;
+  }
+
+  *mask = bess::utils::be32_t(bess::utils::SetBitsLow<uint32_t>(len));
+  return true;
+}
+
+// Checks the fields of "rule" that do not depend on the device
+static CommandResponse validate_flow_rule(
+    const bess::pb::PMDPortArg::FlowRule &rule, int num_rxq) {
+  bess::utils::be32_t addr;
+  bess::utils::be32_t mask;
+
+  if (rule.queue() >= static_cast<uint64_t>(num_rxq)) {
+    return CommandFailure(EINVAL, "Invalid RX queue %" PRIu64 " in flow rule",
+                          rule.queue());
+  }
+
+  if (rule.ip_proto() > 0xff || rule.src_port() > 0xffff ||
+      rule.dst_port() > 0xffff) {
+    return CommandFailure(EINVAL, "Invalid ip_proto or port in flow rule");
+  }
+
+  if ((rule.src_port() || rule.dst_port()) &&
+      rule.ip_proto() != IPPROTO_TCP && rule.ip_proto() != IPPROTO_UDP) {
+    return CommandFailure(EINVAL,
+                          "ip_proto must be TCP or UDP to match on ports");
+  }
+
+  for (const std::string &prefix : {rule.src_ip(), rule.dst_ip()}) {
+    if (!prefix.empty() && !parse_ipv4_prefix(prefix, &addr, &mask)) {
+      return CommandFailure(EINVAL, "Invalid IPv4 prefix '%s' in flow rule",
+                            prefix.c_str());
+    }
+  }
+
+  return CommandSuccess();
+}
+
+// Installs a rte_flow rule that steers packets matching "rule" to its RX
+// queue. On success, *ret_flow is set to the handle of the new rule. The
+// rule must have passed validate_flow_rule().
+static CommandResponse create_flow_rule(
+    dpdk_port_t port_id, const bess::pb::PMDPortArg::FlowRule &rule,
+    struct rte_flow **ret_flow) {
+  using bess::utils::be16_t;
+  using bess::utils::be32_t;
+
+  struct rte_flow_attr attr = {};
+  attr.ingress = 1;
+
+  struct rte_flow_item_ipv4 ip_spec = {};
+  struct rte_flow_item_ipv4 ip_mask = {};
+  if (!rule.src_ip().empty()) {
+    be32_t addr;
+    be32_t mask;
+    parse_ipv4_prefix(rule.src_ip(), &addr, &mask);
+    ip_spec.hdr.src_addr = (addr & mask).raw_value();
+    ip_mask.hdr.src_addr = mask.raw_value();
+  }
+  if (!rule.dst_ip().empty()) {
+    be32_t addr;
+    be32_t mask;
+    parse_ipv4_prefix(rule.dst_ip(), &addr, &mask);
+    ip_spec.hdr.dst_addr = (addr & mask).raw_value();
+    ip_mask.hdr.dst_addr = mask.raw_value();
+  }
+  if (rule.ip_proto()) {
+    ip_spec.hdr.next_proto_id = rule.ip_proto();
+    ip_mask.hdr.next_proto_id = 0xff;
+  }
+
+  std::vector<struct rte_flow_item> pattern;
+  pattern.push_back({RTE_FLOW_ITEM_TYPE_ETH, nullptr, nullptr, nullptr});
+  pattern.push_back({RTE_FLOW_ITEM_TYPE_IPV4, &ip_spec, nullptr, &ip_mask});
+
+  // TCP and UDP headers both begin with the source and destination ports
+  struct rte_flow_item_tcp tcp_spec = {};
+  struct rte_flow_item_tcp tcp_mask = {};
+  struct rte_flow_item_udp udp_spec = {};
+  struct rte_flow_item_udp udp_mask = {};
+  if (rule.src_port() || rule.dst_port()) {
+    uint16_t src_port = be16_t(rule.src_port()).raw_value();
+    uint16_t dst_port = be16_t(rule.dst_port()).raw_value();
+    uint16_t src_mask = rule.src_port() ? 0xffff : 0;
+    uint16_t dst_mask = rule.dst_port() ? 0xffff : 0;
+
+    if (rule.ip_proto() == IPPROTO_TCP) {
+      tcp_spec.hdr.src_port = src_port;
+      tcp_spec.hdr.dst_port = dst_port;
+      tcp_mask.hdr.src_port = src_mask;
+      tcp_mask.hdr.dst_port = dst_mask;
+      pattern.push_back(
+          {RTE_FLOW_ITEM_TYPE_TCP, &tcp_spec, nullptr, &tcp_mask});
+    } else {
+      udp_spec.hdr.src_port = src_port;
+      udp_spec.hdr.dst_port = dst_port;
+      udp_mask.hdr.src_port = src_mask;
+      udp_mask.hdr.dst_port = dst_mask;
+      pattern.push_back(
+          {RTE_FLOW_ITEM_TYPE_UDP, &udp_spec, nullptr, &udp_mask});
+    }
+  }
+
+  pattern.push_back({RTE_FLOW_ITEM_TYPE_END, nullptr, nullptr, nullptr});
+
+  struct rte_flow_action_queue queue = {};
+  queue.index = rule.queue();
+
+  struct rte_flow_action actions[] = {
+      {RTE_FLOW_ACTION_TYPE_QUEUE, &queue},
+      {RTE_FLOW_ACTION_TYPE_END, nullptr},
+  };
+
+  struct rte_flow_error error = {};
+  int ret = rte_flow_validate(port_id, &attr, pattern.data(), actions, &error);
+  if (ret != 0) {
+    return CommandFailure(-ret, "Device cannot offload flow rule: %s",
+                          error.message ? error.message : "unknown error");
+  }
+
+  *ret_flow = rte_flow_create(port_id, &attr, pattern.data(), actions, &error);
+  if (!*ret_flow) {
+    return CommandFailure(EIO, "rte_flow_create() failed: %s",
+                          error.message ? error.message : "unknown error");
+  }
+
+  return CommandSuccess();
+}
+
 CommandResponse PMDPort::Init(const bess::pb::PMDPortArg &arg) {
   dpdk_port_t ret_port_id = DPDK_PORT_UNKNOWN;
 
@@ -255,10 +454,60 @@ CommandResponse PMDPort::Init(const bess::pb::PMDPortArg &arg) {
     eth_rxconf.rx_drop_en = 1;
   }
 
+  if (arg.rx_offload_checksum()) {
+    if ((dev_info.rx_offload_capa & DEV_RX_OFFLOAD_CHECKSUM) !=
+        DEV_RX_OFFLOAD_CHECKSUM) {
+      return CommandFailure(ENOTSUP,
+                            "Device does not support RX checksum offload");
+    }
+    eth_conf.rxmode.offloads |= DEV_RX_OFFLOAD_CHECKSUM;
+  }
+
+  uint32_t tx_offloads = 0;
+  tx_offloads |= arg.tx_offload_checksum() ? kTxOffloadChecksum : 0;
+  tx_offloads |= arg.tx_offload_tso() ? DEV_TX_OFFLOAD_TCP_TSO : 0;
+  if ((dev_info.tx_offload_capa & tx_offloads) != tx_offloads) {
+    return CommandFailure(ENOTSUP, "Device does not support TX offloads 0x%x",
+                          tx_offloads & ~dev_info.tx_offload_capa);
+  }
+
   eth_txconf = dev_info.default_txconf;
-  eth_txconf.txq_flags = ETH_TXQ_FLAGS_NOVLANOFFL |
-                         ETH_TXQ_FLAGS_NOMULTSEGS * (1 - SN_TSO_SG) |
-                         ETH_TXQ_FLAGS_NOXSUMS * (1 - SN_HW_TXCSUM);
+  eth_txconf.txq_flags = ETH_TXQ_FLAGS_NOVLANOFFL;
+  // Chained packets may come from anywhere in the pipeline (GRO, Share()), so
+  // multi-segment TX stays enabled unless the user vouches otherwise
+  if (arg.tx_single_segment() && !arg.tx_offload_tso()) {
+    eth_txconf.txq_flags |= ETH_TXQ_FLAGS_NOMULTSEGS;
+  }
+  if (!arg.tx_offload_checksum() && !arg.tx_offload_tso()) {
+    eth_txconf.txq_flags |= ETH_TXQ_FLAGS_NOXSUMS;
+  }
+
+  // Only request hash types that the device can compute. Some PMDs (e.g.,
+  // virtio) support none, in which case RSS is disabled altogether.
+  eth_conf.rx_adv_conf.rss_conf.rss_hf &= dev_info.flow_type_rss_offloads;
+  if (eth_conf.rx_adv_conf.rss_conf.rss_hf == 0) {
+    eth_conf.rxmode.mq_mode = ETH_MQ_RX_NONE;
+  }
+
+  std::vector<uint8_t> rss_key(arg.rss_key().begin(), arg.rss_key().end());
+  if (!rss_key.empty()) {
+    size_t key_len =
+        dev_info.hash_key_size ? dev_info.hash_key_size : kDefaultRssKeyLen;
+    if (rss_key.size() != key_len) {
+      return CommandFailure(EINVAL, "rss_key must be %zu bytes long", key_len);
+    }
+    eth_conf.rx_adv_conf.rss_conf.rss_key = rss_key.data();
+    eth_conf.rx_adv_conf.rss_conf.rss_key_len = key_len;
+  }
+
+  const bess::PacketPool *pool = bess::PacketPool::Default();
+  if (!arg.pool().empty()) {
+    pool = bess::PacketPool::Find(arg.pool());
+    if (!pool) {
+      return CommandFailure(ENOENT, "Packet pool '%s' does not exist",
+                            arg.pool().c_str());
+    }
+  }
 
   ret = rte_eth_dev_configure(ret_port_id, num_rxq, num_txq, &eth_conf);
   if (ret != 0) {
@@ -286,9 +535,8 @@ CommandResponse PMDPort::Init(const bess::pb::PMDPortArg &arg) {
       sid = 0;
     }
 
-    ret =
-        rte_eth_rx_queue_setup(ret_port_id, i, queue_size[PACKET_DIR_INC], sid,
-                               &eth_rxconf, bess::get_pframe_pool_socket(sid));
+    ret = rte_eth_rx_queue_setup(ret_port_id, i, queue_size[PACKET_DIR_INC],
+                                 sid, &eth_rxconf, pool->mempool(sid));
     if (ret != 0) {
       return CommandFailure(-ret, "rte_eth_rx_queue_setup() failed");
     }
@@ -305,12 +553,50 @@ CommandResponse PMDPort::Init(const bess::pb::PMDPortArg &arg) {
     }
   }
 
+  // Check everything that can be checked before the device starts, so that
+  // most errors leave it stopped
+  if (arg.rss_reta_size() > 0) {
+    err = validate_rss_reta(dev_info.reta_size, arg.rss_reta(), num_rxq);
+    if (err.error().code() != 0) {
+      return err;
+    }
+  }
+
+  for (const auto &rule : arg.flow_rules()) {
+    err = validate_flow_rule(rule, num_rxq);
+    if (err.error().code() != 0) {
+      return err;
+    }
+  }
+
   ret = rte_eth_dev_start(ret_port_id);
   if (ret != 0) {
     return CommandFailure(-ret, "rte_eth_dev_start() failed");
   }
   dpdk_port_id_ = ret_port_id;
 
+  if (arg.rss_reta_size() > 0) {
+    err = update_rss_reta(dpdk_port_id_, dev_info.reta_size, arg.rss_reta());
+  }
+
+  for (const auto &rule : arg.flow_rules()) {
+    if (err.error().code() != 0) {
+      break;
+    }
+    struct rte_flow *flow;
+    err = create_flow_rule(dpdk_port_id_, rule, &flow);
+    if (err.error().code() == 0) {
+      flows_.push_back(flow);
+    }
+  }
+
+  // The port is destroyed without DeInit() if Init() fails
+  if (err.error().code() != 0) {
+    DestroyFlows();
+    rte_eth_dev_stop(dpdk_port_id_);
+    return err;
+  }
+
   numa_node = rte_eth_dev_socket_id(static_cast<int>(ret_port_id));
   node_placement_ =
       numa_node == -1 ? UNCONSTRAINED_SOCKET : (1ull << numa_node);
@@ -364,7 +650,20 @@ int PMDPort::UpdateConf(const Conf &conf) {
   return 0;
 }
 
+void PMDPort::DestroyFlows() {
+  for (struct rte_flow *flow : flows_) {
+    struct rte_flow_error error;
+    if (rte_flow_destroy(dpdk_port_id_, flow, &error) != 0) {
+      LOG(WARNING) << "rte_flow_destroy() failed: "
+                   << (error.message ? error.message : "unknown error");
+    }
+  }
+  flows_.clear();
+}
+
 void PMDPort::DeInit() {
+  DestroyFlows();
+
   rte_eth_dev_stop(dpdk_port_id_);
 
   if (hot_plugged_) {
@@ -439,10 +738,8 @@ int PMDPort::RecvPackets(queue_t qid, bess::Packet **pkts, int cnt) {
 }
 
 int PMDPort::SendPackets(queue_t qid, bess::Packet **pkts, int cnt) {
-  int sent = rte_eth_tx_burst(dpdk_port_id_, qid,
-                              reinterpret_cast<struct rte_mbuf **>(pkts), cnt);
-  queue_stats[PACKET_DIR_OUT][qid].dropped += (cnt - sent);
-  return sent;
+  return rte_eth_tx_burst(dpdk_port_id_, qid,
+                          reinterpret_cast<struct rte_mbuf **>(pkts), cnt);
 }
 
 Port::LinkStatus PMDPort::GetLinkStatus() {
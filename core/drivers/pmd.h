@@ -32,10 +32,12 @@
 #define BESS_DRIVERS_PMD_H_
 
 #include <string>
+#include <vector>
 
 #include <rte_config.h>
 #include <rte_errno.h>
 #include <rte_ethdev.h>
+#include <rte_flow.h>
 
 #include "../module.h"
 #include "../port.h"
@@ -67,9 +69,17 @@ class PMDPort final : public Port {
    * * string pci : The PCI address of the port to bind to.
    * * string vdev : If a virtual device, the virtual device address (e.g.
    * tun/tap)
+   * * bool rx_offload_checksum, tx_offload_checksum, tx_offload_tso :
+   * hardware offloads to enable.
+   * * bytes rss_key, repeated uint64 rss_reta : RSS hash key and redirection
+   * table.
+   * * repeated FlowRule flow_rules : rte_flow rules steering packets to queues.
+   * * bool tx_single_segment : no chained packets are sent, so the PMD may
+   * use its single-segment TX path.
    *
    * EXPECTS:
    * * Must specify exactly one of port_id or PCI or vdev.
+   * * Requested offloads must be supported by the device.
    */
   CommandResponse Init(const bess::pb::PMDPortArg &arg);
 
@@ -155,6 +165,13 @@ class PMDPort final : public Port {
   placement_constraint node_placement_;
 
   std::string driver_;  // ixgbe, i40e, ...
+
+  void DestroyFlows();
+
+  /*!
+   * rte_flow rules installed at Init(), destroyed at DeInit().
+   */
+  std::vector<struct rte_flow *> flows_;
 };
 
 #endif  // BESS_DRIVERS_PMD_H_
@@ -39,16 +39,58 @@
 #if MEM_ALLOC_PROVIDER == LIBC
 
 #include <malloc.h>
+#include <numaif.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
 
-void *mem_alloc(size_t size) {
-  return calloc(1, size);
+static size_t page_size() {
+  static const size_t size = sysconf(_SC_PAGESIZE);
+  return size;
+}
+
+/* Sets the memory policy of [addr, addr + len) to prefer 'socket', moving
+ * any pages already faulted in. A negative socket restores the default. */
+static int bind_pages(void *addr, size_t len, int socket) {
+  unsigned long nodemask;
+  int ret;
+
+  if (socket < 0) {
+    ret = mbind(addr, len, MPOL_DEFAULT, nullptr, 0, 0);
+  } else {
+    /* mbind() only looks at maxnode - 1 bits of the mask */
+    if (socket >= static_cast<int>(sizeof(nodemask) * 8 - 1)) {
+      return -EINVAL;
+    }
+    nodemask = 1ul << socket;
+    ret = mbind(addr, len, MPOL_PREFERRED, &nodemask, sizeof(nodemask) * 8,
+                MPOL_MF_MOVE);
+  }
+
+  return ret ? -errno : 0;
+}
+
+/* Same as above, for the pages that lie entirely within [addr, addr + len).
+ * Others may hold unrelated data. */
+static int bind_whole_pages(void *addr, size_t len, int socket) {
+  const uintptr_t pg = page_size();
+  uintptr_t start = reinterpret_cast<uintptr_t>(addr);
+  uintptr_t end = start + len;
+
+  start = (start + pg - 1) & ~(pg - 1);
+  end &= ~(pg - 1);
+  if (end <= start) {
+    return 0;
+  }
+
+  return bind_pages(reinterpret_cast<void *>(start), end - start, socket);
 }
 
-/* TODO: socket is ignored for now */
-void *mem_alloc_ex(size_t size, size_t align, int) {
+static void *alloc_on_socket(size_t size, size_t align, int socket) {
   void *ptr;
   int ret;
 
@@ -56,11 +98,53 @@ void *mem_alloc_ex(size_t size, size_t align, int) {
   if (ret)
     return nullptr;
 
+  /* Set the policy before memset() faults the pages in. Failure (e.g., no
+   * NUMA support in the kernel) is not fatal; we just lose locality. */
+  if (socket >= 0) {
+    bind_whole_pages(ptr, size, socket);
+  }
+
   memset(ptr, 0, size);
 
   return ptr;
 }
 
+void *mem_alloc(size_t size) {
+  return calloc(1, size);
+}
+
+void *mem_alloc_ex(size_t size, size_t align, int socket) {
+  return alloc_on_socket(size, align, socket);
+}
+
+void *mem_alloc_movable(size_t size, size_t align, int socket) {
+  const size_t pg = page_size();
+
+  align = std::max(align, pg);
+  size = std::max((size + pg - 1) & ~(pg - 1), pg);
+
+  return alloc_on_socket(size, align, socket);
+}
+
+int mem_migrate(void *ptr, int socket) {
+  return bind_whole_pages(ptr, malloc_usable_size(ptr), socket);
+}
+
+int mem_socket(const void *ptr) {
+  int node = -1;
+
+  if (get_mempolicy(&node, nullptr, 0, const_cast<void *>(ptr),
+                    MPOL_F_NODE | MPOL_F_ADDR)) {
+    return -errno;
+  }
+
+  return node;
+}
+
+size_t mem_usable_size(const void *ptr) {
+  return ptr ? malloc_usable_size(const_cast<void *>(ptr)) : 0;
+}
+
 void *mem_realloc(void *ptr, size_t size) {
   size_t old_size = malloc_usable_size(ptr);
   char *new_ptr = static_cast<char *>(realloc(ptr, size));
@@ -78,6 +162,8 @@ void mem_free(void *ptr) {
 
 #elif MEM_ALLOC_PROVIDER == DPDK
 
+#include <cerrno>
+
 #include <rte_config.h>
 #include <rte_malloc.h>
 
@@ -85,6 +171,34 @@ void *mem_alloc(size_t size) {
   return rte_zmalloc(/* name= */ nullptr, size, /* align= */ 0);
 }
 
+void *mem_alloc_ex(size_t size, size_t align, int socket) {
+  return rte_zmalloc_socket(/* name= */ nullptr, size, align,
+                            socket < 0 ? SOCKET_ID_ANY : socket);
+}
+
+void *mem_alloc_movable(size_t size, size_t align, int socket) {
+  return mem_alloc_ex(size, align, socket);
+}
+
+/* hugepage memory cannot be moved once allocated */
+int mem_migrate(void *, int) {
+  return -ENOTSUP;
+}
+
+int mem_socket(const void *) {
+  return -ENOTSUP;
+}
+
+size_t mem_usable_size(const void *ptr) {
+  size_t size;
+
+  if (!ptr || rte_malloc_validate(ptr, &size)) {
+    return 0;
+  }
+
+  return size;
+}
+
 void *mem_realloc(void *ptr, size_t size) {
   return rte_realloc(ptr, size, /* align= */ 0);
 }
@@ -40,8 +40,29 @@
 
 void *mem_alloc(size_t size); /* zero initialized by default */
 
+/* Zero-initialized allocation aligned to 'align', preferably on NUMA node
+ * 'socket'. Only pages that the allocation covers entirely can be placed, so
+ * small ones land wherever the allocator has room. A negative socket leaves
+ * placement to the kernel (first touch). */
 void *mem_alloc_ex(size_t size, size_t align, int socket);
 
+/* Same as mem_alloc_ex(), but page aligned and rounded up to whole pages, so
+ * that the allocation can be placed, and later moved with mem_migrate(), as a
+ * whole. Meant for long-lived per-module state; it costs at least a page. */
+void *mem_alloc_movable(size_t size, size_t align, int socket);
+
+/* Moves the pages that lie entirely within an allocation to 'socket', which
+ * is all of them for mem_alloc_movable(). Returns 0 on success, -errno
+ * otherwise. */
+int mem_migrate(void *ptr, int socket);
+
+/* Returns the NUMA node backing the page at 'ptr', or -errno. */
+int mem_socket(const void *ptr);
+
+/* Returns the number of usable bytes of an allocation (possibly larger than
+ * requested), or 0 if 'ptr' is nullptr. */
+size_t mem_usable_size(const void *ptr);
+
 void *mem_realloc(void *ptr, size_t size);
 
 void mem_free(void *ptr);
@@ -49,9 +49,9 @@ Pipeline default_pipeline;
 
 // Helpers -----------------------------------------------------------------
 
-static mt_offset_t ComputeNextOffset(mt_offset_t curr_offset, int8_t size) {
+static mt_offset_t ComputeNextOffset(mt_offset_t curr_offset, int size) {
   uint32_t overflow;
-  int8_t rounded_size;
+  int rounded_size;
 
   rounded_size = align_ceil_pow2(size);
 
@@ -74,7 +74,7 @@ static void CheckOrphanReaders() {
 
     size_t i = 0;
     for (const auto &attr : m->all_attrs()) {
-      if (m->attr_offset(i) == kMetadataOffsetNoRead) {
+      if (m->attr_offset(i) == kMetadataOffsetNoRead && !attr.optional) {
         LOG(WARNING) << "Metadata attr " << attr.name << "/" << attr.size
                      << " of module " << m->name() << " has "
                      << "no upstream module that sets the value!";
@@ -106,7 +106,13 @@ class ScopeComponentComp {
   bool reverse_;
 };
 
-static bool DegreeComp(const ScopeComponent &a, const ScopeComponent &b) {
+// Attributes accessed by more modules come first, so that they get the lowest
+// offsets and tend to share the first cache line of the metadata area.
+// Among equally hot ones, the more constrained (higher degree) come first.
+static bool HotnessComp(const ScopeComponent &a, const ScopeComponent &b) {
+  if (a.accesses() != b.accesses()) {
+    return a.accesses() > b.accesses();
+  }
   return a.degree() > b.degree();
 }
 
@@ -362,7 +368,7 @@ void Pipeline::AssignOffsets() {
       continue;
     }
 
-    offset = 0;
+    offset = ComputeNextOffset(0, comp1->size());
 
     for (size_t j = 0; j < scope_components_.size(); j++) {
       if (i == j) {
@@ -375,22 +381,27 @@ void Pipeline::AssignOffsets() {
       }
     }
 
-    while (!h.empty()) {
+    // First fit. Components are visited in the order of their offsets.
+    while (!h.empty() && offset != kMetadataOffsetNoSpace) {
       comp2 = h.top();
       h.pop();
 
-      if (comp2->offset() == kMetadataOffsetNoRead ||
-          comp2->offset() == kMetadataOffsetNoWrite ||
-          comp2->offset() == kMetadataOffsetNoSpace) {
+      if (!IsValidOffset(comp2->offset())) {
         continue;
       }
 
-      if (offset + comp1->size() > comp2->offset()) {
-        offset =
-            ComputeNextOffset(comp2->offset() + comp2->size(), comp1->size());
-      } else {
+      if (offset + comp1->size() <= comp2->offset()) {
         break;
       }
+
+      // comp2 ends before the current candidate (e.g., it is nested in a
+      // component that has already pushed the candidate past it)
+      if (comp2->offset() + comp2->size() <= offset) {
+        continue;
+      }
+
+      offset =
+          ComputeNextOffset(comp2->offset() + comp2->size(), comp1->size());
     }
 
     comp1->set_offset(offset);
@@ -431,6 +442,19 @@ void Pipeline::LogAllScopes() const {
   }
 }
 
+void Pipeline::ComputeScopeAccesses() {
+  for (auto &component : scope_components_) {
+    for (const Module *m : component.modules()) {
+      for (const auto &attr : m->all_attrs()) {
+        if (get_attr_id(&attr) == component.attr_id()) {
+          component.incr_accesses();
+          break;
+        }
+      }
+    }
+  }
+}
+
 void Pipeline::ComputeScopeDegrees() {
   for (size_t i = 0; i < scope_components_.size(); i++) {
     for (size_t j = i + 1; j < scope_components_.size(); j++) {
@@ -475,7 +499,8 @@ int Pipeline::ComputeMetadataOffsets() {
   }
 
   ComputeScopeDegrees();
-  std::sort(scope_components_.begin(), scope_components_.end(), DegreeComp);
+  ComputeScopeAccesses();
+  std::sort(scope_components_.begin(), scope_components_.end(), HotnessComp);
   AssignOffsets();
 
   if (VLOG_IS_ON(1)) {
@@ -51,7 +51,7 @@ static_assert(kMetadataAttrMaxSize <= SIZE_MAX,
               "Max metadata attr size check failed");
 
 // Max number of attributes per module.
-static const size_t kMaxAttrsPerModule = 16;
+static const size_t kMaxAttrsPerModule = 32;
 static_assert(kMaxAttrsPerModule <= SIZE_MAX,
               "Max metadata attrs per module check failed");
 
@@ -61,7 +61,9 @@ static_assert(kMetadataTotalSize <= SIZE_MAX,
               "Total metadata size check failed");
 
 // Normal offset values are 0 or a positive value.
-typedef int8_t mt_offset_t;
+typedef int16_t mt_offset_t;
+static_assert(kMetadataTotalSize <= INT16_MAX,
+              "Metadata offsets must fit in mt_offset_t");
 typedef int16_t scope_id_t;
 
 // No downstream module reads the attribute, so the module can skip writing.
@@ -78,11 +80,12 @@ static inline int IsValidOffset(mt_offset_t offset) {
 }
 
 struct Attribute {
-  Attribute() : name(), size(), mode(), scope_id() {}
+  Attribute() : name(), size(), mode(), optional(), scope_id() {}
 
   std::string name;
   size_t size;  // in bytes
   enum class AccessMode { kRead = 0, kWrite, kUpdate } mode;
+  bool optional;  // reader can do without it, so no warning if never set
   mutable int scope_id;
 };
 
@@ -98,7 +101,8 @@ class ScopeComponent {
         assigned_(),
         invalid_(),
         modules_(),
-        degree_() {}
+        degree_(),
+        accesses_() {}
 
   ~ScopeComponent() {}
 
@@ -127,6 +131,11 @@ class ScopeComponent {
   int degree() const { return degree_; }
   void incr_degree() { degree_++; }
 
+  // Number of modules in the component that read or write the attribute,
+  // as opposed to those that just pass it through.
+  int accesses() const { return accesses_; }
+  void incr_accesses() { accesses_++; }
+
   bool DisjointFrom(const ScopeComponent &rhs);
 
  private:
@@ -141,6 +150,7 @@ class ScopeComponent {
   bool invalid_;
   std::set<Module *> modules_;
   int degree_;
+  int accesses_;
 };
 
 class Pipeline {
@@ -196,6 +206,7 @@ class Pipeline {
   void FillOffsetArrays();
   void AssignOffsets();
   void ComputeScopeDegrees();
+  void ComputeScopeAccesses();
 
   std::vector<ScopeComponent> scope_components_;
 
@@ -351,5 +351,78 @@ TEST_F(MetadataTest, ScopeComponentDegreeOrder) {
               (m4->attr_offset(1) + 6 <= m3->attr_offset(4)));
 }
 
+// Attributes used by more modules should be packed first, at low offsets.
+TEST_F(MetadataTest, HotAttrsFirst) {
+  Module *m2 = create_foo();
+  ASSERT_NE(nullptr, m2);
+
+  ASSERT_EQ(0, m0->AddMetadataAttr("cold", 4, Attribute::AccessMode::kWrite));
+  ASSERT_EQ(1, m0->AddMetadataAttr("hot", 4, Attribute::AccessMode::kWrite));
+  ASSERT_EQ(0, m1->AddMetadataAttr("cold", 4, Attribute::AccessMode::kRead));
+  ASSERT_EQ(1, m1->AddMetadataAttr("hot", 4, Attribute::AccessMode::kRead));
+  ASSERT_EQ(0, m2->AddMetadataAttr("hot", 4, Attribute::AccessMode::kRead));
+  ModuleGraph::ConnectModules(m0, 0, m1, 0);
+  ModuleGraph::ConnectModules(m1, 0, m2, 0);
+
+  ASSERT_EQ(0, default_pipeline.ComputeMetadataOffsets());
+
+  ASSERT_EQ(0, m0->attr_offset(1));
+  ASSERT_EQ(0, m2->attr_offset(0));
+  ASSERT_EQ(4, m0->attr_offset(0));
+  ASSERT_EQ(4, m1->attr_offset(0));
+}
+
+TEST_F(MetadataTest, TypedAttrHandles) {
+  WriteAttr<uint32_t> w;
+  ReadAttr<uint32_t> r;
+  ReadAttr<uint16_t> unwritten;
+
+  ASSERT_EQ(0, w.Register(m0, "a"));
+  ASSERT_EQ(0, r.Register(m1, "a"));
+  ASSERT_EQ(1, unwritten.Register(m1, "b"));
+  ModuleGraph::ConnectModules(m0, 0, m1, 0);
+
+  ASSERT_EQ(0, default_pipeline.ComputeMetadataOffsets());
+
+  // Handles follow the offsets assigned to their modules
+  ASSERT_TRUE(r.valid());
+  ASSERT_EQ(m0->attr_offset(0), w.offset());
+  ASSERT_EQ(m1->attr_offset(0), r.offset());
+  ASSERT_EQ(w.offset(), r.offset());
+  ASSERT_FALSE(unwritten.valid());
+
+  PacketBatch batch;
+  batch.clear();
+  for (int i = 0; i < 4; i++) {
+    batch.add(new Packet());
+  }
+
+  uint32_t in[PacketBatch::kMaxBurst] = {1, 2, 3, 4};
+  uint32_t out[PacketBatch::kMaxBurst] = {};
+  w.Scatter(&batch, in);
+  r.Gather(&batch, out);
+  for (int i = 0; i < 4; i++) {
+    EXPECT_EQ(in[i], out[i]);
+    EXPECT_EQ(in[i], r.get(batch.pkts()[i]));
+  }
+
+  w.Fill(&batch, 42);
+  r.Gather(&batch, out);
+  for (int i = 0; i < 4; i++) {
+    EXPECT_EQ(42, out[i]);
+  }
+
+  // Reading an attribute that nobody writes yields zero values
+  uint16_t garbage[PacketBatch::kMaxBurst] = {7, 7, 7, 7};
+  unwritten.Gather(&batch, garbage);
+  for (int i = 0; i < 4; i++) {
+    EXPECT_EQ(0, garbage[i]);
+  }
+
+  for (int i = 0; i < 4; i++) {
+    delete batch.pkts()[i];
+  }
+}
+
 }  // namespace metadata
 }  // namespace bess
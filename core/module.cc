@@ -33,6 +33,7 @@
 #include <glog/logging.h>
 
 #include <algorithm>
+#include <cstring>
 #include <sstream>
 
 #include "gate.h"
@@ -121,6 +122,13 @@ Module *ModuleBuilder::CreateModule(const std::string &name,
   m->set_name(name);
   m->set_module_builder(this);
   m->set_pipeline(pipeline);
+
+  if (bess::ModuleProfiler::enabled()) {
+    m->profile_ = static_cast<bess::ModuleProfile *>(mem_alloc_ex(
+        sizeof(bess::ModuleProfile) * Worker::kMaxWorkers,
+        alignof(bess::ModuleProfile), -1));
+  }
+
   return m;
 }
 
@@ -236,8 +244,117 @@ CheckConstraintResult Module::CheckModuleConstraints() const {
   return valid;
 }
 
+int Module::PreferredSocket() const {
+  std::unordered_set<const Module *> visited;
+  placement_constraint allowed = ComputePlacementConstraints(&visited);
+  placement_constraint used = 0;
+
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    if (active_workers_[wid] && workers[wid]) {
+      used |= 1ull << workers[wid]->socket();
+    }
+  }
+
+  // Prefer where the workers actually run. Fall back to the constraints if no
+  // worker is attached (yet) or the workers span several sockets.
+  placement_constraint candidates = used;
+  if (__builtin_popcountll(candidates) != 1) {
+    candidates = (used & allowed) ? (used & allowed) : allowed;
+  }
+
+  if (__builtin_popcountll(candidates) != 1) {
+    return -1;
+  }
+
+  return __builtin_ctzll(candidates);
+}
+
+void Module::UpdateMemoryPlacement() {
+  int socket = PreferredSocket();
+
+  // Memory stays where it is if there is no better place.
+  if (socket < 0 || socket == socket_) {
+    return;
+  }
+
+  socket_ = socket;
+
+  int ret = mem_migrate(this, socket);
+  for (void *ptr : mem_regions_) {
+    if (ret) {
+      break;
+    }
+    ret = mem_migrate(ptr, socket);
+  }
+  if (!ret && arena_) {
+    ret = arena_->Migrate(socket);
+  }
+
+  if (ret) {
+    LOG(WARNING) << "Failed to move memory of module " << name_
+                 << " to socket " << socket << ": " << strerror(-ret);
+  } else {
+    VLOG(1) << "Module " << name_ << " placed on socket " << socket;
+  }
+}
+
+void *Module::AllocMemory(size_t size, size_t align) {
+  void *ptr = mem_alloc_movable(size, align, socket_);
+  if (ptr) {
+    TrackMemory(ptr);
+  }
+  return ptr;
+}
+
+void Module::FreeMemory(void *ptr) {
+  if (ptr) {
+    UntrackMemory(ptr);
+    mem_free(ptr);
+  }
+}
+
+int Module::CreateArena(size_t bytes) {
+  if (arena_) {
+    return -EEXIST;
+  }
+
+  std::unique_ptr<bess::utils::Arena> arena(new bess::utils::Arena());
+  int ret = arena->Init(bytes, socket_);
+  if (ret) {
+    return ret;
+  }
+
+  arena_ = std::move(arena);
+  return 0;
+}
+
+size_t Module::MemoryUsage() const {
+  size_t bytes = mem_usable_size(this);
+
+  for (const void *ptr : mem_regions_) {
+    bytes += mem_usable_size(ptr);
+  }
+
+  if (arena_) {
+    bytes += arena_->capacity() + arena_->overflow();
+  }
+
+  return bytes;
+}
+
+void Module::TrackMemory(void *ptr) {
+  mem_regions_.push_back(ptr);
+}
+
+void Module::UntrackMemory(void *ptr) {
+  mem_regions_.erase(
+      std::remove(mem_regions_.begin(), mem_regions_.end(), ptr),
+      mem_regions_.end());
+}
+
 int Module::AddMetadataAttr(const std::string &name, size_t size,
-                            bess::metadata::Attribute::AccessMode mode) {
+                            bess::metadata::Attribute::AccessMode mode,
+                            bool optional) {
   int ret;
 
   if (attrs_.size() >= bess::metadata::kMaxAttrsPerModule)
@@ -264,6 +381,7 @@ int Module::AddMetadataAttr(const std::string &name, size_t size,
   attr.name = name;
   attr.size = size;
   attr.mode = mode;
+  attr.optional = optional;
   attr.scope_id = -1;
 
   attrs_.push_back(attr);
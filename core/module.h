@@ -31,8 +31,10 @@
 #ifndef BESS_MODULE_H_
 #define BESS_MODULE_H_
 
+#include <algorithm>
 #include <atomic>
 #include <map>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -44,7 +46,9 @@
 #include "gate.h"
 #include "message.h"
 #include "metadata.h"
+#include "module_profiler.h"
 #include "packet.h"
+#include "utils/arena.h"
 
 using bess::gate_idx_t;
 
@@ -181,8 +185,10 @@ enum CheckConstraintResult {
 class alignas(64) Module {
   // overide this section to create a new module -----------------------------
  public:
+  // The object is placed on the socket of its workers once they are known.
+  // See UpdateMemoryPlacement().
   static void *operator new(std::size_t size) {
-    return mem_alloc_ex(size, alignof(Module), 0);
+    return mem_alloc_movable(size, alignof(Module), -1);
   }
 
   static void operator delete(void *ptr) { mem_free(ptr); }
@@ -202,11 +208,15 @@ class alignas(64) Module {
         parent_tasks_(),
         children_overload_(0),
         overload_(false),
+        socket_(-1),
+        mem_regions_(),
+        arena_(),
+        profile_(),
         node_constraints_(UNCONSTRAINED_SOCKET),
         min_allowed_workers_(1),
         max_allowed_workers_(1),
         propagate_workers_(true) {}
-  virtual ~Module() {}
+  virtual ~Module() { mem_free(profile_); }
 
   CommandResponse Init(const bess::pb::EmptyArg &arg);
 
@@ -291,9 +301,12 @@ class alignas(64) Module {
   // automatically registered, so only attributes specific to a module
   // 'instance'
   // need this function.
+  // If `optional`, the module copes with the attribute not being set upstream
+  // (e.g., it computes the value by itself), so it is not warned about.
   // Returns its allocated ID (>= 0), or a negative number for error */
   int AddMetadataAttr(const std::string &name, size_t size,
-                      bess::metadata::Attribute::AccessMode mode);
+                      bess::metadata::Attribute::AccessMode mode,
+                      bool optional = false);
 
   CommandResponse RunCommand(const std::string &cmd,
                              const google::protobuf::Any &arg) {
@@ -377,6 +390,48 @@ class alignas(64) Module {
 
   virtual CheckConstraintResult CheckModuleConstraints() const;
 
+  // The NUMA node this module's state should live on, derived from the
+  // sockets of the active workers and the placement constraints of the
+  // pipeline. Returns -1 if there is no single best node.
+  int PreferredSocket() const;
+
+  // NUMA node the module's memory currently targets (-1 if not placed yet).
+  int socket() const { return socket_; }
+
+  // Moves the module object and all memory regions obtained through
+  // AllocMemory()/TrackMemory() to PreferredSocket(). Should be called after
+  // active workers have been propagated, while workers are paused.
+  void UpdateMemoryPlacement();
+
+  // Allocates zeroed memory for per-module state (tables, rings, ...) on the
+  // module's socket. The region is migrated along with the module if its
+  // placement changes. Must be released with FreeMemory().
+  void *AllocMemory(size_t size, size_t align);
+  void FreeMemory(void *ptr);
+
+  // Same as above for regions obtained directly from mem_alloc_movable().
+  void TrackMemory(void *ptr);
+  void UntrackMemory(void *ptr);
+
+  // Reserves a hugepage-backed arena of 'bytes' for large per-module data
+  // structures (use bess::utils::ArenaAllocator). Typically called from Init()
+  // with a size taken from the module arguments. Returns 0 or -errno.
+  int CreateArena(size_t bytes);
+
+  // nullptr if the module has no arena
+  bess::utils::Arena *arena() const { return arena_.get(); }
+
+  // Approximate bytes of memory held by the module: the module object, its
+  // tracked memory regions and its arena. Modules that keep large tables in
+  // standard containers should add them.
+  virtual size_t MemoryUsage() const;
+
+  // Profile of worker 'wid', or nullptr if profiling is not enabled.
+  // See ModuleProfiler.
+  bess::ModuleProfile *profile(int wid) const {
+    return profile_ ? &profile_[wid] : nullptr;
+  }
+
   // For testing.
   int children_overload() const { return children_overload_; };
 
@@ -466,6 +521,19 @@ class alignas(64) Module {
   // Whether the module itself is overloaded.
   bool overload_;
 
+  // NUMA node module memory is placed on, -1 if unknown.
+  int socket_;
+
+  // Memory regions (from mem_alloc_movable) that are migrated with the module.
+  std::vector<void *> mem_regions_;
+
+  // Optional arena for module state. Being a base class member, it outlives
+  // any container of the derived module that allocates from it.
+  std::unique_ptr<bess::utils::Arena> arena_;
+
+  // Per-worker array, allocated at creation if ModuleProfiler is enabled
+  bess::ModuleProfile *profile_;
+
   // TODO[apanda]: Move to some constraint structure?
   // Placement constraints for this module. We use this to update the task based
   // on all upstream tasks.
@@ -705,6 +773,130 @@ static inline void set_attr(Module *m, int attr_id, bess::Packet *pkt, T val) {
   set_attr_with_offset(m->attr_offset(attr_id), pkt, val);
 }
 
+namespace bess {
+namespace metadata {
+
+// Typed handle to a metadata attribute of a module, meant to be a member of
+// the module class. Register() it in Init(), instead of AddMetadataAttr().
+// The handle then tracks the offset assigned by ComputeMetadataOffsets()
+// without any per-access index check.
+//
+// Batch helpers check the offset once per batch, so the per-packet loop is a
+// plain load/store at a fixed offset. Per-packet accessors do not check it at
+// all: test valid() once per batch before using them.
+template <typename T, Attribute::AccessMode kMode>
+class Attr {
+ public:
+  static_assert(sizeof(T) <= kMetadataAttrMaxSize,
+                "metadata attribute too large");
+
+  Attr() : offset_(&kUnassigned) {}
+
+  // Returns the attribute ID (>= 0), or a negative number for error, as
+  // Module::AddMetadataAttr() does.
+  int Register(Module *m, const std::string &name, bool optional = false) {
+    int ret = m->AddMetadataAttr(name, sizeof(T), kMode, optional);
+    if (ret >= 0) {
+      offset_ = &m->all_attr_offsets()[ret];
+    }
+    return ret;
+  }
+
+  mt_offset_t offset() const { return *offset_; }
+
+  // false if no upstream module writes the attribute (kRead), or no
+  // downstream module reads it (kWrite)
+  bool valid() const { return IsValidOffset(*offset_); }
+
+  // ptr(), get() and set() are unchecked. Only use them if valid() is true.
+  T *ptr(Packet *pkt) const {
+    DCHECK(valid());
+    return _ptr_attr_with_offset<T>(*offset_, pkt);
+  }
+
+  T get(const Packet *pkt) const {
+    static_assert(kMode != Attribute::AccessMode::kWrite,
+                  "reading a write-only attribute");
+    DCHECK(valid());
+    return _get_attr_with_offset<T>(*offset_, pkt);
+  }
+
+  void set(Packet *pkt, T val) const {
+    static_assert(kMode != Attribute::AccessMode::kRead,
+                  "writing a read-only attribute");
+    DCHECK(valid());
+    _set_attr_with_offset<T>(*offset_, pkt, val);
+  }
+
+  // vals[i] = attribute of the i-th packet, or T() if not valid()
+  void Gather(const PacketBatch *batch, T *vals) const {
+    static_assert(kMode != Attribute::AccessMode::kWrite,
+                  "reading a write-only attribute");
+    const mt_offset_t offset = *offset_;
+    const int cnt = batch->cnt();
+
+    if (!IsValidOffset(offset)) {
+      std::fill(vals, vals + cnt, T());
+      return;
+    }
+
+    for (int i = 0; i < cnt; i++) {
+      vals[i] = _get_attr_with_offset<T>(offset, batch->pkts()[i]);
+    }
+  }
+
+  // Attribute of the i-th packet = vals[i]. No-op if not valid().
+  void Scatter(PacketBatch *batch, const T *vals) const {
+    static_assert(kMode != Attribute::AccessMode::kRead,
+                  "writing a read-only attribute");
+    const mt_offset_t offset = *offset_;
+    const int cnt = batch->cnt();
+
+    if (!IsValidOffset(offset)) {
+      return;
+    }
+
+    for (int i = 0; i < cnt; i++) {
+      _set_attr_with_offset<T>(offset, batch->pkts()[i], vals[i]);
+    }
+  }
+
+  // Sets the attribute of all packets in the batch to val.
+  void Fill(PacketBatch *batch, T val) const {
+    static_assert(kMode != Attribute::AccessMode::kRead,
+                  "writing a read-only attribute");
+    const mt_offset_t offset = *offset_;
+    const int cnt = batch->cnt();
+
+    if (!IsValidOffset(offset)) {
+      return;
+    }
+
+    for (int i = 0; i < cnt; i++) {
+      _set_attr_with_offset<T>(offset, batch->pkts()[i], val);
+    }
+  }
+
+ private:
+  static const mt_offset_t kUnassigned = kMetadataOffsetNoRead;
+
+  // Points to the slot of the owner module's offset array
+  const mt_offset_t *offset_;
+};
+
+template <typename T, Attribute::AccessMode kMode>
+const mt_offset_t Attr<T, kMode>::kUnassigned;
+
+template <typename T>
+using ReadAttr = Attr<T, Attribute::AccessMode::kRead>;
+template <typename T>
+using WriteAttr = Attr<T, Attribute::AccessMode::kWrite>;
+template <typename T>
+using UpdateAttr = Attr<T, Attribute::AccessMode::kUpdate>;
+
+}  // namespace metadata
+}  // namespace bess
+
 #define DEF_MODULE(_MOD, _NAME_TEMPLATE, _HELP)                          \
   class _MOD##_class {                                                   \
    public:                                                               \
@@ -402,3 +402,10 @@ void ModuleGraph::PropagateActiveWorker() {
     }
   }
 }
+
+void ModuleGraph::UpdateMemoryPlacement() {
+  PropagateActiveWorker();
+  for (auto &pair : all_modules_) {
+    pair.second->UpdateMemoryPlacement();
+  }
+}
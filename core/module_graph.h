@@ -82,6 +82,10 @@ class ModuleGraph {
   // Update information about what workers are accessing what module
   static void PropagateActiveWorker();
 
+  // Move module memory to the NUMA node of the workers running each module.
+  // Workers must be paused.
+  static void UpdateMemoryPlacement();
+
  private:
   static void UpdateParentsAs(Module *parent_task, Module *module,
                               std::unordered_set<Module *> &visited_modules);
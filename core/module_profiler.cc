@@ -0,0 +1,180 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "module_profiler.h"
+
+#include <algorithm>
+
+#include <glog/logging.h>
+
+#include "module.h"
+#include "utils/perf_counters.h"
+
+using bess::utils::PerfCounters;
+
+namespace bess {
+
+bool ModuleProfiler::enabled_ = false;
+PerfCounters *ModuleProfiler::counters_[Worker::kMaxWorkers];
+
+// Counts of back-to-back Read()s of each worker, subtracted from every sample
+static uint64_t read_overheads[Worker::kMaxWorkers][PerfCounters::kNumEvents];
+
+// Returns the minimum count of each event between two back-to-back Read()s
+static void MeasureReadOverhead(const PerfCounters *counters,
+                                uint64_t *overhead) {
+  const int kRounds = 64;
+
+  uint64_t before[PerfCounters::kNumEvents];
+  uint64_t after[PerfCounters::kNumEvents];
+
+  for (int i = 0; i < PerfCounters::kNumEvents; i++) {
+    overhead[i] = UINT64_MAX;
+  }
+
+  for (int round = 0; round < kRounds; round++) {
+    counters->Read(before);
+    counters->Read(after);
+    for (int i = 0; i < PerfCounters::kNumEvents; i++) {
+      overhead[i] = std::min(overhead[i], after[i] - before[i]);
+    }
+  }
+}
+
+static void Charge(int wid, ModuleProfile *profile, uint64_t packets,
+                   const uint64_t *before, const uint64_t *after) {
+  uint64_t delta[PerfCounters::kNumEvents];
+
+  for (int i = 0; i < PerfCounters::kNumEvents; i++) {
+    uint64_t d = after[i] - before[i];
+    uint64_t overhead = read_overheads[wid][i];
+    delta[i] = (d > overhead) ? d - overhead : 0;
+  }
+
+  profile->calls++;
+  profile->packets += packets;
+  profile->cycles += delta[PerfCounters::kCycles];
+  profile->instructions += delta[PerfCounters::kInstructions];
+  profile->llc_misses += delta[PerfCounters::kLlcMisses];
+  profile->dtlb_misses += delta[PerfCounters::kDtlbMisses];
+}
+
+void ModuleProfiler::InitWorker(int wid) {
+  if (!enabled_) {
+    return;
+  }
+
+  PerfCounters *counters = new PerfCounters();
+  int opened = counters->Open();
+  if (opened < PerfCounters::kNumEvents) {
+    LOG(WARNING) << "Worker " << wid << ": only " << opened << " of "
+                 << PerfCounters::kNumEvents
+                 << " performance counters are available";
+  }
+
+  uint64_t *overhead = read_overheads[wid];
+  MeasureReadOverhead(counters, overhead);
+  LOG(INFO) << "Worker " << wid << ": reading performance counters costs "
+            << overhead[PerfCounters::kCycles] << " cycles, "
+            << overhead[PerfCounters::kInstructions]
+            << " instructions (subtracted from module profiles)";
+
+  counters_[wid] = counters;
+}
+
+void ModuleProfiler::DeinitWorker(int wid) {
+  delete counters_[wid];
+  counters_[wid] = nullptr;
+}
+
+void ModuleProfiler::ProcessBatch(Context *ctx, Module *m,
+                                  PacketBatch *batch) {
+  const PerfCounters *counters = counters_[ctx->wid];
+  ModuleProfile *profile = m->profile(ctx->wid);
+
+  if (!counters || !profile) {
+    m->ProcessBatch(ctx, batch);
+    return;
+  }
+
+  uint64_t before[PerfCounters::kNumEvents];
+  uint64_t after[PerfCounters::kNumEvents];
+  int cnt = batch->cnt();
+
+  counters->Read(before);
+  m->ProcessBatch(ctx, batch);
+  counters->Read(after);
+
+  Charge(ctx->wid, profile, cnt, before, after);
+}
+
+struct task_result ModuleProfiler::RunTask(Context *ctx, Module *m,
+                                           PacketBatch *batch, void *arg) {
+  const PerfCounters *counters = counters_[ctx->wid];
+  ModuleProfile *profile = m->profile(ctx->wid);
+
+  if (!counters || !profile) {
+    return m->RunTask(ctx, batch, arg);
+  }
+
+  uint64_t before[PerfCounters::kNumEvents];
+  uint64_t after[PerfCounters::kNumEvents];
+
+  counters->Read(before);
+  struct task_result result = m->RunTask(ctx, batch, arg);
+  counters->Read(after);
+
+  Charge(ctx->wid, profile, result.packets, before, after);
+  return result;
+}
+
+ModuleProfile ModuleProfiler::Aggregate(const Module *m) {
+  ModuleProfile sum = {};
+
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    const ModuleProfile *profile = m->profile(wid);
+    if (profile) {
+      sum += *profile;
+    }
+  }
+
+  return sum;
+}
+
+void ModuleProfiler::Reset(Module *m) {
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    ModuleProfile *profile = m->profile(wid);
+    if (profile) {
+      *profile = {};
+    }
+  }
+}
+
+}  // namespace bess
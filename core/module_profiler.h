@@ -0,0 +1,102 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_MODULE_PROFILER_H_
+#define BESS_MODULE_PROFILER_H_
+
+#include <cstdint>
+
+#include "pktbatch.h"
+#include "worker.h"
+
+class Module;
+struct Context;
+
+namespace bess {
+
+namespace utils {
+class PerfCounters;
+}  // namespace utils
+
+// Cost of a module, accumulated over the ProcessBatch() (and RunTask(), for
+// task modules) calls of one worker. Cache aligned, as each worker updates
+// its own.
+struct alignas(64) ModuleProfile {
+  uint64_t calls;
+  uint64_t packets;  // input packets, or packets generated by RunTask()
+  uint64_t cycles;
+  uint64_t instructions;
+  uint64_t llc_misses;
+  uint64_t dtlb_misses;
+
+  ModuleProfile &operator+=(const ModuleProfile &rhs) {
+    calls += rhs.calls;
+    packets += rhs.packets;
+    cycles += rhs.cycles;
+    instructions += rhs.instructions;
+    llc_misses += rhs.llc_misses;
+    dtlb_misses += rhs.dtlb_misses;
+    return *this;
+  }
+};
+
+// Opt-in (bessd --profile_modules) instrumentation that brackets every
+// ProcessBatch() and RunTask() call with hardware performance counters of the
+// worker thread. Since modules of a task run one after another, each call is
+// charged only for its own work, not for that of downstream modules.
+// The cost of reading the counters themselves (significant if they cannot be
+// read with rdpmc) is measured when the worker starts and subtracted.
+class ModuleProfiler {
+ public:
+  static bool enabled() { return enabled_; }
+
+  // Must be called before any worker or module is created
+  static void Enable() { enabled_ = true; }
+
+  // Called by each worker thread when it starts and before it quits
+  static void InitWorker(int wid);
+  static void DeinitWorker(int wid);
+
+  static void ProcessBatch(Context *ctx, Module *m, PacketBatch *batch);
+  static struct task_result RunTask(Context *ctx, Module *m,
+                                    PacketBatch *batch, void *arg);
+
+  // Sum of the profiles of all workers
+  static ModuleProfile Aggregate(const Module *m);
+  static void Reset(Module *m);
+
+ private:
+  static bool enabled_;
+  static utils::PerfCounters *counters_[Worker::kMaxWorkers];
+};
+
+}  // namespace bess
+
+#endif  // BESS_MODULE_PROFILER_H_
@@ -29,6 +29,12 @@
 
 #include "acl.h"
 
+#include <glog/logging.h>
+#include <rte_acl.h>
+#include <rte_hash_crc.h>
+
+#include <cstdio>
+
 #include "../utils/ether.h"
 #include "../utils/ip.h"
 #include "../utils/udp.h"
@@ -37,9 +43,75 @@ const Commands ACL::cmds = {
     {"add", "ACLArg", MODULE_CMD_FUNC(&ACL::CommandAdd),
      Command::THREAD_UNSAFE},
     {"clear", "EmptyArg", MODULE_CMD_FUNC(&ACL::CommandClear),
-     Command::THREAD_UNSAFE}};
+     Command::THREAD_UNSAFE},
+    {"get_cache_stats", "FlowCacheCommandGetStatsArg",
+     MODULE_CMD_FUNC(&ACL::CommandGetCacheStats), Command::THREAD_UNSAFE}};
+
+namespace {
+
+enum TrieField {
+  kFieldPad = 0,
+  kFieldSrcIp,
+  kFieldDstIp,
+  kFieldSrcPort,
+  kFieldDstPort,
+  kNumTrieFields,
+};
+
+RTE_ACL_RULE_DEF(TrieRule, kNumTrieFields);
+
+// Verdicts stored as rte_acl userdata. 0 is reserved for "no match".
+const uint32_t kTriePass = 1;
+const uint32_t kTrieDrop = 2;
+
+// Sets an IP field to match "prefix"
+void SetTrieIp(struct rte_acl_field *field, const Ipv4Prefix &prefix) {
+  field->value.u32 = (prefix.addr & prefix.mask).value();
+  field->mask_range.u32 = prefix.prefix_length();
+}
+
+// Sets a port field to match "port", or any port if it is 0
+void SetTriePort(struct rte_acl_field *field, be16_t port) {
+  if (port == be16_t(0)) {
+    field->value.u16 = 0;
+    field->mask_range.u16 = UINT16_MAX;
+  } else {
+    field->value.u16 = port.value();
+    field->mask_range.u16 = port.value();
+  }
+}
+
+}  // namespace
 
 CommandResponse ACL::Init(const bess::pb::ACLArg &arg) {
+  if (arg.backend() == "" || arg.backend() == "auto") {
+    backend_ = kBackendAuto;
+  } else if (arg.backend() == "scan") {
+    backend_ = kBackendScan;
+  } else if (arg.backend() == "trie") {
+    backend_ = kBackendTrie;
+  } else {
+    return CommandFailure(EINVAL, "available backends: auto, scan, trie");
+  }
+
+  if (arg.cache_size() > 0) {
+    caches_.assign(Worker::kMaxWorkers, FlowCache(arg.cache_size()));
+  }
+
+  AddRules(arg);
+
+  // No worker is running yet, so there is nothing to gain from building in
+  // the background
+  Rebuild(false);
+  return CommandSuccess();
+}
+
+void ACL::DeInit() {
+  JoinBuilder();
+  FreeTrie(trie_.exchange(nullptr));
+}
+
+void ACL::AddRules(const bess::pb::ACLArg &arg) {
   for (const auto &rule : arg.rules()) {
     ACLRule new_rule = {
         .src_ip = Ipv4Prefix(rule.src_ip()),
@@ -49,27 +121,191 @@ CommandResponse ACL::Init(const bess::pb::ACLArg &arg) {
         .drop = rule.drop()};
     rules_.push_back(new_rule);
   }
-  return CommandSuccess();
+
+  for (auto &cache : caches_) {
+    cache.Invalidate();
+  }
+}
+
+void ACL::Rebuild(bool background) {
+  // Workers are paused and the builder is done, so nobody else can be
+  // holding on to the old trie
+  JoinBuilder();
+  generation_++;
+  FreeTrie(trie_.exchange(nullptr));
+
+  if (rules_.empty() || backend_ == kBackendScan ||
+      (backend_ == kBackendAuto && rules_.size() < kTrieMinRules)) {
+    return;
+  }
+
+  if (!background) {
+    trie_.store(BuildTrie(rules_, generation_), std::memory_order_release);
+    return;
+  }
+
+  builder_ = std::thread([this](std::vector<ACLRule> rules,
+                                uint64_t generation) {
+    trie_.store(BuildTrie(rules, generation), std::memory_order_release);
+  }, rules_, generation_);
+}
+
+void ACL::JoinBuilder() {
+  if (builder_.joinable()) {
+    builder_.join();
+  }
+}
+
+ACL::Trie *ACL::BuildTrie(const std::vector<ACLRule> &rules,
+                          uint64_t generation) {
+  // rte_acl_create() returns any existing context with the same name
+  static std::atomic<uint32_t> next_id;
+  char name[RTE_ACL_NAMESIZE];
+  snprintf(name, sizeof(name), "bess_acl_%u", next_id++);
+
+  struct rte_acl_param param = {};
+  param.name = name;
+  param.socket_id = SOCKET_ID_ANY;
+  param.rule_size = RTE_ACL_RULE_SZ(kNumTrieFields);
+  param.max_rule_num = rules.size();
+
+  struct rte_acl_ctx *ctx = rte_acl_create(&param);
+  if (!ctx) {
+    LOG(ERROR) << "rte_acl_create() failed: " << rte_strerror(rte_errno);
+    return nullptr;
+  }
+
+  // Rule values are in host order, while packet fields are matched as-is
+  std::vector<TrieRule> trie_rules(rules.size());
+  for (size_t i = 0; i < rules.size(); i++) {
+    const ACLRule &rule = rules[i];
+    TrieRule &r = trie_rules[i];
+
+    r.data.category_mask = 1;
+    // Earlier rules take precedence
+    r.data.priority = RTE_ACL_MAX_PRIORITY - i;
+    if (rule.drop) {
+      r.data.userdata = kTrieDrop;
+    } else {
+      r.data.userdata = kTriePass;
+    }
+
+    SetTrieIp(&r.field[kFieldSrcIp], rule.src_ip);
+    SetTrieIp(&r.field[kFieldDstIp], rule.dst_ip);
+    SetTriePort(&r.field[kFieldSrcPort], rule.src_port);
+    SetTriePort(&r.field[kFieldDstPort], rule.dst_port);
+  }
+
+  const uint32_t key_offset = offsetof(TrieInput, key);
+
+  struct rte_acl_config cfg = {};
+  cfg.num_categories = 1;
+  cfg.num_fields = kNumTrieFields;
+  cfg.defs[kFieldPad] = {RTE_ACL_FIELD_TYPE_BITMASK, sizeof(uint8_t),
+                         kFieldPad, 0, offsetof(TrieInput, pad)};
+  cfg.defs[kFieldSrcIp] = {RTE_ACL_FIELD_TYPE_MASK, sizeof(uint32_t),
+                           kFieldSrcIp, 1,
+                           key_offset + offsetof(FlowKey, src_ip)};
+  cfg.defs[kFieldDstIp] = {RTE_ACL_FIELD_TYPE_MASK, sizeof(uint32_t),
+                           kFieldDstIp, 2,
+                           key_offset + offsetof(FlowKey, dst_ip)};
+  // Both ports share one 4-byte input word
+  cfg.defs[kFieldSrcPort] = {RTE_ACL_FIELD_TYPE_RANGE, sizeof(uint16_t),
+                             kFieldSrcPort, 3,
+                             key_offset + offsetof(FlowKey, src_port)};
+  cfg.defs[kFieldDstPort] = {RTE_ACL_FIELD_TYPE_RANGE, sizeof(uint16_t),
+                             kFieldDstPort, 3,
+                             key_offset + offsetof(FlowKey, dst_port)};
+
+  int ret = rte_acl_add_rules(
+      ctx, reinterpret_cast<const struct rte_acl_rule *>(trie_rules.data()),
+      trie_rules.size());
+  if (ret == 0) {
+    ret = rte_acl_build(ctx, &cfg);
+  }
+  if (ret != 0) {
+    LOG(ERROR) << "Failed to build rte_acl context: " << rte_strerror(-ret)
+               << ". Falling back to a linear scan.";
+    rte_acl_free(ctx);
+    return nullptr;
+  }
+
+  return new Trie{ctx, generation};
+}
+
+void ACL::FreeTrie(Trie *trie) {
+  if (trie) {
+    rte_acl_free(trie->ctx);
+    delete trie;
+  }
 }
 
 CommandResponse ACL::CommandAdd(const bess::pb::ACLArg &arg) {
-  Init(arg);
+  AddRules(arg);
+  Rebuild(true);
   return CommandSuccess();
 }
 
 CommandResponse ACL::CommandClear(const bess::pb::EmptyArg &) {
   rules_.clear();
+  for (auto &cache : caches_) {
+    cache.Invalidate();
+  }
+  Rebuild(true);
   return CommandSuccess();
 }
 
+CommandResponse ACL::CommandGetCacheStats(
+    const bess::pb::FlowCacheCommandGetStatsArg &arg) {
+  if (caches_.empty()) {
+    return CommandFailure(EINVAL, "flow cache is not enabled");
+  }
+
+  bess::pb::FlowCacheCommandGetStatsResponse r;
+  r.set_size(caches_[0].size());
+  for (auto &cache : caches_) {
+    r.set_hits(r.hits() + cache.hits());
+    r.set_misses(r.misses() + cache.misses());
+    if (arg.reset()) {
+      cache.ResetStats();
+    }
+  }
+
+  return CommandSuccess(r);
+}
+
+bool ACL::Drop(const FlowKey &key) const {
+  for (const auto &rule : rules_) {
+    if (rule.Match(key.src_ip, key.dst_ip, key.src_port, key.dst_port)) {
+      return rule.drop;  // Stop matching other rules
+    }
+  }
+  return true;
+}
+
 void ACL::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   using bess::utils::Ethernet;
   using bess::utils::Ipv4;
   using bess::utils::Udp;
 
   gate_idx_t incoming_gate = ctx->current_igate;
+  FlowCache *cache = caches_.empty() ? nullptr : &caches_[ctx->wid];
+
+  // A trie left over from an older rule set is never used
+  const Trie *trie = trie_.load(std::memory_order_acquire);
+  if (trie && trie->generation != generation_) {
+    trie = nullptr;
+  }
 
   int cnt = batch->cnt();
+  TrieInput inputs[bess::PacketBatch::kMaxBurst];
+  uint32_t hashes[bess::PacketBatch::kMaxBurst];
+  bool drop[bess::PacketBatch::kMaxBurst];
+
+  // Indices of packets whose verdict is not cached
+  int misses[bess::PacketBatch::kMaxBurst];
+  int num_misses = 0;
+
   for (int i = 0; i < cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
 
@@ -79,19 +315,50 @@ void ACL::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
     Udp *udp =
         reinterpret_cast<Udp *>(reinterpret_cast<uint8_t *>(ip) + ip_bytes);
 
-    bool emitted = false;
-    for (const auto &rule : rules_) {
-      if (rule.Match(ip->src, ip->dst, udp->src_port, udp->dst_port)) {
-        if (!rule.drop) {
-          emitted = true;
-          EmitPacket(ctx, pkt, incoming_gate);
-        }
-        break;  // Stop matching other rules
+    FlowKey &key = inputs[i].key;
+    inputs[i].pad = 0;
+    key = {ip->src, ip->dst, udp->src_port, udp->dst_port};
+
+    if (cache) {
+      hashes[i] = rte_hash_crc(&key, sizeof(key), 0);
+      const bool *cached = cache->Find(key, hashes[i]);
+      if (cached) {
+        drop[i] = *cached;
+        continue;
       }
     }
+    misses[num_misses++] = i;
+  }
+
+  if (trie && num_misses > 0) {
+    const uint8_t *data[bess::PacketBatch::kMaxBurst];
+    uint32_t results[bess::PacketBatch::kMaxBurst];
+    for (int j = 0; j < num_misses; j++) {
+      data[j] = reinterpret_cast<const uint8_t *>(&inputs[misses[j]]);
+    }
+    rte_acl_classify(trie->ctx, data, results, num_misses, 1);
+    for (int j = 0; j < num_misses; j++) {
+      drop[misses[j]] = (results[j] != kTriePass);
+    }
+  } else {
+    for (int j = 0; j < num_misses; j++) {
+      drop[misses[j]] = Drop(inputs[misses[j]].key);
+    }
+  }
+
+  if (cache) {
+    for (int j = 0; j < num_misses; j++) {
+      int i = misses[j];
+      cache->Insert(inputs[i].key, hashes[i], drop[i]);
+    }
+  }
 
-    if (!emitted) {
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+    if (drop[i]) {
       DropPacket(ctx, pkt);
+    } else {
+      EmitPacket(ctx, pkt, incoming_gate);
     }
   }
 }
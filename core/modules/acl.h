@@ -30,16 +30,22 @@
 #ifndef BESS_MODULES_ACL_H_
 #define BESS_MODULES_ACL_H_
 
+#include <atomic>
+#include <cstring>
+#include <thread>
 #include <vector>
 
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
+#include "../utils/flow_cache.h"
 #include "../utils/ip.h"
 
 using bess::utils::be16_t;
 using bess::utils::be32_t;
 using bess::utils::Ipv4Prefix;
 
+struct rte_acl_ctx;
+
 class ACL final : public Module {
  public:
   struct ACLRule {
@@ -58,17 +64,100 @@ class ACL final : public Module {
 
   static const Commands cmds;
 
-  ACL() : Module() { max_allowed_workers_ = Worker::kMaxWorkers; }
+  ACL()
+      : Module(),
+        backend_(kBackendAuto),
+        generation_(),
+        trie_(nullptr),
+        builder_() {
+    max_allowed_workers_ = Worker::kMaxWorkers;
+  }
 
   CommandResponse Init(const bess::pb::ACLArg &arg);
+  void DeInit() override;
 
   void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
 
   CommandResponse CommandAdd(const bess::pb::ACLArg &arg);
   CommandResponse CommandClear(const bess::pb::EmptyArg &arg);
+  CommandResponse CommandGetCacheStats(
+      const bess::pb::FlowCacheCommandGetStatsArg &arg);
 
  private:
+  // The fields that rules can match on
+  struct FlowKey {
+    be32_t src_ip;
+    be32_t dst_ip;
+    be16_t src_port;
+    be16_t dst_port;
+  };
+
+  // Input layout for the rte_acl trie. rte_acl requires the first field to be
+  // a single byte, so the key is preceded by a padding word that all rules
+  // wildcard.
+  struct TrieInput {
+    uint32_t pad;
+    FlowKey key;
+  };
+
+  // A compiled rte_acl context for the rule set of the given generation
+  struct Trie {
+    struct rte_acl_ctx *ctx;
+    uint64_t generation;
+  };
+
+  enum Backend {
+    kBackendAuto = 0,  // Scan small rule sets, compile larger ones
+    kBackendScan,
+    kBackendTrie,
+  };
+
+  // With the "auto" backend, rule sets at least this large use rte_acl
+  static const size_t kTrieMinRules = 16;
+
+  struct FlowKeyEq {
+    bool operator()(const FlowKey &lhs, const FlowKey &rhs) const {
+      return memcmp(&lhs, &rhs, sizeof(FlowKey)) == 0;
+    }
+  };
+
+  // Caches whether the flow is dropped
+  using FlowCache = bess::utils::FlowCache<FlowKey, bool, FlowKeyEq>;
+
+  void AddRules(const bess::pb::ACLArg &arg);
+
+  // Returns true if the first matching rule drops the flow, or none matches
+  bool Drop(const FlowKey &key) const;
+
+  // Drops the current trie and, if the backend calls for it, compiles a new
+  // one for rules_. Must be called while workers are paused. Unless
+  // "background" is false, the build runs on a separate thread and packets
+  // fall back to scanning rules_ until it is published.
+  void Rebuild(bool background);
+
+  // Waits for an in-progress background build, if any
+  void JoinBuilder();
+
+  // Returns a new trie for the rules, or nullptr on failure
+  static Trie *BuildTrie(const std::vector<ACLRule> &rules,
+                         uint64_t generation);
+
+  static void FreeTrie(Trie *trie);
+
   std::vector<ACLRule> rules_;
+
+  Backend backend_;
+
+  // Bumped on every rule change. Workers only use a trie built for the
+  // current generation.
+  uint64_t generation_;
+
+  std::atomic<Trie *> trie_;
+
+  std::thread builder_;
+
+  // One per worker, or empty if the flow cache is disabled
+  std::vector<FlowCache> caches_;
 };
 
 #endif  // BESS_MODULES_ACL_H_
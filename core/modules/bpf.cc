@@ -35,9 +35,13 @@
 
 #include <sys/mman.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <iterator>
+#include <set>
+#include <tuple>
 
 #ifdef __x86_64  // JIT compilation code only works in 64-bit
                  /*
@@ -1098,6 +1102,492 @@ static bpf_filter_func_t bpf_jit_compile(struct bpf_insn *prog, u_int nins,
 /* Note: unmatched packets are sent to gate 0 */
 #define SNAPLEN 0xffff
 
+/* -------------------------------------------------------------------------
+ * Merging filters
+ *
+ * Filters are chained in priority order into a single program, where each
+ * "ret #0" (no match) continues with the next filter, and every other "ret"
+ * returns 1 + the gate of the filter. Since filter programs are trees of
+ * tests on the same few header fields, the next filter would mostly repeat
+ * tests whose outcome is already known on the path that rejected the
+ * packet (e.g., "is it IPv4?"). So each rejecting jump is threaded past
+ * those tests, directly to the first instruction of the following filters
+ * that still needs to run.
+ *
+ * Only A and loads at constant offsets are tracked, which is what pcap
+ * generates for protocol and address tests. pcap also never reads A, X or
+ * scratch memory before writing them, so registers left over from earlier
+ * filters do no harm; filters that do are not merged.
+ * ------------------------------------------------------------------------- */
+
+namespace {
+
+// A packet load at a constant offset, as (size << 32) | offset
+using LoadKey = uint64_t;
+
+const LoadKey kUnknownLoad = UINT64_MAX;
+
+// The outcome of comparing a load with a constant
+struct Fact {
+  LoadKey key;
+  uint16_t op;  // BPF_JEQ, BPF_JGT, BPF_JGE or BPF_JSET
+  uint32_t k;
+  bool taken;
+
+  bool operator<(const Fact &o) const {
+    return std::tie(key, op, k, taken) < std::tie(o.key, o.op, o.k, o.taken);
+  }
+};
+
+// What is known at a point of a filter
+struct State {
+  bool reached;
+  LoadKey a;                 // What A holds
+  std::set<LoadKey> loaded;  // Loads known to be within the packet
+  std::set<Fact> facts;
+
+  State() : reached(), a(kUnknownLoad), loaded(), facts() {}
+
+  void Join(const State &o) {
+    if (!reached) {
+      *this = o;
+      return;
+    }
+
+    if (a != o.a) {
+      a = kUnknownLoad;
+    }
+
+    std::set<LoadKey> l;
+    std::set_intersection(loaded.begin(), loaded.end(), o.loaded.begin(),
+                          o.loaded.end(), std::inserter(l, l.begin()));
+    loaded.swap(l);
+
+    std::set<Fact> f;
+    std::set_intersection(facts.begin(), facts.end(), o.facts.begin(),
+                          o.facts.end(), std::inserter(f, f.begin()));
+    facts.swap(f);
+  }
+};
+
+// Registers and scratch memory words used by instructions, as bitmasks
+const uint32_t kRegA = 1 << 0;
+const uint32_t kRegX = 1 << 1;
+
+inline uint32_t MemWord(uint32_t k) {
+  return 1 << (2 + k);
+}
+
+bool IsLoad(const bpf_insn &insn, LoadKey *key) {
+  if (BPF_CLASS(insn.code) != BPF_LD || BPF_MODE(insn.code) != BPF_ABS) {
+    return false;
+  }
+
+  switch (BPF_SIZE(insn.code)) {
+    case BPF_W:
+      *key = (4ull << 32) | insn.k;
+      return true;
+    case BPF_H:
+      *key = (2ull << 32) | insn.k;
+      return true;
+    case BPF_B:
+      *key = (1ull << 32) | insn.k;
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool IsReject(const bpf_insn &insn) {
+  return insn.code == (BPF_RET | BPF_K) && insn.k == 0;
+}
+
+// Returns the number of successors of insns[pc], storing them into "succ"
+int Successors(const std::vector<bpf_insn> &insns, size_t pc, size_t *succ) {
+  const bpf_insn &insn = insns[pc];
+
+  if (BPF_CLASS(insn.code) == BPF_RET) {
+    return 0;
+  }
+  if (BPF_CLASS(insn.code) != BPF_JMP) {
+    succ[0] = pc + 1;
+    return 1;
+  }
+  if (BPF_OP(insn.code) == BPF_JA) {
+    succ[0] = pc + 1 + insn.k;
+    return 1;
+  }
+  succ[0] = pc + 1 + insn.jt;
+  succ[1] = pc + 1 + insn.jf;
+  return 2;
+}
+
+// Sets "reads" and "writes" to the registers and memory words insn uses.
+// Returns false for unknown instructions.
+bool Uses(const bpf_insn &insn, uint32_t *reads, uint32_t *writes) {
+  *reads = *writes = 0;
+
+  switch (BPF_CLASS(insn.code)) {
+    case BPF_LD:
+      *writes = kRegA;
+      if (BPF_MODE(insn.code) == BPF_IND) {
+        *reads = kRegX;
+      } else if (BPF_MODE(insn.code) == BPF_MEM) {
+        *reads = MemWord(insn.k);
+      }
+      return true;
+    case BPF_LDX:
+      *writes = kRegX;
+      if (BPF_MODE(insn.code) == BPF_MEM) {
+        *reads = MemWord(insn.k);
+      }
+      return true;
+    case BPF_ST:
+      *reads = kRegA;
+      *writes = MemWord(insn.k);
+      return true;
+    case BPF_STX:
+      *reads = kRegX;
+      *writes = MemWord(insn.k);
+      return true;
+    case BPF_ALU:
+      *reads = kRegA | (BPF_SRC(insn.code) == BPF_X ? kRegX : 0);
+      *writes = kRegA;
+      return true;
+    case BPF_JMP:
+      if (BPF_OP(insn.code) != BPF_JA) {
+        *reads = kRegA | (BPF_SRC(insn.code) == BPF_X ? kRegX : 0);
+      }
+      return true;
+    case BPF_RET:
+      // "ret a" and "ret x" cannot be merged
+      return BPF_RVAL(insn.code) == BPF_K;
+    case BPF_MISC:
+      if (BPF_MISCOP(insn.code) == BPF_TAX) {
+        *reads = kRegA;
+        *writes = kRegX;
+      } else {
+        *reads = kRegX;
+        *writes = kRegA;
+      }
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Returns true if the filter can be chained after others: it only returns
+// constants, stays within its bounds, and writes registers and scratch
+// memory before reading them.
+bool IsMergeable(const std::vector<bpf_insn> &insns) {
+  const uint32_t kAll = ~0u;
+  std::vector<uint32_t> written(insns.size(), kAll);
+
+  if (insns.empty()) {
+    return false;
+  }
+
+  written[0] = 0;
+  for (size_t pc = 0; pc < insns.size(); pc++) {
+    const bpf_insn &insn = insns[pc];
+    uint32_t reads;
+    uint32_t writes;
+
+    bool mem = BPF_CLASS(insn.code) == BPF_ST ||
+               BPF_CLASS(insn.code) == BPF_STX ||
+               ((BPF_CLASS(insn.code) == BPF_LD ||
+                 BPF_CLASS(insn.code) == BPF_LDX) &&
+                BPF_MODE(insn.code) == BPF_MEM);
+    if ((mem && insn.k >= BPF_MEMWORDS) || !Uses(insn, &reads, &writes)) {
+      return false;
+    }
+    if (written[pc] == kAll) {
+      continue;  // unreachable
+    }
+    if (reads & ~written[pc]) {
+      return false;
+    }
+
+    size_t succ[2];
+    int n = Successors(insns, pc, succ);
+    if (n == 0 && BPF_CLASS(insn.code) != BPF_RET) {
+      return false;
+    }
+    for (int i = 0; i < n; i++) {
+      if (succ[i] >= insns.size()) {
+        return false;
+      }
+      written[succ[i]] &= written[pc] | writes;
+    }
+  }
+
+  return true;
+}
+
+// Returns the state after insn, when it takes the branch "taken"
+State Step(const State &in, const bpf_insn &insn, bool taken) {
+  State out = in;
+  LoadKey key;
+
+  switch (BPF_CLASS(insn.code)) {
+    case BPF_LD:
+      if (IsLoad(insn, &key)) {
+        out.a = key;
+        out.loaded.insert(key);
+      } else {
+        out.a = kUnknownLoad;
+      }
+      break;
+    case BPF_LDX:
+      if (BPF_MODE(insn.code) == BPF_MSH) {
+        out.loaded.insert((1ull << 32) | insn.k);
+      }
+      break;
+    case BPF_ALU:
+      out.a = kUnknownLoad;
+      break;
+    case BPF_MISC:
+      if (BPF_MISCOP(insn.code) == BPF_TXA) {
+        out.a = kUnknownLoad;
+      }
+      break;
+    case BPF_JMP:
+      if (BPF_OP(insn.code) != BPF_JA && BPF_SRC(insn.code) == BPF_K &&
+          in.a != kUnknownLoad) {
+        out.facts.insert(
+            {in.a, static_cast<uint16_t>(BPF_OP(insn.code)), insn.k, taken});
+      }
+      break;
+  }
+
+  return out;
+}
+
+// Returns the state at each instruction of a mergeable filter
+std::vector<State> Analyze(const std::vector<bpf_insn> &insns) {
+  std::vector<State> states(insns.size());
+
+  states[0].reached = true;
+  for (size_t pc = 0; pc < insns.size(); pc++) {
+    if (!states[pc].reached) {
+      continue;
+    }
+
+    size_t succ[2];
+    int n = Successors(insns, pc, succ);
+    for (int i = 0; i < n; i++) {
+      states[succ[i]].Join(Step(states[pc], insns[pc], i == 0));
+    }
+  }
+
+  return states;
+}
+
+// Returns whether A is live before each instruction
+std::vector<bool> LiveA(const std::vector<bpf_insn> &insns) {
+  std::vector<bool> live(insns.size());
+
+  for (size_t pc = insns.size(); pc-- > 0;) {
+    uint32_t reads;
+    uint32_t writes;
+    Uses(insns[pc], &reads, &writes);
+
+    if (reads & kRegA) {
+      live[pc] = true;
+    } else if (!(writes & kRegA)) {
+      size_t succ[2];
+      int n = Successors(insns, pc, succ);
+      for (int i = 0; i < n; i++) {
+        live[pc] = live[pc] || live[succ[i]];
+      }
+    }
+  }
+
+  return live;
+}
+
+// Tries to decide "(key) op k" from "facts"
+bool Decide(const std::set<Fact> &facts, LoadKey key, uint16_t op, uint32_t k,
+            bool *taken) {
+  for (const Fact &f : facts) {
+    if (f.key != key) {
+      continue;
+    }
+    if (f.op == op && f.k == k) {
+      *taken = f.taken;
+      return true;
+    }
+    if (f.op == BPF_JEQ && f.taken) {
+      switch (op) {
+        case BPF_JEQ:
+          *taken = f.k == k;
+          return true;
+        case BPF_JGT:
+          *taken = f.k > k;
+          return true;
+        case BPF_JGE:
+          *taken = f.k >= k;
+          return true;
+        case BPF_JSET:
+          *taken = (f.k & k) != 0;
+          return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+// Follows "insns" (the merged program so far) from its start, given what is
+// known when a filter rejects the packet, as long as instructions can be
+// skipped: reloads of loads that already succeeded and tests with known
+// outcomes. Returns where execution can resume.
+size_t Thread(const std::vector<bpf_insn> &insns, const std::vector<bool> &live,
+              const State &known) {
+  size_t resume = 0;
+  size_t pc = 0;
+  LoadKey a = known.a;  // What A would hold at "pc"
+
+  while (pc < insns.size()) {
+    const bpf_insn &insn = insns[pc];
+    LoadKey key;
+    bool taken;
+
+    if (IsLoad(insn, &key)) {
+      if (key != known.a && known.loaded.count(key) == 0) {
+        break;  // might be out of bounds
+      }
+      a = key;
+      pc++;
+    } else if (insn.code == (BPF_JMP | BPF_JA)) {
+      pc += 1 + insn.k;
+    } else if (BPF_CLASS(insn.code) == BPF_JMP &&
+               BPF_SRC(insn.code) == BPF_K && a != kUnknownLoad &&
+               Decide(known.facts, a, BPF_OP(insn.code), insn.k, &taken)) {
+      pc += 1 + (taken ? insn.jt : insn.jf);
+    } else {
+      break;
+    }
+
+    // A still holds the right value, or does not matter
+    if (a == known.a || !live[pc]) {
+      resume = pc;
+    }
+  }
+
+  return resume;
+}
+
+bpf_insn Jump(size_t from, size_t to) {
+  return BPF_STMT(BPF_JMP | BPF_JA, static_cast<uint32_t>(to - from - 1));
+}
+
+}  // namespace
+
+bool BPF::Merge() {
+  // The program is built backwards, from the lowest priority filter
+  std::vector<bpf_insn> prog = {BPF_STMT(BPF_RET | BPF_K, 1)};  // no match
+
+  for (auto it = filters_.rbegin(); it != filters_.rend(); ++it) {
+    const std::vector<bpf_insn> &insns = it->insns;
+    if (!IsMergeable(insns)) {
+      return false;
+    }
+
+    std::vector<State> states = Analyze(insns);
+    std::vector<bool> live = LiveA(prog);
+    std::vector<bpf_insn> block = insns;
+    size_t n = insns.size();
+
+    // Where each "ret #0" continues, with what is known on all paths to it
+    std::vector<size_t> next(n);
+    for (size_t pc = 0; pc < n; pc++) {
+      if (IsReject(insns[pc]) && states[pc].reached) {
+        next[pc] = Thread(prog, live, states[pc]);
+      }
+    }
+
+    // Jumps to "ret #0" may know more than that. Conditional ones get a
+    // trampoline after the filter (jt/jf are only 8 bits long).
+    std::vector<size_t> ja_to(n, SIZE_MAX);
+    std::vector<size_t> trampolines;
+    for (size_t pc = 0; pc < n; pc++) {
+      bpf_insn &insn = block[pc];
+      if (!states[pc].reached || BPF_CLASS(insn.code) != BPF_JMP) {
+        continue;
+      }
+
+      size_t succ[2];
+      int num_succ = Successors(insns, pc, succ);
+      for (int i = 0; i < num_succ; i++) {
+        if (!IsReject(insns[succ[i]])) {
+          continue;
+        }
+
+        size_t to = Thread(prog, live, Step(states[pc], insns[pc], i == 0));
+        if (to == next[succ[i]]) {
+          continue;
+        }
+
+        if (num_succ == 1) {
+          ja_to[pc] = to;
+          continue;
+        }
+
+        size_t slot = std::find(trampolines.begin(), trampolines.end(), to) -
+                      trampolines.begin();
+        if (n + slot - pc - 1 > UINT8_MAX) {
+          continue;
+        }
+        if (slot == trampolines.size()) {
+          trampolines.push_back(to);
+        }
+        (i == 0 ? insn.jt : insn.jf) = n + slot - pc - 1;
+      }
+    }
+
+    // Positions in "prog" move by the size of this block
+    size_t len = n + trampolines.size();
+    for (size_t pc = 0; pc < n; pc++) {
+      bpf_insn &insn = block[pc];
+      if (IsReject(insn)) {
+        insn = Jump(pc, len + next[pc]);
+      } else if (BPF_CLASS(insn.code) == BPF_RET) {
+        insn.k = it->gate + 1;
+      } else if (ja_to[pc] != SIZE_MAX) {
+        insn = Jump(pc, len + ja_to[pc]);
+      }
+    }
+    for (size_t i = 0; i < trampolines.size(); i++) {
+      block.push_back(Jump(n + i, len + trampolines[i]));
+    }
+
+    block.insert(block.end(), prog.begin(), prog.end());
+    prog.swap(block);
+  }
+
+  ReleaseMerged();
+
+#ifdef __x86_64
+  merged_.func = bpf_jit_compile(prog.data(), prog.size(), &merged_.mmap_size);
+  if (!merged_.func) {
+    return false;
+  }
+#endif
+  merged_.insns.swap(prog);
+  return true;
+}
+
+void BPF::ReleaseMerged() {
+#ifdef __x86_64
+  if (merged_.func) {
+    munmap(reinterpret_cast<void *>(merged_.func), merged_.mmap_size);
+    merged_.func = nullptr;
+  }
+#endif
+  merged_.insns.clear();
+}
+
 const Commands BPF::cmds = {
     {"add", "BPFArg", MODULE_CMD_FUNC(&BPF::CommandAdd),
      Command::THREAD_UNSAFE},
@@ -1109,15 +1599,14 @@ CommandResponse BPF::Init(const bess::pb::BPFArg &arg) {
 }
 
 void BPF::DeInit() {
-  for (auto &filter : filters_) {
 #ifdef __x86_64
+  for (auto &filter : filters_) {
     munmap(reinterpret_cast<void *>(filter.func), filter.mmap_size);
-#else
-    pcap_freecode(&filter.il_code);
-#endif
   }
+#endif
 
   filters_.clear();
+  ReleaseMerged();
 }
 
 CommandResponse BPF::CommandAdd(const bess::pb::BPFArg &arg) {
@@ -1139,14 +1628,15 @@ CommandResponse BPF::CommandAdd(const bess::pb::BPFArg &arg) {
       return CommandFailure(EINVAL, "BPF compilation error");
     }
 
-#ifdef __x86_64
-    filter.func = bpf_jit_compile(il.bf_insns, il.bf_len, &filter.mmap_size);
+    filter.insns.assign(il.bf_insns, il.bf_insns + il.bf_len);
     pcap_freecode(&il);
+
+#ifdef __x86_64
+    filter.func = bpf_jit_compile(filter.insns.data(), filter.insns.size(),
+                                  &filter.mmap_size);
     if (!filter.func) {
       return CommandFailure(ENOMEM, "BPF JIT compilation error");
     }
-#else
-    filter.il_code = il;
 #endif
 
     filters_.push_back(filter);
@@ -1158,6 +1648,11 @@ CommandResponse BPF::CommandAdd(const bess::pb::BPFArg &arg) {
               return b.priority < a.priority;
             });
 
+  // Without a merged program, filters are run one by one
+  if (filters_.size() < 2 || !Merge()) {
+    ReleaseMerged();
+  }
+
   return CommandSuccess();
 }
 
@@ -1166,15 +1661,13 @@ CommandResponse BPF::CommandClear(const bess::pb::EmptyArg &) {
   return CommandSuccess();
 }
 
-inline bool BPF::Match(const Filter &filter, u_char *pkt, u_int wirelen,
-                       u_int buflen) {
+inline u_int BPF::Run(const Filter &filter, u_char *pkt, u_int wirelen,
+                      u_int buflen) {
 #ifdef __x86_64
-  int ret = filter.func(pkt, wirelen, buflen);
+  return filter.func(pkt, wirelen, buflen);
 #else
-  int ret = bpf_filter(filter.il_code.bf_insns, pkt, wirelen, buflen);
+  return bpf_filter(filter.insns.data(), pkt, wirelen, buflen);
 #endif
-
-  return ret != 0;
 }
 
 void BPF::ProcessBatch1Filter(Context *ctx, bess::PacketBatch *batch) {
@@ -1185,8 +1678,8 @@ void BPF::ProcessBatch1Filter(Context *ctx, bess::PacketBatch *batch) {
   for (int i = 0; i < cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
 
-    if (Match(filter, pkt->head_data<u_char *>(), pkt->total_len(),
-              pkt->head_len())) {
+    if (Run(filter, pkt->head_data<u_char *>(), pkt->total_len(),
+            pkt->head_len())) {
       EmitPacket(ctx, pkt, filter.gate);
     } else {
       EmitPacket(ctx, pkt);
@@ -1205,17 +1698,28 @@ void BPF::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
     return;
   }
 
-  // slow version for general cases
   int cnt = batch->cnt();
 
   for (int i = 0; i < cnt; i++) {
-    gate_idx_t gate = 0;  // default gate for unmatched pkts
     bess::Packet *pkt = batch->pkts()[i];
+    u_char *data = pkt->head_data<u_char *>();
+    u_int wirelen = pkt->total_len();
+    u_int buflen = pkt->head_len();
+
+    if (!merged_.insns.empty()) {
+      u_int ret = Run(merged_, data, wirelen, buflen);
+      if (likely(ret)) {
+        EmitPacket(ctx, pkt, ret - 1);
+        continue;
+      }
+    }
+
+    // slow version, for when there is no merged program or it failed
+    gate_idx_t gate = 0;  // default gate for unmatched pkts
 
     // high priority filters are checked first
     for (const Filter &filter : filters_) {
-      if (Match(filter, pkt->head_data<uint8_t *>(), pkt->total_len(),
-                pkt->head_len())) {
+      if (Run(filter, data, wirelen, buflen)) {
         gate = filter.gate;
         break;
       }
@@ -46,7 +46,7 @@ class BPF final : public Module {
 
   static const Commands cmds;
 
-  BPF() : Module() { max_allowed_workers_ = Worker::kMaxWorkers; }
+  BPF() : Module(), merged_() { max_allowed_workers_ = Worker::kMaxWorkers; }
 
   CommandResponse Init(const bess::pb::BPFArg &arg);
   void DeInit() override;
@@ -61,19 +61,29 @@ class BPF final : public Module {
 #ifdef __x86_64
     bpf_filter_func_t func;
     size_t mmap_size;  // needed for munmap()
-#else
-    bpf_program il_code;
 #endif
+    std::vector<bpf_insn> insns;  // IL code
     int gate;
     int priority;     // higher number == higher priority
     std::string exp;  // original filter expression string
   };
 
-  static bool Match(const Filter &, u_char *, u_int, u_int);
+  // Returns the return value of the filter program
+  static u_int Run(const Filter &, u_char *, u_int, u_int);
+
+  // (Re)builds merged_ from filters_. Returns false if they cannot be merged.
+  bool Merge();
+  void ReleaseMerged();
 
   void ProcessBatch1Filter(Context *ctx, bess::PacketBatch *batch);
 
   std::vector<Filter> filters_;
+
+  // All filters merged into one program that returns 1 + the gate of the
+  // first matching filter (1 if none match), or 0 if it failed on a filter
+  // (e.g., reading past the end of the packet). "gate" and "priority" are
+  // unused, and "insns" is empty if there is no merged program.
+  Filter merged_;
 };
 
 #endif  // BESS_MODULES_BPF_H_
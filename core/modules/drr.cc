@@ -71,7 +71,9 @@ DRR::~DRR() {
     RemoveFlow(it->second);
     it++;
   }
-  std::free(flow_ring_);
+  if (flow_ring_) {
+    FreeRing(arena(), flow_ring_);
+  }
 }
 
 CommandResponse DRR::Init(const bess::pb::DRRArg &arg) {
@@ -96,6 +98,17 @@ CommandResponse DRR::Init(const bess::pb::DRRArg &arg) {
     }
   }
 
+  if (arg.arena_size() != 0) {
+    int ret = CreateArena(arg.arena_size());
+    if (ret) {
+      return CommandFailure(-ret, "failed to reserve a %" PRIu64 "-byte arena",
+                            arg.arena_size());
+    }
+    // Presize the table, as it is expected to be large
+    flows_ = CuckooMap<FlowId, Flow *, Hash, EqualTo>(
+        max_number_flows_, max_number_flows_, arena());
+  }
+
   // register task
   tid = RegisterTask(nullptr);
   if (tid == INVALID_TASK_ID) {
@@ -308,7 +321,7 @@ DRR::FlowId DRR::GetId(bess::Packet *pkt) {
 
 void DRR::AddNewFlow(bess::Packet *pkt, FlowId id, int *err) {
   // creates flow
-  Flow *f = new Flow(id);
+  Flow *f = new Flow(id, arena());
 
   // TODO(joshua) do proper error checking
   f->queue = AddQueue(static_cast<int>(kFlowQueueSize), err);
@@ -340,7 +353,12 @@ llring *DRR::AddQueue(uint32_t slots, int *err) {
   int bytes = llring_bytes_with_slots(slots);
   int ret;
 
-  llring *queue = static_cast<llring *>(aligned_alloc(alignof(llring), bytes));
+  llring *queue;
+  if (arena()) {
+    queue = static_cast<llring *>(arena()->Alloc(bytes, alignof(llring)));
+  } else {
+    queue = static_cast<llring *>(aligned_alloc(alignof(llring), bytes));
+  }
   if (!queue) {
     *err = -ENOMEM;
     return nullptr;
@@ -348,13 +366,25 @@ llring *DRR::AddQueue(uint32_t slots, int *err) {
 
   ret = llring_init(queue, slots, 1, 1);
   if (ret) {
-    std::free(queue);
+    if (arena()) {
+      arena()->Free(queue, bytes);
+    } else {
+      std::free(queue);
+    }
     *err = -EINVAL;
     return nullptr;
   }
   return queue;
 }
 
+void DRR::FreeRing(bess::utils::Arena *arena, llring *ring) {
+  if (arena) {
+    arena->Free(ring, llring_bytes(ring));
+  } else {
+    std::free(ring);
+  }
+}
+
 void DRR::Enqueue(Flow *f, bess::Packet *newpkt, int *err) {
   // if the queue is full. drop the packet.
   if (llring_count(f->queue) >= max_queue_size_) {
@@ -398,12 +428,12 @@ llring *DRR::ResizeQueue(llring *old_queue, uint32_t new_size, int *err) {
         bess::Packet::Free(pkt);
         *err = 0;
       } else if (*err != 0) {
-        std::free(new_queue);
+        FreeRing(arena(), new_queue);
         return nullptr;
       }
     }
 
-    std::free(old_queue);
+    FreeRing(arena(), old_queue);
   }
   return new_queue;
 }
@@ -105,9 +105,21 @@ class DRR final : public Module {
     FlowId id;                  // allows the flow to remove itself from the map
     struct llring *queue;       // queue to store current packets for flow
     bess::Packet *next_packet;  // buffer to store next packet from the queue.
-    Flow() : deficit(0), timer(0), id(), next_packet(nullptr){};
-    Flow(FlowId new_id)
-        : deficit(0), timer(0), id(new_id), next_packet(nullptr){};
+    bess::utils::Arena *arena;  // where the queue was allocated from
+    Flow()
+        : deficit(0),
+          timer(0),
+          id(),
+          queue(nullptr),
+          next_packet(nullptr),
+          arena(nullptr){};
+    Flow(FlowId new_id, bess::utils::Arena *a)
+        : deficit(0),
+          timer(0),
+          id(new_id),
+          queue(nullptr),
+          next_packet(nullptr),
+          arena(a){};
     ~Flow() {
       if (queue) {
         bess::Packet *pkt;
@@ -115,7 +127,7 @@ class DRR final : public Module {
           bess::Packet::Free(pkt);
         }
 
-        std::free(queue);
+        FreeRing(arena, queue);
       }
 
       if (next_packet) {
@@ -234,6 +246,10 @@ class DRR final : public Module {
   //  Returns a llring queue.
   llring *AddQueue(uint32_t slots, int *err);
 
+  //  Frees an llring allocated by AddQueue() from 'arena' (or the heap, if
+  //  nullptr).
+  static void FreeRing(bess::utils::Arena *arena, llring *ring);
+
   // the number of bytes to allocate to each flow in each round.
   uint32_t quantum_;
 
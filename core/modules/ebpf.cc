@@ -0,0 +1,236 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "ebpf.h"
+
+#include <cstring>
+
+#include "../utils/format.h"
+
+using bess::utils::ebpf::Insn;
+using bess::utils::ebpf::PacketContext;
+
+const Commands EBPF::cmds = {
+    {"map_lookup", "EBPFCommandMapLookupArg",
+     MODULE_CMD_FUNC(&EBPF::CommandMapLookup), Command::THREAD_UNSAFE},
+    {"map_update", "EBPFCommandMapUpdateArg",
+     MODULE_CMD_FUNC(&EBPF::CommandMapUpdate), Command::THREAD_UNSAFE},
+    {"map_delete", "EBPFCommandMapDeleteArg",
+     MODULE_CMD_FUNC(&EBPF::CommandMapDelete), Command::THREAD_UNSAFE},
+};
+
+CommandResponse EBPF::Init(const bess::pb::EBPFArg &arg) {
+  for (const auto &m : arg.maps()) {
+    Map::Type type;
+    if (m.type() == "array") {
+      type = Map::kArray;
+    } else if (m.type() == "hash") {
+      type = Map::kHash;
+    } else {
+      return CommandFailure(EINVAL, "map '%s': invalid type '%s'",
+                            m.name().c_str(), m.type().c_str());
+    }
+
+    if (m.name().empty() || map_index_.count(m.name())) {
+      return CommandFailure(EINVAL, "map '%s': name must be unique",
+                            m.name().c_str());
+    }
+
+    auto map = std::make_shared<Map>();
+    bess::utils::ebpf::Error err =
+        map->Init(type, m.key_size(), m.value_size(), m.max_entries());
+    if (err.first) {
+      return CommandFailure(err.first, "map '%s': %s", m.name().c_str(),
+                            err.second.c_str());
+    }
+
+    map_index_[m.name()] = maps_.size();
+    maps_.push_back(std::move(map));
+  }
+
+  std::vector<Program::Attr> attrs;
+  for (const auto &a : arg.attrs()) {
+    using AccessMode = bess::metadata::Attribute::AccessMode;
+    AccessMode mode;
+    if (a.mode() == "read") {
+      mode = AccessMode::kRead;
+    } else if (a.mode() == "write") {
+      mode = AccessMode::kWrite;
+    } else if (a.mode() == "update") {
+      mode = AccessMode::kUpdate;
+    } else {
+      return CommandFailure(EINVAL, "attribute '%s': invalid mode '%s'",
+                            a.name().c_str(), a.mode().c_str());
+    }
+
+    int ret = AddMetadataAttr(a.name(), a.size(), mode);
+    if (ret < 0) {
+      return CommandFailure(-ret, "add_metadata_attr() failed");
+    }
+
+    attrs.push_back({.size = a.size(),
+                     .readable = mode != AccessMode::kWrite,
+                     .writable = mode != AccessMode::kRead});
+  }
+
+  const std::string &code = arg.code();
+  if (code.empty() || code.size() % sizeof(Insn)) {
+    return CommandFailure(EINVAL,
+                          "'code' must be a non-empty sequence of 8-byte "
+                          "instructions");
+  }
+
+  std::vector<Insn> insns(code.size() / sizeof(Insn));
+  memcpy(insns.data(), code.data(), code.size());
+
+  bess::utils::ebpf::Error err = prog_.Load(insns, maps_, attrs, !arg.no_jit());
+  if (err.first) {
+    return CommandFailure(err.first, "%s", err.second.c_str());
+  }
+
+  return CommandSuccess();
+}
+
+void EBPF::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
+  int cnt = batch->cnt();
+  const bess::metadata::mt_offset_t *offsets = all_attr_offsets();
+  bool writes = prog_.writes_packet();
+
+  PacketContext pctx[bess::PacketBatch::kMaxBurst];
+  PacketContext *pctxs[bess::PacketBatch::kMaxBurst];
+  bess::Packet *pkts[bess::PacketBatch::kMaxBurst];
+  uint64_t rets[bess::PacketBatch::kMaxBurst];
+  int n = 0;
+
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+
+    // Programs that store to the packet directly may touch any byte of the
+    // first segment.
+    if (writes && !pkt->make_writable(pkt->head_len())) {
+      DropPacket(ctx, pkt);
+      continue;
+    }
+
+    PacketContext &c = pctx[n];
+    c.pkt = pkt;
+    c.igate = ctx->current_igate;
+    c.attr_offsets = offsets;
+    c.Reset();
+    pctxs[n] = &c;
+    pkts[n] = pkt;
+    n++;
+  }
+
+  prog_.RunBatch(pctxs, n, rets);
+
+  for (int i = 0; i < n; i++) {
+    if (rets[i] < kNumOGates) {
+      EmitPacket(ctx, pkts[i], rets[i]);
+    } else {
+      DropPacket(ctx, pkts[i]);
+    }
+  }
+}
+
+std::string EBPF::GetDesc() const {
+  return bess::utils::Format("%zu maps%s", maps_.size(),
+                             prog_.jitted() ? ", jit" : "");
+}
+
+Map *EBPF::FindMap(const std::string &name) const {
+  auto it = map_index_.find(name);
+  if (it == map_index_.end()) {
+    return nullptr;
+  }
+  return maps_[it->second].get();
+}
+
+CommandResponse EBPF::CommandMapLookup(
+    const bess::pb::EBPFCommandMapLookupArg &arg) {
+  Map *map = FindMap(arg.map());
+  if (!map) {
+    return CommandFailure(ENOENT, "no map '%s'", arg.map().c_str());
+  }
+  if (arg.key().size() != map->key_size()) {
+    return CommandFailure(EINVAL, "key must be %u bytes", map->key_size());
+  }
+
+  const void *value = map->Lookup(arg.key().data());
+  if (!value) {
+    return CommandFailure(ENOENT, "key not found");
+  }
+
+  bess::pb::EBPFCommandMapLookupResponse r;
+  r.set_value(value, map->value_size());
+  return CommandSuccess(r);
+}
+
+CommandResponse EBPF::CommandMapUpdate(
+    const bess::pb::EBPFCommandMapUpdateArg &arg) {
+  Map *map = FindMap(arg.map());
+  if (!map) {
+    return CommandFailure(ENOENT, "no map '%s'", arg.map().c_str());
+  }
+  if (arg.key().size() != map->key_size()) {
+    return CommandFailure(EINVAL, "key must be %u bytes", map->key_size());
+  }
+  if (arg.value().size() != map->value_size()) {
+    return CommandFailure(EINVAL, "value must be %u bytes",
+                          map->value_size());
+  }
+
+  int ret = map->Update(arg.key().data(), arg.value().data(), arg.flags());
+  if (ret < 0) {
+    return CommandFailure(-ret, "map update failed");
+  }
+
+  return CommandSuccess();
+}
+
+CommandResponse EBPF::CommandMapDelete(
+    const bess::pb::EBPFCommandMapDeleteArg &arg) {
+  Map *map = FindMap(arg.map());
+  if (!map) {
+    return CommandFailure(ENOENT, "no map '%s'", arg.map().c_str());
+  }
+  if (arg.key().size() != map->key_size()) {
+    return CommandFailure(EINVAL, "key must be %u bytes", map->key_size());
+  }
+
+  int ret = map->Delete(arg.key().data());
+  if (ret < 0) {
+    return CommandFailure(-ret, "map delete failed");
+  }
+
+  return CommandSuccess();
+}
+
+ADD_MODULE(EBPF, "ebpf", "runs eBPF programs on packets")
@@ -0,0 +1,80 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_MODULES_EBPF_H_
+#define BESS_MODULES_EBPF_H_
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../module.h"
+#include "../pb/module_msg.pb.h"
+#include "../utils/ebpf.h"
+
+using bess::utils::ebpf::Map;
+using bess::utils::ebpf::Program;
+
+// Runs a user-supplied eBPF program on each packet and sends the packet out
+// of the gate the program returns. See utils/ebpf.h for what programs can do.
+class EBPF final : public Module {
+ public:
+  static const gate_idx_t kNumIGates = MAX_GATES;
+  static const gate_idx_t kNumOGates = MAX_GATES;
+
+  static const Commands cmds;
+
+  // Maps are not thread safe, so only one worker may run the module.
+  EBPF() : Module() {}
+
+  CommandResponse Init(const bess::pb::EBPFArg &arg);
+
+  void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
+
+  std::string GetDesc() const override;
+
+  CommandResponse CommandMapLookup(
+      const bess::pb::EBPFCommandMapLookupArg &arg);
+  CommandResponse CommandMapUpdate(
+      const bess::pb::EBPFCommandMapUpdateArg &arg);
+  CommandResponse CommandMapDelete(
+      const bess::pb::EBPFCommandMapDeleteArg &arg);
+
+ private:
+  // Returns the map called "name", or nullptr
+  Map *FindMap(const std::string &name) const;
+
+  Program prog_;
+  std::vector<std::shared_ptr<Map>> maps_;
+  std::map<std::string, size_t> map_index_;  // name -> index in maps_
+};
+
+#endif  // BESS_MODULES_EBPF_H_
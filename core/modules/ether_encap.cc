@@ -31,22 +31,16 @@
 #include "ether_encap.h"
 
 #include "../utils/ether.h"
+#include "parse.h"
 
 using bess::utils::Ethernet;
 
-enum {
-  ATTR_R_ETHER_SRC,
-  ATTR_R_ETHER_DST,
-  ATTR_R_ETHER_TYPE,
-};
-
 CommandResponse EtherEncap::Init(
     const bess::pb::EtherEncapArg &arg[[maybe_unused]]) {
-  using AccessMode = bess::metadata::Attribute::AccessMode;
-
-  AddMetadataAttr("ether_src", sizeof(Ethernet::Address), AccessMode::kRead);
-  AddMetadataAttr("ether_dst", sizeof(Ethernet::Address), AccessMode::kRead);
-  AddMetadataAttr("ether_type", 2, AccessMode::kRead);
+  ether_src_attr_.Register(this, "ether_src");
+  ether_dst_attr_.Register(this, "ether_dst");
+  ether_type_attr_.Register(this, "ether_type");
+  info_attr_.Register(this, bess::utils::kHeaderInfoAttrName, true);
 
   return CommandSuccess();
 };
@@ -54,16 +48,23 @@ CommandResponse EtherEncap::Init(
 void EtherEncap::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   int cnt = batch->cnt();
 
+  InvalidateHeaderInfo(info_attr_, batch);
+
+  Ethernet::Address ether_src[bess::PacketBatch::kMaxBurst];
+  Ethernet::Address ether_dst[bess::PacketBatch::kMaxBurst];
+  bess::utils::be16_t ether_type[bess::PacketBatch::kMaxBurst];
+
+  ether_src_attr_.Gather(batch, ether_src);
+  ether_dst_attr_.Gather(batch, ether_dst);
+  ether_type_attr_.Gather(batch, ether_type);
+
   for (int i = 0; i < cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
 
-    Ethernet::Address ether_src;
-    Ethernet::Address ether_dst;
-    bess::utils::be16_t ether_type;
-
-    ether_src = get_attr<Ethernet::Address>(this, ATTR_R_ETHER_SRC, pkt);
-    ether_dst = get_attr<Ethernet::Address>(this, ATTR_R_ETHER_DST, pkt);
-    ether_type = get_attr<bess::utils::be16_t>(this, ATTR_R_ETHER_TYPE, pkt);
+    // The headroom may be shared with other packets
+    if (unlikely(!pkt->make_writable(0))) {
+      continue;
+    }
 
     Ethernet *eth = static_cast<Ethernet *>(pkt->prepend(sizeof(*eth)));
 
@@ -72,9 +73,9 @@ void EtherEncap::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
       continue;
     }
 
-    eth->dst_addr = ether_dst;
-    eth->src_addr = ether_src;
-    eth->ether_type = ether_type;
+    eth->dst_addr = ether_dst[i];
+    eth->src_addr = ether_src[i];
+    eth->ether_type = ether_type[i];
   }
 
   RunNextModule(ctx, batch);
@@ -33,6 +33,8 @@
 
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
+#include "../utils/ether.h"
+#include "../utils/header_parser.h"
 
 class EtherEncap final : public Module {
  public:
@@ -41,6 +43,14 @@ class EtherEncap final : public Module {
   CommandResponse Init(const bess::pb::EtherEncapArg &arg);
 
   void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
+
+ private:
+  bess::metadata::ReadAttr<bess::utils::Ethernet::Address> ether_src_attr_;
+  bess::metadata::ReadAttr<bess::utils::Ethernet::Address> ether_dst_attr_;
+  bess::metadata::ReadAttr<bess::utils::be16_t> ether_type_attr_;
+
+  // Set by Parse upstream, if any. Marked stale, as headers are added.
+  bess::metadata::UpdateAttr<bess::utils::HeaderInfo> info_attr_;
 };
 
 #endif  // BESS_MODULES_ETHERENCAP_H_
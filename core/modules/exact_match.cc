@@ -227,19 +227,31 @@ void ExactMatch::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
 
   default_gate = ACCESS_ONCE(default_gate_);
 
-  const auto buffer_fn = [&](bess::Packet *pkt, const ExactMatchField &f) {
-    int attr_id = f.attr_id;
-    if (attr_id >= 0) {
-      return ptr_attr<uint8_t>(this, attr_id, pkt);
+  int cnt = batch->cnt();
+
+  if (table_.offset_only()) {
+    // Lets the table gather all fields of a packet at once
+    const void *bufs[bess::PacketBatch::kMaxBurst];
+    for (int i = 0; i < cnt; i++) {
+      bufs[i] = batch->pkts()[i]->head_data<void *>();
     }
-    return pkt->head_data<uint8_t *>() + f.offset;
-  };
-  table_.MakeKeys(batch, buffer_fn, keys);
+    table_.MakeKeys(bufs, keys, cnt);
+  } else {
+    const auto buffer_fn = [&](bess::Packet *pkt, const ExactMatchField &f) {
+      int attr_id = f.attr_id;
+      if (attr_id >= 0) {
+        return ptr_attr<uint8_t>(this, attr_id, pkt);
+      }
+      return pkt->head_data<uint8_t *>() + f.offset;
+    };
+    table_.MakeKeys(batch, buffer_fn, keys);
+  }
+
+  gate_idx_t gates[bess::PacketBatch::kMaxBurst];
+  table_.Find(keys, gates, cnt, default_gate);
 
-  int cnt = batch->cnt();
   for (int i = 0; i < cnt; i++) {
-    bess::Packet *pkt = batch->pkts()[i];
-    EmitPacket(ctx, pkt, table_.Find(keys[i], default_gate));
+    EmitPacket(ctx, batch->pkts()[i], gates[i]);
   }
 }
 
@@ -59,6 +59,10 @@ class ExactMatch final : public Module {
 
   std::string GetDesc() const override;
 
+  size_t MemoryUsage() const override {
+    return Module::MemoryUsage() + table_.MemoryUsage();
+  }
+
   CommandResponse Init(const bess::pb::ExactMatchArg &arg);
   CommandResponse GetInitialArg(const bess::pb::EmptyArg &arg);
   CommandResponse GetRuntimeConfig(const bess::pb::EmptyArg &arg);
@@ -186,7 +186,8 @@ CommandResponse FlowGen::ProcessArguments(const bess::pb::FlowGenArg &arg) {
     return CommandFailure(EINVAL, "must specify 'template'");
   }
 
-  if (arg.template_().length() > MAX_TEMPLATE_SIZE) {
+  if (arg.template_().length() > MAX_TEMPLATE_SIZE ||
+      (pool_ && arg.template_().length() > pool_->data_size())) {
     return CommandFailure(EINVAL, "'template' is too big");
   }
 
@@ -278,7 +279,8 @@ void FlowGen::UpdateDerivedParameters() {
 CommandResponse FlowGen::CommandUpdate(const bess::pb::FlowGenArg &arg) {
   if (arg.template_().length() > 0) {
     LOG(INFO) << "Updating FlowGen template";
-    if (arg.template_().length() > MAX_TEMPLATE_SIZE) {
+    if (arg.template_().length() > MAX_TEMPLATE_SIZE ||
+        (pool_ && arg.template_().length() > pool_->data_size())) {
       return CommandFailure(EINVAL, "'template' is too big");
     }
     template_size_ = arg.template_().length();
@@ -382,6 +384,14 @@ CommandResponse FlowGen::Init(const bess::pb::FlowGenArg &arg) {
     return CommandFailure(ENOMEM, "task creation failed");
   }
 
+  if (!arg.pool().empty()) {
+    pool_ = bess::PacketPool::Find(arg.pool());
+    if (!pool_) {
+      return CommandFailure(ENOENT, "Packet pool '%s' does not exist",
+                            arg.pool().c_str());
+    }
+  }
+
   templ_ = new char[MAX_TEMPLATE_SIZE];
   if (templ_ == nullptr) {
     return CommandFailure(ENOMEM, "unable to allocate template");
@@ -425,37 +435,26 @@ CommandResponse FlowGen::UpdateBaseAddresses() {
   return CommandSuccess();
 }
 
-bess::Packet *FlowGen::FillPacket(struct flow *f) {
-  bess::Packet *pkt;
-
+void FlowGen::FillPacket(bess::Packet *pkt, struct flow *f, bool syn,
+                         bool fin) {
   int size = template_size_;
 
-  if (!(pkt = bess::Packet::Alloc())) {
-    return nullptr;
-  }
-
-  char *p = pkt->buffer<char *>() + SNBUF_HEADROOM;
+  char *p = pkt->head_data<char *>();
 
   Ethernet *eth = reinterpret_cast<Ethernet *>(p);
   Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
   Tcp *tcp = reinterpret_cast<Tcp *>(ip + 1);
 
-  // SYN or FIN?
-  if (f->first_pkt || f->packets_left <= 1) {
+  // SYN or FIN? The rest of the template has already been copied in.
+  if (syn || fin) {
     pkt->set_total_len(60);  // eth + ip + tcp
     pkt->set_data_len(60);   // eth + ip + tcp
     ip->length = be16_t(40);
-  } else {
-    pkt->set_data_off(SNBUF_HEADROOM);
-    pkt->set_total_len(size);
-    pkt->set_data_len(size);
-
-    bess::utils::Copy(p, templ_, size, true);
   }
 
-  uint8_t tcp_flags = f->first_pkt ? /* SYN */ 0x02 : /* ACK */ 0x10;
+  uint8_t tcp_flags = syn ? /* SYN */ 0x02 : /* ACK */ 0x10;
 
-  if (f->packets_left <= 1) {
+  if (fin) {
     tcp_flags |= 0x01; /* FIN */
   }
 
@@ -468,9 +467,7 @@ bess::Packet *FlowGen::FillPacket(struct flow *f) {
   tcp->seq_num = be32_t(f->next_seq_no);
 
   f->next_seq_no +=
-      f->first_pkt ? 1 : size - (sizeof(*eth) + sizeof(*ip) + sizeof(*tcp));
-
-  return pkt;
+      syn ? 1 : size - (sizeof(*eth) + sizeof(*ip) + sizeof(*tcp));
 }
 
 void FlowGen::GeneratePackets(Context *ctx, bess::PacketBatch *batch) {
@@ -479,11 +476,20 @@ void FlowGen::GeneratePackets(Context *ctx, bess::PacketBatch *batch) {
   batch->clear();
   const int burst = ACCESS_ONCE(burst_);
 
-  while (batch->cnt() < burst && !events_.empty()) {
+  struct {
+    struct flow *f;
+    bool syn;
+    bool fin;
+  } pending[bess::PacketBatch::kMaxBurst];
+  int cnt = 0;
+
+  // First pick the flows to emit a packet for, so that all packets of the
+  // batch can be allocated (and stamped with the template) in one go.
+  while (cnt < burst && !events_.empty()) {
     uint64_t t = events_.top().first;
     struct flow *f = events_.top().second;
     if (!f || now < t)
-      return;
+      break;
 
     events_.pop();
 
@@ -493,10 +499,7 @@ void FlowGen::GeneratePackets(Context *ctx, bess::PacketBatch *batch) {
       continue;
     }
 
-    bess::Packet *pkt = FillPacket(f);
-    if (pkt) {
-      batch->add(pkt);
-    }
+    pending[cnt++] = {f, f->first_pkt, f->packets_left <= 1};
 
     if (f->first_pkt) {
       ScheduleFlow(t + NextFlowArrival());
@@ -507,6 +510,24 @@ void FlowGen::GeneratePackets(Context *ctx, bess::PacketBatch *batch) {
 
     events_.emplace(t + static_cast<uint64_t>(1e9 / flow_pps_), f);
   }
+
+  if (cnt == 0) {
+    return;
+  }
+
+  struct rte_mempool *pool =
+      pool_ ? pool_->mempool(current_worker.socket()) : nullptr;
+  if (!bess::Packet::Alloc(batch->pkts(), cnt, templ_, template_size_,
+                           pool)) {
+    return;
+  }
+
+  for (int i = 0; i < cnt; i++) {
+    FillPacket(batch->pkts()[i], pending[i].f, pending[i].syn,
+               pending[i].fin);
+  }
+
+  batch->set_cnt(cnt);
 }
 
 struct task_result FlowGen::RunTask(Context *ctx, bess::PacketBatch *batch,
@@ -32,6 +32,7 @@
 #define BESS_MODULES_FLOWGEN_H_
 
 #include "../module.h"
+#include "../packet_pool.h"
 #include "../pb/module_msg.pb.h"
 
 #include <queue>
@@ -87,7 +88,8 @@ class FlowGen final : public Module {
         flow_pkts_(),
         flow_gap_ns_(),
         pareto_(),
-        burst_() {
+        burst_(),
+        pool_() {
     is_task_ = true;
   }
 
@@ -114,7 +116,7 @@ class FlowGen final : public Module {
   void PopulateInitialFlows();
 
   CommandResponse UpdateBaseAddresses();
-  bess::Packet *FillPacket(struct flow *f);
+  void FillPacket(bess::Packet *pkt, struct flow *f, bool syn, bool fin);
   void GeneratePackets(Context *ctx, bess::PacketBatch *batch);
 
   CommandResponse ProcessArguments(const bess::pb::FlowGenArg &arg);
@@ -170,6 +172,9 @@ class FlowGen final : public Module {
   } pareto_;
 
   int burst_;
+
+  // nullptr for the default pool
+  const bess::PacketPool *pool_;
 };
 
 #endif  // BESS_MODULES_FLOWGEN_H_
@@ -30,7 +30,11 @@
 
 #include "generic_decap.h"
 
+#include "parse.h"
+
 CommandResponse GenericDecap::Init(const bess::pb::GenericDecapArg &arg) {
+  info_attr_.Register(this, bess::utils::kHeaderInfoAttrName, true);
+
   if (arg.bytes() == 0) {
     return CommandSuccess();
   }
@@ -44,6 +48,8 @@ CommandResponse GenericDecap::Init(const bess::pb::GenericDecapArg &arg) {
 void GenericDecap::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   int cnt = batch->cnt();
 
+  InvalidateHeaderInfo(info_attr_, batch);
+
   int decap_size = decap_size_;
 
   for (int i = 0; i < cnt; i++) {
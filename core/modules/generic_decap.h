@@ -33,6 +33,7 @@
 
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
+#include "../utils/header_parser.h"
 
 class GenericDecap final : public Module {
  public:
@@ -46,6 +47,9 @@ class GenericDecap final : public Module {
 
  private:
   int decap_size_;
+
+  // Set by Parse upstream, if any. Marked stale, as headers are removed.
+  bess::metadata::UpdateAttr<bess::utils::HeaderInfo> info_attr_;
 };
 
 #endif  // BESS_MODULES_GENERICDECAP_H_
@@ -31,6 +31,7 @@
 #include "generic_encap.h"
 
 #include "../utils/endian.h"
+#include "parse.h"
 
 static_assert(MAX_FIELD_SIZE <= sizeof(uint64_t),
               "field cannot be larger than 8 bytes");
@@ -122,12 +123,16 @@ CommandResponse GenericEncap::Init(const bess::pb::GenericEncapArg &arg) {
   encap_size_ = size_acc;
   num_fields_ = arg.fields_size();
 
+  info_attr_.Register(this, bess::utils::kHeaderInfoAttrName, true);
+
   return CommandSuccess();
 }
 
 void GenericEncap::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   int cnt = batch->cnt();
 
+  InvalidateHeaderInfo(info_attr_, batch);
+
   int encap_size = encap_size_;
 
   char headers[bess::PacketBatch::kMaxBurst][MAX_HEADER_SIZE] __ymm_aligned;
@@ -150,6 +155,11 @@ void GenericEncap::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   for (int i = 0; i < cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
 
+    // The headroom may be shared with other packets
+    if (unlikely(!pkt->make_writable(0))) {
+      continue;
+    }
+
     char *p = static_cast<char *>(pkt->prepend(encap_size));
 
     if (unlikely(!p)) {
@@ -33,6 +33,7 @@
 
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
+#include "../utils/header_parser.h"
 
 #define MAX_FIELDS 8
 #define MAX_FIELD_SIZE 8
@@ -63,6 +64,9 @@ class GenericEncap final : public Module {
   int num_fields_;
 
   struct Field fields_[MAX_FIELDS];
+
+  // Set by Parse upstream, if any. Marked stale, as headers are added.
+  bess::metadata::UpdateAttr<bess::utils::HeaderInfo> info_attr_;
 };
 
 #endif  // BESS_MODULES_GENERICENCAP_H_
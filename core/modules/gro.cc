@@ -0,0 +1,294 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "gro.h"
+
+#include <rte_hash_crc.h>
+
+#include <algorithm>
+
+#include "../utils/checksum.h"
+#include "../utils/ether.h"
+#include "../utils/flow_hash.h"
+#include "../utils/format.h"
+#include "../utils/ip.h"
+#include "../utils/tcp.h"
+
+using bess::utils::Ethernet;
+using bess::utils::Ipv4;
+using bess::utils::Tcp;
+using bess::utils::be16_t;
+
+// Ethernet + IPv4 (without options) + TCP (with options) headers
+static const uint16_t kMaxHeaderLen = sizeof(Ethernet) + sizeof(Ipv4) + 60;
+
+// Longer chains are not worth it (and many NICs cannot send them anyway)
+static const uint16_t kMaxSegs = 64;
+
+static const uint8_t kMergeableFlags = Tcp::Flag::kAck | Tcp::Flag::kPsh;
+
+static const uint16_t kFragmentMask = Ipv4::Flag::kMF | 0x1FFF;
+
+CommandResponse GRO::Init(const bess::pb::GROArg &arg) {
+  if (arg.max_size() > kDefaultMaxSize) {
+    return CommandFailure(EINVAL, "'max_size' must be [0, %u]",
+                          kDefaultMaxSize);
+  }
+
+  if (arg.max_size()) {
+    max_size_ = arg.max_size();
+  }
+
+  flow_hash_attr_.Register(this, bess::utils::kFlowHashAttrName, true);
+
+  timeout_ns_ = arg.timeout_ns();
+  if (timeout_ns_) {
+    task_id_t tid = RegisterTask(nullptr);
+    if (tid == INVALID_TASK_ID) {
+      return CommandFailure(ENOMEM, "Task creation failed");
+    }
+  }
+
+  return CommandSuccess();
+}
+
+void GRO::DeInit() {
+  for (size_t i = 0; i < num_active_; i++) {
+    bess::Packet::Free(flows_[active_[i]].head);
+    flows_[active_[i]].head = nullptr;
+  }
+  num_active_ = 0;
+}
+
+std::string GRO::GetDesc() const {
+  return bess::utils::Format("%zu flows", num_active_);
+}
+
+bess::Packet *GRO::Flush(Flow *flow) {
+  bess::Packet *pkt = flow->head;
+
+  if (flow->segs > 1) {
+    Ethernet *eth = pkt->head_data<Ethernet *>();
+    Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
+    Tcp *tcp = reinterpret_cast<Tcp *>(ip + 1);
+    uint16_t tcp_len = flow->ip_len - sizeof(*ip);
+
+    ip->length = be16_t(flow->ip_len);
+    ip->checksum = bess::utils::CalculateIpv4NoOptChecksum(*ip);
+
+    tcp->checksum = 0;
+    uint32_t sum = bess::utils::CalculateIpv4PseudoHeaderSum(
+        ip->src, ip->dst, Ipv4::Proto::kTcp, tcp_len);
+    sum = bess::utils::AddSum(
+        sum, pkt->CalculateSum(sizeof(*eth) + sizeof(*ip), tcp_len));
+    tcp->checksum = bess::utils::FoldChecksum(sum);
+  }
+
+  size_t last = active_[--num_active_];
+  active_[flow->slot] = last;
+  flows_[last].slot = flow->slot;
+  flow->head = nullptr;
+
+  return pkt;
+}
+
+void GRO::FlushExpired(Context *ctx, uint64_t deadline_ns) {
+  size_t i = 0;
+
+  // Flush() moves the last active flow into the freed slot
+  while (i < num_active_) {
+    Flow *flow = &flows_[active_[i]];
+    if (flow->start_ns <= deadline_ns) {
+      EmitPacket(ctx, Flush(flow));
+    } else {
+      i++;
+    }
+  }
+}
+
+bool GRO::Merge(Context *ctx, bess::Packet *pkt) {
+  Ethernet *eth = pkt->pull_head<Ethernet *>(
+      std::min<uint32_t>(pkt->total_len(), kMaxHeaderLen));
+  if (unlikely(!eth) || eth->ether_type != be16_t(Ethernet::Type::kIpv4)) {
+    return false;
+  }
+
+  Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
+  size_t ip_bytes = ip->header_length << 2;
+  if (ip->protocol != Ipv4::Proto::kTcp || ip_bytes < sizeof(*ip) ||
+      static_cast<size_t>(pkt->total_len()) <
+          sizeof(*eth) + ip_bytes + sizeof(Tcp)) {
+    return false;
+  }
+
+  Tcp *tcp =
+      reinterpret_cast<Tcp *>(reinterpret_cast<uint8_t *>(ip) + ip_bytes);
+  FlowKey key = {ip->src, ip->dst, tcp->src_port, tcp->dst_port};
+  uint32_t hash = flow_hash_attr_.valid() ? flow_hash_attr_.get(pkt)
+                                          : rte_hash_crc(&key, sizeof(key), 0);
+
+  // Multiply-shift, taking the high bits: the low bits of an RSS hash are
+  // what the NIC used to pick our queue, so they are mostly the same here.
+  Flow *flow = &flows_[(hash * 0x9e3779b1u) >> (32 - kFlowBits)];
+  bool same_flow = flow->head && flow->key == key;
+
+  uint16_t ip_len = ip->length.value();
+  uint16_t tcp_bytes = tcp->offset << 2;
+  uint16_t hdr_len = sizeof(*eth) + ip_bytes + tcp_bytes;
+
+  // Only plain, unfragmented data segments without trailing padding
+  if (ip_bytes != sizeof(*ip) ||
+      (ip->fragment_offset.value() & kFragmentMask) ||
+      tcp_bytes < sizeof(*tcp) || hdr_len >= sizeof(*eth) + ip_len ||
+      static_cast<size_t>(pkt->total_len()) != sizeof(*eth) + ip_len ||
+      (tcp->flags & ~kMergeableFlags) || !(tcp->flags & Tcp::Flag::kAck)) {
+    // Keep the segments of the flow in order
+    if (same_flow) {
+      EmitPacket(ctx, Flush(flow));
+    }
+    return false;
+  }
+
+  uint16_t payload_len = sizeof(*eth) + ip_len - hdr_len;
+
+  if (same_flow) {
+    bess::Packet *head = flow->head;
+    Ipv4 *head_ip = reinterpret_cast<Ipv4 *>(head->head_data<Ethernet *>() + 1);
+    Tcp *head_tcp = reinterpret_cast<Tcp *>(head_ip + 1);
+
+    if (tcp->seq_num.value() == flow->next_seq &&
+        tcp->ack_num == head_tcp->ack_num && hdr_len == flow->hdr_len &&
+        payload_len <= flow->mss &&
+        flow->ip_len + payload_len <= max_size_ &&
+        head->nb_segs() + pkt->nb_segs() <= kMaxSegs &&
+        ip->ttl == head_ip->ttl &&
+        ip->type_of_service == head_ip->type_of_service &&
+        memcmp(tcp + 1, head_tcp + 1, tcp_bytes - sizeof(*tcp)) == 0) {
+      head_tcp->flags |= tcp->flags;
+      head_tcp->window = tcp->window;
+
+      // Chain the payload only
+      pkt->adj(hdr_len);
+      flow->tail->set_next(pkt);
+      flow->tail = pkt->last_segment();
+      head->set_nb_segs(head->nb_segs() + pkt->nb_segs());
+      head->set_total_len(head->total_len() + payload_len);
+
+      flow->next_seq += payload_len;
+      flow->ip_len += payload_len;
+      flow->segs++;
+
+      // A short or pushed segment ends the burst
+      if (payload_len < flow->mss || (tcp->flags & Tcp::Flag::kPsh) ||
+          flow->ip_len + flow->mss > max_size_) {
+        EmitPacket(ctx, Flush(flow));
+      }
+      return true;
+    }
+  }
+
+  // Evict the colliding (or non-contiguous) flow
+  if (flow->head) {
+    EmitPacket(ctx, Flush(flow));
+  }
+
+  if ((tcp->flags & Tcp::Flag::kPsh) || ip_len + payload_len > max_size_) {
+    return false;
+  }
+
+  flow->key = key;
+  flow->head = pkt;
+  flow->tail = pkt->last_segment();
+  flow->next_seq = tcp->seq_num.value() + payload_len;
+  flow->hdr_len = hdr_len;
+  flow->mss = payload_len;
+  flow->ip_len = ip_len;
+  flow->segs = 1;
+  flow->start_ns = ctx->current_ns;
+  flow->slot = num_active_;
+  active_[num_active_++] = flow - flows_;
+
+  return true;
+}
+
+void GRO::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
+  int cnt = batch->cnt();
+
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+    if (!Merge(ctx, pkt)) {
+      EmitPacket(ctx, pkt);
+    }
+  }
+
+  if (timeout_ns_ == 0) {
+    FlushExpired(ctx, UINT64_MAX);
+  } else if (ctx->current_ns >= timeout_ns_) {
+    FlushExpired(ctx, ctx->current_ns - timeout_ns_);
+  }
+}
+
+struct task_result GRO::RunTask(Context *ctx, bess::PacketBatch *batch,
+                                void *) {
+  const int pkt_overhead = 24;
+
+  if (num_active_ == 0 || ctx->current_ns < timeout_ns_) {
+    return {.block = true, .packets = 0, .bits = 0};
+  }
+
+  uint64_t deadline_ns = ctx->current_ns - timeout_ns_;
+  uint64_t total_bytes = 0;
+  size_t i = 0;
+
+  batch->clear();
+  while (i < num_active_ && !batch->full()) {
+    Flow *flow = &flows_[active_[i]];
+    if (flow->start_ns <= deadline_ns) {
+      bess::Packet *pkt = Flush(flow);
+      total_bytes += pkt->total_len();
+      batch->add(pkt);
+    } else {
+      i++;
+    }
+  }
+
+  uint32_t cnt = batch->cnt();
+  if (cnt == 0) {
+    return {.block = true, .packets = 0, .bits = 0};
+  }
+
+  RunNextModule(ctx, batch);
+
+  return {.block = false,
+          .packets = cnt,
+          .bits = (total_bytes + cnt * pkt_overhead) * 8};
+}
+
+ADD_MODULE(GRO, "gro", "coalesces TCP segments into large packets")
@@ -0,0 +1,118 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_MODULES_GRO_H_
+#define BESS_MODULES_GRO_H_
+
+#include "../module.h"
+#include "../pb/module_msg.pb.h"
+#include "../utils/endian.h"
+
+// Coalesces in-order TCP/IPv4 segments of the same flow into chained packets
+class GRO final : public Module {
+ public:
+  GRO()
+      : Module(),
+        max_size_(kDefaultMaxSize),
+        timeout_ns_(),
+        flows_(),
+        active_(),
+        num_active_(),
+        flow_hash_attr_() {
+    is_task_ = true;
+  }
+
+  CommandResponse Init(const bess::pb::GROArg &arg);
+
+  void DeInit() override;
+
+  struct task_result RunTask(Context *ctx, bess::PacketBatch *batch,
+                             void *arg) override;
+  void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
+
+  std::string GetDesc() const override;
+
+ private:
+  static const uint32_t kDefaultMaxSize = 65535;
+
+  // Flows are direct-mapped; a colliding flow flushes the one being held.
+  static const int kFlowBits = 8;
+  static const size_t kNumFlows = 1 << kFlowBits;
+
+  struct FlowKey {
+    bess::utils::be32_t src_ip;
+    bess::utils::be32_t dst_ip;
+    bess::utils::be16_t src_port;
+    bess::utils::be16_t dst_port;
+
+    bool operator==(const FlowKey &other) const {
+      return src_ip == other.src_ip && dst_ip == other.dst_ip &&
+             src_port == other.src_port && dst_port == other.dst_port;
+    }
+  };
+
+  struct Flow {
+    FlowKey key;
+    bess::Packet *head;  // nullptr if the slot is free
+    bess::Packet *tail;  // last segment of the chain
+    uint32_t next_seq;   // expected sequence number of the next segment
+    uint16_t hdr_len;    // Ethernet + IP + TCP header bytes
+    uint16_t mss;        // payload size of the first segment
+    uint16_t ip_len;     // IP length of the coalesced packet so far
+    uint16_t segs;       // number of coalesced segments
+    uint64_t start_ns;   // when the first segment arrived
+    size_t slot;         // index in active_
+  };
+
+  // Tries to coalesce pkt into its flow. Returns false if pkt must be
+  // forwarded as it is. Flows that must not be held any longer are emitted.
+  bool Merge(Context *ctx, bess::Packet *pkt);
+
+  // Fixes the headers of the packet held by the flow, releases the flow and
+  // returns the packet.
+  bess::Packet *Flush(Flow *flow);
+
+  // Emits packets of all flows started at or before "deadline_ns"
+  void FlushExpired(Context *ctx, uint64_t deadline_ns);
+
+  uint32_t max_size_;
+  uint64_t timeout_ns_;
+
+  Flow flows_[kNumFlows];
+
+  // Indices of the flows currently holding a packet
+  size_t active_[kNumFlows];
+  size_t num_active_;
+
+  // Picks the flow slot instead of hashing FlowKey, if set upstream
+  bess::metadata::ReadAttr<uint32_t> flow_hash_attr_;
+};
+
+#endif  // BESS_MODULES_GRO_H_
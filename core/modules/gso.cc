@@ -0,0 +1,199 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "gso.h"
+
+#include <algorithm>
+
+#include "../utils/checksum.h"
+#include "../utils/ether.h"
+#include "../utils/format.h"
+#include "../utils/ip.h"
+#include "../utils/tcp.h"
+#include "parse.h"
+
+using bess::utils::Ethernet;
+using bess::utils::Ipv4;
+using bess::utils::Tcp;
+using bess::utils::be16_t;
+using bess::utils::be32_t;
+
+// Ethernet + IPv4 (with options) + TCP (with options) headers
+static const uint16_t kMaxHeaderLen = sizeof(Ethernet) + 60 + 60;
+
+static const uint16_t kFragmentMask = Ipv4::Flag::kMF | 0x1FFF;
+
+// Congestion Window Reduced, not in Tcp::Flag
+static const uint8_t kTcpFlagCwr = 0x80;
+
+CommandResponse GSO::Init(const bess::pb::GSOArg &arg) {
+  if ((arg.mss() && arg.mss() < kMinMss) ||
+      arg.mss() + kMaxHeaderLen > SNBUF_DATA) {
+    return CommandFailure(EINVAL, "'mss' must be 0 or [%hu, %d]", kMinMss,
+                          SNBUF_DATA - kMaxHeaderLen);
+  }
+
+  if (arg.mss()) {
+    mss_ = arg.mss();
+  }
+
+  info_attr_.Register(this, bess::utils::kHeaderInfoAttrName, true);
+
+  return CommandSuccess();
+}
+
+std::string GSO::GetDesc() const {
+  return bess::utils::Format("mss=%hu", mss_);
+}
+
+bool GSO::Segment(Context *ctx, const bess::Packet *pkt, uint16_t hdr_len,
+                  uint16_t payload_len, size_t num_segs) {
+  const char *hdr = pkt->head_data<const char *>();
+  const Ipv4 *ip = reinterpret_cast<const Ipv4 *>(hdr + sizeof(Ethernet));
+  const size_t ip_bytes = ip->header_length << 2;
+  const Tcp *tcp = reinterpret_cast<const Tcp *>(
+      reinterpret_cast<const char *>(ip) + ip_bytes);
+
+  const uint32_t seq = tcp->seq_num.value();
+  const uint16_t id = ip->id.value();
+  const uint8_t flags = tcp->flags;
+
+  // Allocate all segments first, so that the packet is either sent in full
+  // or not at all
+  bess::Packet *segs[kMaxSegs];
+
+  for (size_t i = 0; i < num_segs; i += bess::PacketBatch::kMaxBurst) {
+    size_t cnt = std::min(num_segs - i, bess::PacketBatch::kMaxBurst);
+    if (bess::Packet::Alloc(segs + i, cnt, 0) != cnt) {
+      for (size_t j = 0; j < i; j += bess::PacketBatch::kMaxBurst) {
+        bess::Packet::Free(segs + j, bess::PacketBatch::kMaxBurst);
+      }
+      return false;
+    }
+  }
+
+  uint32_t offset = 0;
+  for (size_t i = 0; i < num_segs; i++) {
+    bess::Packet *seg = segs[i];
+    uint16_t len = std::min<uint32_t>(mss_, payload_len - offset);
+    char *p = seg->head_data<char *>();
+
+    seg->set_data_len(hdr_len + len);
+    seg->set_total_len(hdr_len + len);
+    bess::utils::Copy(reinterpret_cast<void *>(seg->metadata<uintptr_t>()),
+                      pkt->metadata<const char *>(), SNBUF_METADATA);
+    bess::utils::Copy(p, hdr, hdr_len);
+    pkt->CopyOut(p + hdr_len, hdr_len + offset, len);
+
+    Ipv4 *seg_ip = reinterpret_cast<Ipv4 *>(p + sizeof(Ethernet));
+    Tcp *seg_tcp = reinterpret_cast<Tcp *>(p + sizeof(Ethernet) + ip_bytes);
+
+    seg_ip->length = be16_t(hdr_len - sizeof(Ethernet) + len);
+    seg_ip->id = be16_t(static_cast<uint16_t>(id + i));
+    seg_ip->checksum = bess::utils::CalculateIpv4Checksum(*seg_ip);
+
+    // FIN/PSH belong to the last segment, CWR to the first one
+    seg_tcp->seq_num = be32_t(seq + offset);
+    seg_tcp->flags = flags;
+    if (offset + len < payload_len) {
+      seg_tcp->flags &= ~(Tcp::Flag::kFin | Tcp::Flag::kPsh);
+    }
+    if (offset > 0) {
+      seg_tcp->flags &= ~kTcpFlagCwr;
+    }
+    seg_tcp->checksum = bess::utils::CalculateIpv4TcpChecksum(*seg_ip,
+                                                              *seg_tcp);
+
+    EmitPacket(ctx, seg);
+    offset += len;
+  }
+
+  return true;
+}
+
+void GSO::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
+  int cnt = batch->cnt();
+  size_t budget = kMaxSegsPerBatch;
+
+  InvalidateHeaderInfo(info_attr_, batch);
+
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+
+    Ethernet *eth = pkt->pull_head<Ethernet *>(
+        std::min<uint32_t>(pkt->total_len(), kMaxHeaderLen));
+    if (unlikely(!eth) || eth->ether_type != be16_t(Ethernet::Type::kIpv4)) {
+      EmitPacket(ctx, pkt);
+      continue;
+    }
+
+    Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
+    size_t ip_bytes = ip->header_length << 2;
+    if (ip->protocol != Ipv4::Proto::kTcp || ip_bytes < sizeof(*ip) ||
+        (ip->fragment_offset.value() & kFragmentMask) ||
+        static_cast<size_t>(pkt->total_len()) <
+            sizeof(*eth) + ip_bytes + sizeof(Tcp)) {
+      EmitPacket(ctx, pkt);
+      continue;
+    }
+
+    Tcp *tcp =
+        reinterpret_cast<Tcp *>(reinterpret_cast<uint8_t *>(ip) + ip_bytes);
+    size_t tcp_bytes = tcp->offset << 2;
+    uint16_t ip_len = ip->length.value();
+    uint16_t hdr_len = sizeof(*eth) + ip_bytes + tcp_bytes;
+
+    // Leave small (or malformed) packets alone
+    if (hdr_len + mss_ >= sizeof(*eth) + ip_len ||
+        static_cast<size_t>(pkt->total_len()) < sizeof(*eth) + ip_len ||
+        tcp_bytes < sizeof(*tcp)) {
+      EmitPacket(ctx, pkt);
+      continue;
+    }
+
+    uint16_t payload_len = sizeof(*eth) + ip_len - hdr_len;
+    size_t num_segs = (payload_len + mss_ - 1) / mss_;
+
+    // Only with many large packets and a small MSS
+    if (unlikely(num_segs > budget)) {
+      DropPacket(ctx, pkt);
+      continue;
+    }
+    budget -= num_segs;
+
+    if (Segment(ctx, pkt, hdr_len, payload_len, num_segs)) {
+      bess::Packet::Free(pkt);
+    } else {
+      DropPacket(ctx, pkt);
+    }
+  }
+}
+
+ADD_MODULE(GSO, "gso", "splits large TCP packets into MSS-sized segments")
@@ -0,0 +1,78 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_MODULES_GSO_H_
+#define BESS_MODULES_GSO_H_
+
+#include "../module.h"
+#include "../pb/module_msg.pb.h"
+#include "../utils/header_parser.h"
+
+// Splits large TCP/IPv4 packets into MSS-sized segments
+class GSO final : public Module {
+ public:
+  GSO() : Module(), mss_(kDefaultMss) {
+    max_allowed_workers_ = Worker::kMaxWorkers;
+  }
+
+  CommandResponse Init(const bess::pb::GSOArg &arg);
+
+  void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
+
+  std::string GetDesc() const override;
+
+ private:
+  static const uint16_t kDefaultMss = 1460;
+  static const uint16_t kMinMss = 88;  // TCP_MIN_MSS of Linux
+
+  // The most segments a packet can be split into
+  static const size_t kMaxSegs = (UINT16_MAX + kMinMss - 1) / kMinMss;
+
+  // The most segments emitted per input batch. Output batches come from the
+  // task's fixed pool (MAX_PBATCH_CNT), which is shared with the rest of the
+  // pipeline, so this keeps GSO to a quarter of it.
+  static const size_t kMaxSegsPerBatch = 64 * bess::PacketBatch::kMaxBurst;
+
+  static_assert(kMaxSegs <= kMaxSegsPerBatch,
+                "A packet must fit in the segment budget of a batch");
+
+  // Emits the "num_segs" segments of pkt, whose headers take "hdr_len" bytes.
+  // Returns false (emitting nothing) if packet allocation failed.
+  bool Segment(Context *ctx, const bess::Packet *pkt, uint16_t hdr_len,
+               uint16_t payload_len, size_t num_segs);
+
+  uint16_t mss_;
+
+  // Set by Parse upstream, if any. Marked stale, as segments are
+  // rebuilt from the head of the packet.
+  bess::metadata::UpdateAttr<bess::utils::HeaderInfo> info_attr_;
+};
+
+#endif  // BESS_MODULES_GSO_H_
@@ -30,9 +30,19 @@
 
 #include "hash_lb.h"
 
+#include <memory>
 #include <utility>
 #include <vector>
 
+#include "../utils/ether.h"
+#include "../utils/flow_hash.h"
+#include "../utils/ip.h"
+
+using bess::utils::Ethernet;
+using bess::utils::HeaderInfo;
+using bess::utils::Ipv4;
+using MaglevTable = bess::utils::MaglevTable<gate_idx_t>;
+
 static inline uint32_t hash_64(uint64_t val, uint32_t init_val) {
 #if __x86_64
   return crc32c_sse42_u64(val, init_val);
@@ -60,6 +70,46 @@ static inline uint16_t hash_range(uint32_t hashval, uint16_t range) {
 #endif
 }
 
+/* Hashes the IP addresses (plus ports and protocol if "l4") of a packet
+ * whose headers were located by the Parse module. Non-IP packets are hashed
+ * over their MAC addresses. */
+static inline uint32_t hash_parsed(const bess::Packet *pkt, HeaderInfo info,
+                                   bool l4) {
+  const char *head = pkt->head_data<const char *>();
+  uint32_t init = 0;
+
+  bess::utils::ReparseIfStale(head, pkt->head_len(), &info);
+
+  if (l4) {
+    init = info.l4_proto;
+    if (info.l4_offset && (info.l4_proto == Ipv4::Proto::kTcp ||
+                           info.l4_proto == Ipv4::Proto::kUdp ||
+                           info.l4_proto == Ipv4::Proto::kSctp ||
+                           info.l4_proto == Ipv4::Proto::kUdpLite)) {
+      init ^= *(reinterpret_cast<const uint32_t *>(head + info.l4_offset));
+    }
+  }
+
+  if (info.l3_offset && info.l3_type == Ethernet::Type::kIpv4) {
+    return hash_64(
+        *(reinterpret_cast<const uint64_t *>(head + info.l3_offset + 12)),
+        init);
+  }
+
+  if (info.l3_offset && info.l3_type == Ethernet::Type::kIpv6) {
+    const uint64_t *addrs =
+        reinterpret_cast<const uint64_t *>(head + info.l3_offset + 8);
+    uint32_t hash_val = init;
+    for (int i = 0; i < 4; i++) {
+      hash_val = hash_64(addrs[i], hash_val);
+    }
+    return hash_val;
+  }
+
+  return hash_64(*(reinterpret_cast<const uint64_t *>(head)),
+                 *(reinterpret_cast<const uint32_t *>(head + 8)));
+}
+
 static inline int is_valid_gate(gate_idx_t gate) {
   return (gate < MAX_GATES || gate == DROP_GATE);
 }
@@ -68,7 +118,7 @@ const Commands HashLB::cmds = {
     {"set_mode", "HashLBCommandSetModeArg",
      MODULE_CMD_FUNC(&HashLB::CommandSetMode), Command::THREAD_UNSAFE},
     {"set_gates", "HashLBCommandSetGatesArg",
-     MODULE_CMD_FUNC(&HashLB::CommandSetGates), Command::THREAD_UNSAFE}};
+     MODULE_CMD_FUNC(&HashLB::CommandSetGates), Command::THREAD_SAFE}};
 
 CommandResponse HashLB::CommandSetMode(
     const bess::pb::HashLBCommandSetModeArg &arg) {
@@ -104,20 +154,72 @@ CommandResponse HashLB::CommandSetGates(
                           kMaxGates);
   }
 
+  if (arg.weights_size() && arg.weights_size() != arg.gates_size()) {
+    return CommandFailure(EINVAL, "'weights' and 'gates' differ in length");
+  }
+
+  std::vector<MaglevTable::Backend> backends;
+  std::vector<bool> seen(MAX_GATES + 1);
   for (int i = 0; i < arg.gates_size(); i++) {
-    gates_[i] = arg.gates(i);
-    if (!is_valid_gate(gates_[i])) {
-      return CommandFailure(EINVAL, "Invalid ogate %d", gates_[i]);
+    int64_t gate = arg.gates(i);
+    if (gate < 0 || gate > UINT16_MAX || !is_valid_gate(gate)) {
+      return CommandFailure(EINVAL, "Invalid ogate %" PRId64, gate);
+    }
+
+    uint64_t weight = arg.weights_size() ? arg.weights(i) : 1;
+    if (!consistent_ && weight != 1) {
+      return CommandFailure(EINVAL, "'weights' requires consistent=True");
+    }
+    if (weight > UINT32_MAX) {
+      return CommandFailure(EINVAL, "Weight %" PRIu64 " is too large", weight);
+    }
+
+    if (consistent_) {
+      if (seen[gate]) {
+        return CommandFailure(EINVAL,
+                              "Duplicate ogate %" PRId64 " (use 'weights')",
+                              gate);
+      }
+      seen[gate] = true;
+      backends.push_back({static_cast<gate_idx_t>(gate),
+                          static_cast<uint32_t>(weight)});
     }
   }
 
-  num_gates_ = arg.gates_size();
+  // Build the new table before touching the live one
+  std::unique_ptr<std::vector<gate_idx_t>> new_gates;
+  if (consistent_) {
+    new_gates.reset(new std::vector<gate_idx_t>(
+        MaglevTable().Build(backends, DROP_GATE)));
+  } else {
+    new_gates.reset(
+        new std::vector<gate_idx_t>(arg.gates().begin(), arg.gates().end()));
+  }
+  if (new_gates->empty()) {
+    new_gates->push_back(DROP_GATE);
+  }
+
+  const std::vector<gate_idx_t> *old_gates = gates_.load();
+  gates_.store(new_gates.release());
+  synchronize_workers();
+  delete old_gates;
+
   return CommandSuccess();
 }
 
 CommandResponse HashLB::Init(const bess::pb::HashLBArg &arg) {
+  consistent_ = arg.consistent();
+  if (arg.flow_hash()) {
+    int ret = flow_hash_attr_.Register(this, bess::utils::kFlowHashAttrName);
+    if (ret < 0) {
+      return CommandFailure(-ret, "Failed to register metadata attribute");
+    }
+  }
+  info_attr_.Register(this, bess::utils::kHeaderInfoAttrName, true);
+
   bess::pb::HashLBCommandSetGatesArg gates_arg;
   *gates_arg.mutable_gates() = arg.gates();
+  *gates_arg.mutable_weights() = arg.weights();
   CommandResponse ret = CommandSetGates(gates_arg);
   if (ret.has_error()) {
     return ret;
@@ -134,12 +236,23 @@ CommandResponse HashLB::Init(const bess::pb::HashLBArg &arg) {
 }
 
 std::string HashLB::GetDesc() const {
-  return bess::utils::Format("%zu fields", fields_table_.num_fields());
+  return bess::utils::Format("%zu fields%s%s", fields_table_.num_fields(),
+                             consistent_ ? ", consistent" : "",
+                             flow_hash_attr_.valid() ? ", flow_hash" : "");
+}
+
+inline gate_idx_t HashLB::SelectGate(const std::vector<gate_idx_t> &gates,
+                                     uint32_t hash) const {
+  if (consistent_) {
+    return gates[MaglevTable::Slot(hash, gates.size())];
+  }
+  return gates[hash_range(hash, gates.size())];
 }
 
 template <>
 inline void HashLB::DoProcessBatch<HashLB::Mode::kOther>(
-    Context *ctx, bess::PacketBatch *batch) {
+    Context *ctx, bess::PacketBatch *batch,
+    const std::vector<gate_idx_t> &gates) {
   void *bufs[bess::PacketBatch::kMaxBurst];
   ExactMatchKey keys[bess::PacketBatch::kMaxBurst];
 
@@ -151,14 +264,14 @@ inline void HashLB::DoProcessBatch<HashLB::Mode::kOther>(
   fields_table_.MakeKeys((const void **)bufs, keys, cnt);
 
   for (size_t i = 0; i < cnt; i++) {
-    EmitPacket(ctx, batch->pkts()[i],
-               gates_[hash_range(hasher_(keys[i]), num_gates_)]);
+    EmitPacket(ctx, batch->pkts()[i], SelectGate(gates, hasher_(keys[i])));
   }
 }
 
 template <>
 inline void HashLB::DoProcessBatch<HashLB::Mode::kL2>(
-    Context *ctx, bess::PacketBatch *batch) {
+    Context *ctx, bess::PacketBatch *batch,
+    const std::vector<gate_idx_t> &gates) {
   int cnt = batch->cnt();
   for (int i = 0; i < cnt; i++) {
     bess::Packet *snb = batch->pkts()[i];
@@ -169,17 +282,28 @@ inline void HashLB::DoProcessBatch<HashLB::Mode::kL2>(
 
     uint32_t hash_val = hash_64(v0, v1);
 
-    EmitPacket(ctx, snb, gates_[hash_range(hash_val, num_gates_)]);
+    EmitPacket(ctx, snb, SelectGate(gates, hash_val));
   }
 }
 
 template <>
 inline void HashLB::DoProcessBatch<HashLB::Mode::kL3>(
-    Context *ctx, bess::PacketBatch *batch) {
-  /* assumes untagged packets */
+    Context *ctx, bess::PacketBatch *batch,
+    const std::vector<gate_idx_t> &gates) {
+  /* assumes untagged packets, unless parsed upstream */
   const int ip_offset = 14;
 
   int cnt = batch->cnt();
+
+  if (info_attr_.valid()) {
+    for (int i = 0; i < cnt; i++) {
+      bess::Packet *snb = batch->pkts()[i];
+      uint32_t hash_val = hash_parsed(snb, info_attr_.get(snb), false);
+      EmitPacket(ctx, snb, SelectGate(gates, hash_val));
+    }
+    return;
+  }
+
   for (int i = 0; i < cnt; i++) {
     bess::Packet *snb = batch->pkts()[i];
     char *head = snb->head_data<char *>();
@@ -189,18 +313,37 @@ inline void HashLB::DoProcessBatch<HashLB::Mode::kL3>(
 
     hash_val = hash_64(v, 0);
 
-    EmitPacket(ctx, snb, gates_[hash_range(hash_val, num_gates_)]);
+    EmitPacket(ctx, snb, SelectGate(gates, hash_val));
   }
 }
 
 template <>
 inline void HashLB::DoProcessBatch<HashLB::Mode::kL4>(
-    Context *ctx, bess::PacketBatch *batch) {
-  /* assumes untagged packets without IP options */
+    Context *ctx, bess::PacketBatch *batch,
+    const std::vector<gate_idx_t> &gates) {
+  /* assumes untagged packets without IP options, unless parsed upstream */
   const int ip_offset = 14;
   const int l4_offset = ip_offset + 20;
 
   int cnt = batch->cnt();
+
+  if (flow_hash_attr_.valid()) {
+    for (int i = 0; i < cnt; i++) {
+      bess::Packet *snb = batch->pkts()[i];
+      EmitPacket(ctx, snb, SelectGate(gates, flow_hash_attr_.get(snb)));
+    }
+    return;
+  }
+
+  if (info_attr_.valid()) {
+    for (int i = 0; i < cnt; i++) {
+      bess::Packet *snb = batch->pkts()[i];
+      uint32_t hash_val = hash_parsed(snb, info_attr_.get(snb), true);
+      EmitPacket(ctx, snb, SelectGate(gates, hash_val));
+    }
+    return;
+  }
+
   for (int i = 0; i < cnt; i++) {
     bess::Packet *snb = batch->pkts()[i];
     char *head = snb->head_data<char *>();
@@ -213,23 +356,25 @@ inline void HashLB::DoProcessBatch<HashLB::Mode::kL4>(
 
     hash_val = hash_64(v0, v1);
 
-    EmitPacket(ctx, snb, gates_[hash_range(hash_val, num_gates_)]);
+    EmitPacket(ctx, snb, SelectGate(gates, hash_val));
   }
 }
 
 void HashLB::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
+  const std::vector<gate_idx_t> &gates = *gates_.load();
+
   switch (mode_) {
     case Mode::kL2:
-      DoProcessBatch<Mode::kL2>(ctx, batch);
+      DoProcessBatch<Mode::kL2>(ctx, batch, gates);
       break;
     case Mode::kL3:
-      DoProcessBatch<Mode::kL3>(ctx, batch);
+      DoProcessBatch<Mode::kL3>(ctx, batch, gates);
       break;
     case Mode::kL4:
-      DoProcessBatch<Mode::kL4>(ctx, batch);
+      DoProcessBatch<Mode::kL4>(ctx, batch, gates);
       break;
     case Mode::kOther:
-      DoProcessBatch<Mode::kOther>(ctx, batch);
+      DoProcessBatch<Mode::kOther>(ctx, batch, gates);
       break;
     default:
       DCHECK(0);
@@ -31,9 +31,14 @@
 #ifndef BESS_MODULES_HASHLB_H_
 #define BESS_MODULES_HASHLB_H_
 
+#include <atomic>
+#include <vector>
+
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
 #include "../utils/exact_match_table.h"
+#include "../utils/header_parser.h"
+#include "../utils/maglev.h"
 
 using bess::utils::ExactMatchField;
 using bess::utils::ExactMatchTable;
@@ -47,10 +52,19 @@ class HashLB final : public Module {
   static const Commands cmds;
 
   HashLB()
-      : Module(), gates_(), num_gates_(), mode_(), fields_table_(), hasher_(0) {
+      : Module(),
+        consistent_(),
+        gates_(new std::vector<gate_idx_t>()),
+        mode_(),
+        fields_table_(),
+        hasher_(0),
+        flow_hash_attr_(),
+        info_attr_() {
     max_allowed_workers_ = Worker::kMaxWorkers;
   }
 
+  ~HashLB() { delete gates_.load(); }
+
   CommandResponse Init(const bess::pb::HashLBArg &arg);
 
   std::string GetDesc() const override;
@@ -66,17 +80,36 @@ class HashLB final : public Module {
   static constexpr Mode kDefaultMode = Mode::kL4;
 
   template <Mode mode>
-  inline void DoProcessBatch(Context *ctx, bess::PacketBatch *batch);
+  inline void DoProcessBatch(Context *ctx, bess::PacketBatch *batch,
+                             const std::vector<gate_idx_t> &gates);
+
+  inline gate_idx_t SelectGate(const std::vector<gate_idx_t> &gates,
+                               uint32_t hash) const;
 
   static constexpr size_t kMaxGates = 16384;
 
-  gate_idx_t gates_[kMaxGates];
-  size_t num_gates_;
+  // If set, gates_ holds a Maglev lookup table rather than the gate list.
+  bool consistent_;
+
+  // Gates to pick from by hash. Never empty: {DROP_GATE} if no gates are set.
+  // set_gates builds a new one aside and swaps it in, so workers read
+  // whichever one the pointer refers to at the start of a batch.
+  std::atomic<const std::vector<gate_idx_t> *> gates_;
+
   Mode mode_;
 
   // No rules are ever added to this table, we just use it for MakeKeys().
   ExactMatchTable<int> fields_table_;
   ExactMatchKeyHash hasher_;
+
+  // Used in place of our own 5-tuple hash in L4 mode. Only registered with
+  // the "flow_hash" argument, so that which gate a flow goes to does not
+  // silently depend on the NIC's RSS hash function.
+  bess::metadata::ReadAttr<uint32_t> flow_hash_attr_;
+
+  // Header offsets from the Parse module. If set upstream, L3/L4 modes find
+  // the headers there rather than assuming untagged IPv4.
+  bess::metadata::ReadAttr<bess::utils::HeaderInfo> info_attr_;
 };
 
 #endif  // BESS_MODULES_HASHLB_H_
@@ -30,10 +30,20 @@
 
 #include "ip_checksum.h"
 
+#include <algorithm>
+
 #include "../utils/checksum.h"
 #include "../utils/ether.h"
 #include "../utils/ip.h"
 
+// Ethernet + QinQ + VLAN + IPv4 (with options) headers
+static const uint16_t kMaxHeaderLen = 14 + 4 + 4 + 60;
+
+CommandResponse IPChecksum::Init(const bess::pb::IPChecksumArg &arg) {
+  hw_ = arg.hw();
+  return CommandSuccess();
+}
+
 void IPChecksum::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   using bess::utils::Ethernet;
   using bess::utils::Ipv4;
@@ -43,7 +53,16 @@ void IPChecksum::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   int cnt = batch->cnt();
 
   for (int i = 0; i < cnt; i++) {
-    Ethernet *eth = batch->pkts()[i]->head_data<Ethernet *>();
+    bess::Packet *pkt = batch->pkts()[i];
+
+    // Headers must be contiguous even in multi-segment packets, and not
+    // shared with other packets
+    Ethernet *eth = pkt->make_writable<Ethernet *>(
+        std::min<uint32_t>(pkt->total_len(), kMaxHeaderLen));
+    if (unlikely(!eth)) {
+      continue;
+    }
+
     void *data = eth + 1;
     Ipv4 *ip;
 
@@ -70,7 +89,15 @@ void IPChecksum::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
       continue;
     }
 
-    ip->checksum = CalculateIpv4Checksum(*ip);
+    if (hw_) {
+      ip->checksum = 0;
+      pkt->request_tx_offload(
+          PKT_TX_IPV4 | PKT_TX_IP_CKSUM,
+          reinterpret_cast<uintptr_t>(ip) - reinterpret_cast<uintptr_t>(eth),
+          ip->header_length << 2);
+    } else {
+      ip->checksum = CalculateIpv4Checksum(*ip);
+    }
   }
 
   RunNextModule(ctx, batch);
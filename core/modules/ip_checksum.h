@@ -33,13 +33,22 @@
 #define BESS_MODULES_IP_CHECKSUM_H_
 
 #include "../module.h"
+#include "../pb/module_msg.pb.h"
 
 // Compute IP checksum on packet
 class IPChecksum final : public Module {
  public:
-  IPChecksum() : Module() { max_allowed_workers_ = Worker::kMaxWorkers; }
+  IPChecksum() : Module(), hw_(false) {
+    max_allowed_workers_ = Worker::kMaxWorkers;
+  }
+
+  CommandResponse Init(const bess::pb::IPChecksumArg &arg);
 
   void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
+
+ private:
+  // If true, leave the checksum to the NIC (see Packet::request_tx_offload())
+  bool hw_;
 };
 
 #endif  // BESS_MODULES_IP_CHECKSUM_H_
@@ -33,28 +33,20 @@
 #include "../utils/checksum.h"
 #include "../utils/ether.h"
 #include "../utils/ip.h"
+#include "parse.h"
 
 using bess::utils::Ethernet;
 using bess::utils::Ipv4;
 using bess::utils::be16_t;
 using bess::utils::be32_t;
 
-enum {
-  ATTR_R_IP_SRC,
-  ATTR_R_IP_DST,
-  ATTR_R_IP_PROTO,
-  ATTR_W_IP_NEXTHOP,
-  ATTR_W_ETHER_TYPE,
-};
-
 CommandResponse IPEncap::Init(const bess::pb::IPEncapArg &arg[[maybe_unused]]) {
-  using AccessMode = bess::metadata::Attribute::AccessMode;
-
-  AddMetadataAttr("ip_src", 4, AccessMode::kRead);
-  AddMetadataAttr("ip_dst", 4, AccessMode::kRead);
-  AddMetadataAttr("ip_proto", 1, AccessMode::kRead);
-  AddMetadataAttr("ip_nexthop", 4, AccessMode::kWrite);
-  AddMetadataAttr("ether_type", 2, AccessMode::kWrite);
+  ip_src_attr_.Register(this, "ip_src");
+  ip_dst_attr_.Register(this, "ip_dst");
+  ip_proto_attr_.Register(this, "ip_proto");
+  ip_nexthop_attr_.Register(this, "ip_nexthop");
+  ether_type_attr_.Register(this, "ether_type");
+  info_attr_.Register(this, bess::utils::kHeaderInfoAttrName, true);
 
   return CommandSuccess();
 }
@@ -62,17 +54,28 @@ CommandResponse IPEncap::Init(const bess::pb::IPEncapArg &arg[[maybe_unused]]) {
 void IPEncap::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   int cnt = batch->cnt();
 
+  InvalidateHeaderInfo(info_attr_, batch);
+
+  be32_t ip_src[bess::PacketBatch::kMaxBurst];
+  be32_t ip_dst[bess::PacketBatch::kMaxBurst];
+  uint8_t ip_proto[bess::PacketBatch::kMaxBurst];
+
+  ip_src_attr_.Gather(batch, ip_src);
+  ip_dst_attr_.Gather(batch, ip_dst);
+  ip_proto_attr_.Gather(batch, ip_proto);
+
   for (int i = 0; i < cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
 
-    be32_t ip_src = get_attr<be32_t>(this, ATTR_R_IP_SRC, pkt);
-    be32_t ip_dst = get_attr<be32_t>(this, ATTR_R_IP_DST, pkt);
-    uint8_t ip_proto = get_attr<uint8_t>(this, ATTR_R_IP_PROTO, pkt);
-
     Ipv4 *iph;
 
     uint16_t total_len = pkt->total_len() + sizeof(*iph);
 
+    // The headroom may be shared with other packets
+    if (unlikely(!pkt->make_writable(0))) {
+      continue;
+    }
+
     iph = static_cast<Ipv4 *>(pkt->prepend(sizeof(*iph)));
 
     if (unlikely(!iph)) {
@@ -85,17 +88,16 @@ void IPEncap::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
     iph->length = be16_t(total_len);
     iph->fragment_offset = be16_t(Ipv4::Flag::kDF);
     iph->ttl = 64;
-    iph->protocol = ip_proto;
-    iph->src = ip_src;
-    iph->dst = ip_dst;
+    iph->protocol = ip_proto[i];
+    iph->src = ip_src[i];
+    iph->dst = ip_dst[i];
 
     iph->checksum = bess::utils::CalculateIpv4NoOptChecksum(*iph);
-
-    set_attr<be32_t>(this, ATTR_W_IP_NEXTHOP, pkt, ip_dst);
-    set_attr<be16_t>(this, ATTR_W_ETHER_TYPE, pkt,
-                     be16_t(Ethernet::Type::kIpv4));
   }
 
+  ip_nexthop_attr_.Scatter(batch, ip_dst);
+  ether_type_attr_.Fill(batch, be16_t(Ethernet::Type::kIpv4));
+
   RunNextModule(ctx, batch);
 }
 
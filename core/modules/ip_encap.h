@@ -33,6 +33,8 @@
 
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
+#include "../utils/endian.h"
+#include "../utils/header_parser.h"
 
 class IPEncap final : public Module {
  public:
@@ -41,6 +43,16 @@ class IPEncap final : public Module {
   CommandResponse Init(const bess::pb::IPEncapArg &arg);
 
   void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
+
+ private:
+  bess::metadata::ReadAttr<bess::utils::be32_t> ip_src_attr_;
+  bess::metadata::ReadAttr<bess::utils::be32_t> ip_dst_attr_;
+  bess::metadata::ReadAttr<uint8_t> ip_proto_attr_;
+  bess::metadata::WriteAttr<bess::utils::be32_t> ip_nexthop_attr_;
+  bess::metadata::WriteAttr<bess::utils::be16_t> ether_type_attr_;
+
+  // Set by Parse upstream, if any. Marked stale, as headers are added.
+  bess::metadata::UpdateAttr<bess::utils::HeaderInfo> info_attr_;
 };
 
 #endif  // BESS_MODULES_IPENCAP_H_
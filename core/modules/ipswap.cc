@@ -40,6 +40,7 @@ void IPSwap::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   using bess::utils::Udp;
 
   int cnt = batch->cnt();
+  int n = 0;
 
   for (int i = 0; i < cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
@@ -47,6 +48,15 @@ void IPSwap::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
     Ethernet *eth = pkt->head_data<Ethernet *>();
     Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
     size_t ip_bytes = (ip->header_length & 0xf) << 2;
+
+    eth = pkt->make_writable<Ethernet *>(sizeof(*eth) + ip_bytes +
+                                         sizeof(Udp));
+    if (unlikely(!eth)) {
+      DropPacket(ctx, pkt);
+      continue;
+    }
+
+    ip = reinterpret_cast<Ipv4 *>(eth + 1);
     Udp *udp =
         reinterpret_cast<Udp *>(reinterpret_cast<uint8_t *>(ip) + ip_bytes);
 
@@ -69,8 +79,11 @@ void IPSwap::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
       default:
         VLOG(1) << "Unknown protocol: " << ip->protocol;
     }
+
+    batch->pkts()[n++] = pkt;
   }
 
+  batch->set_cnt(n);
   RunNextModule(ctx, batch);
 }
 
@@ -32,6 +32,8 @@
 
 #include <rte_hash_crc.h>
 
+#include <algorithm>
+
 #include "../mem_alloc.h"
 #include "../utils/endian.h"
 #include "../utils/simd.h"
@@ -70,8 +72,8 @@ static int l2_init(struct l2_table *l2tbl, int size, int bucket) {
     return -EINVAL;
   }
 
-  l2tbl->table = static_cast<l2_entry *>(mem_alloc_ex(
-      sizeof(struct l2_entry) * size * bucket, alignof(struct l2_entry), 0));
+  l2tbl->table = static_cast<l2_entry *>(mem_alloc_movable(
+      sizeof(struct l2_entry) * size * bucket, alignof(struct l2_entry), -1));
   if (l2tbl->table == nullptr) {
     return -ENOMEM;
   }
@@ -555,6 +557,8 @@ const Commands L2Forward::cmds = {
      MODULE_CMD_FUNC(&L2Forward::CommandLookup), Command::THREAD_SAFE},
     {"populate", "L2ForwardCommandPopulateArg",
      MODULE_CMD_FUNC(&L2Forward::CommandPopulate), Command::THREAD_UNSAFE},
+    {"flush_learned", "EmptyArg",
+     MODULE_CMD_FUNC(&L2Forward::CommandFlushLearned), Command::THREAD_UNSAFE},
 };
 
 CommandResponse L2Forward::Init(const bess::pb::L2ForwardArg &arg) {
@@ -580,14 +584,56 @@ CommandResponse L2Forward::Init(const bess::pb::L2ForwardArg &arg) {
                           size, bucket);
   }
 
+  // the table moves to the socket of our worker(s) once they are known
+  TrackMemory(l2_table_.table);
+
+  for (const auto gate : arg.flood_gates()) {
+    if (gate >= MAX_GATES) {
+      return CommandFailure(EINVAL, "Invalid flood gate: %" PRIu64, gate);
+    }
+    flood_gates_.push_back(gate);
+  }
+
+  learn_ = arg.learn();
+  if (learn_) {
+    age_ns_ = arg.age_sec() * 1000000000ull;
+    if (age_ns_ == 0) {
+      age_ns_ = kDefaultAgeNs;
+    }
+
+    uint64_t max_learned = arg.max_learned();
+    if (max_learned == 0) {
+      max_learned = kDefaultMaxLearned;
+    }
+
+    uint64_t buckets =
+        align_ceil_pow2((max_learned + kLearnWays - 1) / kLearnWays);
+    learned_ = static_cast<LearnedSlot *>(
+        AllocMemory(buckets * kLearnWays * sizeof(LearnedSlot), 64));
+    if (!learned_) {
+      return CommandFailure(ENOMEM, "Cannot allocate %" PRIu64
+                                    " learned entries",
+                            max_learned);
+    }
+    learned_mask_ = buckets - 1;
+    mcs_lock_init(&learn_lock_);
+  }
+
   return CommandSuccess();
 }
 
 void L2Forward::DeInit() {
+  FreeMemory(learned_);
+  UntrackMemory(l2_table_.table);
   l2_deinit(&l2_table_);
 }
 
 void L2Forward::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
+  if (learn_) {
+    ProcessBatchLearn(ctx, batch);
+    return;
+  }
+
   gate_idx_t default_gate = ACCESS_ONCE(default_gate_);
 
   int cnt = batch->cnt();
@@ -608,6 +654,153 @@ void L2Forward::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   }
 }
 
+void L2Forward::ProcessBatchLearn(Context *ctx, bess::PacketBatch *batch) {
+  gate_idx_t default_gate = ACCESS_ONCE(default_gate_);
+  gate_idx_t igate = ctx->current_igate;
+  uint64_t now = ctx->current_ns;
+
+  int cnt = batch->cnt();
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *snb = batch->pkts()[i];
+
+    // NOTE: assumes little endian
+    uint64_t dst = *(snb->head_data<uint64_t *>()) & 0x0000ffffffffffff;
+    uint64_t src = *(snb->head_data<uint64_t *>(6)) & 0x0000ffffffffffff;
+
+    Learn(src, igate, now);
+
+    // Broadcast and multicast (the I/G bit of the first octet) always flood
+    if (dst & 1) {
+      Flood(ctx, snb, igate, default_gate);
+      continue;
+    }
+
+    gate_idx_t out_gate;
+    if (l2_find(&l2_table_, dst, &out_gate) == 0) {
+      EmitPacket(ctx, snb, out_gate);
+      continue;
+    }
+
+    if (FindLearned(dst, now, &out_gate)) {
+      if (out_gate == igate) {
+        // The destination is behind the port the packet came from
+        DropPacket(ctx, snb);
+      } else {
+        EmitPacket(ctx, snb, out_gate);
+      }
+    } else {
+      Flood(ctx, snb, igate, default_gate);
+    }
+  }
+}
+
+void L2Forward::Learn(uint64_t addr, gate_idx_t gate, uint64_t now) {
+  // Group addresses are never valid source addresses, and 0 marks empty slots
+  if ((addr & 1) || addr == 0) {
+    return;
+  }
+
+  LearnedSlot *bucket = LearnBucket(addr);
+  const uint64_t key = addr << 16 | gate;
+
+  // Known address on the same port. Workers' clocks are not in lockstep, so
+  // "last_seen_ns" may be ahead of "now".
+  for (size_t i = 0; i < kLearnWays; i++) {
+    if (bucket[i].key.load(std::memory_order_relaxed) == key) {
+      uint64_t seen = bucket[i].last_seen_ns.load(std::memory_order_relaxed);
+      uint64_t refresh_ns = std::min(age_ns_ / 4, uint64_t{kRefreshNs});
+      if (now > seen && now - seen >= refresh_ns) {
+        bucket[i].last_seen_ns.store(now, std::memory_order_relaxed);
+      }
+      return;
+    }
+  }
+
+  // A new address, or one that moved to another port. Take its slot, or the
+  // least recently seen one (empty slots were never seen).
+  mcslock_node_t mynode;
+  mcs_lock(&learn_lock_, &mynode);
+
+  LearnedSlot *victim = &bucket[0];
+  for (size_t i = 0; i < kLearnWays; i++) {
+    if (bucket[i].key.load(std::memory_order_relaxed) >> 16 == addr) {
+      victim = &bucket[i];
+      break;
+    }
+    if (bucket[i].last_seen_ns.load(std::memory_order_relaxed) <
+        victim->last_seen_ns.load(std::memory_order_relaxed)) {
+      victim = &bucket[i];
+    }
+  }
+
+  victim->last_seen_ns.store(now, std::memory_order_relaxed);
+  victim->key.store(key, std::memory_order_release);
+
+  mcs_unlock(&learn_lock_, &mynode);
+}
+
+bool L2Forward::FindLearned(uint64_t addr, uint64_t now,
+                            gate_idx_t *gate) const {
+  const LearnedSlot *bucket = LearnBucket(addr);
+
+  for (size_t i = 0; i < kLearnWays; i++) {
+    uint64_t key = bucket[i].key.load(std::memory_order_acquire);
+    if (key != 0 && key >> 16 == addr) {
+      uint64_t seen = bucket[i].last_seen_ns.load(std::memory_order_relaxed);
+      if (now > seen && now - seen > age_ns_) {
+        return false;
+      }
+      *gate = key & 0xffff;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void L2Forward::Flood(Context *ctx, bess::Packet *pkt, gate_idx_t igate,
+                      gate_idx_t default_gate) {
+  if (flood_gates_.empty()) {
+    EmitPacket(ctx, pkt, default_gate);
+    return;
+  }
+
+  // The original goes out the last gate, zero-copy replicas (see Replicate)
+  // out all the others
+  bool has_prev = false;
+  gate_idx_t prev = 0;
+  for (gate_idx_t gate : flood_gates_) {
+    if (gate == igate) {
+      continue;
+    }
+
+    if (has_prev) {
+      bess::Packet *copy = bess::Packet::Share(pkt, kFloodPrivateLen);
+      if (copy) {
+        EmitPacket(ctx, copy, prev);
+      }
+    }
+    has_prev = true;
+    prev = gate;
+  }
+
+  if (!has_prev) {
+    DropPacket(ctx, pkt);
+    return;
+  }
+
+  // The buffer of the original is now shared, so it cannot be written to
+  if (pkt->refcnt() > 1) {
+    bess::Packet *copy = bess::Packet::Share(pkt, kFloodPrivateLen);
+    if (copy) {
+      bess::Packet::Free(pkt);
+      pkt = copy;
+    }
+  }
+
+  EmitPacket(ctx, pkt, prev);
+}
+
 CommandResponse L2Forward::CommandAdd(
     const bess::pb::L2ForwardCommandAddArg &arg) {
   for (int i = 0; i < arg.entries_size(); i++) {
@@ -741,5 +934,14 @@ CommandResponse L2Forward::CommandPopulate(
   return CommandSuccess();
 }
 
+CommandResponse L2Forward::CommandFlushLearned(const bess::pb::EmptyArg &) {
+  if (learned_) {
+    memset(static_cast<void *>(learned_), 0,
+           (learned_mask_ + 1) * kLearnWays * sizeof(LearnedSlot));
+  }
+
+  return CommandSuccess();
+}
+
 ADD_MODULE(L2Forward, "l2_forward",
            "classifies packets with destination MAC address")
@@ -31,8 +31,15 @@
 #ifndef BESS_MODULES_L2FORWARD_H_
 #define BESS_MODULES_L2FORWARD_H_
 
+#include <atomic>
+#include <vector>
+
+#include <rte_config.h>
+#include <rte_hash_crc.h>
+
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
+#include "../utils/mcslock.h"
 
 #if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
 #error this code assumes little endian architecture (x86)
@@ -59,11 +66,20 @@ struct l2_table {
 
 class L2Forward final : public Module {
  public:
+  static const gate_idx_t kNumIGates = MAX_GATES;
   static const gate_idx_t kNumOGates = MAX_GATES;
 
   static const Commands cmds;
 
-  L2Forward() : Module(), l2_table_(), default_gate_() {
+  L2Forward()
+      : Module(),
+        l2_table_(),
+        default_gate_(),
+        learn_(),
+        age_ns_(),
+        flood_gates_(),
+        learned_(),
+        learned_mask_() {
     max_allowed_workers_ = Worker::kMaxWorkers;
   }
 
@@ -80,10 +96,66 @@ class L2Forward final : public Module {
   CommandResponse CommandLookup(const bess::pb::L2ForwardCommandLookupArg &arg);
   CommandResponse CommandPopulate(
       const bess::pb::L2ForwardCommandPopulateArg &arg);
+  CommandResponse CommandFlushLearned(const bess::pb::EmptyArg &arg);
 
  private:
+  static const uint64_t kDefaultAgeNs = 300ull * 1000 * 1000 * 1000;
+  static const uint64_t kDefaultMaxLearned = 1024 * 1024;
+
+  // Learned entries are refreshed at most this often (or a quarter of the
+  // age), so that a busy station does not keep their cache line bouncing
+  // between workers
+  static const uint64_t kRefreshNs = 1000 * 1000 * 1000;
+
+  // Flooded packets are zero-copy replicas with this many private bytes
+  static const uint16_t kFloodPrivateLen = 64;
+
+  // A slot of the learned table, which all workers share. "key" packs the
+  // address (upper 48 bits) and the gate (lower 16 bits), so that lookups
+  // read both at once without a lock. It is 0 if the slot is empty.
+  struct LearnedSlot {
+    std::atomic<uint64_t> key;
+    std::atomic<uint64_t> last_seen_ns;
+  };
+
+  // Slots per bucket, a cache line. When a bucket is full, the least
+  // recently seen entry is replaced.
+  static const size_t kLearnWays = 4;
+
+  static_assert(sizeof(LearnedSlot) * kLearnWays == 64,
+                "A bucket must fill a cache line");
+
+  LearnedSlot *LearnBucket(uint64_t addr) const {
+    return &learned_[(rte_hash_crc_8byte(addr, 0) & learned_mask_) *
+                     kLearnWays];
+  }
+
+  void ProcessBatchLearn(Context *ctx, bess::PacketBatch *batch);
+
+  // Maps "addr" to "gate". Only takes the lock for new or moved addresses.
+  void Learn(uint64_t addr, gate_idx_t gate, uint64_t now);
+
+  // Looks up a learned address that has not expired
+  bool FindLearned(uint64_t addr, uint64_t now, gate_idx_t *gate) const;
+
+  // Sends the packet to all flood gates but igate, or to default_gate if there
+  // are no flood gates.
+  void Flood(Context *ctx, bess::Packet *pkt, gate_idx_t igate,
+             gate_idx_t default_gate);
+
+  // Static entries, added by commands
   struct l2_table l2_table_;
   gate_idx_t default_gate_;
+
+  bool learn_;
+  uint64_t age_ns_;
+  std::vector<gate_idx_t> flood_gates_;
+
+  // Buckets of kLearnWays slots, or nullptr if learning is disabled. Writers
+  // serialize on learn_lock_.
+  LearnedSlot *learned_;
+  uint64_t learned_mask_;  // number of buckets - 1
+  mcslock learn_lock_;
 };
 
 #endif  // BESS_MODULES_L2FORWARD_H_
@@ -30,12 +30,39 @@
 
 #include "l4_checksum.h"
 
+#include <rte_ip.h>
+
+#include <algorithm>
+
 #include "../utils/checksum.h"
 #include "../utils/ether.h"
 #include "../utils/ip.h"
 #include "../utils/tcp.h"
 #include "../utils/udp.h"
 
+// Ethernet + IPv4 (with options) + TCP (with options) headers
+static const uint16_t kMaxHeaderLen = 14 + 60 + 60;
+
+// Returns the checksum of a TCP/UDP segment that spans multiple packet
+// segments. The checksum field must be zeroed beforehand.
+static uint16_t CalculateScatteredChecksum(const bess::Packet *pkt,
+                                           const bess::utils::Ipv4 &ip,
+                                           uint32_t l4_offset,
+                                           uint16_t l4_len) {
+  using bess::utils::AddSum;
+  using bess::utils::CalculateIpv4PseudoHeaderSum;
+
+  uint32_t sum =
+      CalculateIpv4PseudoHeaderSum(ip.src, ip.dst, ip.protocol, l4_len);
+  return bess::utils::FoldChecksum(
+      AddSum(sum, pkt->CalculateSum(l4_offset, l4_len)));
+}
+
+CommandResponse L4Checksum::Init(const bess::pb::L4ChecksumArg &arg) {
+  hw_ = arg.hw();
+  return CommandSuccess();
+}
+
 void L4Checksum::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   using bess::utils::Ethernet;
   using bess::utils::Ipv4;
@@ -46,7 +73,15 @@ void L4Checksum::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   int cnt = batch->cnt();
 
   for (int i = 0; i < cnt; i++) {
-    Ethernet *eth = batch->pkts()[i]->head_data<Ethernet *>();
+    bess::Packet *pkt = batch->pkts()[i];
+
+    // Headers must be contiguous even in multi-segment packets, and not
+    // shared with other packets
+    Ethernet *eth = pkt->make_writable<Ethernet *>(
+        std::min<uint32_t>(pkt->total_len(), kMaxHeaderLen));
+    if (unlikely(!eth)) {
+      continue;
+    }
 
     // Calculate checksum only for IPv4 packets
     if (eth->ether_type != be16_t(Ethernet::Type::kIpv4))
@@ -54,6 +89,50 @@ void L4Checksum::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
 
     Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
 
+    if (hw_) {
+      // The NIC expects the (non-complemented) pseudo-header checksum
+      const struct ipv4_hdr *iph = reinterpret_cast<struct ipv4_hdr *>(ip);
+      size_t ip_bytes = (ip->header_length) << 2;
+      void *l4 = reinterpret_cast<uint8_t *>(ip) + ip_bytes;
+      uint64_t flags = PKT_TX_IPV4;
+
+      if (ip->protocol == Ipv4::Proto::kUdp) {
+        flags |= PKT_TX_UDP_CKSUM;
+        reinterpret_cast<Udp *>(l4)->checksum = rte_ipv4_phdr_cksum(iph, flags);
+      } else if (ip->protocol == Ipv4::Proto::kTcp) {
+        flags |= PKT_TX_TCP_CKSUM;
+        reinterpret_cast<Tcp *>(l4)->checksum = rte_ipv4_phdr_cksum(iph, flags);
+      } else {
+        continue;
+      }
+
+      pkt->request_tx_offload(flags, sizeof(*eth), ip_bytes);
+      continue;
+    }
+
+    if (unlikely(!pkt->is_linear())) {
+      size_t ip_bytes = (ip->header_length) << 2;
+      uint32_t l4_offset = sizeof(*eth) + ip_bytes;
+      uint16_t l4_len = ip->length.value() - ip_bytes;
+      void *l4 = reinterpret_cast<uint8_t *>(ip) + ip_bytes;
+
+      if (l4_offset + l4_len > static_cast<uint32_t>(pkt->total_len())) {
+        continue;
+      }
+
+      if (ip->protocol == Ipv4::Proto::kUdp) {
+        Udp *udp = reinterpret_cast<Udp *>(l4);
+        udp->checksum = 0;
+        udp->checksum =
+            CalculateScatteredChecksum(pkt, *ip, l4_offset, l4_len) ?: 0xFFFF;
+      } else if (ip->protocol == Ipv4::Proto::kTcp) {
+        Tcp *tcp = reinterpret_cast<Tcp *>(l4);
+        tcp->checksum = 0;
+        tcp->checksum = CalculateScatteredChecksum(pkt, *ip, l4_offset, l4_len);
+      }
+      continue;
+    }
+
     if (ip->protocol == Ipv4::Proto::kUdp) {
       size_t ip_bytes = (ip->header_length) << 2;
       Udp *udp =
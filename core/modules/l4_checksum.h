@@ -32,12 +32,21 @@
 #define BESS_MODULES_L4_CHECKSUM_H_
 
 #include "../module.h"
+#include "../pb/module_msg.pb.h"
 
 // Compute L4 checksum on packet
 class L4Checksum final : public Module {
  public:
-  L4Checksum() : Module() { max_allowed_workers_ = Worker::kMaxWorkers; }
+  L4Checksum() : Module(), hw_(false) {
+    max_allowed_workers_ = Worker::kMaxWorkers;
+  }
+
+  CommandResponse Init(const bess::pb::L4ChecksumArg &arg);
   void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
+
+ private:
+  // If true, leave the checksum to the NIC (see Packet::request_tx_offload())
+  bool hw_;
 };
 
 #endif  // BESS_MODULES_L4_CHECKSUM_H_
@@ -36,16 +36,26 @@ void MACSwap::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   using bess::utils::Ethernet;
 
   int cnt = batch->cnt();
+  int n = 0;
 
   for (int i = 0; i < cnt; i++) {
-    Ethernet *eth = batch->pkts()[i]->head_data<Ethernet *>();
+    bess::Packet *pkt = batch->pkts()[i];
+    Ethernet *eth = pkt->make_writable<Ethernet *>(sizeof(*eth));
     Ethernet::Address tmp;
 
+    if (unlikely(!eth)) {
+      DropPacket(ctx, pkt);
+      continue;
+    }
+
     tmp = eth->dst_addr;
     eth->dst_addr = eth->src_addr;
     eth->src_addr = tmp;
+
+    batch->pkts()[n++] = pkt;
   }
 
+  batch->set_cnt(n);
   RunNextModule(ctx, batch);
 }
 
@@ -43,6 +43,7 @@
 #include "../utils/udp.h"
 
 using bess::utils::Ethernet;
+using bess::utils::HeaderInfo;
 using bess::utils::Ipv4;
 using IpProto = bess::utils::Ipv4::Proto;
 using bess::utils::Udp;
@@ -63,6 +64,8 @@ const Commands NAT::cmds = {
 
 // TODO(torek): move this to set/get runtime config
 CommandResponse NAT::Init(const bess::pb::NATArg &arg) {
+  info_attr_.Register(this, bess::utils::kHeaderInfoAttrName, true);
+
   // Check before committing any changes.
   for (const auto &address_range : arg.ext_addrs()) {
     for (const auto &range : address_range.port_ranges()) {
@@ -327,14 +330,32 @@ inline void NAT::DoProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   static gate_idx_t ogate_idx = static_cast<gate_idx_t>(dir);
   int cnt = batch->cnt();
   uint64_t now = ctx->current_ns;
+  const bool parsed = info_attr_.valid();
 
   for (int i = 0; i < cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
 
     Ethernet *eth = pkt->head_data<Ethernet *>();
-    Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
-    size_t ip_bytes = (ip->header_length) << 2;
-    void *l4 = reinterpret_cast<uint8_t *>(ip) + ip_bytes;
+    size_t ip_offset = sizeof(*eth);
+    size_t l4_offset;
+
+    if (parsed) {
+      HeaderInfo info = info_attr_.get(pkt);
+      bess::utils::ReparseIfStale(eth, pkt->head_len(), &info);
+      // Neither IPv4 nor the first fragment
+      if (info.l3_type != Ethernet::Type::kIpv4 || !info.l4_offset) {
+        DropPacket(ctx, pkt);
+        continue;
+      }
+      ip_offset = info.l3_offset;
+      l4_offset = info.l4_offset;
+    } else {
+      const Ipv4 *ip = reinterpret_cast<const Ipv4 *>(eth + 1);
+      l4_offset = ip_offset + (ip->header_length << 2);
+    }
+
+    Ipv4 *ip = reinterpret_cast<Ipv4 *>(pkt->head_data<uint8_t *>(ip_offset));
+    void *l4 = pkt->head_data<uint8_t *>(l4_offset);
 
     bool valid_protocol;
     Endpoint before;
@@ -359,6 +380,15 @@ inline void NAT::DoProcessBatch(Context *ctx, bess::PacketBatch *batch) {
       hash_item->second.last_refresh = now;
     }
 
+    // Stamp() rewrites the ports and the L4 checksum as well
+    uint8_t *head = pkt->make_writable<uint8_t *>(l4_offset + sizeof(Tcp));
+    if (unlikely(!head)) {
+      DropPacket(ctx, pkt);
+      continue;
+    }
+    ip = reinterpret_cast<Ipv4 *>(head + ip_offset);
+    l4 = head + l4_offset;
+
     Stamp<dir>(ip, l4, before, hash_item->second.endpoint);
     EmitPacket(ctx, pkt, ogate_idx);
   }
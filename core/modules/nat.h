@@ -44,6 +44,7 @@
 
 #include "../utils/cuckoo_map.h"
 #include "../utils/endian.h"
+#include "../utils/header_parser.h"
 #include "../utils/random.h"
 
 // Theory of operation:
@@ -176,6 +177,10 @@ class NAT final : public Module {
 
   HashTable map_;
   Random rng_;
+
+  // Header offsets from the Parse module, if set upstream. Otherwise packets
+  // are assumed to be untagged IPv4.
+  bess::metadata::ReadAttr<bess::utils::HeaderInfo> info_attr_;
 };
 
 #endif  // BESS_MODULES_NAT_H_
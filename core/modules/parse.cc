@@ -0,0 +1,69 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "parse.h"
+
+using bess::utils::HeaderInfo;
+
+CommandResponse Parse::Init(const bess::pb::ParseArg &arg) {
+  vxlan_inner_ = arg.vxlan_inner();
+
+  int ret = info_attr_.Register(this, bess::utils::kHeaderInfoAttrName);
+  if (ret < 0) {
+    return CommandFailure(-ret, "Failed to register metadata attribute");
+  }
+
+  return CommandSuccess();
+}
+
+void Parse::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
+  // Nobody downstream cares
+  if (!info_attr_.valid()) {
+    RunNextModule(ctx, batch);
+    return;
+  }
+
+  int cnt = batch->cnt();
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+    HeaderInfo *info = info_attr_.ptr(pkt);
+    bess::utils::ParseHeaders(pkt->head_data(), pkt->head_len(), info,
+                              vxlan_inner_);
+  }
+
+  RunNextModule(ctx, batch);
+}
+
+std::string Parse::GetDesc() const {
+  return vxlan_inner_ ? "vxlan inner" : "";
+}
+
+ADD_MODULE(Parse, "parse",
+           "parses L2-L4 headers once and stores their offsets as metadata")
@@ -0,0 +1,73 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_MODULES_PARSE_H_
+#define BESS_MODULES_PARSE_H_
+
+#include "../module.h"
+#include "../pb/module_msg.pb.h"
+#include "../utils/header_parser.h"
+
+class Parse final : public Module {
+ public:
+  Parse() : Module(), vxlan_inner_(), info_attr_() {
+    max_allowed_workers_ = Worker::kMaxWorkers;
+  }
+
+  CommandResponse Init(const bess::pb::ParseArg &arg);
+
+  void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
+
+  std::string GetDesc() const override;
+
+ private:
+  bool vxlan_inner_;
+
+  bess::metadata::WriteAttr<bess::utils::HeaderInfo> info_attr_;
+};
+
+// Flags the "header_info" attribute of all packets in the batch as stale. For
+// modules that add or remove headers, which register the attribute as an
+// optional UpdateAttr: the offsets found by Parse upstream no longer match the
+// frame, so consumers must not follow them. No-op without Parse upstream.
+static inline void InvalidateHeaderInfo(
+    const bess::metadata::UpdateAttr<bess::utils::HeaderInfo> &attr,
+    bess::PacketBatch *batch) {
+  if (!attr.valid()) {
+    return;
+  }
+
+  int cnt = batch->cnt();
+  for (int i = 0; i < cnt; i++) {
+    attr.ptr(batch->pkts()[i])->flags |= bess::utils::HeaderInfo::kStale;
+  }
+}
+
+#endif  // BESS_MODULES_PARSE_H_
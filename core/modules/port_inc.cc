@@ -29,6 +29,7 @@
 // POSSIBILITY OF SUCH DAMAGE.
 
 #include "port_inc.h"
+#include "../utils/flow_hash.h"
 #include "../utils/format.h"
 
 const Commands PortInc::cmds = {
@@ -78,6 +79,16 @@ CommandResponse PortInc::Init(const bess::pb::PortIncArg &arg) {
     prefetch_ = 1;
   }
 
+  if (!arg.pool().empty()) {
+    pool_ = bess::PacketPool::Find(arg.pool());
+    if (!pool_) {
+      return CommandFailure(ENOENT, "Packet pool '%s' does not exist",
+                            arg.pool().c_str());
+    }
+  }
+
+  flow_hash_attr_.Register(this, bess::utils::kFlowHashAttrName);
+
   ret = port_->AcquireQueues(reinterpret_cast<const module *>(this),
                              PACKET_DIR_INC, nullptr, 0);
   if (ret < 0) {
@@ -118,9 +129,14 @@ struct task_result PortInc::RunTask(Context *ctx, bess::PacketBatch *batch,
   const int burst = ACCESS_ONCE(burst_);
   const int pkt_overhead = 24;
 
-  batch->set_cnt(p->RecvPackets(qid, batch->pkts(), burst));
+  {
+    // Only affects drivers that allocate buffers themselves
+    bess::ScopedPacketPool scope(pool_);
+    batch->set_cnt(p->RecvPackets(qid, batch->pkts(), burst));
+  }
   uint32_t cnt = batch->cnt();
   if (cnt == 0) {
+    p->UpdateQueueStats(PACKET_DIR_INC, qid, 0, 0, 0, 0);
     return {.block = true, .packets = 0, .bits = 0};
   }
 
@@ -137,8 +153,20 @@ struct task_result PortInc::RunTask(Context *ctx, bess::PacketBatch *batch,
   }
 
   if (!(p->GetFlags() & DRIVER_FLAG_SELF_INC_STATS)) {
-    p->queue_stats[PACKET_DIR_INC][qid].packets += cnt;
-    p->queue_stats[PACKET_DIR_INC][qid].bytes += received_bytes;
+    p->UpdateQueueStats(PACKET_DIR_INC, qid, cnt, 0, received_bytes, cnt);
+  } else {
+    p->UpdateQueueStats(PACKET_DIR_INC, qid, 0, 0, 0, cnt);
+  }
+
+  if (flow_hash_attr_.valid()) {
+    // Reuse the RSS hash of the NIC, so that downstream modules need not hash
+    for (uint32_t i = 0; i < cnt; i++) {
+      bess::Packet *pkt = batch->pkts()[i];
+      flow_hash_attr_.set(pkt, pkt->has_rss_hash()
+                                   ? pkt->rss_hash()
+                                   : bess::utils::FlowHash(pkt->head_data(),
+                                                           pkt->head_len()));
+    }
   }
 
   RunNextModule(ctx, batch);
@@ -32,6 +32,7 @@
 #define BESS_MODULES_PORTINC_H_
 
 #include "../module.h"
+#include "../packet_pool.h"
 #include "../pb/module_msg.pb.h"
 #include "../port.h"
 
@@ -41,7 +42,8 @@ class PortInc final : public Module {
 
   static const Commands cmds;
 
-  PortInc() : Module(), port_(), prefetch_(), burst_() {
+  PortInc()
+      : Module(), port_(), prefetch_(), burst_(), pool_(), flow_hash_attr_() {
     is_task_ = true;
     max_allowed_workers_ = Worker::kMaxWorkers;
   }
@@ -62,6 +64,12 @@ class PortInc final : public Module {
   Port *port_;
   int prefetch_;
   int burst_;
+
+  // Pool for drivers that allocate on receive. nullptr for the default pool
+  const bess::PacketPool *pool_;
+
+  // Only set if some module downstream reads it
+  bess::metadata::WriteAttr<uint32_t> flow_hash_attr_;
 };
 
 #endif  // BESS_MODULES_PORTINC_H_
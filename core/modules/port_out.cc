@@ -29,6 +29,8 @@
 // POSSIBILITY OF SUCH DAMAGE.
 
 #include "port_out.h"
+#include "../task.h"
+#include "../traffic_class.h"
 #include "../utils/format.h"
 
 CommandResponse PortOut::Init(const bess::pb::PortOutArg &arg) {
@@ -58,6 +60,41 @@ CommandResponse PortOut::Init(const bess::pb::PortOutArg &arg) {
 
   max_allowed_workers_ = port_->num_queues[PACKET_DIR_OUT];
 
+  if (arg.tx_buffer()) {
+    if (arg.tx_buffer() > bess::TxBuffer::kMaxCapacity) {
+      return CommandFailure(EINVAL, "'tx_buffer' must be at most %zu",
+                            bess::TxBuffer::kMaxCapacity);
+    }
+
+    uint64_t timeout_ns = arg.tx_buffer_timeout_ns()
+                              ? arg.tx_buffer_timeout_ns()
+                              : kDefaultTxBufferTimeoutNs;
+
+    tx_buffer_ = arg.tx_buffer();
+    for (queue_t qid = 0; qid < port_->num_queues[PACKET_DIR_OUT]; qid++) {
+      tx_buffers_[qid].Init(tx_buffer_, timeout_ns);
+      mcs_lock_init(&tx_locks_[qid]);
+    }
+
+    // The task drains the buffers of all queues, whichever worker owns them,
+    // since it runs on a single worker only. It also makes this module a task,
+    // which is needed for SignalOverload() to reach the upstream tasks.
+    if (RegisterTask(nullptr) == INVALID_TASK_ID) {
+      return CommandFailure(ENOMEM, "Task creation failed");
+    }
+    is_task_ = true;
+  }
+
+  if (arg.backpressure()) {
+    if (!tx_buffer_) {
+      return CommandFailure(EINVAL, "'backpressure' requires 'tx_buffer'");
+    }
+
+    // SignalOverload()/SignalUnderload() are not thread safe
+    backpressure_ = true;
+    max_allowed_workers_ = 1;
+  }
+
   for (queue_t i = 0; i < max_allowed_workers_; i++) {
     available_queues_.push_back(i);
   }
@@ -74,6 +111,10 @@ CommandResponse PortOut::Init(const bess::pb::PortOutArg &arg) {
 }
 
 void PortOut::DeInit() {
+  for (bess::TxBuffer &buf : tx_buffers_) {
+    buf.Clear();
+  }
+
   if (port_) {
     port_->ReleaseQueues(reinterpret_cast<const module *>(this), PACKET_DIR_OUT,
                          nullptr, 0);
@@ -85,6 +126,35 @@ std::string PortOut::GetDesc() const {
                              port_->port_builder()->class_name().c_str());
 }
 
+int PortOut::SendBuffered(Context *ctx, queue_t qid, bess::Packet **pkts,
+                          int cnt, uint64_t *sent_bytes) {
+  Port *p = port_;
+  bess::TxBuffer *buf = &tx_buffers_[qid];
+
+  int dropped;
+  int sent_pkts =
+      buf->Send(p, qid, pkts, cnt, ctx->current_ns, sent_bytes, &dropped);
+
+  // Retries from RunTask() are not counted as TX calls
+  int burst = cnt ? cnt : -1;
+  if (!(p->GetFlags() & DRIVER_FLAG_SELF_OUT_STATS)) {
+    p->UpdateQueueStats(PACKET_DIR_OUT, qid, sent_pkts, dropped, *sent_bytes,
+                        burst);
+  } else {
+    p->UpdateQueueStats(PACKET_DIR_OUT, qid, 0, dropped, 0, burst);
+  }
+
+  if (backpressure_) {
+    if (buf->cnt() > buf->capacity() * kHighWaterRatio) {
+      SignalOverload();
+    } else if (buf->cnt() < buf->capacity() * kLowWaterRatio) {
+      SignalUnderload();
+    }
+  }
+
+  return sent_pkts;
+}
+
 void PortOut::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   Port *p = port_;
 
@@ -94,6 +164,19 @@ void PortOut::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   int sent_pkts = 0;
 
   if (likely(qid < port_->num_queues[PACKET_DIR_OUT]) && p->conf().admin_up) {
+    if (tx_buffer_) {
+      if (!tx_lock_needed_[qid]) {
+        SendBuffered(ctx, qid, batch->pkts(), batch->cnt(), &sent_bytes);
+        return;
+      }
+
+      mcslock_node_t mynode;
+      mcs_lock(&tx_locks_[qid], &mynode);
+      SendBuffered(ctx, qid, batch->pkts(), batch->cnt(), &sent_bytes);
+      mcs_unlock(&tx_locks_[qid], &mynode);
+      return;
+    }
+
     sent_pkts = p->SendPackets(qid, batch->pkts(), batch->cnt());
   }
 
@@ -104,9 +187,11 @@ void PortOut::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
       sent_bytes += batch->pkts()[i]->total_len();
     }
 
-    p->queue_stats[dir][qid].packets += sent_pkts;
-    p->queue_stats[dir][qid].dropped += (batch->cnt() - sent_pkts);
-    p->queue_stats[dir][qid].bytes += sent_bytes;
+    p->UpdateQueueStats(dir, qid, sent_pkts, batch->cnt() - sent_pkts,
+                        sent_bytes, batch->cnt());
+  } else {
+    p->UpdateQueueStats(PACKET_DIR_OUT, qid, 0, batch->cnt() - sent_pkts, 0,
+                        batch->cnt());
   }
 
   if (sent_pkts < batch->cnt()) {
@@ -114,6 +199,40 @@ void PortOut::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   }
 }
 
+struct task_result PortOut::RunTask(Context *ctx, bess::PacketBatch *,
+                                   void *) {
+  const int pkt_overhead = 24;
+
+  if (!port_->conf().admin_up) {
+    return {.block = true, .packets = 0, .bits = 0};
+  }
+
+  uint64_t sent_bytes = 0;
+  uint32_t sent_pkts = 0;
+
+  for (queue_t qid = 0; qid < port_->num_queues[PACKET_DIR_OUT]; qid++) {
+    // Peek without the lock first, not to bounce it between workers for
+    // nothing. A queue whose owner is sending right now is skipped as well,
+    // since the owner retries its buffer anyway.
+    mcslock_node_t mynode;
+    if (tx_buffers_[qid].cnt() == 0 ||
+        !mcs_trylock(&tx_locks_[qid], &mynode)) {
+      continue;
+    }
+
+    if (tx_buffers_[qid].cnt() > 0) {
+      uint64_t bytes;
+      sent_pkts += SendBuffered(ctx, qid, nullptr, 0, &bytes);
+      sent_bytes += bytes;
+    }
+    mcs_unlock(&tx_locks_[qid], &mynode);
+  }
+
+  return {.block = (sent_pkts == 0),
+          .packets = sent_pkts,
+          .bits = (sent_bytes + sent_pkts * pkt_overhead) * 8};
+}
+
 int PortOut::OnEvent(bess::Event e) {
   if (e != bess::Event::PreResume) {
     return -ENOTSUP;
@@ -141,6 +260,22 @@ int PortOut::OnEvent(bess::Event e) {
     }
   }
 
+  // A queue needs the lock only if RunTask() drains it from another worker.
+  // Workers are paused here, so the flags can be updated without one.
+  if (tx_buffer_) {
+    const bess::LeafTrafficClass *tc = tasks()[0]->GetTC();
+    int task_wid = tc ? tc->WorkerId() : -1;
+
+    for (queue_t qid = 0; qid < MAX_QUEUES_PER_DIR; qid++) {
+      tx_lock_needed_[qid] = false;
+    }
+    for (int i = 0; i < Worker::kMaxWorkers; i++) {
+      if (worker_queues_[i] >= 0 && task_wid >= 0 && i != task_wid) {
+        tx_lock_needed_[worker_queues_[i]] = true;
+      }
+    }
+  }
+
   return 0;
 }
 
@@ -34,6 +34,8 @@
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
 #include "../port.h"
+#include "../tx_buffer.h"
+#include "../utils/mcslock.h"
 #include "../worker.h"
 
 class PortOut final : public Module {
@@ -41,7 +43,14 @@ class PortOut final : public Module {
   static const gate_idx_t kNumIGates = MAX_GATES;
   static const gate_idx_t kNumOGates = 0;
 
-  PortOut() : Module(), port_(), available_queues_(), worker_queues_() {}
+  PortOut()
+      : Module(),
+        port_(),
+        available_queues_(),
+        worker_queues_(),
+        tx_lock_needed_(),
+        tx_buffer_(),
+        backpressure_() {}
 
   CommandResponse Init(const bess::pb::PortOutArg &arg);
 
@@ -49,16 +58,42 @@ class PortOut final : public Module {
 
   void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
 
+  // Retries buffered packets even if no new packets arrive
+  struct task_result RunTask(Context *ctx, bess::PacketBatch *batch,
+                             void *arg) override;
+
   int OnEvent(bess::Event e) override;
 
   std::string GetDesc() const override;
 
  private:
+  static const uint64_t kDefaultTxBufferTimeoutNs = 1000000;  // 1ms
+
+  // TX buffer occupancy ratios to signal overload/underload at
+  const double kHighWaterRatio = 0.75;
+  const double kLowWaterRatio = 0.25;
+
+  // Sends "pkts" through the TX buffer of the queue. Returns the number of
+  // packets sent (including previously buffered ones).
+  int SendBuffered(Context *ctx, queue_t qid, bess::Packet **pkts, int cnt,
+                   uint64_t *sent_bytes);
+
   Port *port_;
 
   std::vector<queue_t> available_queues_;
 
   int worker_queues_[Worker::kMaxWorkers];
+
+  // Per-queue buffers of packets not accepted by the port yet. RunTask() may
+  // drain a queue owned by another worker, so each one is guarded by a lock.
+  bess::TxBuffer tx_buffers_[MAX_QUEUES_PER_DIR];
+  mcslock tx_locks_[MAX_QUEUES_PER_DIR];
+  // Whether the queue is shared with RunTask() on another worker. Updated
+  // on PreResume, so ProcessBatch() can skip the lock when it is not.
+  bool tx_lock_needed_[MAX_QUEUES_PER_DIR];
+  size_t tx_buffer_;  // capacity of each buffer. 0 if disabled
+
+  bool backpressure_;
 };
 
 #endif  // BESS_MODULES_PORTOUT_H_
@@ -30,7 +30,6 @@
 
 #include "queue.h"
 
-#include "../mem_alloc.h"
 #include "../utils/format.h"
 
 #define DEFAULT_QUEUE_SIZE 1024
@@ -51,14 +50,14 @@ int Queue::Resize(int slots) {
 
   int ret;
 
-  new_queue = static_cast<llring *>(mem_alloc_ex(bytes, alignof(llring), 0));
+  new_queue = static_cast<llring *>(AllocMemory(bytes, alignof(llring)));
   if (!new_queue) {
     return -ENOMEM;
   }
 
   ret = llring_init(new_queue, slots, 0, 1);
   if (ret) {
-    mem_free(new_queue);
+    FreeMemory(new_queue);
     return -EINVAL;
   }
 
@@ -73,7 +72,7 @@ int Queue::Resize(int slots) {
       }
     }
 
-    mem_free(old_queue);
+    FreeMemory(old_queue);
   }
 
   queue_ = new_queue;
@@ -128,7 +127,7 @@ void Queue::DeInit() {
     while (llring_sc_dequeue(queue_, (void **)&pkt) == 0) {
       bess::Packet::Free(pkt);
     }
-    mem_free(queue_);
+    FreeMemory(queue_);
   }
 }
 
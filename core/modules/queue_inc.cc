@@ -103,6 +103,7 @@ struct task_result QueueInc::RunTask(Context *ctx, bess::PacketBatch *batch,
   uint32_t cnt = batch->cnt();
 
   if (cnt == 0) {
+    p->UpdateQueueStats(PACKET_DIR_INC, qid, 0, 0, 0, 0);
     return {.block = true, .packets = 0, .bits = 0};
   }
 
@@ -119,8 +120,9 @@ struct task_result QueueInc::RunTask(Context *ctx, bess::PacketBatch *batch,
   }
 
   if (!(p->GetFlags() & DRIVER_FLAG_SELF_INC_STATS)) {
-    p->queue_stats[PACKET_DIR_INC][qid].packets += cnt;
-    p->queue_stats[PACKET_DIR_INC][qid].bytes += received_bytes;
+    p->UpdateQueueStats(PACKET_DIR_INC, qid, cnt, 0, received_bytes, cnt);
+  } else {
+    p->UpdateQueueStats(PACKET_DIR_INC, qid, 0, 0, 0, cnt);
   }
 
   RunNextModule(ctx, batch);
@@ -52,6 +52,31 @@ CommandResponse QueueOut::Init(const bess::pb::QueueOutArg &arg) {
 
   node_constraints_ = port_->GetNodePlacementConstraint();
 
+  if (arg.tx_buffer()) {
+    if (arg.tx_buffer() > bess::TxBuffer::kMaxCapacity) {
+      return CommandFailure(EINVAL, "'tx_buffer' must be at most %zu",
+                            bess::TxBuffer::kMaxCapacity);
+    }
+
+    mcs_lock_init(&tx_lock_);
+    tx_buffer_.Init(arg.tx_buffer(), arg.tx_buffer_timeout_ns()
+                                         ? arg.tx_buffer_timeout_ns()
+                                         : kDefaultTxBufferTimeoutNs);
+
+    // See PortOut::Init()
+    if (RegisterTask(nullptr) == INVALID_TASK_ID) {
+      return CommandFailure(ENOMEM, "Task creation failed");
+    }
+    is_task_ = true;
+  }
+
+  if (arg.backpressure()) {
+    if (!arg.tx_buffer()) {
+      return CommandFailure(EINVAL, "'backpressure' requires 'tx_buffer'");
+    }
+    backpressure_ = true;
+  }
+
   ret = port_->AcquireQueues(reinterpret_cast<const module *>(this),
                              PACKET_DIR_OUT, &qid_, 1);
   if (ret < 0) {
@@ -62,6 +87,8 @@ CommandResponse QueueOut::Init(const bess::pb::QueueOutArg &arg) {
 }
 
 void QueueOut::DeInit() {
+  tx_buffer_.Clear();
+
   if (port_) {
     port_->ReleaseQueues(reinterpret_cast<const module *>(this), PACKET_DIR_OUT,
                          &qid_, 1);
@@ -73,7 +100,35 @@ std::string QueueOut::GetDesc() const {
                              port_->port_builder()->class_name().c_str());
 }
 
-void QueueOut::ProcessBatch(Context *, bess::PacketBatch *batch) {
+int QueueOut::SendBuffered(Context *ctx, bess::Packet **pkts, int cnt,
+                           uint64_t *sent_bytes) {
+  Port *p = port_;
+
+  int dropped;
+  int sent_pkts = tx_buffer_.Send(p, qid_, pkts, cnt, ctx->current_ns,
+                                  sent_bytes, &dropped);
+
+  // Retries from RunTask() are not counted as TX calls
+  int burst = cnt ? cnt : -1;
+  if (!(p->GetFlags() & DRIVER_FLAG_SELF_OUT_STATS)) {
+    p->UpdateQueueStats(PACKET_DIR_OUT, qid_, sent_pkts, dropped, *sent_bytes,
+                        burst);
+  } else {
+    p->UpdateQueueStats(PACKET_DIR_OUT, qid_, 0, dropped, 0, burst);
+  }
+
+  if (backpressure_) {
+    if (tx_buffer_.cnt() > tx_buffer_.capacity() * kHighWaterRatio) {
+      SignalOverload();
+    } else if (tx_buffer_.cnt() < tx_buffer_.capacity() * kLowWaterRatio) {
+      SignalUnderload();
+    }
+  }
+
+  return sent_pkts;
+}
+
+void QueueOut::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   Port *p = port_;
 
   const queue_t qid = qid_;
@@ -82,6 +137,14 @@ void QueueOut::ProcessBatch(Context *, bess::PacketBatch *batch) {
   int sent_pkts = 0;
 
   if (p->conf().admin_up) {
+    if (tx_buffer_.capacity()) {
+      mcslock_node_t mynode;
+      mcs_lock(&tx_lock_, &mynode);
+      SendBuffered(ctx, batch->pkts(), batch->cnt(), &sent_bytes);
+      mcs_unlock(&tx_lock_, &mynode);
+      return;
+    }
+
     sent_pkts = p->SendPackets(qid, batch->pkts(), batch->cnt());
   }
 
@@ -92,9 +155,11 @@ void QueueOut::ProcessBatch(Context *, bess::PacketBatch *batch) {
       sent_bytes += batch->pkts()[i]->total_len();
     }
 
-    p->queue_stats[dir][qid].packets += sent_pkts;
-    p->queue_stats[dir][qid].dropped += (batch->cnt() - sent_pkts);
-    p->queue_stats[dir][qid].bytes += sent_bytes;
+    p->UpdateQueueStats(dir, qid, sent_pkts, batch->cnt() - sent_pkts,
+                        sent_bytes, batch->cnt());
+  } else {
+    p->UpdateQueueStats(PACKET_DIR_OUT, qid, 0, batch->cnt() - sent_pkts, 0,
+                        batch->cnt());
   }
 
   if (sent_pkts < batch->cnt()) {
@@ -102,5 +167,28 @@ void QueueOut::ProcessBatch(Context *, bess::PacketBatch *batch) {
   }
 }
 
+struct task_result QueueOut::RunTask(Context *ctx, bess::PacketBatch *,
+                                    void *) {
+  const int pkt_overhead = 24;
+
+  if (tx_buffer_.cnt() == 0 || !port_->conf().admin_up) {
+    return {.block = true, .packets = 0, .bits = 0};
+  }
+
+  // The feeding worker retries the buffer as well, so do not wait for it
+  mcslock_node_t mynode;
+  if (!mcs_trylock(&tx_lock_, &mynode)) {
+    return {.block = false, .packets = 0, .bits = 0};
+  }
+
+  uint64_t sent_bytes;
+  uint32_t sent_pkts = SendBuffered(ctx, nullptr, 0, &sent_bytes);
+  mcs_unlock(&tx_lock_, &mynode);
+
+  return {.block = (sent_pkts == 0),
+          .packets = sent_pkts,
+          .bits = (sent_bytes + sent_pkts * pkt_overhead) * 8};
+}
+
 ADD_MODULE(QueueOut, "queue_out",
            "sends packets to a port via a specific queue")
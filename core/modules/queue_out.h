@@ -34,12 +34,14 @@
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
 #include "../port.h"
+#include "../tx_buffer.h"
+#include "../utils/mcslock.h"
 
 class QueueOut final : public Module {
  public:
   static const gate_idx_t kNumOGates = 0;
 
-  QueueOut() : Module(), port_(), qid_() {}
+  QueueOut() : Module(), port_(), qid_(), tx_buffer_(), backpressure_() {}
 
   CommandResponse Init(const bess::pb::QueueOutArg &arg);
 
@@ -47,11 +49,33 @@ class QueueOut final : public Module {
 
   void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
 
+  // Retries buffered packets even if no new packets arrive
+  struct task_result RunTask(Context *ctx, bess::PacketBatch *batch,
+                             void *arg) override;
+
   std::string GetDesc() const override;
 
  private:
+  static const uint64_t kDefaultTxBufferTimeoutNs = 1000000;  // 1ms
+
+  // TX buffer occupancy ratios to signal overload/underload at
+  const double kHighWaterRatio = 0.75;
+  const double kLowWaterRatio = 0.25;
+
+  // Sends "pkts" through the TX buffer. Returns the number of packets sent
+  // (including previously buffered ones).
+  int SendBuffered(Context *ctx, bess::Packet **pkts, int cnt,
+                   uint64_t *sent_bytes);
+
   Port *port_;
   queue_t qid_;
+
+  // Packets not accepted by the port yet, if enabled. The task may run on
+  // another worker than the one feeding packets, hence the lock.
+  bess::TxBuffer tx_buffer_;
+  mcslock tx_lock_;
+
+  bool backpressure_;
 };
 
 #endif  // BESS_MODULES_QUEUEOUT_H_
@@ -30,6 +30,8 @@
 
 #include "random_update.h"
 
+#include <algorithm>
+
 using bess::utils::be32_t;
 
 const Commands RandomUpdate::cmds = {
@@ -102,6 +104,9 @@ CommandResponse RandomUpdate::CommandAdd(const bess::pb::RandomUpdateArg &arg) {
     // avoid modulo 0
     vars_[curr + i].range = (max - min + 1) ?: 0xffffffff;
     vars_[curr + i].bit_shift = (4 - size) * 8;
+
+    // 4 bytes are read and written, regardless of 'size'
+    writable_len_ = std::max<uint16_t>(writable_len_, offset + 4);
   }
 
   num_vars_ = curr + arg.fields_size();
@@ -110,11 +115,27 @@ CommandResponse RandomUpdate::CommandAdd(const bess::pb::RandomUpdateArg &arg) {
 
 CommandResponse RandomUpdate::CommandClear(const bess::pb::EmptyArg &) {
   num_vars_ = 0;
+  writable_len_ = 0;
   return CommandSuccess();
 }
 
 void RandomUpdate::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   int cnt = batch->cnt();
+  int n = 0;
+  uint16_t writable_len = writable_len_;
+
+  for (int j = 0; j < cnt; j++) {
+    bess::Packet *pkt = batch->pkts()[j];
+
+    if (unlikely(!pkt->make_writable(writable_len))) {
+      DropPacket(ctx, pkt);
+      continue;
+    }
+
+    batch->pkts()[n++] = pkt;
+  }
+  cnt = n;
+  batch->set_cnt(cnt);
 
   for (size_t i = 0; i < num_vars_; i++) {
     const auto var = &vars_[i];
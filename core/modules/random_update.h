@@ -43,7 +43,7 @@ class RandomUpdate final : public Module {
  public:
   static const Commands cmds;
 
-  RandomUpdate() : Module(), num_vars_(), vars_(), rng_() {
+  RandomUpdate() : Module(), num_vars_(), vars_(), rng_(), writable_len_() {
     max_allowed_workers_ = Worker::kMaxWorkers;
   }
 
@@ -66,6 +66,9 @@ class RandomUpdate final : public Module {
   } vars_[kMaxVariable];
 
   Random rng_;
+
+  // Packet data bytes that the variables may touch
+  uint16_t writable_len_;
 };
 
 #endif  // BESS_MODULES_RANDOMUPDATE_H_
@@ -29,6 +29,10 @@
 
 #include "replicate.h"
 
+#include "../packet_pool.h"
+
+const uint16_t Replicate::kDefaultPrivateLen;
+
 const Commands Replicate::cmds = {
     {"set_gates", "ReplicateCommandSetGatesArg",
      MODULE_CMD_FUNC(&Replicate::CommandSetGates), Command::THREAD_UNSAFE},
@@ -47,6 +51,19 @@ CommandResponse Replicate::Init(const bess::pb::ReplicateArg &arg) {
   }
   ngates_ = arg.gates_size();
 
+  zero_copy_ = arg.zero_copy();
+  private_len_ = kDefaultPrivateLen;
+  // Not limited to the default pool: packets may come from a named pool with
+  // larger buffers. If it does not fit in the buffers of the packet's pool,
+  // Packet::Share() falls back to a full copy.
+  if (arg.private_len()) {
+    if (arg.private_len() > bess::PacketPool::kMaxDataSize) {
+      return CommandFailure(EINVAL, "'private_len' must be [1, %zu]",
+                            bess::PacketPool::kMaxDataSize);
+    }
+    private_len_ = arg.private_len();
+  }
+
   return CommandSuccess();
 }
 
@@ -69,11 +86,24 @@ void Replicate::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   for (int i = 0; i < cnt; i++) {
     bess::Packet *tocopy = batch->pkts()[i];
     for (int j = 1; j < ngates_; j++) {
-      bess::Packet *newpkt = bess::Packet::copy(tocopy);
+      bess::Packet *newpkt = zero_copy_
+                                 ? bess::Packet::Share(tocopy, private_len_)
+                                 : bess::Packet::copy(tocopy);
       if (newpkt) {
         EmitPacket(ctx, newpkt, gates_[j]);
       }
     }
+
+    // The buffer of the original is now shared, so it cannot be written to
+    // (see Packet::make_writable()). Send out a replica of it instead.
+    if (zero_copy_ && tocopy->refcnt() > 1) {
+      bess::Packet *newpkt = bess::Packet::Share(tocopy, private_len_);
+      if (newpkt) {
+        bess::Packet::Free(tocopy);
+        tocopy = newpkt;
+      }
+    }
+
     EmitPacket(ctx, tocopy, 0);
   }
 }
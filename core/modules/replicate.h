@@ -38,9 +38,14 @@ class Replicate final : public Module {
   static const gate_idx_t kMaxGates = 32;
   static const gate_idx_t kNumOGates = kMaxGates;
 
+  // Bytes copied into each zero-copy replica by default (Ethernet, VLAN,
+  // IPv4 and TCP headers without options)
+  static const uint16_t kDefaultPrivateLen = 64;
+
   static const Commands cmds;
 
-  Replicate() : Module(), gates_(), ngates_() {
+  Replicate()
+      : Module(), gates_(), ngates_(), zero_copy_(), private_len_() {
     max_allowed_workers_ = Worker::kMaxWorkers;
   }
 
@@ -59,6 +64,10 @@ class Replicate final : public Module {
   gate_idx_t gates_[kMaxGates];
   // The total number of output gates
   int ngates_;
+
+  // Share the packet data among copies, instead of copying it
+  bool zero_copy_;
+  uint16_t private_len_;
 };
 
 #endif  // BESS_MODULES_RELICATE_H_
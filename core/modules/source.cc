@@ -47,8 +47,16 @@ CommandResponse Source::Init(const bess::pb::SourceArg &arg) {
   pkt_size_ = 60;
   burst_ = bess::PacketBatch::kMaxBurst;
 
+  if (!arg.pool().empty()) {
+    pool_ = bess::PacketPool::Find(arg.pool());
+    if (!pool_) {
+      return CommandFailure(ENOENT, "Packet pool '%s' does not exist",
+                            arg.pool().c_str());
+    }
+  }
+
   if (arg.pkt_size() > 0) {
-    if (arg.pkt_size() > SNBUF_DATA) {
+    if (arg.pkt_size() > max_pkt_size()) {
       return CommandFailure(EINVAL, "Invalid packet size");
     }
     pkt_size_ = arg.pkt_size();
@@ -73,7 +81,7 @@ CommandResponse Source::CommandSetBurst(
 CommandResponse Source::CommandSetPktSize(
     const bess::pb::SourceCommandSetPktSizeArg &arg) {
   uint64_t val = arg.pkt_size();
-  if (val == 0 || val > SNBUF_DATA) {
+  if (val == 0 || val > max_pkt_size()) {
     return CommandFailure(EINVAL, "Invalid packet size");
   }
   pkt_size_ = val;
@@ -92,7 +100,10 @@ struct task_result Source::RunTask(Context *ctx, bess::PacketBatch *batch,
   const int pkt_size = ACCESS_ONCE(pkt_size_);
   const int burst = ACCESS_ONCE(burst_);
 
-  uint32_t cnt = bess::Packet::Alloc(batch->pkts(), burst, pkt_size);
+  struct rte_mempool *pool =
+      pool_ ? pool_->mempool(current_worker.socket()) : nullptr;
+
+  uint32_t cnt = bess::Packet::Alloc(batch->pkts(), burst, pkt_size, pool);
   batch->set_cnt(cnt);
   RunNextModule(ctx, batch);  // it's fine to call this function with cnt==0
 
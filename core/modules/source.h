@@ -32,6 +32,7 @@
 #define BESS_MODULES_FLOWGEN_H_
 
 #include "../module.h"
+#include "../packet_pool.h"
 #include "../pb/module_msg.pb.h"
 
 class Source final : public Module {
@@ -40,7 +41,7 @@ class Source final : public Module {
 
   static const Commands cmds;
 
-  Source() : Module(), pkt_size_(), burst_() { is_task_ = true; }
+  Source() : Module(), pkt_size_(), burst_(), pool_() { is_task_ = true; }
 
   CommandResponse Init(const bess::pb::SourceArg &arg);
 
@@ -53,8 +54,15 @@ class Source final : public Module {
       const bess::pb::SourceCommandSetPktSizeArg &arg);
 
  private:
+  uint64_t max_pkt_size() const {
+    return pool_ ? pool_->data_size() : SNBUF_DATA;
+  }
+
   int pkt_size_;
   int burst_;
+
+  // nullptr for the default pool
+  const bess::PacketPool *pool_;
 };
 
 #endif  // BESS_MODULES_FLOWGEN_H_
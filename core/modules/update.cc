@@ -30,6 +30,8 @@
 
 #include "update.h"
 
+#include <algorithm>
+
 #include "../utils/endian.h"
 
 const Commands Update::cmds = {
@@ -45,6 +47,21 @@ CommandResponse Update::Init(const bess::pb::UpdateArg &arg) {
 
 void Update::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   int cnt = batch->cnt();
+  int n = 0;
+  uint16_t writable_len = writable_len_;
+
+  for (int j = 0; j < cnt; j++) {
+    bess::Packet *snb = batch->pkts()[j];
+
+    if (unlikely(!snb->make_writable(writable_len))) {
+      DropPacket(ctx, snb);
+      continue;
+    }
+
+    batch->pkts()[n++] = snb;
+  }
+  cnt = n;
+  batch->set_cnt(cnt);
 
   for (size_t i = 0; i < num_fields_; i++) {
     const auto field = &fields_[i];
@@ -97,6 +114,8 @@ CommandResponse Update::CommandAdd(const bess::pb::UpdateArg &arg) {
     fields_[curr + i].offset = field.offset();
     fields_[curr + i].mask = mask;
     fields_[curr + i].value = value;
+
+    writable_len_ = std::max<uint16_t>(writable_len_, field.offset() + 8);
   }
 
   num_fields_ = curr + arg.fields_size();
@@ -105,6 +124,7 @@ CommandResponse Update::CommandAdd(const bess::pb::UpdateArg &arg) {
 
 CommandResponse Update::CommandClear(const bess::pb::EmptyArg &) {
   num_fields_ = 0;
+  writable_len_ = 0;
   return CommandSuccess();
 }
 
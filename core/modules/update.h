@@ -42,7 +42,7 @@ class Update final : public Module {
  public:
   static const Commands cmds;
 
-  Update() : Module(), num_fields_(), fields_() {
+  Update() : Module(), num_fields_(), fields_(), writable_len_() {
     max_allowed_workers_ = Worker::kMaxWorkers;
   }
 
@@ -63,6 +63,9 @@ class Update final : public Module {
     be64_t value; /* in network order */
     size_t offset;
   } fields_[kMaxFields];
+
+  // Packet data bytes that the fields (8 bytes each, masked) may touch
+  uint16_t writable_len_;
 };
 
 #endif  // BESS_MODULES_UPDATE_H_
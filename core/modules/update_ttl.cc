@@ -43,7 +43,12 @@ void UpdateTTL::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   for (int i = 0; i < cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
 
-    Ethernet *eth = pkt->head_data<Ethernet *>();
+    Ethernet *eth = pkt->make_writable<Ethernet *>(sizeof(*eth) + sizeof(Ipv4));
+    if (unlikely(!eth)) {
+      DropPacket(ctx, pkt);
+      continue;
+    }
+
     Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
 
     if (ip->ttl > 1) {
@@ -174,6 +174,16 @@ inline static bess::Packet *GenerateResetPacket(
 }
 
 CommandResponse UrlFilter::Init(const bess::pb::UrlFilterArg &arg) {
+  if (arg.arena_size() && !arena()) {
+    int ret = CreateArena(arg.arena_size());
+    if (ret) {
+      return CommandFailure(-ret, "failed to reserve a %" PRIu64 "-byte arena",
+                            arg.arena_size());
+    }
+    flow_cache_ = FlowCache(0, FlowHash(), std::equal_to<Flow>(),
+                            FlowCache::allocator_type(arena()));
+  }
+
   for (const auto &url : arg.blacklist()) {
     blacklist_[url.host()].Insert(url.path(), {});
   }
@@ -194,8 +204,10 @@ CommandResponse UrlFilter::CommandClear(const bess::pb::EmptyArg &) {
 // such a way that SetRuntimeConfig would build the same one.
 CommandResponse UrlFilter::GetInitialArg(const bess::pb::EmptyArg &) {
   bess::pb::UrlFilterArg resp;
-  // Our return value is empty since we return
-  // the current blacklist as the runtime config.
+  // The blacklist is returned as the runtime config.
+  if (arena()) {
+    resp.set_arena_size(arena()->capacity());
+  }
   return CommandSuccess(resp);
 }
 
@@ -268,8 +280,7 @@ void UrlFilter::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
     uint64_t now = ctx->current_ns;
 
     // Find existing flow, if we have one.
-    std::unordered_map<Flow, FlowRecord, FlowHash>::iterator it =
-        flow_cache_.find(flow);
+    FlowCache::iterator it = flow_cache_.find(flow);
 
     if (it != flow_cache_.end()) {
       if (now >= it->second.ExpiryTime()) {
@@ -292,7 +303,8 @@ void UrlFilter::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
       // skip a pointless emplace/erase pair for such packets.
       if (tcp->flags & Tcp::Flag::kSyn) {
         std::tie(it, std::ignore) = flow_cache_.emplace(
-            std::piecewise_construct, std::make_tuple(flow), std::make_tuple());
+            std::piecewise_construct, std::make_tuple(flow),
+            std::make_tuple(arena()));
       } else {
         EmitPacket(ctx, pkt, 0);
         continue;
@@ -45,6 +45,8 @@
 #include "../utils/tcp_flow_reconstruct.h"
 #include "../utils/trie.h"
 
+using bess::utils::Arena;
+using bess::utils::ArenaAllocator;
 using bess::utils::TcpFlowReconstruct;
 using bess::utils::Trie;
 using bess::utils::be16_t;
@@ -91,7 +93,8 @@ struct FlowHash {
 
 class FlowRecord {
  public:
-  FlowRecord() : done_analyzing_(false), buffer_(128), expiry_time_(0) {}
+  explicit FlowRecord(Arena *arena = nullptr)
+      : done_analyzing_(false), buffer_(128, arena), expiry_time_(0) {}
 
   bool IsAnalyzed() { return done_analyzing_; }
   void SetAnalyzed() { done_analyzing_ = true; }
@@ -130,8 +133,13 @@ class UrlFilter final : public Module {
   CommandResponse SetRuntimeConfig(const bess::pb::UrlFilterConfig &arg);
 
  private:
+  // Flow state lives in the module arena, if one was requested
+  using FlowCache =
+      std::unordered_map<Flow, FlowRecord, FlowHash, std::equal_to<Flow>,
+                         ArenaAllocator<std::pair<const Flow, FlowRecord>>>;
+
   std::unordered_map<std::string, Trie<std::tuple<>>> blacklist_;
-  std::unordered_map<Flow, FlowRecord, FlowHash> flow_cache_;
+  FlowCache flow_cache_;
 };
 
 #endif  // BESS_MODULES_URL_FILTER_H_
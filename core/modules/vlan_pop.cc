@@ -31,6 +31,12 @@
 #include "vlan_pop.h"
 
 #include "../utils/ether.h"
+#include "parse.h"
+
+CommandResponse VLANPop::Init(const bess::pb::VLANPopArg &) {
+  info_attr_.Register(this, bess::utils::kHeaderInfoAttrName, true);
+  return CommandSuccess();
+}
 
 void VLANPop::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   using bess::utils::be16_t;
@@ -38,9 +44,16 @@ void VLANPop::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
 
   int cnt = batch->cnt();
 
+  InvalidateHeaderInfo(info_attr_, batch);
+
   for (int i = 0; i < cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
-    char *old_head = pkt->head_data<char *>();
+
+    // The MAC addresses are moved
+    char *old_head = pkt->make_writable<char *>(sizeof(Ethernet) + 4);
+    if (unlikely(!old_head)) {
+      continue;
+    }
 
     __m128i eth = _mm_loadu_si128(reinterpret_cast<__m128i *>(old_head));
     be16_t tpid(be16_t::swap(_mm_extract_epi16(eth, 6)));
@@ -32,12 +32,22 @@
 #define BESS_MODULES_VLANPOP_H_
 
 #include "../module.h"
+#include "../pb/module_msg.pb.h"
+#include "../utils/header_parser.h"
 
 class VLANPop final : public Module {
  public:
-  VLANPop() : Module() { max_allowed_workers_ = Worker::kMaxWorkers; }
+  VLANPop() : Module(), info_attr_() {
+    max_allowed_workers_ = Worker::kMaxWorkers;
+  }
+
+  CommandResponse Init(const bess::pb::VLANPopArg &arg);
 
   void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
+
+ private:
+  // Set by Parse upstream, if any. Marked stale, as tags are removed.
+  bess::metadata::UpdateAttr<bess::utils::HeaderInfo> info_attr_;
 };
 
 #endif  // BESS_MODULES_VLANPOP_H_
@@ -35,6 +35,7 @@
 #include "../utils/ether.h"
 #include "../utils/format.h"
 #include "../utils/simd.h"
+#include "parse.h"
 
 using bess::utils::be16_t;
 using bess::utils::be32_t;
@@ -46,6 +47,7 @@ const Commands VLANPush::cmds = {
 };
 
 CommandResponse VLANPush::Init(const bess::pb::VLANPushArg &arg) {
+  info_attr_.Register(this, bess::utils::kHeaderInfoAttrName, true);
   return CommandSetTci(arg);
 }
 
@@ -60,6 +62,8 @@ CommandResponse VLANPush::CommandSetTci(const bess::pb::VLANPushArg &arg) {
 void VLANPush::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   int cnt = batch->cnt();
 
+  InvalidateHeaderInfo(info_attr_, batch);
+
   be32_t vlan_tag = vlan_tag_;
   be32_t qinq_tag = qinq_tag_;
 
@@ -67,7 +71,9 @@ void VLANPush::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
     bess::Packet *pkt = batch->pkts()[i];
     char *new_head;
 
-    if ((new_head = static_cast<char *>(pkt->prepend(4))) != nullptr) {
+    // The MAC addresses are moved as well
+    if (pkt->make_writable(sizeof(Ethernet)) &&
+        (new_head = static_cast<char *>(pkt->prepend(4))) != nullptr) {
       // shift 12 bytes to the left by 4 bytes
       __m128i ethh;
 
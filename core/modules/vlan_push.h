@@ -35,6 +35,7 @@
 #include "../pb/module_msg.pb.h"
 
 #include "../utils/endian.h"
+#include "../utils/header_parser.h"
 
 class VLANPush final : public Module {
  public:
@@ -55,6 +56,9 @@ class VLANPush final : public Module {
  private:
   bess::utils::be32_t vlan_tag_;
   bess::utils::be32_t qinq_tag_;
+
+  // Set by Parse upstream, if any. Marked stale, as headers are added.
+  bess::metadata::UpdateAttr<bess::utils::HeaderInfo> info_attr_;
 };
 
 #endif  // BESS_MODULES_VLANPUSH_H_
@@ -31,6 +31,12 @@
 #include "vlan_split.h"
 
 #include "../utils/ether.h"
+#include "parse.h"
+
+CommandResponse VLANSplit::Init(const bess::pb::VLANSplitArg &) {
+  info_attr_.Register(this, bess::utils::kHeaderInfoAttrName, true);
+  return CommandSuccess();
+}
 
 void VLANSplit::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   using bess::utils::be16_t;
@@ -38,6 +44,8 @@ void VLANSplit::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
 
   int cnt = batch->cnt();
 
+  InvalidateHeaderInfo(info_attr_, batch);
+
   for (int i = 0; i < cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
     char *old_head = pkt->head_data<char *>();
@@ -32,14 +32,24 @@
 #define BESS_MODULES_VLANSPLIT_H_
 
 #include "../module.h"
+#include "../pb/module_msg.pb.h"
+#include "../utils/header_parser.h"
 
 class VLANSplit final : public Module {
  public:
-  VLANSplit() : Module() { max_allowed_workers_ = Worker::kMaxWorkers; }
+  VLANSplit() : Module(), info_attr_() {
+    max_allowed_workers_ = Worker::kMaxWorkers;
+  }
 
   static const gate_idx_t kNumOGates = 4096;
 
+  CommandResponse Init(const bess::pb::VLANSplitArg &arg);
+
   void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
+
+ private:
+  // Set by Parse upstream, if any. Marked stale, as tags are removed.
+  bess::metadata::UpdateAttr<bess::utils::HeaderInfo> info_attr_;
 };
 
 #endif  // BESS_MODULES_VLANSPLIT_H_
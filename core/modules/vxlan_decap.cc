@@ -34,29 +34,22 @@
 #include "../utils/ip.h"
 #include "../utils/udp.h"
 #include "../utils/vxlan.h"
+#include "parse.h"
 
 /* TODO: Currently it decapulates the entire Ethernet/IP/UDP/VXLAN headers.
  *       Modularize. */
 
-enum {
-  ATTR_W_TUN_IP_SRC,
-  ATTR_W_TUN_IP_DST,
-  ATTR_W_TUN_ID,
-};
-
 CommandResponse VXLANDecap::Init(
     const bess::pb::VXLANDecapArg &arg[[maybe_unused]]) {
-  using AccessMode = bess::metadata::Attribute::AccessMode;
-
-  AddMetadataAttr("tun_ip_src", 4, AccessMode::kWrite);
-  AddMetadataAttr("tun_ip_dst", 4, AccessMode::kWrite);
-  AddMetadataAttr("tun_id", 4, AccessMode::kWrite);
+  tun_ip_src_attr_.Register(this, "tun_ip_src");
+  tun_ip_dst_attr_.Register(this, "tun_ip_dst");
+  tun_id_attr_.Register(this, "tun_id");
+  info_attr_.Register(this, bess::utils::kHeaderInfoAttrName, true);
 
   return CommandSuccess();
 }
 
 void VXLANDecap::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
-  using bess::utils::be32_t;
   using bess::utils::Ethernet;
   using bess::utils::Ipv4;
   using bess::utils::Udp;
@@ -64,23 +57,61 @@ void VXLANDecap::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
 
   int cnt = batch->cnt();
 
+  bess::utils::be32_t ip_src[bess::PacketBatch::kMaxBurst];
+  bess::utils::be32_t ip_dst[bess::PacketBatch::kMaxBurst];
+  bess::utils::be32_t vni[bess::PacketBatch::kMaxBurst];
+  size_t outer_lens[bess::PacketBatch::kMaxBurst];
+
+  InvalidateHeaderInfo(info_attr_, batch);
+
   for (int i = 0; i < cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
-    Ethernet *eth = pkt->head_data<Ethernet *>();
+
+    outer_lens[i] = 0;
+    ip_src[i] = ip_dst[i] = vni[i] = bess::utils::be32_t(0);
+
+    // The outer headers may span multiple segments
+    Ethernet *eth =
+        pkt->pull_head<Ethernet *>(sizeof(Ethernet) + sizeof(Ipv4));
+    if (unlikely(!eth)) {
+      continue;
+    }
+
     Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
     size_t ip_bytes = ip->header_length << 2;
+    size_t outer_len = sizeof(*eth) + ip_bytes + sizeof(Udp) + sizeof(Vxlan);
+    if (unlikely(!pkt->pull_head(outer_len))) {
+      continue;
+    }
+
+    // pull_head() may have moved the data
+    eth = pkt->head_data<Ethernet *>();
+    ip = reinterpret_cast<Ipv4 *>(eth + 1);
     Udp *udp =
         reinterpret_cast<Udp *>(reinterpret_cast<uint8_t *>(ip) + ip_bytes);
     Vxlan *vh = reinterpret_cast<Vxlan *>(udp + 1);
 
-    set_attr<be32_t>(this, ATTR_W_TUN_IP_SRC, pkt, ip->src);
-    set_attr<be32_t>(this, ATTR_W_TUN_IP_DST, pkt, ip->dst);
-    set_attr<be32_t>(this, ATTR_W_TUN_ID, pkt, vh->vx_vni >> 8);
-
-    pkt->adj(sizeof(*eth) + ip_bytes + sizeof(*udp) + sizeof(*vh));
+    ip_src[i] = ip->src;
+    ip_dst[i] = ip->dst;
+    vni[i] = vh->vx_vni >> 8;
+    outer_lens[i] = outer_len;
   }
 
-  RunNextModule(ctx, batch);
+  tun_ip_src_attr_.Scatter(batch, ip_src);
+  tun_ip_dst_attr_.Scatter(batch, ip_dst);
+  tun_id_attr_.Scatter(batch, vni);
+
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+
+    if (unlikely(!outer_lens[i])) {
+      DropPacket(ctx, pkt);
+      continue;
+    }
+
+    pkt->adj(outer_lens[i]);
+    EmitPacket(ctx, pkt);
+  }
 }
 
 ADD_MODULE(VXLANDecap, "vxlan_decap",
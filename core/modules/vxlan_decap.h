@@ -33,6 +33,8 @@
 
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
+#include "../utils/endian.h"
+#include "../utils/header_parser.h"
 
 class VXLANDecap final : public Module {
  public:
@@ -40,6 +42,14 @@ class VXLANDecap final : public Module {
   CommandResponse Init(const bess::pb::VXLANDecapArg &arg);
 
   void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
+
+ private:
+  bess::metadata::WriteAttr<bess::utils::be32_t> tun_ip_src_attr_;
+  bess::metadata::WriteAttr<bess::utils::be32_t> tun_ip_dst_attr_;
+  bess::metadata::WriteAttr<bess::utils::be32_t> tun_id_attr_;
+
+  // Set by Parse upstream, if any. Marked stale, as headers are removed.
+  bess::metadata::UpdateAttr<bess::utils::HeaderInfo> info_attr_;
 };
 
 #endif  // BESS_MODULES_VXLANDECAP_H_
@@ -36,19 +36,11 @@
 #include "../utils/ip.h"
 #include "../utils/udp.h"
 #include "../utils/vxlan.h"
+#include "parse.h"
 
 using bess::utils::be16_t;
 using bess::utils::be32_t;
 
-enum {
-  ATTR_R_TUN_IP_SRC,
-  ATTR_R_TUN_IP_DST,
-  ATTR_R_TUN_ID,
-  ATTR_W_IP_SRC,
-  ATTR_W_IP_DST,
-  ATTR_W_IP_PROTO,
-};
-
 // NOTE: UDP port 4789 is the official port number assigned by IANA,
 // but some systems (including Linux) uses 8472 for legacy reasons.
 const uint16_t VXLANEncap::kDefaultDstPort = 4789;
@@ -64,14 +56,13 @@ CommandResponse VXLANEncap::Init(const bess::pb::VXLANEncapArg &arg) {
     dstport_ = be16_t(dstport);
   }
 
-  using AccessMode = bess::metadata::Attribute::AccessMode;
-
-  AddMetadataAttr("tun_ip_src", 4, AccessMode::kRead);
-  AddMetadataAttr("tun_ip_dst", 4, AccessMode::kRead);
-  AddMetadataAttr("tun_id", 4, AccessMode::kRead);
-  AddMetadataAttr("ip_src", 4, AccessMode::kWrite);
-  AddMetadataAttr("ip_dst", 4, AccessMode::kWrite);
-  AddMetadataAttr("ip_proto", 1, AccessMode::kWrite);
+  tun_ip_src_attr_.Register(this, "tun_ip_src");
+  tun_ip_dst_attr_.Register(this, "tun_ip_dst");
+  tun_id_attr_.Register(this, "tun_id");
+  ip_src_attr_.Register(this, "ip_src");
+  ip_dst_attr_.Register(this, "ip_dst");
+  ip_proto_attr_.Register(this, "ip_proto");
+  info_attr_.Register(this, bess::utils::kHeaderInfoAttrName, true);
 
   return CommandSuccess();
 }
@@ -84,20 +75,33 @@ void VXLANEncap::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
 
   int cnt = batch->cnt();
 
+  InvalidateHeaderInfo(info_attr_, batch);
+
+  be32_t ip_src[bess::PacketBatch::kMaxBurst];
+  be32_t ip_dst[bess::PacketBatch::kMaxBurst];
+  be32_t vni[bess::PacketBatch::kMaxBurst];
+
+  tun_ip_src_attr_.Gather(batch, ip_src);
+  tun_ip_dst_attr_.Gather(batch, ip_dst);
+  tun_id_attr_.Gather(batch, vni);
+
   for (int i = 0; i < cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
 
-    be32_t ip_src = get_attr<be32_t>(this, ATTR_R_TUN_IP_SRC, pkt);
-    be32_t ip_dst = get_attr<be32_t>(this, ATTR_R_TUN_IP_DST, pkt);
-    be32_t vni = get_attr<be32_t>(this, ATTR_R_TUN_ID, pkt);
-
     Ethernet *inner_eth;
     Udp *udp;
     Vxlan *vh;
 
     size_t inner_frame_len = pkt->total_len() + sizeof(*udp);
 
-    inner_eth = pkt->head_data<Ethernet *>();
+    // The headroom may be shared with other packets. The MAC addresses are
+    // hashed below.
+    inner_eth =
+        pkt->make_writable<Ethernet *>(sizeof(Ethernet::Address) * 2);
+    if (unlikely(!inner_eth)) {
+      continue;
+    }
+
     udp = static_cast<Udp *>(pkt->prepend(sizeof(*udp) + sizeof(*vh)));
     if (unlikely(!udp)) {
       continue;
@@ -105,7 +109,7 @@ void VXLANEncap::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
 
     vh = reinterpret_cast<Vxlan *>(udp + 1);
     vh->vx_flags = be32_t(0x08000000);
-    vh->vx_vni = vni << 8;
+    vh->vx_vni = vni[i] << 8;
 
     udp->src_port = be16_t(
         rte_hash_crc(inner_eth, sizeof(Ethernet::Address) * 2, UINT32_MAX) |
@@ -113,12 +117,12 @@ void VXLANEncap::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
     udp->dst_port = dstport_;
     udp->length = be16_t(sizeof(*udp) + inner_frame_len);
     udp->checksum = 0;
-
-    set_attr<be32_t>(this, ATTR_W_IP_SRC, pkt, ip_src);
-    set_attr<be32_t>(this, ATTR_W_IP_DST, pkt, ip_dst);
-    set_attr<uint8_t>(this, ATTR_W_IP_PROTO, pkt, Ipv4::Proto::kUdp);
   }
 
+  ip_src_attr_.Scatter(batch, ip_src);
+  ip_dst_attr_.Scatter(batch, ip_dst);
+  ip_proto_attr_.Fill(batch, Ipv4::Proto::kUdp);
+
   RunNextModule(ctx, batch);
 }
 
@@ -35,6 +35,7 @@
 #include "../pb/module_msg.pb.h"
 
 #include "../utils/endian.h"
+#include "../utils/header_parser.h"
 
 class VXLANEncap final : public Module {
  public:
@@ -50,6 +51,16 @@ class VXLANEncap final : public Module {
 
  private:
   bess::utils::be16_t dstport_;
+
+  bess::metadata::ReadAttr<bess::utils::be32_t> tun_ip_src_attr_;
+  bess::metadata::ReadAttr<bess::utils::be32_t> tun_ip_dst_attr_;
+  bess::metadata::ReadAttr<bess::utils::be32_t> tun_id_attr_;
+  bess::metadata::WriteAttr<bess::utils::be32_t> ip_src_attr_;
+  bess::metadata::WriteAttr<bess::utils::be32_t> ip_dst_attr_;
+  bess::metadata::WriteAttr<uint8_t> ip_proto_attr_;
+
+  // Set by Parse upstream, if any. Marked stale, as headers are added.
+  bess::metadata::UpdateAttr<bess::utils::HeaderInfo> info_attr_;
 };
 
 #endif  // BESS_MODULES_VXLANENCAP_H_
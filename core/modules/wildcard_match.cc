@@ -35,6 +35,7 @@
 
 #include "../utils/endian.h"
 #include "../utils/format.h"
+#include "../utils/time.h"
 
 using bess::metadata::Attribute;
 
@@ -68,9 +69,14 @@ const Commands WildcardMatch::cmds = {
      MODULE_CMD_FUNC(&WildcardMatch::CommandDelete), Command::THREAD_UNSAFE},
     {"clear", "EmptyArg", MODULE_CMD_FUNC(&WildcardMatch::CommandClear),
      Command::THREAD_UNSAFE},
+    {"update", "WildcardMatchCommandUpdateArg",
+     MODULE_CMD_FUNC(&WildcardMatch::CommandUpdate), Command::THREAD_SAFE},
     {"set_default_gate", "WildcardMatchCommandSetDefaultGateArg",
      MODULE_CMD_FUNC(&WildcardMatch::CommandSetDefaultGate),
-     Command::THREAD_SAFE}};
+     Command::THREAD_SAFE},
+    {"get_cache_stats", "FlowCacheCommandGetStatsArg",
+     MODULE_CMD_FUNC(&WildcardMatch::CommandGetCacheStats),
+     Command::THREAD_UNSAFE}};
 
 CommandResponse WildcardMatch::AddFieldOne(const bess::pb::Field &field,
                                            struct WmField *f) {
@@ -130,20 +136,28 @@ CommandResponse WildcardMatch::Init(const bess::pb::WildcardMatchArg &arg) {
   default_gate_ = DROP_GATE;
   total_key_size_ = align_ceil(size_acc, sizeof(uint64_t));
 
+  memset(&field_mask_, 0, sizeof(field_mask_));
+  memset(&field_mask_, 0xff, size_acc);
+
+  if (arg.cache_size() > 0) {
+    caches_.assign(Worker::kMaxWorkers, WmCache(arg.cache_size()));
+  }
+
   return CommandSuccess();
 }
 
-inline gate_idx_t WildcardMatch::LookupEntry(const wm_hkey_t &key,
+inline gate_idx_t WildcardMatch::LookupEntry(const WmTable &table,
+                                             const wm_hkey_t &key,
                                              gate_idx_t def_gate) {
   struct WmData result = {
       .priority = INT_MIN, .ogate = def_gate,
   };
 
-  for (auto &tuple : tuples_) {
-    const auto &ht = tuple.ht;
+  for (const auto &tuple : table.tuples) {
+    const auto &ht = tuple->ht;
     wm_hkey_t key_masked;
 
-    mask(&key_masked, key, tuple.mask, total_key_size_);
+    mask(&key_masked, key, tuple->mask, total_key_size_);
 
     const auto *entry =
         ht.Find(key_masked, wm_hash(total_key_size_), wm_eq(total_key_size_));
@@ -170,6 +184,9 @@ void WildcardMatch::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
 
   default_gate = ACCESS_ONCE(default_gate_);
 
+  // Stays valid until this task returns, even if replaced in the meantime
+  const WmTable *table = table_.load();
+
   for (const auto &field : fields_) {
     int offset;
     int pos = field.pos;
@@ -196,22 +213,71 @@ void WildcardMatch::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
     }
   }
 
+  if (caches_.empty()) {
+    for (int i = 0; i < cnt; i++) {
+      bess::Packet *pkt = batch->pkts()[i];
+      EmitPacket(ctx, pkt, LookupEntry(*table, keys[i], default_gate));
+    }
+    return;
+  }
+
+  WmCache &wm_cache = caches_[ctx->wid];
+  if (wm_cache.version != table->version) {
+    wm_cache.cache.Invalidate();
+    wm_cache.version = table->version;
+  }
+
+  FlowCache &cache = wm_cache.cache;
+  wm_hash hasher(total_key_size_);
+  wm_eq eq(total_key_size_);
+
   for (int i = 0; i < cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
-    EmitPacket(ctx, pkt, LookupEntry(keys[i], default_gate));
+    gate_idx_t gate;
+
+    mask(&keys[i], keys[i], field_mask_, total_key_size_);
+    uint32_t hash = hasher(keys[i]);
+
+    const gate_idx_t *cached = cache.Find(keys[i], hash, eq);
+    if (cached) {
+      gate = *cached;
+    } else {
+      gate = LookupEntry(*table, keys[i], kNoMatch);
+      cache.Insert(keys[i], hash, gate);
+    }
+
+    EmitPacket(ctx, pkt, gate == kNoMatch ? default_gate : gate);
   }
 }
 
 std::string WildcardMatch::GetDesc() const {
   int num_rules = 0;
 
-  for (const auto &tuple : tuples_) {
-    num_rules += tuple.ht.Count();
+  for (const auto &tuple : table_.load()->tuples) {
+    num_rules += tuple->ht.Count();
   }
 
   return bess::utils::Format("%zu fields, %d rules", fields_.size(), num_rules);
 }
 
+size_t WildcardMatch::MemoryUsage() const {
+  size_t bytes = Module::MemoryUsage();
+
+  const WmTable *table = table_.load();
+  bytes += fields_.capacity() * sizeof(struct WmField);
+  bytes += sizeof(WmTable);
+  bytes += table->tuples.capacity() * sizeof(std::shared_ptr<WmTuple>);
+  for (const auto &tuple : table->tuples) {
+    bytes += sizeof(WmTuple) + tuple->ht.MemoryUsage();
+  }
+  bytes += caches_.capacity() * sizeof(WmCache);
+  for (const auto &wm_cache : caches_) {
+    bytes += wm_cache.cache.MemoryUsage();
+  }
+
+  return bytes;
+}
+
 template <typename T>
 CommandResponse WildcardMatch::ExtractKeyMask(const T &arg, wm_hkey_t *key,
                                               wm_hkey_t *mask) {
@@ -275,11 +341,11 @@ CommandResponse WildcardMatch::ExtractKeyMask(const T &arg, wm_hkey_t *key,
   return CommandSuccess();
 }
 
-int WildcardMatch::FindTuple(wm_hkey_t *mask) {
+int WildcardMatch::FindTuple(const WmTable &table, wm_hkey_t *mask) {
   int i = 0;
 
-  for (const auto &tuple : tuples_) {
-    if (memcmp(&tuple.mask, mask, total_key_size_) == 0) {
+  for (const auto &tuple : table.tuples) {
+    if (memcmp(&tuple->mask, mask, total_key_size_) == 0) {
       return i;
     }
     i++;
@@ -287,35 +353,52 @@ int WildcardMatch::FindTuple(wm_hkey_t *mask) {
   return -ENOENT;
 }
 
-int WildcardMatch::AddTuple(wm_hkey_t *mask) {
-  if (tuples_.size() >= MAX_TUPLES) {
+int WildcardMatch::AddTuple(WmTable *table, wm_hkey_t *mask) {
+  if (table->tuples.size() >= MAX_TUPLES) {
     return -ENOSPC;
   }
 
-  tuples_.emplace_back();
-  struct WmTuple &tuple = tuples_.back();
+  table->tuples.push_back(std::make_shared<WmTuple>());
+  struct WmTuple &tuple = *table->tuples.back();
   bess::utils::Copy(&tuple.mask, mask, sizeof(*mask));
 
-  return int(tuples_.size() - 1);
+  return int(table->tuples.size() - 1);
 }
 
-int WildcardMatch::DelEntry(int idx, wm_hkey_t *key) {
-  struct WmTuple &tuple = tuples_[idx];
-  int ret =
-      tuple.ht.Remove(*key, wm_hash(total_key_size_), wm_eq(total_key_size_));
-  if (ret) {
-    return ret;
+WildcardMatch::WmTuple *WildcardMatch::MutableTuple(WmTable *table, int idx) {
+  std::shared_ptr<WmTuple> &tuple = table->tuples[idx];
+
+  if (tuple.use_count() > 1) {
+    // Still visible to workers through another table. Copy it.
+    auto copy = std::make_shared<WmTuple>();
+    bess::utils::Copy(&copy->mask, &tuple->mask, sizeof(copy->mask));
+    for (const auto &entry : tuple->ht) {
+      copy->ht.Insert(entry.first, entry.second, wm_hash(total_key_size_),
+                      wm_eq(total_key_size_));
+    }
+    tuple = std::move(copy);
   }
 
+  return tuple.get();
+}
+
+int WildcardMatch::DelEntry(WmTable *table, int idx, wm_hkey_t *key) {
+  struct WmTuple &tuple = *MutableTuple(table, idx);
+  if (!tuple.ht.Remove(*key, wm_hash(total_key_size_),
+                       wm_eq(total_key_size_))) {
+    return -ENOENT;
+  }
+
+  // Empty tuples would still cost a lookup per packet
   if (tuple.ht.Count() == 0) {
-    tuples_.erase(tuples_.begin() + idx);
+    table->tuples.erase(table->tuples.begin() + idx);
   }
 
   return 0;
 }
 
-CommandResponse WildcardMatch::CommandAdd(
-    const bess::pb::WildcardMatchCommandAddArg &arg) {
+CommandResponse WildcardMatch::AddRule(
+    WmTable *table, const bess::pb::WildcardMatchCommandAddArg &arg) {
   gate_idx_t gate = arg.gate();
   int priority = arg.priority();
 
@@ -336,25 +419,26 @@ CommandResponse WildcardMatch::CommandAdd(
   data.priority = priority;
   data.ogate = gate;
 
-  int idx = FindTuple(&mask);
+  int idx = FindTuple(*table, &mask);
   if (idx < 0) {
-    idx = AddTuple(&mask);
+    idx = AddTuple(table, &mask);
     if (idx < 0) {
       return CommandFailure(-idx, "failed to add a new wildcard pattern");
     }
   }
 
-  auto *ret = tuples_[idx].ht.Insert(key, data, wm_hash(total_key_size_),
-                                     wm_eq(total_key_size_));
+  auto *ret = MutableTuple(table, idx)->ht.Insert(
+      key, data, wm_hash(total_key_size_), wm_eq(total_key_size_));
   if (ret == nullptr) {
     return CommandFailure(EINVAL, "failed to add a rule");
   }
 
+  table->version++;
   return CommandSuccess();
 }
 
-CommandResponse WildcardMatch::CommandDelete(
-    const bess::pb::WildcardMatchCommandDeleteArg &arg) {
+CommandResponse WildcardMatch::DeleteRule(
+    WmTable *table, const bess::pb::WildcardMatchCommandDeleteArg &arg) {
   wm_hkey_t key;
   wm_hkey_t mask;
 
@@ -363,28 +447,100 @@ CommandResponse WildcardMatch::CommandDelete(
     return err;
   }
 
-  int idx = FindTuple(&mask);
+  int idx = FindTuple(*table, &mask);
   if (idx < 0) {
     return CommandFailure(-idx, "failed to delete a rule");
   }
 
-  int ret = DelEntry(idx, &key);
+  int ret = DelEntry(table, idx, &key);
   if (ret < 0) {
     return CommandFailure(-ret, "failed to delete a rule");
   }
 
+  table->version++;
   return CommandSuccess();
 }
 
+CommandResponse WildcardMatch::CommandAdd(
+    const bess::pb::WildcardMatchCommandAddArg &arg) {
+  return AddRule(table_.load(), arg);
+}
+
+CommandResponse WildcardMatch::CommandDelete(
+    const bess::pb::WildcardMatchCommandDeleteArg &arg) {
+  return DeleteRule(table_.load(), arg);
+}
+
 CommandResponse WildcardMatch::CommandClear(const bess::pb::EmptyArg &) {
   WildcardMatch::Clear();
   return CommandSuccess();
 }
 
 void WildcardMatch::Clear() {
-  for (auto &tuple : tuples_) {
-    tuple.ht.Clear();
+  WmTable *table = table_.load();
+  table->tuples.clear();
+  table->version++;
+}
+
+// Applies all deletions, then all additions, as a single change. Runs while
+// workers are running: the changes go to a new table, which replaces the
+// current one only if all of them succeed. The response reports how long
+// each step took.
+CommandResponse WildcardMatch::CommandUpdate(
+    const bess::pb::WildcardMatchCommandUpdateArg &arg) {
+  uint64_t start = rdtsc();
+
+  WmTable *old_table = table_.load();
+  std::unique_ptr<WmTable> new_table(new WmTable(*old_table));
+
+  for (int i = 0; i < arg.deletes_size(); i++) {
+    CommandResponse err = DeleteRule(new_table.get(), arg.deletes(i));
+    if (err.error().code() != 0) {
+      return CommandFailure(err.error().code(), "deletes[%d]: %s", i,
+                            err.error().errmsg().c_str());
+    }
+  }
+
+  for (int i = 0; i < arg.adds_size(); i++) {
+    CommandResponse err = AddRule(new_table.get(), arg.adds(i));
+    if (err.error().code() != 0) {
+      return CommandFailure(err.error().code(), "adds[%d]: %s", i,
+                            err.error().errmsg().c_str());
+    }
   }
+
+  uint64_t built = rdtsc();
+
+  table_.store(new_table.release());
+  synchronize_workers();
+  delete old_table;
+
+  uint64_t done = rdtsc();
+
+  bess::pb::WildcardMatchCommandUpdateResponse r;
+  r.set_build_ns(tsc_to_ns(built - start));
+  r.set_sync_ns(tsc_to_ns(done - built));
+  r.set_num_tuples(table_.load()->tuples.size());
+  return CommandSuccess(r);
+}
+
+CommandResponse WildcardMatch::CommandGetCacheStats(
+    const bess::pb::FlowCacheCommandGetStatsArg &arg) {
+  if (caches_.empty()) {
+    return CommandFailure(EINVAL, "flow cache is not enabled");
+  }
+
+  bess::pb::FlowCacheCommandGetStatsResponse r;
+  r.set_size(caches_[0].cache.size());
+  for (auto &wm_cache : caches_) {
+    r.set_hits(r.hits() + wm_cache.cache.hits());
+    r.set_misses(r.misses() + wm_cache.cache.misses());
+    if (arg.reset()) {
+      wm_cache.cache.ResetStats();
+    }
+  }
+
+  return CommandSuccess(r);
 }
 
 // Retrieves a WildcardMatchArg that would reconstruct this module.
@@ -399,6 +555,9 @@ CommandResponse WildcardMatch::GetInitialArg(const bess::pb::EmptyArg &) {
     }
     f->set_num_bytes(field.size);
   }
+  if (!caches_.empty()) {
+    resp.set_cache_size(caches_[0].cache.size());
+  }
   return CommandSuccess(resp);
 }
 
@@ -411,11 +570,11 @@ CommandResponse WildcardMatch::GetRuntimeConfig(const bess::pb::EmptyArg &) {
   resp.set_default_gate(default_gate_);
 
   // Each tuple provides a single mask, which may have many data-matches.
-  for (auto &tuple : tuples_) {
-    wm_hkey_t mask = tuple.mask;
+  for (auto &tuple : table_.load()->tuples) {
+    wm_hkey_t mask = tuple->mask;
     // Each entry in the hash table has priority, ogate, and the data
     // (one datum per field, under the mask for this field).
-    for (auto &entry : tuple.ht) {
+    for (auto &entry : tuple->ht) {
       // Create the rule instance
       rule_t *rule = resp.add_rules();
       rule->set_priority(entry.second.priority);
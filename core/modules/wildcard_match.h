@@ -33,11 +33,15 @@
 
 #include "../module.h"
 
+#include <atomic>
+#include <memory>
+
 #include <rte_config.h>
 #include <rte_hash_crc.h>
 
 #include "../pb/module_msg.pb.h"
 #include "../utils/cuckoo_map.h"
+#include "../utils/flow_cache.h"
 
 using bess::utils::HashResult;
 using bess::utils::CuckooMap;
@@ -135,16 +139,26 @@ class WildcardMatch final : public Module {
   static const Commands cmds;
 
   WildcardMatch()
-      : Module(), default_gate_(), total_key_size_(), fields_(), tuples_() {
+      : Module(),
+        default_gate_(),
+        total_key_size_(),
+        field_mask_(),
+        fields_(),
+        table_(new WmTable()),
+        caches_() {
     max_allowed_workers_ = Worker::kMaxWorkers;
   }
 
+  ~WildcardMatch() { delete table_.load(); }
+
   CommandResponse Init(const bess::pb::WildcardMatchArg &arg);
 
   void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
 
   std::string GetDesc() const override;
 
+  size_t MemoryUsage() const override;
+
   CommandResponse GetInitialArg(const bess::pb::EmptyArg &arg);
   CommandResponse GetRuntimeConfig(const bess::pb::EmptyArg &arg);
   CommandResponse SetRuntimeConfig(const bess::pb::WildcardMatchConfig &arg);
@@ -152,8 +166,12 @@ class WildcardMatch final : public Module {
   CommandResponse CommandDelete(
       const bess::pb::WildcardMatchCommandDeleteArg &arg);
   CommandResponse CommandClear(const bess::pb::EmptyArg &arg);
+  CommandResponse CommandUpdate(
+      const bess::pb::WildcardMatchCommandUpdateArg &arg);
   CommandResponse CommandSetDefaultGate(
       const bess::pb::WildcardMatchCommandSetDefaultGateArg &arg);
+  CommandResponse CommandGetCacheStats(
+      const bess::pb::FlowCacheCommandGetStatsArg &arg);
 
  private:
   struct WmTuple {
@@ -161,16 +179,48 @@ class WildcardMatch final : public Module {
     wm_hkey_t mask;
   };
 
-  gate_idx_t LookupEntry(const wm_hkey_t &key, gate_idx_t def_gate);
+  // A snapshot of all rules. Workers read whichever one table_ points to at
+  // the beginning of a batch. "update" builds a new snapshot off the data
+  // path and swaps it in, so that workers keep running and never see half of
+  // a batch of changes. Tuples that a batch does not touch are shared between
+  // the old and the new snapshot.
+  struct WmTable {
+    std::vector<std::shared_ptr<WmTuple>> tuples;
+    uint64_t version;  // changes whenever the rules do
+  };
+
+  // Caches the output gate of LookupEntry() for a key, or kNoMatch so that
+  // the default gate can change without invalidating the cache.
+  using FlowCache = bess::utils::FlowCache<wm_hkey_t, gate_idx_t, wm_eq>;
+
+  struct WmCache {
+    explicit WmCache(size_t size) : cache(size), version() {}
+
+    FlowCache cache;
+    uint64_t version;  // of the WmTable that the cached entries came from
+  };
+
+  static const gate_idx_t kNoMatch = DROP_GATE + 1;
+
+  gate_idx_t LookupEntry(const WmTable &table, const wm_hkey_t &key,
+                         gate_idx_t def_gate);
 
   CommandResponse AddFieldOne(const bess::pb::Field &field, struct WmField *f);
 
   template <typename T>
   CommandResponse ExtractKeyMask(const T &arg, wm_hkey_t *key, wm_hkey_t *mask);
 
-  int FindTuple(wm_hkey_t *mask);
-  int AddTuple(wm_hkey_t *mask);
-  int DelEntry(int idx, wm_hkey_t *key);
+  // The functions below modify a table in place. Tuples shared with another
+  // table are copied first.
+  CommandResponse AddRule(WmTable *table,
+                          const bess::pb::WildcardMatchCommandAddArg &arg);
+  CommandResponse DeleteRule(
+      WmTable *table, const bess::pb::WildcardMatchCommandDeleteArg &arg);
+
+  int FindTuple(const WmTable &table, wm_hkey_t *mask);
+  int AddTuple(WmTable *table, wm_hkey_t *mask);
+  int DelEntry(WmTable *table, int idx, wm_hkey_t *key);
+  WmTuple *MutableTuple(WmTable *table, int idx);
 
   void Clear();
 
@@ -178,9 +228,18 @@ class WildcardMatch final : public Module {
 
   size_t total_key_size_; /* a multiple of sizeof(uint64_t) */
 
+  // All-ones over the bytes of the fields, so that cached keys do not
+  // include packet data past the last field.
+  wm_hkey_t field_mask_;
+
   // TODO(melvinw): this can be refactored to use ExactMatchTable
   std::vector<struct WmField> fields_;
-  std::vector<struct WmTuple> tuples_;
+
+  // Never null. Replaced only by CommandUpdate() while workers are running.
+  std::atomic<WmTable *> table_;
+
+  // One per worker, or empty if the flow cache is disabled
+  std::vector<WmCache> caches_;
 };
 
 #endif  // BESS_MODULES_WILDCARDMATCH_H_
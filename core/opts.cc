@@ -34,6 +34,7 @@
 #include <cstdint>
 
 #include "bessd.h"
+#include "packet_cache.h"
 #include "worker.h"
 
 // Port this BESS instance listens on.
@@ -118,3 +119,25 @@ DEFINE_int32(buffers, 262144, "Specifies how many packet buffers to allocate per
 	     " must be a power of 2.");
 static const bool _buffers_dummy[[maybe_unused]] =
     google::RegisterFlagValidator(&FLAGS_buffers, &ValidateBuffersPerSocket);
+
+DEFINE_bool(profile_modules, false,
+            "Collect per-module hardware performance counters "
+            "(adds overhead to every module call)");
+
+static bool ValidatePacketCacheDepth(const char *, int32_t value) {
+  const int32_t min_depth = bess::PacketCache::kMinDepth;
+  const int32_t max_depth = bess::PacketCache::kMaxDepth;
+
+  if (value != 0 && (value < min_depth || value > max_depth)) {
+    LOG(ERROR) << "Packet cache depth must be 0 (disabled) or in ["
+               << min_depth << ", " << max_depth << "]: " << value;
+    return false;
+  }
+  return true;
+}
+DEFINE_int32(packet_cache, bess::PacketCache::kDefaultDepth,
+             "Specifies how many free packet buffers each worker keeps for "
+             "reuse, 0 to disable");
+static const bool _packet_cache_dummy[[maybe_unused]] =
+    google::RegisterFlagValidator(&FLAGS_packet_cache,
+                                  &ValidatePacketCacheDepth);
@@ -41,7 +41,10 @@
 
 #include "dpdk.h"
 #include "opts.h"
+#include "packet_pool.h"
+#include "utils/checksum.h"
 #include "utils/common.h"
+#include "utils/copy.h"
 
 namespace bess {
 
@@ -49,42 +52,18 @@ const size_t PacketBatch::kMaxBurst;
 
 static struct rte_mempool *pframe_pool[RTE_MAX_NUMA_NODES];
 
-static void packet_init(struct rte_mempool *mp, void *opaque_arg, void *_m,
-                        unsigned i) {
-  Packet *pkt;
-
-  pkt = reinterpret_cast<Packet *>(_m);
-
-  rte_pktmbuf_init(mp, nullptr, _m, i);
-
-  memset(pkt->reserve(), 0, SNBUF_RESERVE);
-
-  pkt->set_vaddr(pkt);
-  pkt->set_paddr(rte_mempool_virt2iova(pkt));
-  pkt->set_sid(reinterpret_cast<uintptr_t>(opaque_arg));
-  pkt->set_index(i);
-}
-
 static void init_mempool_socket(int sid) {
-  struct rte_pktmbuf_pool_private pool_priv;
   char name[256];
   int current_try = FLAGS_buffers;
 
-  const int num_mempool_cache = 512;
   const int minimum_try = 16384;
 
-  pool_priv.mbuf_data_room_size = SNBUF_HEADROOM + SNBUF_DATA;
-  pool_priv.mbuf_priv_size = SNBUF_RESERVE;
-
 again:
   snprintf(name, sizeof(name), "pframe%d_%dk", sid, (current_try + 1) / 1024);
 
   /* 2^n - 1 is optimal according to the DPDK manual */
-  pframe_pool[sid] = rte_mempool_create(
-      name, current_try - 1, sizeof(Packet), num_mempool_cache,
-      sizeof(struct rte_pktmbuf_pool_private), rte_pktmbuf_pool_init,
-      &pool_priv, packet_init, reinterpret_cast<void *>((uintptr_t)sid), sid,
-      0);
+  pframe_pool[sid] =
+      PacketPool::CreateMempool(name, SNBUF_DATA, current_try - 1, sid);
 
   if (!pframe_pool[sid]) {
     LOG(WARNING) << "Allocating " << current_try - 1 << " buffers on socket "
@@ -122,6 +101,8 @@ void init_mempool(void) {
       initialized[sid] = 1;
     }
   }
+
+  PacketPool::CreateDefault(pframe_pool, FLAGS_buffers - 1);
 }
 
 void close_mempool(void) {
@@ -176,6 +157,233 @@ Packet::Packet() {
 
 #undef check_offset
 
+void *Packet::PullHead(uint16_t len) {
+  if (len > pkt_len_) {
+    return nullptr;
+  }
+
+  if (len <= data_len_) {
+    return head_data();
+  }
+
+  // The head buffer and the segments we take data from are modified in place
+  if (!RTE_MBUF_DIRECT(&mbuf_)) {
+    return nullptr;
+  }
+
+  for (const Packet *seg = this; seg; seg = seg->next_) {
+    if (seg->refcnt() != 1) {
+      return nullptr;
+    }
+  }
+
+  uint16_t to_pull = len - data_len_;
+
+  if (tailroom() < to_pull) {
+    // Make room by moving the existing data toward the buffer start
+    uint16_t shift = to_pull - tailroom();
+    if (headroom() < shift) {
+      return nullptr;
+    }
+
+    memmove(head_data<char *>() - shift, head_data(), data_len_);
+    data_off_ -= shift;
+  }
+
+  char *dst = head_data<char *>() + data_len_;
+
+  while (to_pull > 0) {
+    Packet *seg = next_;
+    uint16_t n = std::min(to_pull, seg->data_len_);
+
+    bess::utils::Copy(dst, seg->head_data(), n);
+    dst += n;
+    to_pull -= n;
+    data_len_ += n;
+
+    seg->data_off_ += n;
+    seg->data_len_ -= n;
+
+    if (seg->data_len_ == 0) {
+      next_ = seg->next_;
+      seg->next_ = nullptr;
+      nb_segs_--;
+      rte_pktmbuf_free_seg(&seg->mbuf_);
+    }
+  }
+
+  return head_data();
+}
+
+void *Packet::MakeWritable(uint16_t len) {
+  len = std::min<uint32_t>(len, pkt_len_);
+
+  if (refcnt() != 1) {
+    // Other packets hold this very segment
+    return nullptr;
+  }
+
+  if (RTE_MBUF_INDIRECT(&mbuf_)) {
+    // Hand the shared data over to a new indirect segment, then take back
+    // our own (empty) buffer as the head
+    Packet *rest = __packet_alloc_pool(pool_);
+    if (!rest) {
+      return nullptr;
+    }
+
+    uint64_t ol_flags = mbuf_.ol_flags & ~IND_ATTACHED_MBUF;
+    uint32_t pkt_len = pkt_len_;
+    uint16_t nb_segs = nb_segs_;
+
+    rte_pktmbuf_attach(&rest->mbuf_, &mbuf_);
+    rest->next_ = next_;
+
+    rte_pktmbuf_detach(&mbuf_);
+    mbuf_.ol_flags = ol_flags;
+    next_ = rest;
+    nb_segs_ = nb_segs + 1;
+    pkt_len_ = pkt_len;
+  }
+
+  // Copies the bytes from the following segments, shared or not
+  return PullHead(len);
+}
+
+bool Packet::CopyOut(void *dst, uint32_t offset, uint32_t len) const {
+  const Packet *seg = this;
+  char *p = static_cast<char *>(dst);
+
+  // Not "offset + len > pkt_len_", which may wrap around
+  if (offset > pkt_len_ || len > pkt_len_ - offset) {
+    return false;
+  }
+
+  if (len == 0) {
+    return true;
+  }
+
+  while (offset >= seg->data_len_) {
+    offset -= seg->data_len_;
+    seg = seg->next_;
+  }
+
+  while (len > 0) {
+    uint32_t n = std::min<uint32_t>(len, seg->data_len_ - offset);
+
+    bess::utils::Copy(p, seg->head_data<const char *>() + offset, n);
+    p += n;
+    len -= n;
+    offset = 0;
+    seg = seg->next_;
+  }
+
+  return true;
+}
+
+uint32_t Packet::CalculateSum(uint32_t offset, uint32_t len) const {
+  const Packet *seg = this;
+  uint32_t sum = 0;
+  uint32_t done = 0;
+
+  DCHECK_LE(offset + len, pkt_len_);
+
+  while (seg && offset >= seg->data_len_) {
+    offset -= seg->data_len_;
+    seg = seg->next_;
+  }
+
+  while (seg && len > 0) {
+    uint32_t n = std::min<uint32_t>(len, seg->data_len_ - offset);
+
+    sum = bess::utils::AddSum(
+        sum, bess::utils::CalculateSumAt(
+                 seg->head_data<const char *>() + offset, n, done));
+    done += n;
+    len -= n;
+    offset = 0;
+    seg = seg->next_;
+  }
+
+  return sum;
+}
+
+Packet *Packet::CopyChain(const Packet *src) {
+  Packet *head = __packet_alloc_pool(src->pool_);
+  if (!head) {
+    return nullptr;
+  }
+
+  Packet *dst = head;
+
+  for (const Packet *seg = src; seg; seg = seg->next_) {
+    uint16_t copied = 0;
+
+    while (copied < seg->data_len_) {
+      if (dst->tailroom() == 0) {
+        Packet *next = __packet_alloc_pool(src->pool_);
+        if (!next) {
+          Free(head);
+          return nullptr;
+        }
+
+        // no headroom needed in chained segments
+        next->data_off_ = 0;
+        dst->next_ = next;
+        dst = next;
+        head->nb_segs_++;
+      }
+
+      uint16_t n = std::min<uint16_t>(seg->data_len_ - copied, dst->tailroom());
+
+      // Not sloppy: the copy may end right at the end of the buffer
+      bess::utils::Copy(dst->head_data<char *>() + dst->data_len_,
+                        seg->head_data<const char *>() + copied, n);
+      dst->data_len_ += n;
+      head->pkt_len_ += n;
+      copied += n;
+    }
+  }
+
+  return head;
+}
+
+Packet *Packet::Share(Packet *src, uint16_t private_len) {
+  if (unlikely(!src->is_simple()) || src->pkt_len_ <= private_len) {
+    return copy(src);
+  }
+
+  Packet *head = __packet_alloc_pool(src->pool_);
+  if (!head) {
+    return nullptr;
+  }
+
+  // The private bytes do not fit in a buffer of the pool (e.g., a small
+  // named pool, or "src" has headers prepended into its headroom)
+  if (unlikely(private_len > head->tailroom())) {
+    Free(head);
+    return CopyChain(src);
+  }
+
+  Packet *body = __packet_alloc_pool(src->pool_);
+  if (!body) {
+    Free(head);
+    return nullptr;
+  }
+
+  bess::utils::CopyInlined(head->append(private_len), src->head_data(),
+                           private_len, true);
+
+  // Takes a reference to the buffer of "src"
+  rte_pktmbuf_attach(&body->mbuf_, &src->mbuf_);
+  rte_pktmbuf_adj(&body->mbuf_, private_len);
+
+  head->next_ = body;
+  head->nb_segs_ = 2;
+  head->pkt_len_ = src->pkt_len_;
+
+  return head;
+}
+
 Packet *Packet::from_paddr(phys_addr_t paddr) {
   for (int i = 0; i < RTE_MAX_NUMA_NODES; i++) {
     struct rte_mempool *pool;
@@ -42,7 +42,10 @@
 
 #include "mem_alloc.h"
 #include "metadata.h"
+#include "packet_cache.h"
+#include "packet_pool.h"
 #include "snbuf_layout.h"
+#include "utils/copy.h"
 #include "worker.h"
 
 /* NOTE: NEVER use rte_pktmbuf_*() directly,
@@ -55,8 +58,8 @@ static_assert(SNBUF_HEADROOM == RTE_PKTMBUF_HEADROOM,
 static_assert(SNBUF_IMMUTABLE_OFF == 128,
               "Packet immbutable offset must be 128");
 static_assert(SNBUF_METADATA_OFF == 192, "Packet metadata offset must by 192");
-static_assert(SNBUF_SCRATCHPAD_OFF == 320,
-              "Packet scratchpad offset must be 320");
+static_assert(SNBUF_SCRATCHPAD_OFF == 192 + SNBUF_METADATA,
+              "Packet scratchpad must follow the metadata");
 
 namespace bess {
 
@@ -66,13 +69,70 @@ static inline Packet *__packet_alloc_pool(struct rte_mempool *pool) {
   struct rte_mbuf *mbuf;
 
   mbuf = rte_pktmbuf_alloc(pool);
+  if (unlikely(!mbuf)) {
+    __packet_pool_alloc_failed(pool);
+  }
 
   return reinterpret_cast<Packet *>(mbuf);
 }
 
 static inline Packet *__packet_alloc() {
-  return reinterpret_cast<Packet *>(
-      rte_pktmbuf_alloc(current_worker.pframe_pool()));
+  PacketCache *cache = current_worker.packet_cache();
+
+  if (cache) {
+    Packet *pkt;
+    if (!cache->Alloc(&pkt, 1)) {
+      __packet_pool_alloc_failed(cache->pool());
+      return nullptr;
+    }
+
+    // as done by rte_pktmbuf_alloc()
+    struct rte_mbuf *mbuf = reinterpret_cast<struct rte_mbuf *>(pkt);
+    rte_mbuf_refcnt_set(mbuf, 1);
+    rte_pktmbuf_reset(mbuf);
+    return pkt;
+  }
+
+  return __packet_alloc_pool(current_worker.pframe_pool());
+}
+
+// Gets cnt (uninitialized) buffers from 'pool', or from the worker's default
+// pool if nullptr. The worker's packet cache is used if it caches that pool.
+// All or nothing.
+static inline bool __packet_get_bulk(Packet **pkts, size_t cnt,
+                                     struct rte_mempool *pool = nullptr) {
+  PacketCache *cache = current_worker.packet_cache();
+
+  if (cache && (!pool || pool == cache->pool())) {
+    if (likely(cache->Alloc(pkts, cnt))) {
+      return true;
+    }
+    __packet_pool_alloc_failed(cache->pool());
+    return false;
+  }
+
+  if (!pool) {
+    pool = current_worker.pframe_pool();
+  }
+
+  if (likely(rte_mempool_get_bulk(pool, reinterpret_cast<void **>(pkts),
+                                  cnt) == 0)) {
+    return true;
+  }
+  __packet_pool_alloc_failed(pool);
+  return false;
+}
+
+// Returns cnt simple buffers (refcnt 1, single segment) of 'pool'
+static inline void __packet_put_bulk(struct rte_mempool *pool, Packet **pkts,
+                                     size_t cnt) {
+  PacketCache *cache = current_worker.packet_cache();
+
+  if (cache && cache->pool() == pool) {
+    cache->Free(pkts, cnt);
+  } else {
+    rte_mempool_put_bulk(pool, reinterpret_cast<void **>(pkts), cnt);
+  }
 }
 
 struct rte_mempool *get_pframe_pool_socket(int socket);
@@ -157,6 +217,48 @@ class alignas(64) Packet {
   Packet *next() const { return next_; }
   void set_next(Packet *next) { next_ = next; }
 
+  // Range over the segments of a (possibly chained) packet, e.g.,
+  //   for (bess::Packet *seg : pkt->segments()) { ... seg->head_len() ... }
+  class SegmentRange {
+   public:
+    class iterator {
+     public:
+      explicit iterator(Packet *seg) : seg_(seg) {}
+
+      Packet *operator*() const { return seg_; }
+
+      iterator &operator++() {
+        seg_ = seg_->next();
+        return *this;
+      }
+
+      bool operator!=(const iterator &other) const {
+        return seg_ != other.seg_;
+      }
+
+     private:
+      Packet *seg_;
+    };
+
+    explicit SegmentRange(Packet *head) : head_(head) {}
+
+    iterator begin() const { return iterator(head_); }
+    iterator end() const { return iterator(nullptr); }
+
+   private:
+    Packet *head_;
+  };
+
+  SegmentRange segments() { return SegmentRange(this); }
+
+  Packet *last_segment() {
+    Packet *seg = this;
+    while (seg->next_) {
+      seg = seg->next_;
+    }
+    return seg;
+  }
+
   uint16_t data_off() { return data_off_; }
   void set_data_off(uint16_t offset) { data_off_ = offset; }
 
@@ -168,6 +270,25 @@ class alignas(64) Packet {
   int total_len() const { return pkt_len_; }
   void set_total_len(uint32_t len) { pkt_len_ = len; }
 
+  uint64_t ol_flags() const { return mbuf_.ol_flags; }
+  void set_ol_flags(uint64_t flags) { mbuf_.ol_flags = flags; }
+
+  // The RSS hash computed by the NIC on reception, if has_rss_hash()
+  bool has_rss_hash() const { return mbuf_.ol_flags & PKT_RX_RSS_HASH; }
+  uint32_t rss_hash() const { return mbuf_.hash.rss; }
+
+  // Asks the NIC to do the work specified by "flags" (PKT_TX_*) on
+  // transmission, e.g., PKT_TX_IPV4 | PKT_TX_IP_CKSUM. Header lengths are in
+  // bytes. The output port must have the corresponding TX offload enabled.
+  void request_tx_offload(uint64_t flags, uint16_t l2_len, uint16_t l3_len,
+                          uint16_t l4_len = 0, uint16_t tso_segsz = 0) {
+    mbuf_.ol_flags |= flags;
+    mbuf_.l2_len = l2_len;
+    mbuf_.l3_len = l3_len;
+    mbuf_.l4_len = l4_len;
+    mbuf_.tso_segsz = tso_segsz;
+  }
+
   uint16_t refcnt() const { return rte_mbuf_refcnt_read(&as_rte_mbuf()); }
 
   void set_refcnt(uint16_t cnt) { rte_mbuf_refcnt_set(&as_rte_mbuf(), cnt); }
@@ -189,6 +310,28 @@ class alignas(64) Packet {
     return is_linear() && RTE_MBUF_DIRECT(&as_rte_mbuf());
   }
 
+  // Is the head segment (its data and headroom) not shared with any other
+  // packet, so that it can be modified in place?
+  bool is_head_private() const {
+    return RTE_MBUF_DIRECT(&as_rte_mbuf()) && refcnt() == 1;
+  }
+
+  // Makes the first "len" bytes of the packet (all of it, if shorter)
+  // contiguous and private to this packet, copying them out of buffers
+  // shared with other packets (see Share()) if necessary. The headroom is
+  // made private as well, so that prepend() is safe afterwards. Modules must
+  // call this before modifying packet data in place.
+  // Returns head_data(), or nullptr if memory allocation failed or the head
+  // segment itself is referenced by other packets. Pointers into the packet
+  // data obtained before the call may be invalidated.
+  template <typename T = void *>
+  T make_writable(uint16_t len) {
+    if (likely(len <= data_len_ && is_head_private())) {
+      return head_data<T>();
+    }
+    return reinterpret_cast<T>(MakeWritable(len));
+  }
+
   void reset() { rte_pktmbuf_reset(&as_rte_mbuf()); }
 
   void *prepend(uint16_t len) {
@@ -202,9 +345,39 @@ class alignas(64) Packet {
     return head_data();
   }
 
+  // Makes sure that the first "len" bytes of the packet are contiguous in the
+  // first segment, moving data from the following segments if necessary.
+  // Returns head_data(), or nullptr if the packet is shorter than "len" or
+  // the first segment cannot be extended (e.g., its buffer is shared).
+  template <typename T = void *>
+  T pull_head(uint16_t len) {
+    if (likely(len <= data_len_)) {
+      return head_data<T>();
+    }
+    return reinterpret_cast<T>(PullHead(len));
+  }
+
+  // Returns a pointer to "len" bytes at "offset". If the bytes span multiple
+  // segments, they are copied into "buf" (at least "len" bytes long) first.
+  // Returns nullptr if the packet is shorter than "offset + len".
+  template <typename T = const void *>
+  T read(uint32_t offset, uint32_t len, void *buf) const {
+    return reinterpret_cast<T>(
+        rte_pktmbuf_read(&as_rte_mbuf(), offset, len, buf));
+  }
+
+  // Copies "len" bytes at "offset" into "dst", gathering them from multiple
+  // segments if necessary. Returns false if the packet is too short.
+  bool CopyOut(void *dst, uint32_t offset, uint32_t len) const;
+
+  // Returns 32-bit one's complement sum of "len" bytes at "offset", which may
+  // span multiple segments (see bess::utils::CalculateSum())
+  uint32_t CalculateSum(uint32_t offset, uint32_t len) const;
+
   // remove bytes from the beginning
   void *adj(uint16_t len) {
-    if (unlikely(data_len_ < len))
+    // The bytes to remove span multiple segments
+    if (unlikely(data_len_ < len) && !PullHead(len))
       return nullptr;
 
     data_off_ += len;
@@ -229,7 +402,9 @@ class alignas(64) Packet {
   static Packet *copy(const Packet *src) {
     Packet *dst;
 
-    DCHECK(src->is_linear());
+    if (unlikely(!src->is_linear())) {
+      return CopyChain(src);
+    }
 
     dst = __packet_alloc_pool(src->pool_);
     if (!dst) {
@@ -242,6 +417,17 @@ class alignas(64) Packet {
     return dst;
   }
 
+  // Returns a zero-copy replica of "src" (nullptr if allocation failed).
+  // The first "private_len" bytes (and the headroom) are copied into a new
+  // head segment of its own, and the rest of the data is shared with "src"
+  // through an indirect segment. Headers within the private region can be
+  // rewritten or prepended to freely; to write beyond it, make_writable() the
+  // bytes first, which copies them into the head segment (copy-on-write).
+  // Falls back to copy() if "src" is not simple or not longer than
+  // "private_len", or to a chained copy if "private_len" does not fit in a
+  // buffer of the pool of "src".
+  static Packet *Share(Packet *src, uint16_t private_len);
+
   phys_addr_t dma_addr() { return buf_physaddr_ + data_off_; }
 
   std::string Dump();
@@ -254,11 +440,32 @@ class alignas(64) Packet {
 
   static Packet *Alloc() { return __packet_alloc(); }
 
-  // cnt must be [0, PacketBatch::kMaxBurst]
-  static inline size_t Alloc(Packet **pkts, size_t cnt, uint16_t len);
+  // Allocates from 'pool' (see PacketPool::mempool()) instead of the default
+  static Packet *Alloc(struct rte_mempool *pool) {
+    return __packet_alloc_pool(pool);
+  }
+
+  // cnt must be [0, PacketBatch::kMaxBurst].
+  // If 'pool' is nullptr, packets are allocated from the default pool.
+  static inline size_t Alloc(Packet **pkts, size_t cnt, uint16_t len,
+                             struct rte_mempool *pool = nullptr);
+
+  // Same as above, but also fills in the data of each packet with the first
+  // 'len' bytes of 'templ', in the same pass. 'templ' must be readable up to
+  // 'len' rounded up to 32 bytes (see bess::utils::Copy()).
+  static inline size_t Alloc(Packet **pkts, size_t cnt, const void *templ,
+                             uint16_t len, struct rte_mempool *pool = nullptr);
 
   // pkt may be nullptr
   static void Free(Packet *pkt) {
+    PacketCache *cache = current_worker.packet_cache();
+
+    if (cache && pkt && pkt->pool_ == cache->pool() && pkt->is_simple() &&
+        pkt->refcnt() == 1) {
+      cache->Free(&pkt, 1);
+      return;
+    }
+
     rte_pktmbuf_free(reinterpret_cast<struct rte_mbuf *>(pkt));
   }
 
@@ -270,6 +477,19 @@ class alignas(64) Packet {
   static void Free(PacketBatch *batch) { Free(batch->pkts(), batch->cnt()); }
 
  private:
+  // Initializes a freshly allocated buffer. See Alloc() for details.
+  static inline void Rearm(Packet *pkt, __m128i rearm, __m128i rxdesc);
+
+  // Slow path of pull_head()
+  void *PullHead(uint16_t len);
+
+  // Slow path of make_writable()
+  void *MakeWritable(uint16_t len);
+
+  // Slow path of copy() for multi-segment packets. The data is packed into
+  // as few (full) segments as possible, without linearizing the packet.
+  static Packet *CopyChain(const Packet *src);
+
   union {
     struct {
       // offset 0: Virtual address of segment buffer.
@@ -389,29 +609,100 @@ class alignas(64) Packet {
 static_assert(std::is_standard_layout<Packet>::value, "Incorrect class Packet");
 static_assert(sizeof(Packet) == SNBUF_SIZE, "Incorrect class Packet");
 
-#if __AVX__
-#include "packet_avx.h"
-#else
-inline size_t Packet::Alloc(Packet **pkts, size_t cnt, uint16_t len) {
+// We must make sure that the following 12 fields are initialized
+// as done in rte_pktmbuf_reset(). We group them into two 16-byte stores.
+//
+// - 1st store: mbuf.rearm_data
+//   2B data_off == RTE_PKTMBUF_HEADROOM (SNBUF_HEADROOM)
+//   2B refcnt == 1
+//   2B nb_segs == 1
+//   2B port == 0xffff (as of 17.05 0xff is set, but 0xffff makes more sense)
+//   8B ol_flags == 0
+//
+// - 2nd store: mbuf.rx_descriptor_fields1
+//   4B packet_type == 0
+//   4B pkt_len == len
+//   2B data_len == len
+//   2B vlan_tci == 0
+//   4B (rss == 0)       (not initialized by rte_pktmbuf_reset)
+//
+// We can ignore these fields:
+//   vlan_tci_outer == 0 (not required if ol_flags == 0)
+//   tx_offload == 0     (not required if ol_flags == 0)
+//   next == nullptr     (all packets in a mempool must already be nullptr)
+inline void Packet::Rearm(Packet *pkt, __m128i rearm, __m128i rxdesc) {
+  _mm_store_si128(&pkt->rearm_data_, rearm);
+  _mm_store_si128(&pkt->rx_descriptor_fields1_, rxdesc);
+
+  DCHECK_EQ(pkt->mbuf_.data_off, RTE_PKTMBUF_HEADROOM);
+  DCHECK_EQ(pkt->mbuf_.refcnt, 1);
+  DCHECK_EQ(pkt->mbuf_.nb_segs, 1);
+  DCHECK_EQ(pkt->mbuf_.port, 0xffff);
+  DCHECK_EQ(pkt->mbuf_.ol_flags, 0);
+
+  DCHECK_EQ(pkt->mbuf_.packet_type, 0);
+  DCHECK_EQ(pkt->mbuf_.pkt_len, pkt->mbuf_.data_len);
+  DCHECK_EQ(pkt->mbuf_.vlan_tci, 0);
+}
+
+inline size_t Packet::Alloc(Packet **pkts, size_t cnt, uint16_t len,
+                            struct rte_mempool *pool) {
+  DCHECK_LE(cnt, PacketBatch::kMaxBurst);
+
+  // all (cnt) or nothing (0)
+  if (!__packet_get_bulk(pkts, cnt, pool)) {
+    return 0;
+  }
+
+  const __m128i rearm =
+      _mm_setr_epi16(SNBUF_HEADROOM, 1, 1, 0xffff, 0, 0, 0, 0);
+  const __m128i rxdesc = _mm_setr_epi32(0, len, len, 0);
+
+  size_t i;
+
+  /* 4 at a time didn't help */
+  for (i = 0; i < (cnt & (~0x1)); i += 2) {
+    /* since the data is likely to be in the store buffer
+     * as 64-bit writes, 128-bit read will cause stalls */
+    Rearm(pkts[i], rearm, rxdesc);
+    Rearm(pkts[i + 1], rearm, rxdesc);
+  }
+
+  if (cnt & 0x1) {
+    Rearm(pkts[i], rearm, rxdesc);
+  }
+
+  return cnt;
+}
+
+inline size_t Packet::Alloc(Packet **pkts, size_t cnt, const void *templ,
+                            uint16_t len, struct rte_mempool *pool) {
   DCHECK_LE(cnt, PacketBatch::kMaxBurst);
 
-  // rte_mempool_get_bulk() is all (cnt) or nothing (0)
-  if (rte_mempool_get_bulk(current_worker.pframe_pool(),
-                           reinterpret_cast<void **>(pkts), cnt) < 0) {
+  if (!__packet_get_bulk(pkts, cnt, pool)) {
     return 0;
   }
 
+  const __m128i rearm =
+      _mm_setr_epi16(SNBUF_HEADROOM, 1, 1, 0xffff, 0, 0, 0, 0);
+  const __m128i rxdesc = _mm_setr_epi32(0, len, len, 0);
+
   for (size_t i = 0; i < cnt; i++) {
     Packet *pkt = pkts[i];
 
-    pkt->set_refcnt(1);
-    pkt->reset();
-    pkt->pkt_len_ = pkt->data_len_ = len;
+    Rearm(pkt, rearm, rxdesc);
+
+    // Buffers from a mempool are direct, so the data starts at data_.
+    // Sloppy copy is fine, as buffers are padded to a multiple of 64 bytes.
+    bess::utils::CopyInlined(pkt->data_, templ, len, true);
   }
 
   return cnt;
 }
 
+#if __AVX__
+#include "packet_avx.h"
+#else
 inline void Packet::Free(Packet **pkts, size_t cnt) {
   DCHECK_LE(cnt, PacketBatch::kMaxBurst);
 
@@ -433,7 +724,7 @@ inline void Packet::Free(Packet **pkts, size_t cnt) {
 
   /* NOTE: it seems that zeroing the refcnt of mbufs is not necessary.
    *   (allocators will reset them) */
-  rte_mempool_put_bulk(pool, reinterpret_cast<void **>(pkts), cnt);
+  __packet_put_bulk(pool, pkts, cnt);
   return;
 
 slow_path:
@@ -0,0 +1,127 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "packet.h"
+
+#include <unistd.h>
+
+#include <benchmark/benchmark.h>
+#include <glog/logging.h>
+
+#include "dpdk.h"
+
+using bess::Packet;
+using bess::PacketBatch;
+using bess::PacketPool;
+
+namespace {
+
+struct rte_mempool *pool;
+
+// A minimal Ethernet + IPv4 + TCP header, padded up to the largest size used
+unsigned char templ[2048] = {
+    // Ethernet
+    0x02, 0x00, 0x00, 0x00, 0x00, 0x02, 0x02, 0x00, 0x00, 0x00, 0x00, 0x01,
+    0x08, 0x00,
+    // IPv4
+    0x45, 0x00, 0x00, 0x28, 0x00, 0x00, 0x00, 0x00, 0x40, 0x06, 0x00, 0x00,
+    0x0a, 0x00, 0x00, 0x01, 0x0a, 0x00, 0x00, 0x02,
+    // TCP
+    0x04, 0xd2, 0x00, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x50, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+}  // namespace
+
+// Per-packet allocation followed by a copy of the template, which is what
+// packet generators used to do.
+static void BM_AllocCopy(benchmark::State &state) {
+  const uint16_t len = state.range(0);
+  Packet *pkts[PacketBatch::kMaxBurst];
+
+  while (state.KeepRunning()) {
+    for (size_t i = 0; i < PacketBatch::kMaxBurst; i++) {
+      Packet *pkt = Packet::Alloc(pool);
+      pkt->set_data_len(len);
+      pkt->set_total_len(len);
+      bess::utils::Copy(pkt->head_data(), templ, len, true);
+      pkts[i] = pkt;
+    }
+    Packet::Free(pkts, PacketBatch::kMaxBurst);
+  }
+
+  state.SetItemsProcessed(state.iterations() * PacketBatch::kMaxBurst);
+}
+
+static void BM_AllocBulk(benchmark::State &state) {
+  const uint16_t len = state.range(0);
+  Packet *pkts[PacketBatch::kMaxBurst];
+
+  while (state.KeepRunning()) {
+    size_t cnt = Packet::Alloc(pkts, PacketBatch::kMaxBurst, len, pool);
+    CHECK_EQ(cnt, PacketBatch::kMaxBurst);
+    Packet::Free(pkts, cnt);
+  }
+
+  state.SetItemsProcessed(state.iterations() * PacketBatch::kMaxBurst);
+}
+
+static void BM_AllocBulkTemplate(benchmark::State &state) {
+  const uint16_t len = state.range(0);
+  Packet *pkts[PacketBatch::kMaxBurst];
+
+  while (state.KeepRunning()) {
+    size_t cnt = Packet::Alloc(pkts, PacketBatch::kMaxBurst, templ, len, pool);
+    CHECK_EQ(cnt, PacketBatch::kMaxBurst);
+    Packet::Free(pkts, cnt);
+  }
+
+  state.SetItemsProcessed(state.iterations() * PacketBatch::kMaxBurst);
+}
+
+BENCHMARK(BM_AllocCopy)->Arg(60)->Arg(512)->Arg(1514);
+BENCHMARK(BM_AllocBulk)->Arg(60)->Arg(512)->Arg(1514);
+BENCHMARK(BM_AllocBulkTemplate)->Arg(60)->Arg(512)->Arg(1514);
+
+int main(int argc, char **argv) {
+  if (geteuid() != 0) {
+    LOG(INFO) << "This benchmark requires root privileges. Skipping...";
+    return 0;
+  }
+
+  init_dpdk(argv[0], 1024, 0, true);
+  pool = PacketPool::CreateMempool("packet_bench", SNBUF_DATA, 4096,
+                                   SOCKET_ID_ANY);
+  CHECK(pool);
+
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
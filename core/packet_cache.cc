@@ -0,0 +1,208 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "packet_cache.h"
+
+#include <glog/logging.h>
+#include <rte_mbuf.h>
+
+#include <algorithm>
+#include <atomic>
+
+#include "mem_alloc.h"
+#include "worker.h"
+
+namespace bess {
+
+const size_t PacketCache::kMaxDepth;
+const size_t PacketCache::kDefaultDepth;
+const size_t PacketCache::kMinDepth;
+const size_t PacketCache::kRefillSize;
+
+// Never freed, so that other workers may safely push into the return ring of
+// a worker that is going away. Buffers pushed after Detach() are picked up
+// when the worker ID is reused.
+static std::atomic<PacketCache *> caches[Worker::kMaxWorkers];
+
+// Per socket, the ID of a worker that recently had to refill from the mempool
+// (-1 if none). Overflowing workers hand their surplus to it.
+static std::atomic<int> hungry[RTE_MAX_NUMA_NODES];
+
+static const int kNoWorker = -1;
+
+static bool init_hungry() {
+  for (auto &h : hungry) {
+    h = kNoWorker;
+  }
+  return true;
+}
+static const bool _hungry_dummy[[maybe_unused]] = init_hungry();
+
+PacketCache *PacketCache::Attach(int wid, int socket,
+                                 struct rte_mempool *pool, size_t depth) {
+  CHECK(wid >= 0 && wid < Worker::kMaxWorkers);
+  CHECK(socket >= 0 && socket < RTE_MAX_NUMA_NODES);
+
+  if (depth == 0) {
+    return nullptr;
+  }
+
+  PacketCache *c = caches[wid].load(std::memory_order_relaxed);
+  if (!c) {
+    c = new PacketCache();
+
+    c->stack_ = static_cast<Packet **>(
+        mem_alloc_ex(sizeof(Packet *) * kMaxDepth, alignof(Packet *), socket));
+    // Large enough for a full cache of every other worker
+    int slots = align_ceil_pow2(kMaxDepth * 2);
+    c->returns_ = static_cast<struct llring *>(mem_alloc_ex(
+        llring_bytes_with_slots(slots), alignof(struct llring), socket));
+    CHECK(c->stack_ && c->returns_);
+    CHECK_EQ(llring_init(c->returns_, slots, /* sp= */ 0, /* sc= */ 1), 0);
+
+    caches[wid].store(c, std::memory_order_release);
+  } else {
+    // Strays that arrived after Detach(). They may be from another pool.
+    void *pkt;
+    while (llring_sc_dequeue(c->returns_, &pkt) == 0) {
+      rte_mempool_put(static_cast<struct rte_mbuf *>(pkt)->pool, pkt);
+    }
+  }
+
+  c->wid_ = wid;
+  c->socket_ = socket;
+  c->depth_ = std::min(std::max(depth, kMinDepth), kMaxDepth);
+  c->cnt_ = 0;
+  c->stats_ = {};
+  c->pool_.store(pool, std::memory_order_release);
+
+  return c;
+}
+
+void PacketCache::Detach(int wid) {
+  PacketCache *c = caches[wid].load(std::memory_order_relaxed);
+  if (!c || !c->pool()) {
+    return;
+  }
+
+  struct rte_mempool *pool = c->pool();
+
+  int expected = wid;
+  hungry[c->socket_].compare_exchange_strong(expected, kNoWorker);
+
+  if (c->cnt_) {
+    rte_mempool_put_bulk(pool, reinterpret_cast<void **>(c->stack_), c->cnt_);
+    c->cnt_ = 0;
+  }
+
+  void *pkts[kRefillSize];
+  unsigned n;
+  while ((n = llring_sc_dequeue_burst(c->returns_, pkts, kRefillSize)) > 0) {
+    rte_mempool_put_bulk(pool, pkts, n);
+  }
+
+  c->pool_.store(nullptr, std::memory_order_release);
+}
+
+const PacketCache *PacketCache::ForWorker(int wid) {
+  const PacketCache *c = caches[wid].load(std::memory_order_acquire);
+  return (c && c->pool_.load(std::memory_order_acquire)) ? c : nullptr;
+}
+
+bool PacketCache::Refill(size_t cnt) {
+  // First, what other workers gave us
+  unsigned n = llring_sc_dequeue_burst(
+      returns_, reinterpret_cast<void **>(&stack_[cnt_]), depth_ - cnt_);
+  cnt_ += n;
+  stats_.remote_in += n;
+
+  if (cnt_ < cnt) {
+    hungry[socket_].store(wid_, std::memory_order_relaxed);
+
+    // Then the mempool, in chunks to amortize its cost
+    size_t want = std::min(std::max(cnt - cnt_, kRefillSize), depth_ - cnt_);
+    void **dst = reinterpret_cast<void **>(&stack_[cnt_]);
+    if (rte_mempool_get_bulk(pool(), dst, want) < 0) {
+      // The pool is running low. Take just what we need.
+      want = cnt - cnt_;
+      if (rte_mempool_get_bulk(pool(), dst, want) < 0) {
+        return false;
+      }
+    }
+    cnt_ += want;
+    stats_.mempool_gets++;
+  }
+
+  stats_.misses += cnt;
+  return true;
+}
+
+void PacketCache::Flush(size_t incoming) {
+  // We have a surplus, so stop asking for more
+  int expected = wid_;
+  hungry[socket_].compare_exchange_strong(expected, kNoWorker,
+                                          std::memory_order_relaxed);
+
+  // Keep the hottest half
+  Evict(cnt_ + incoming - depth_ / 2);
+}
+
+void PacketCache::Evict(size_t n) {
+  void **cold = reinterpret_cast<void **>(stack_);
+  int target = hungry[socket_].load(std::memory_order_relaxed);
+  bool given = false;
+
+  if (target != kNoWorker && target != wid_) {
+    // The target may be attaching or detaching concurrently
+    PacketCache *c = caches[target].load(std::memory_order_acquire);
+    if (c && c->pool_.load(std::memory_order_acquire) == pool()) {
+      // Either all or none are enqueued
+      given = llring_mp_enqueue_bulk(c->returns_, cold, n) !=
+              -LLRING_ERR_NOBUF;
+      if (!given) {
+        // Full. It evidently does not need more.
+        hungry[socket_].compare_exchange_strong(target, kNoWorker,
+                                                std::memory_order_relaxed);
+      }
+    }
+  }
+
+  if (given) {
+    stats_.remote_out += n;
+  } else {
+    rte_mempool_put_bulk(pool(), cold, n);
+    stats_.mempool_puts++;
+  }
+
+  cnt_ -= n;
+  memmove(stack_, stack_ + n, cnt_ * sizeof(Packet *));
+}
+
+}  // namespace bess
@@ -0,0 +1,168 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_PACKET_CACHE_H_
+#define BESS_PACKET_CACHE_H_
+
+#include <rte_config.h>
+#include <rte_mempool.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#include "kmod/llring.h"
+#include "utils/common.h"
+
+namespace bess {
+
+class Packet;
+
+// A per-worker free list of packet buffers in front of the mempool.
+//
+// Buffers are recycled LIFO, so an allocation gets the most recently freed
+// (and most likely cache-resident) buffers first. Unlike the DPDK per-lcore
+// mempool cache, it works for any worker thread regardless of its lcore ID.
+//
+// Workers that free more than they allocate (e.g., the TX side of a pipeline
+// split by a Queue) would otherwise keep flushing to the mempool while the
+// allocating worker keeps refilling from it. Instead, a worker that runs dry
+// advertises itself, and overflowing workers on the same socket hand their
+// surplus to it in batches through its multi-producer return ring.
+//
+// Alloc()/Free() must only be called by the owning worker.
+class PacketCache {
+ public:
+  static const size_t kMaxDepth = 4096;
+  static const size_t kDefaultDepth = 512;
+  static const size_t kMinDepth = 64;
+
+  // Buffers are taken from the mempool in chunks of (at least) this many
+  static const size_t kRefillSize = 64;
+
+  struct Stats {
+    uint64_t hits;          // buffers allocated directly from the cache
+    uint64_t misses;        // buffers allocated after a refill
+    uint64_t mempool_gets;  // bulk gets from the mempool
+    uint64_t mempool_puts;  // bulk puts to the mempool
+    uint64_t remote_in;     // buffers received from other workers
+    uint64_t remote_out;    // buffers handed over to other workers
+  };
+
+  // Sets up the cache of worker 'wid' for buffers of 'pool' (on 'socket'),
+  // holding up to 'depth' buffers. Returns nullptr if depth is 0.
+  static PacketCache *Attach(int wid, int socket, struct rte_mempool *pool,
+                             size_t depth);
+
+  // Returns all buffers held by the cache of 'wid' to the mempool
+  static void Detach(int wid);
+
+  // Returns the cache of worker 'wid', or nullptr if it has none
+  static const PacketCache *ForWorker(int wid);
+
+  // All (returns true) or nothing (false). The buffers are not initialized.
+  // cnt must be [1, PacketBatch::kMaxBurst]
+  inline bool Alloc(Packet **pkts, size_t cnt) {
+    if (likely(cnt_ >= cnt)) {
+      stats_.hits += cnt;
+    } else if (!Refill(cnt)) {
+      return false;
+    }
+
+    // The top of the stack holds the most recently freed buffers
+    Packet **top = &stack_[cnt_ - cnt];
+    for (size_t i = 0; i < cnt; i++) {
+      pkts[i] = top[cnt - i - 1];
+    }
+    cnt_ -= cnt;
+    return true;
+  }
+
+  // Packets must come from pool(), be single-segment, and have refcnt 1.
+  // cnt must be [1, PacketBatch::kMaxBurst]
+  inline void Free(Packet **pkts, size_t cnt) {
+    if (unlikely(cnt_ + cnt > depth_)) {
+      Flush(cnt);
+    }
+
+    memcpy(&stack_[cnt_], pkts, cnt * sizeof(Packet *));
+    cnt_ += cnt;
+  }
+
+  // Only the owner worker may read it without synchronization
+  struct rte_mempool *pool() const {
+    return pool_.load(std::memory_order_relaxed);
+  }
+  size_t depth() const { return depth_; }
+  size_t cnt() const { return cnt_; }
+  const Stats &stats() const { return stats_; }
+
+ private:
+  PacketCache()
+      : wid_(-1),
+        socket_(-1),
+        pool_(nullptr),
+        depth_(),
+        cnt_(),
+        stack_(),
+        returns_(),
+        stats_() {}
+
+  // Slow path of Alloc(): gets at least 'cnt' buffers in total into the cache
+  bool Refill(size_t cnt);
+
+  // Slow path of Free(): evicts the coldest buffers to make room for
+  // 'incoming' more
+  void Flush(size_t incoming);
+
+  // Gives away the 'n' buffers at the bottom of the stack
+  void Evict(size_t n);
+
+  int wid_;
+  int socket_;
+
+  // Also read by other workers, in Evict(). nullptr while detached.
+  std::atomic<struct rte_mempool *> pool_;
+
+  size_t depth_;
+  size_t cnt_;
+  Packet **stack_;  // [kMaxDepth]
+
+  // Buffers returned by other workers (multi-producer, single consumer)
+  struct llring *returns_;
+
+  Stats stats_;
+
+  DISALLOW_COPY_AND_ASSIGN(PacketCache);
+};
+
+}  // namespace bess
+
+#endif  // BESS_PACKET_CACHE_H_
@@ -0,0 +1,198 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "packet_cache.h"
+
+#include <gtest/gtest.h>
+
+#include <set>
+
+#include "dpdk.h"
+#include "packet.h"
+
+namespace bess {
+namespace {
+
+class PacketCacheTest : public ::testing::Test {
+ protected:
+  static const unsigned kPoolSize = 1023;
+
+  virtual void SetUp() {
+    pool_ = nullptr;
+
+    if (!dpdk_inited_) {
+      if (geteuid() == 0) {
+        init_dpdk("packet_cache_test", 1024, 0, true);
+        dpdk_inited_ = true;
+      } else {
+        LOG(INFO) << "This test requires root privileges. Skipping...";
+        return;
+      }
+    }
+
+    // The cache only moves pointers around, so plain objects will do
+    pool_ = rte_mempool_create("packet_cache_test", kPoolSize, 64, 0, 0,
+                               nullptr, nullptr, nullptr, nullptr, 0, 0);
+    ASSERT_NE(nullptr, pool_);
+  }
+
+  virtual void TearDown() {
+    if (pool_) {
+      PacketCache::Detach(0);
+      PacketCache::Detach(1);
+      EXPECT_EQ(kPoolSize, rte_mempool_avail_count(pool_));
+      rte_mempool_free(pool_);
+    }
+  }
+
+  struct rte_mempool *pool_;
+
+  static bool dpdk_inited_;
+};
+
+bool PacketCacheTest::dpdk_inited_ = false;
+
+TEST_F(PacketCacheTest, Lifo) {
+  if (!pool_) {
+    return;
+  }
+
+  PacketCache *c = PacketCache::Attach(0, 0, pool_, 128);
+  ASSERT_NE(nullptr, c);
+  EXPECT_EQ(c, PacketCache::ForWorker(0));
+
+  Packet *pkts[4];
+  ASSERT_TRUE(c->Alloc(pkts, 4));
+  EXPECT_EQ(4, c->stats().misses);
+  EXPECT_EQ(1, c->stats().mempool_gets);
+
+  c->Free(pkts, 4);
+
+  // The last one freed comes back first
+  Packet *pkt;
+  ASSERT_TRUE(c->Alloc(&pkt, 1));
+  EXPECT_EQ(pkts[3], pkt);
+  EXPECT_EQ(1, c->stats().hits);
+  EXPECT_EQ(1, c->stats().mempool_gets);
+
+  c->Free(&pkt, 1);
+}
+
+TEST_F(PacketCacheTest, Overflow) {
+  if (!pool_) {
+    return;
+  }
+
+  PacketCache *c = PacketCache::Attach(0, 0, pool_, 64);
+  ASSERT_NE(nullptr, c);
+
+  Packet *pkts[128];
+  for (int i = 0; i < 128; i += 32) {
+    ASSERT_TRUE(rte_mempool_get_bulk(pool_, reinterpret_cast<void **>(pkts + i),
+                                     32) == 0);
+  }
+
+  for (int i = 0; i < 128; i += 32) {
+    c->Free(pkts + i, 32);
+    EXPECT_LE(c->cnt(), c->depth());
+  }
+
+  EXPECT_GT(c->stats().mempool_puts, 0);
+  // The most recently freed buffers are kept
+  Packet *pkt;
+  ASSERT_TRUE(c->Alloc(&pkt, 1));
+  EXPECT_EQ(pkts[127], pkt);
+  c->Free(&pkt, 1);
+}
+
+TEST_F(PacketCacheTest, RemoteReturn) {
+  if (!pool_) {
+    return;
+  }
+
+  PacketCache *producer = PacketCache::Attach(0, 0, pool_, 64);
+  PacketCache *consumer = PacketCache::Attach(1, 0, pool_, 64);
+  ASSERT_NE(nullptr, producer);
+  ASSERT_NE(nullptr, consumer);
+
+  // The consumer runs dry and refills from the mempool
+  Packet *pkts[32];
+  ASSERT_TRUE(consumer->Alloc(pkts, 32));
+  EXPECT_EQ(1, consumer->stats().mempool_gets);
+
+  // Packets freed by the producer beyond its depth go to the consumer
+  std::set<Packet *> freed;
+  for (int i = 0; i < 3; i++) {
+    Packet *batch[32];
+    ASSERT_TRUE(rte_mempool_get_bulk(
+                    pool_, reinterpret_cast<void **>(batch), 32) == 0);
+    freed.insert(batch, batch + 32);
+    producer->Free(batch, 32);
+  }
+  EXPECT_GT(producer->stats().remote_out, 0);
+  EXPECT_EQ(0, producer->stats().mempool_puts);
+
+  // ... who picks them up before going to the mempool again
+  consumer->Free(pkts, 32);
+  Packet *a[32], *b[32], *c[32];
+  ASSERT_TRUE(consumer->Alloc(a, 32));
+  ASSERT_TRUE(consumer->Alloc(b, 32));
+  ASSERT_TRUE(consumer->Alloc(c, 32));
+  EXPECT_EQ(producer->stats().remote_out, consumer->stats().remote_in);
+  EXPECT_EQ(1, consumer->stats().mempool_gets);
+  EXPECT_EQ(1, freed.count(c[0]));
+
+  consumer->Free(a, 32);
+  consumer->Free(b, 32);
+  consumer->Free(c, 32);
+}
+
+TEST_F(PacketCacheTest, AllOrNothing) {
+  if (!pool_) {
+    return;
+  }
+
+  PacketCache *c = PacketCache::Attach(0, 0, pool_, 4096);
+  ASSERT_NE(nullptr, c);
+
+  std::vector<Packet *> held;
+  Packet *pkts[32];
+  while (c->Alloc(pkts, 32)) {
+    held.insert(held.end(), pkts, pkts + 32);
+  }
+  EXPECT_EQ(kPoolSize / 32 * 32, held.size());
+
+  for (size_t i = 0; i < held.size(); i += 32) {
+    c->Free(&held[i], 32);
+  }
+}
+
+}  // namespace (unnamed)
+}  // namespace bess
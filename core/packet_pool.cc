@@ -0,0 +1,199 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "packet_pool.h"
+
+#include <glog/logging.h>
+#include <rte_errno.h>
+#include <rte_lcore.h>
+
+#include <algorithm>
+#include <cstdio>
+
+#include "packet.h"
+
+namespace bess {
+
+const char *PacketPool::kDefaultName = "default";
+
+const size_t PacketPool::kMinDataSize;
+const size_t PacketPool::kMaxDataSize;
+const size_t PacketPool::kMinCount;
+
+std::map<std::string, PacketPool *> PacketPool::all_;
+PacketPool *PacketPool::default_;
+
+static void packet_init(struct rte_mempool *mp, void *opaque_arg, void *_m,
+                        unsigned i) {
+  Packet *pkt;
+
+  pkt = reinterpret_cast<Packet *>(_m);
+
+  rte_pktmbuf_init(mp, nullptr, _m, i);
+
+  memset(pkt->reserve(), 0, SNBUF_RESERVE);
+
+  pkt->set_vaddr(pkt);
+  pkt->set_paddr(rte_mempool_virt2iova(pkt));
+  pkt->set_sid(reinterpret_cast<uintptr_t>(opaque_arg));
+  pkt->set_index(i);
+}
+
+struct rte_mempool *PacketPool::CreateMempool(const char *name,
+                                              size_t data_size, size_t n,
+                                              int socket) {
+  // DPDK requires the per-lcore cache to be no larger than n / 1.5
+  const size_t num_mempool_cache = std::min<size_t>(512, n * 2 / 3);
+
+  PacketPoolPrivate priv;
+  priv.mbuf.mbuf_data_room_size = SNBUF_HEADROOM + data_size;
+  priv.mbuf.mbuf_priv_size = SNBUF_RESERVE;
+
+  // Same layout as class Packet, only with a different data room
+  size_t elt_size = align_ceil(SNBUF_DATA_OFF + data_size, 64);
+
+  struct rte_mempool *mp = rte_mempool_create(
+      name, n, elt_size, num_mempool_cache, sizeof(PacketPoolPrivate),
+      rte_pktmbuf_pool_init, &priv.mbuf, packet_init,
+      reinterpret_cast<void *>((uintptr_t)socket), socket, 0);
+
+  if (mp) {
+    auto *mp_priv =
+        reinterpret_cast<PacketPoolPrivate *>(rte_mempool_get_priv(mp));
+    mp_priv->alloc_failures = 0;
+  }
+
+  return mp;
+}
+
+PacketPool *PacketPool::Create(const std::string &name, size_t data_size,
+                               size_t count, int socket, int *err) {
+  int dummy;
+  if (!err) {
+    err = &dummy;
+  }
+
+  if (name.empty() || all_.count(name)) {
+    *err = EEXIST;
+    return nullptr;
+  }
+
+  if (data_size < kMinDataSize || data_size > kMaxDataSize ||
+      count < kMinCount || socket < -1 || socket >= RTE_MAX_NUMA_NODES) {
+    *err = EINVAL;
+    return nullptr;
+  }
+
+  bool sockets[RTE_MAX_NUMA_NODES] = {};
+  if (socket == -1) {
+    for (int i = 0; i < RTE_MAX_LCORE; i++) {
+      sockets[rte_lcore_to_socket_id(i)] = true;
+    }
+  } else {
+    sockets[socket] = true;
+  }
+
+  PacketPool *pool = new PacketPool(name, data_size, count);
+
+  for (int sid = 0; sid < RTE_MAX_NUMA_NODES; sid++) {
+    if (!sockets[sid]) {
+      continue;
+    }
+
+    // mempool names are limited to RTE_MEMPOOL_NAMESIZE
+    char mp_name[RTE_MEMPOOL_NAMESIZE];
+    snprintf(mp_name, sizeof(mp_name), "pp%zu_%d", all_.size(), sid);
+
+    pool->mempools_[sid] = CreateMempool(mp_name, data_size, count, sid);
+    if (!pool->mempools_[sid]) {
+      *err = rte_errno;
+      LOG(WARNING) << "Packet pool '" << name << "': allocating " << count
+                   << " buffers of " << data_size << " bytes on socket "
+                   << sid << " failed (" << rte_strerror(rte_errno) << ")";
+
+      // The mempools created so far are leaked, as with the default pool
+      delete pool;
+      return nullptr;
+    }
+  }
+
+  LOG(INFO) << "Packet pool '" << name << "': " << count << " buffers of "
+            << data_size << " bytes per socket";
+
+  pool->Register();
+  return pool;
+}
+
+PacketPool *PacketPool::CreateDefault(struct rte_mempool **mempools,
+                                      size_t count) {
+  CHECK(!default_);
+
+  PacketPool *pool = new PacketPool(kDefaultName, SNBUF_DATA, count);
+  for (int sid = 0; sid < RTE_MAX_NUMA_NODES; sid++) {
+    pool->mempools_[sid] = mempools[sid];
+  }
+
+  pool->Register();
+  default_ = pool;
+  return pool;
+}
+
+PacketPool *PacketPool::Find(const std::string &name) {
+  const auto &it = all_.find(name);
+  if (it == all_.end()) {
+    return nullptr;
+  }
+  return it->second;
+}
+
+uint64_t PacketPool::alloc_failures(const struct rte_mempool *mp) {
+  const auto *priv = reinterpret_cast<const PacketPoolPrivate *>(
+      rte_mempool_get_priv(const_cast<struct rte_mempool *>(mp)));
+  return priv->alloc_failures.load(std::memory_order_relaxed);
+}
+
+void PacketPool::Register() {
+  struct rte_mempool *any = nullptr;
+  for (int sid = 0; sid < RTE_MAX_NUMA_NODES; sid++) {
+    if (mempools_[sid]) {
+      any = mempools_[sid];
+      break;
+    }
+  }
+  CHECK(any);
+
+  for (int sid = 0; sid < RTE_MAX_NUMA_NODES; sid++) {
+    lookup_[sid] = mempools_[sid] ? mempools_[sid] : any;
+  }
+
+  all_.emplace(name_, this);
+}
+
+}  // namespace bess
@@ -0,0 +1,177 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_PACKET_POOL_H_
+#define BESS_PACKET_POOL_H_
+
+#include <rte_config.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include "snbuf_layout.h"
+#include "utils/common.h"
+#include "worker.h"
+
+namespace bess {
+
+// Stored in the private area of every packet mempool, so that the fast path
+// can account allocation failures without looking up the PacketPool.
+struct PacketPoolPrivate {
+  struct rte_pktmbuf_pool_private mbuf;  // must be the first field
+
+  std::atomic<uint64_t> alloc_failures;
+};
+
+static inline void __packet_pool_alloc_failed(struct rte_mempool *mp) {
+  auto *priv = reinterpret_cast<PacketPoolPrivate *>(rte_mempool_get_priv(mp));
+  priv->alloc_failures.fetch_add(1, std::memory_order_relaxed);
+}
+
+// A named set of packet buffers of the same data room size, with one mempool
+// per NUMA node. The "default" pool is the one created at startup with
+// --buffers (SNBUF_DATA bytes each), and is the one all modules and drivers
+// allocate from unless told otherwise.
+//
+// Pools are never destroyed, as DPDK mempools cannot be freed.
+class PacketPool {
+ public:
+  static const char *kDefaultName;
+
+  static const size_t kMinDataSize = 64;
+  // mbuf.buf_len is 16-bit
+  static const size_t kMaxDataSize = UINT16_MAX - SNBUF_HEADROOM;
+
+  static const size_t kMinCount = 64;
+
+  // Creates a pool of 'count' buffers of 'data_size' bytes on 'socket', or on
+  // every socket with a CPU core if 'socket' is -1. On failure returns nullptr
+  // and sets 'err' (if given) to a positive errno value.
+  static PacketPool *Create(const std::string &name, size_t data_size,
+                            size_t count, int socket, int *err = nullptr);
+
+  // Wraps the mempools created by init_mempool()
+  static PacketPool *CreateDefault(struct rte_mempool **mempools,
+                                   size_t count);
+
+  // Returns nullptr if not found
+  static PacketPool *Find(const std::string &name);
+
+  static PacketPool *Default() { return default_; }
+
+  static const std::map<std::string, PacketPool *> &all() { return all_; }
+
+  // Creates a mempool of 'n' packet buffers with the given data room.
+  // Returns nullptr (and sets rte_errno) on failure.
+  static struct rte_mempool *CreateMempool(const char *name, size_t data_size,
+                                           size_t n, int socket);
+
+  // The mempool to allocate from on 'socket'. Falls back to the mempool of
+  // another socket if the pool has none there.
+  struct rte_mempool *mempool(int socket) const {
+    if (likely(socket >= 0 && socket < RTE_MAX_NUMA_NODES)) {
+      return lookup_[socket];
+    }
+    return lookup_[0];
+  }
+
+  // nullptr if the pool has no buffers on 'socket'
+  struct rte_mempool *local_mempool(int socket) const {
+    return mempools_[socket];
+  }
+
+  const std::string &name() const { return name_; }
+  size_t data_size() const { return data_size_; }
+  size_t count() const { return count_; }
+
+  // Number of times an allocation from the given mempool failed
+  static uint64_t alloc_failures(const struct rte_mempool *mp);
+
+ private:
+  PacketPool(const std::string &name, size_t data_size, size_t count)
+      : name_(name),
+        data_size_(data_size),
+        count_(count),
+        mempools_(),
+        lookup_() {}
+
+  // Fills in lookup_ from mempools_ and registers the pool
+  void Register();
+
+  static std::map<std::string, PacketPool *> all_;
+  static PacketPool *default_;
+
+  std::string name_;
+  size_t data_size_;
+  size_t count_;  // per socket
+
+  struct rte_mempool *mempools_[RTE_MAX_NUMA_NODES];
+  struct rte_mempool *lookup_[RTE_MAX_NUMA_NODES];
+
+  DISALLOW_COPY_AND_ASSIGN(PacketPool);
+};
+
+// Within its scope, packets allocated on the current worker without an
+// explicit pool (e.g., by port drivers) come from 'pool', bypassing the
+// worker's packet cache. A nullptr pool leaves everything as it is.
+class ScopedPacketPool {
+ public:
+  explicit ScopedPacketPool(const PacketPool *pool)
+      : saved_pool_(current_worker.pframe_pool()),
+        saved_cache_(current_worker.packet_cache()),
+        active_(pool != nullptr) {
+    if (active_) {
+      current_worker.set_pframe_pool(pool->mempool(current_worker.socket()));
+      current_worker.set_packet_cache(nullptr);
+    }
+  }
+
+  ~ScopedPacketPool() {
+    if (active_) {
+      current_worker.set_pframe_pool(saved_pool_);
+      current_worker.set_packet_cache(saved_cache_);
+    }
+  }
+
+ private:
+  struct rte_mempool *saved_pool_;
+  PacketCache *saved_cache_;
+  bool active_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedPacketPool);
+};
+
+}  // namespace bess
+
+#endif  // BESS_PACKET_POOL_H_
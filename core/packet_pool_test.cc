@@ -0,0 +1,153 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "packet_pool.h"
+
+#include <gtest/gtest.h>
+
+#include "dpdk.h"
+#include "packet.h"
+
+namespace bess {
+namespace {
+
+class PacketPoolTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    if (!dpdk_inited_) {
+      if (geteuid() == 0) {
+        init_dpdk("packet_pool_test", 1024, 0, true);
+        dpdk_inited_ = true;
+      } else {
+        LOG(INFO) << "This test requires root privileges. Skipping...";
+      }
+    }
+  }
+
+  static bool dpdk_inited_;
+};
+
+bool PacketPoolTest::dpdk_inited_ = false;
+
+TEST_F(PacketPoolTest, CreateAndFind) {
+  if (!dpdk_inited_) {
+    return;
+  }
+
+  PacketPool *pool = PacketPool::Create("test_small", 256, 127, 0);
+  ASSERT_NE(nullptr, pool);
+  EXPECT_EQ(pool, PacketPool::Find("test_small"));
+  EXPECT_EQ("test_small", pool->name());
+  EXPECT_EQ(256, pool->data_size());
+  EXPECT_EQ(127, pool->count());
+
+  // No buffers on socket 1, so allocations there fall back to socket 0
+  ASSERT_NE(nullptr, pool->local_mempool(0));
+  EXPECT_EQ(nullptr, pool->local_mempool(1));
+  EXPECT_EQ(pool->local_mempool(0), pool->mempool(1));
+
+  EXPECT_EQ(nullptr, PacketPool::Find("test_nonexistent"));
+}
+
+TEST_F(PacketPoolTest, InvalidArgs) {
+  if (!dpdk_inited_) {
+    return;
+  }
+
+  int err = 0;
+  ASSERT_NE(nullptr, PacketPool::Create("test_dup", 2048, 127, 0));
+  EXPECT_EQ(nullptr, PacketPool::Create("test_dup", 2048, 127, 0, &err));
+  EXPECT_EQ(EEXIST, err);
+
+  EXPECT_EQ(nullptr, PacketPool::Create("test_tiny", 1, 127, 0, &err));
+  EXPECT_EQ(EINVAL, err);
+  EXPECT_EQ(nullptr, PacketPool::Create("test_huge", 65536, 127, 0, &err));
+  EXPECT_EQ(EINVAL, err);
+  EXPECT_EQ(nullptr, PacketPool::Create("test_few", 2048, 1, 0, &err));
+  EXPECT_EQ(EINVAL, err);
+  EXPECT_EQ(nullptr, PacketPool::Create("test_socket", 2048, 127, -2, &err));
+  EXPECT_EQ(EINVAL, err);
+}
+
+TEST_F(PacketPoolTest, AllocFailures) {
+  if (!dpdk_inited_) {
+    return;
+  }
+
+  PacketPool *pool = PacketPool::Create("test_failures", 128, 64, 0);
+  ASSERT_NE(nullptr, pool);
+  struct rte_mempool *mp = pool->mempool(0);
+  EXPECT_EQ(0, PacketPool::alloc_failures(mp));
+
+  Packet *pkts[64];
+  ASSERT_EQ(32, Packet::Alloc(pkts, 32, 0, mp));
+  ASSERT_EQ(32, Packet::Alloc(pkts + 32, 32, 0, mp));
+  EXPECT_EQ(0, PacketPool::alloc_failures(mp));
+
+  // Exhausted
+  Packet *pkt;
+  EXPECT_EQ(0, Packet::Alloc(&pkt, 1, 0, mp));
+  EXPECT_EQ(1, PacketPool::alloc_failures(mp));
+
+  rte_mempool_put_bulk(mp, reinterpret_cast<void **>(pkts), 64);
+  EXPECT_EQ(64, rte_mempool_avail_count(mp));
+}
+
+TEST_F(PacketPoolTest, AllocTemplate) {
+  if (!dpdk_inited_) {
+    return;
+  }
+
+  PacketPool *pool = PacketPool::Create("test_template", 2048, 64, 0);
+  ASSERT_NE(nullptr, pool);
+  struct rte_mempool *mp = pool->mempool(0);
+
+  char templ[96];  // must be readable up to 32B boundary
+  for (size_t i = 0; i < sizeof(templ); i++) {
+    templ[i] = i;
+  }
+
+  Packet *pkts[32];
+  ASSERT_EQ(32, Packet::Alloc(pkts, 32, templ, 60, mp));
+  for (Packet *pkt : pkts) {
+    EXPECT_EQ(60, pkt->head_len());
+    EXPECT_EQ(60, pkt->total_len());
+    EXPECT_EQ(1, pkt->nb_segs());
+    EXPECT_EQ(1, pkt->refcnt());
+    EXPECT_EQ(SNBUF_HEADROOM, pkt->data_off());
+    EXPECT_EQ(0, memcmp(pkt->head_data(), templ, 60));
+  }
+
+  Packet::Free(pkts, 32);
+  EXPECT_EQ(64, rte_mempool_avail_count(mp));
+}
+
+}  // namespace
+}  // namespace bess
@@ -0,0 +1,383 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "packet.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "dpdk.h"
+#include "packet_pool.h"
+#include "utils/checksum.h"
+
+namespace bess {
+namespace {
+
+// Builds a chained packet whose segments hold "lens" bytes each, filled with
+// consecutive bytes of "data". Segments are not backed by a mempool.
+Packet *MakeChain(const std::vector<uint16_t> &lens, const char *data) {
+  Packet *head = nullptr;
+  Packet *prev = nullptr;
+  uint32_t total = 0;
+
+  for (uint16_t len : lens) {
+    Packet *seg = new Packet();
+    seg->set_buffer(seg->data());
+    seg->as_rte_mbuf().buf_len = SNBUF_DATA;
+    seg->set_data_off(0);
+    seg->set_data_len(len);
+    seg->set_refcnt(1);
+    memcpy(seg->head_data(), data + total, len);
+    total += len;
+
+    if (prev) {
+      prev->set_next(seg);
+    } else {
+      head = seg;
+    }
+    prev = seg;
+  }
+
+  head->set_nb_segs(lens.size());
+  head->set_total_len(total);
+  return head;
+}
+
+void DeleteChain(Packet *pkt) {
+  while (pkt) {
+    Packet *next = pkt->next();
+    delete pkt;
+    pkt = next;
+  }
+}
+
+class PacketChainTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    for (size_t i = 0; i < sizeof(data_); i++) {
+      data_[i] = i * 7 + 3;
+    }
+  }
+
+  char data_[300];
+};
+
+TEST_F(PacketChainTest, Segments) {
+  Packet *pkt = MakeChain({100, 50, 150}, data_);
+
+  std::vector<int> lens;
+  for (Packet *seg : pkt->segments()) {
+    lens.push_back(seg->head_len());
+  }
+
+  EXPECT_EQ(std::vector<int>({100, 50, 150}), lens);
+  EXPECT_EQ(150, pkt->last_segment()->head_len());
+  EXPECT_FALSE(pkt->is_linear());
+
+  DeleteChain(pkt);
+}
+
+TEST_F(PacketChainTest, CopyOut) {
+  Packet *pkt = MakeChain({100, 50, 150}, data_);
+  char buf[300];
+
+  ASSERT_TRUE(pkt->CopyOut(buf, 0, 300));
+  EXPECT_EQ(0, memcmp(buf, data_, 300));
+
+  ASSERT_TRUE(pkt->CopyOut(buf, 120, 100));
+  EXPECT_EQ(0, memcmp(buf, data_ + 120, 100));
+
+  EXPECT_FALSE(pkt->CopyOut(buf, 250, 51));
+  EXPECT_FALSE(pkt->CopyOut(buf, 0xfffffff0, 0x20));
+
+  DeleteChain(pkt);
+}
+
+TEST_F(PacketChainTest, CalculateSum) {
+  Packet *pkt = MakeChain({101, 49, 150}, data_);
+
+  for (uint32_t offset : {0, 1, 99, 100, 101, 150}) {
+    uint32_t len = 300 - offset;
+    EXPECT_EQ(utils::CalculateGenericChecksum(data_ + offset, len),
+              utils::FoldChecksum(pkt->CalculateSum(offset, len)))
+        << "offset " << offset;
+  }
+
+  DeleteChain(pkt);
+}
+
+TEST_F(PacketChainTest, PullHead) {
+  Packet *pkt = MakeChain({10, 50, 240}, data_);
+
+  // Already contiguous
+  EXPECT_EQ(pkt->head_data(), pkt->pull_head(10));
+
+  // Takes bytes from the 2nd segment only
+  char *head = pkt->pull_head<char *>(40);
+  ASSERT_NE(nullptr, head);
+  EXPECT_EQ(0, memcmp(head, data_, 40));
+  EXPECT_EQ(40, pkt->head_len());
+  EXPECT_EQ(20, pkt->next()->head_len());
+  EXPECT_EQ(300, pkt->total_len());
+  EXPECT_EQ(3, pkt->nb_segs());
+
+  char buf[300];
+  ASSERT_TRUE(pkt->CopyOut(buf, 0, 300));
+  EXPECT_EQ(0, memcmp(buf, data_, 300));
+
+  // Too long
+  EXPECT_EQ(nullptr, pkt->pull_head(301));
+
+  // Shared segments must not be modified
+  pkt->next()->set_refcnt(2);
+  EXPECT_EQ(nullptr, pkt->pull_head(50));
+  pkt->next()->set_refcnt(1);
+
+  DeleteChain(pkt);
+}
+
+TEST_F(PacketChainTest, MakeWritable) {
+  Packet *pkt = MakeChain({10, 50, 240}, data_);
+
+  // Private and already contiguous
+  EXPECT_TRUE(pkt->is_head_private());
+  EXPECT_EQ(pkt->head_data(), pkt->make_writable(10));
+
+  // Takes bytes from the following segments
+  char *head = pkt->make_writable<char *>(70);
+  ASSERT_NE(nullptr, head);
+  EXPECT_EQ(0, memcmp(head, data_, 70));
+  EXPECT_EQ(70, pkt->head_len());
+  EXPECT_EQ(300, pkt->total_len());
+
+  // Longer than the packet: all of it
+  head = pkt->make_writable<char *>(1000);
+  ASSERT_NE(nullptr, head);
+  EXPECT_EQ(300, pkt->head_len());
+  EXPECT_EQ(0, memcmp(head, data_, 300));
+  EXPECT_TRUE(pkt->is_linear());
+
+  // The head segment is held by someone else
+  pkt->set_refcnt(2);
+  EXPECT_FALSE(pkt->is_head_private());
+  EXPECT_EQ(nullptr, pkt->make_writable(10));
+  pkt->set_refcnt(1);
+
+  DeleteChain(pkt);
+}
+
+// Share() needs real mempools, like PacketPoolTest
+class PacketShareTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    if (!dpdk_inited_) {
+      if (geteuid() == 0) {
+        init_dpdk("packet_test", 1024, 0, true);
+        dpdk_inited_ = true;
+      } else {
+        LOG(INFO) << "This test requires root privileges. Skipping...";
+      }
+    }
+
+    for (size_t i = 0; i < sizeof(data_); i++) {
+      data_[i] = i * 7 + 3;
+    }
+  }
+
+  // A packet of "len" bytes of data_ from the pool named "name", which is
+  // created (with "data_size" byte buffers) if it does not exist
+  Packet *MakePacket(const std::string &name, size_t data_size,
+                     uint16_t len) {
+    PacketPool *pool = PacketPool::Find(name);
+    if (!pool) {
+      pool = PacketPool::Create(name, data_size, kPoolSize, 0);
+    }
+    if (!pool) {
+      return nullptr;
+    }
+
+    Packet *pkt;
+    if (Packet::Alloc(&pkt, 1, len, pool->mempool(0)) != 1) {
+      return nullptr;
+    }
+    memcpy(pkt->head_data(), data_, len);
+    return pkt;
+  }
+
+  static unsigned avail(const std::string &name) {
+    return rte_mempool_avail_count(PacketPool::Find(name)->mempool(0));
+  }
+
+  static const size_t kPoolSize = 64;
+  static bool dpdk_inited_;
+
+  char data_[1000];
+};
+
+const size_t PacketShareTest::kPoolSize;
+bool PacketShareTest::dpdk_inited_ = false;
+
+TEST_F(PacketShareTest, Refcount) {
+  if (!dpdk_inited_) {
+    return;
+  }
+
+  Packet *src = MakePacket("test_share", 2048, 1000);
+  ASSERT_NE(nullptr, src);
+
+  Packet *replica = Packet::Share(src, 64);
+  ASSERT_NE(nullptr, replica);
+  EXPECT_EQ(2, src->refcnt());
+  EXPECT_EQ(1, replica->refcnt());
+  EXPECT_EQ(2, replica->nb_segs());
+  EXPECT_EQ(64, replica->head_len());
+  EXPECT_EQ(1000, replica->total_len());
+  EXPECT_FALSE(src->is_head_private());
+
+  char buf[1000];
+  ASSERT_TRUE(replica->CopyOut(buf, 0, 1000));
+  EXPECT_EQ(0, memcmp(buf, data_, 1000));
+
+  Packet *replica2 = Packet::Share(src, 64);
+  ASSERT_NE(nullptr, replica2);
+  EXPECT_EQ(3, src->refcnt());
+
+  Packet::Free(replica2);
+  EXPECT_EQ(2, src->refcnt());
+  Packet::Free(replica);
+  EXPECT_EQ(1, src->refcnt());
+  Packet::Free(src);
+  EXPECT_EQ(kPoolSize, avail("test_share"));
+}
+
+TEST_F(PacketShareTest, WritePrivateHead) {
+  if (!dpdk_inited_) {
+    return;
+  }
+
+  Packet *src = MakePacket("test_share", 2048, 1000);
+  ASSERT_NE(nullptr, src);
+  Packet *replica = Packet::Share(src, 64);
+  ASSERT_NE(nullptr, replica);
+
+  // Within the private bytes, and prepended
+  EXPECT_TRUE(replica->is_head_private());
+  replica->head_data<char *>()[10] = ~data_[10];
+  ASSERT_NE(nullptr, replica->prepend(4));
+  EXPECT_EQ(1004, replica->total_len());
+
+  // Beyond them, after copy-on-write
+  char *head = replica->make_writable<char *>(204);
+  ASSERT_NE(nullptr, head);
+  head[200] = ~data_[196];
+
+  EXPECT_EQ(0, memcmp(src->head_data(), data_, 1000));
+  EXPECT_EQ(1000, src->total_len());
+
+  char buf[1000];
+  ASSERT_TRUE(replica->CopyOut(buf, 4, 1000));
+  EXPECT_EQ(static_cast<char>(~data_[10]), buf[10]);
+  EXPECT_EQ(static_cast<char>(~data_[196]), buf[196]);
+  EXPECT_EQ(0, memcmp(buf + 197, data_ + 197, 1000 - 197));
+
+  Packet::Free(replica);
+  Packet::Free(src);
+  EXPECT_EQ(kPoolSize, avail("test_share"));
+}
+
+TEST_F(PacketShareTest, FreeOriginalFirst) {
+  if (!dpdk_inited_) {
+    return;
+  }
+
+  Packet *src = MakePacket("test_share", 2048, 1000);
+  ASSERT_NE(nullptr, src);
+  Packet *replica = Packet::Share(src, 64);
+  ASSERT_NE(nullptr, replica);
+
+  // The buffer stays with the replica
+  Packet::Free(src);
+  EXPECT_EQ(kPoolSize - 3, avail("test_share"));
+
+  char buf[1000];
+  ASSERT_TRUE(replica->CopyOut(buf, 0, 1000));
+  EXPECT_EQ(0, memcmp(buf, data_, 1000));
+
+  Packet::Free(replica);
+  EXPECT_EQ(kPoolSize, avail("test_share"));
+}
+
+TEST_F(PacketShareTest, FreeReplicaFirst) {
+  if (!dpdk_inited_) {
+    return;
+  }
+
+  Packet *src = MakePacket("test_share", 2048, 1000);
+  ASSERT_NE(nullptr, src);
+  Packet *replica = Packet::Share(src, 64);
+  ASSERT_NE(nullptr, replica);
+
+  Packet::Free(replica);
+  EXPECT_EQ(kPoolSize - 1, avail("test_share"));
+  EXPECT_EQ(1, src->refcnt());
+  EXPECT_TRUE(src->is_head_private());
+  EXPECT_EQ(0, memcmp(src->head_data(), data_, 1000));
+
+  Packet::Free(src);
+  EXPECT_EQ(kPoolSize, avail("test_share"));
+}
+
+// The private bytes do not fit in a buffer of a small pool
+TEST_F(PacketShareTest, SmallPool) {
+  if (!dpdk_inited_) {
+    return;
+  }
+
+  Packet *src = MakePacket("test_share_small", 128, 128);
+  ASSERT_NE(nullptr, src);
+  ASSERT_NE(nullptr, src->prepend(64));
+
+  Packet *replica = Packet::Share(src, 160);
+  ASSERT_NE(nullptr, replica);
+  EXPECT_EQ(1, src->refcnt());
+  EXPECT_EQ(192, replica->total_len());
+
+  char buf[192];
+  ASSERT_TRUE(replica->CopyOut(buf, 0, 192));
+  EXPECT_EQ(0, memcmp(buf, src->head_data(), 192));
+
+  Packet::Free(replica);
+  Packet::Free(src);
+  EXPECT_EQ(kPoolSize, avail("test_share_small"));
+}
+
+}  // namespace
+}  // namespace bess
@@ -32,6 +32,7 @@
 
 #include <glog/logging.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cctype>
 #include <cerrno>
@@ -158,19 +159,79 @@ const std::map<std::string, Port *> &PortBuilder::all_ports() {
   return all_ports_;
 }
 
+Port::~Port() {
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    mem_free(counters_[wid]);
+  }
+}
+
 void Port::CollectStats(bool) {}
 
 CommandResponse Port::InitWithGenericArg(const google::protobuf::Any &arg) {
   return port_builder_->RunInit(this, arg);
 }
 
+QueueCounters *Port::AllocCounters(int wid) {
+  QueueCounters *c = static_cast<QueueCounters *>(
+      mem_alloc_ex(sizeof(QueueCounters) * PACKET_DIRS * MAX_QUEUES_PER_DIR,
+                   alignof(QueueCounters), current_worker.socket()));
+  if (!c) {
+    return nullptr;
+  }
+
+  // Zeroed counters must be visible before the pointer is
+  rte_smp_wmb();
+  counters_[wid] = c;
+  return c;
+}
+
+QueueStats Port::GetQueueStats(packet_dir_t dir, queue_t qid,
+                               uint64_t *burst_hist) {
+  QueueStats ret = queue_stats[dir][qid];
+
+  if (burst_hist) {
+    std::fill(burst_hist, burst_hist + QueueCounters::kBurstHistSize, 0);
+  }
+
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    const QueueCounters *c = ACCESS_ONCE(counters_[wid]);
+    if (!c) {
+      continue;
+    }
+
+    c += dir * MAX_QUEUES_PER_DIR + qid;
+
+    // Retry if the worker was updating the counters while we read them
+    QueueCounters snapshot;
+    uint32_t seq;
+    do {
+      seq = ACCESS_ONCE(c->seq);
+      rte_smp_rmb();
+      snapshot = *c;
+      rte_smp_rmb();
+    } while ((seq & 1) || seq != ACCESS_ONCE(c->seq));
+
+    ret.packets += snapshot.stats.packets;
+    ret.dropped += snapshot.stats.dropped;
+    ret.bytes += snapshot.stats.bytes;
+
+    if (burst_hist) {
+      for (size_t i = 0; i < QueueCounters::kBurstHistSize; i++) {
+        burst_hist[i] += snapshot.burst_hist[i];
+      }
+    }
+  }
+
+  return ret;
+}
+
 Port::PortStats Port::GetPortStats() {
   CollectStats(false);
 
   PortStats ret = port_stats_;
 
   for (queue_t qid = 0; qid < num_queues[PACKET_DIR_INC]; qid++) {
-    const QueueStats &inc = queue_stats[PACKET_DIR_INC][qid];
+    const QueueStats inc = GetQueueStats(PACKET_DIR_INC, qid);
 
     ret.inc.packets += inc.packets;
     ret.inc.dropped += inc.dropped;
@@ -178,7 +239,7 @@ Port::PortStats Port::GetPortStats() {
   }
 
   for (queue_t qid = 0; qid < num_queues[PACKET_DIR_OUT]; qid++) {
-    const QueueStats &out = queue_stats[PACKET_DIR_OUT][qid];
+    const QueueStats out = GetQueueStats(PACKET_DIR_OUT, qid);
     ret.out.packets += out.packets;
     ret.out.dropped += out.dropped;
     ret.out.bytes += out.bytes;
@@ -33,7 +33,9 @@
 
 #include <glog/logging.h>
 #include <gtest/gtest_prod.h>
+#include <rte_atomic.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <functional>
 #include <map>
@@ -46,6 +48,7 @@
 #include "pb/port_msg.pb.h"
 #include "utils/common.h"
 #include "utils/ether.h"
+#include "worker.h"
 
 typedef uint8_t queue_t;
 
@@ -180,6 +183,20 @@ struct QueueStats {
   uint64_t bytes;    // It doesn't include Ethernet overhead
 };
 
+// Datapath counters of a queue, updated by a single worker. Each worker has
+// its own (cache-aligned) copy, so no atomic operations are needed. 'seq' is
+// odd while an update is in progress, so that readers can take a consistent
+// snapshot without locking (see Port::GetQueueStats()).
+struct alignas(64) QueueCounters {
+  static const size_t kBurstHistSize = bess::PacketBatch::kMaxBurst + 1;
+
+  uint32_t seq;
+  QueueStats stats;
+
+  // burst_hist[i]: number of RX polls (or TX calls) that handled i packets
+  uint64_t burst_hist[kBurstHistSize];
+};
+
 class Port {
  public:
   struct LinkStatus {
@@ -209,13 +226,14 @@ class Port {
         num_queues(),
         queue_size(),
         users(),
-        queue_stats() {
+        queue_stats(),
+        counters_() {
     conf_.mac_addr.Randomize();
     conf_.mtu = kDefaultMtu;
     conf_.admin_up = true;
   }
 
-  virtual ~Port() {}
+  virtual ~Port();
 
   virtual void DeInit() = 0;
 
@@ -256,6 +274,18 @@ class Port {
 
   PortStats GetPortStats();
 
+  // Returns the stats of a queue, summed over the driver-collected stats
+  // (queue_stats) and the datapath counters of all workers. If burst_hist is
+  // not nullptr, it is filled with QueueCounters::kBurstHistSize buckets.
+  QueueStats GetQueueStats(packet_dir_t dir, queue_t qid,
+                           uint64_t *burst_hist = nullptr);
+
+  // Accounts for a RX poll or TX call on a queue. Must be called by a worker.
+  // "burst" is recorded in the burst size histogram unless negative.
+  inline void UpdateQueueStats(packet_dir_t dir, queue_t qid, uint64_t packets,
+                               uint64_t dropped, uint64_t bytes,
+                               int burst = -1);
+
   /* queues == nullptr if _all_ queues are being acquired/released */
   int AcquireQueues(const struct module *m, packet_dir_t dir,
                     const queue_t *queues, int num);
@@ -283,6 +313,9 @@ class Port {
 
   static const uint32_t kDefaultMtu = 1500;
 
+  // Allocates the counters of the worker
+  QueueCounters *AllocCounters(int wid);
+
   // Private methods, for use by PortBuilder.
   void set_name(const std::string &name) { name_ = name; }
   void set_port_builder(const PortBuilder *port_builder) {
@@ -305,9 +338,49 @@ class Port {
    * TODO: more robust gate keeping */
   const struct module *users[PACKET_DIRS][MAX_QUEUES_PER_DIR];
 
+  // Stats collected by drivers themselves (e.g., from NIC registers).
+  // Datapath counters should go through UpdateQueueStats() instead.
   struct QueueStats queue_stats[PACKET_DIRS][MAX_QUEUES_PER_DIR];
+
+ private:
+  // Per-worker counters, QueueCounters[PACKET_DIRS][MAX_QUEUES_PER_DIR] each.
+  // Allocated on the first update by the worker.
+  QueueCounters *counters_[Worker::kMaxWorkers];
 };
 
+inline void Port::UpdateQueueStats(packet_dir_t dir, queue_t qid,
+                                   uint64_t packets, uint64_t dropped,
+                                   uint64_t bytes, int burst) {
+  const int wid = current_worker.wid();
+
+  if (unlikely(qid >= MAX_QUEUES_PER_DIR)) {
+    return;
+  }
+
+  QueueCounters *c = counters_[wid];
+  if (unlikely(!c)) {
+    c = AllocCounters(wid);
+    if (!c) {
+      return;
+    }
+  }
+
+  c += dir * MAX_QUEUES_PER_DIR + qid;
+
+  c->seq++;
+  rte_smp_wmb();
+
+  c->stats.packets += packets;
+  c->stats.dropped += dropped;
+  c->stats.bytes += bytes;
+  if (burst >= 0) {
+    c->burst_hist[std::min<size_t>(burst, QueueCounters::kBurstHistSize - 1)]++;
+  }
+
+  rte_smp_wmb();
+  c->seq++;
+}
+
 #define ADD_DRIVER(_DRIVER, _NAME_TEMPLATE, _HELP)                       \
   bool __driver__##_DRIVER = PortBuilder::RegisterPortClass(             \
       std::function<Port *()>([]() { return new _DRIVER(); }), #_DRIVER, \
@@ -35,6 +35,7 @@
 
 #include <memory>
 #include <string>
+#include <thread>
 
 class DummyPort : public Port {
  public:
@@ -162,6 +163,67 @@ TEST_F(PortTest, GetPortStats) {
   EXPECT_EQ(0, stats.out.bytes);
 }
 
+// Checks that datapath counters show up in queue and port stats.
+TEST_F(PortTest, UpdateQueueStats) {
+  std::unique_ptr<Port> p(dummy_port_builder->CreatePort("port1"));
+  ASSERT_NE(nullptr, p.get());
+  p->num_queues[PACKET_DIR_INC] = 2;
+  p->num_queues[PACKET_DIR_OUT] = 1;
+
+  p->UpdateQueueStats(PACKET_DIR_INC, 1, 0, 0, 0, 0);
+  p->UpdateQueueStats(PACKET_DIR_INC, 1, 32, 0, 2048, 32);
+  p->UpdateQueueStats(PACKET_DIR_INC, 1, 4, 0, 256, 4);
+  p->UpdateQueueStats(PACKET_DIR_OUT, 0, 30, 2, 1920, 32);
+  p->UpdateQueueStats(PACKET_DIR_OUT, 0, 0, 1, 0);
+  p->queue_stats[PACKET_DIR_INC][0].packets = 10;
+
+  uint64_t hist[QueueCounters::kBurstHistSize];
+  QueueStats q = p->GetQueueStats(PACKET_DIR_INC, 1, hist);
+  EXPECT_EQ(36, q.packets);
+  EXPECT_EQ(2304, q.bytes);
+  EXPECT_EQ(1, hist[0]);
+  EXPECT_EQ(1, hist[4]);
+  EXPECT_EQ(1, hist[32]);
+  EXPECT_EQ(0, hist[1]);
+
+  q = p->GetQueueStats(PACKET_DIR_OUT, 0, hist);
+  EXPECT_EQ(30, q.packets);
+  EXPECT_EQ(3, q.dropped);
+  EXPECT_EQ(1, hist[32]);
+
+  Port::PortStats stats = p->GetPortStats();
+  EXPECT_EQ(46, stats.inc.packets);
+  EXPECT_EQ(2304, stats.inc.bytes);
+  EXPECT_EQ(30, stats.out.packets);
+  EXPECT_EQ(3, stats.out.dropped);
+  EXPECT_EQ(1920, stats.out.bytes);
+}
+
+// Checks that readers never see torn updates.
+TEST_F(PortTest, QueueStatsSnapshot) {
+  std::unique_ptr<Port> p(dummy_port_builder->CreatePort("port1"));
+  ASSERT_NE(nullptr, p.get());
+
+  // Make sure the counters exist before the reader starts
+  p->UpdateQueueStats(PACKET_DIR_INC, 0, 0, 0, 0);
+
+  const int kUpdates = 1000000;
+  std::thread writer([&p, kUpdates]() {
+    for (int i = 0; i < kUpdates; i++) {
+      p->UpdateQueueStats(PACKET_DIR_INC, 0, 1, 1, 64);
+    }
+  });
+
+  QueueStats q;
+  do {
+    q = p->GetQueueStats(PACKET_DIR_INC, 0);
+    ASSERT_EQ(q.packets, q.dropped);
+    ASSERT_EQ(q.packets * 64, q.bytes);
+  } while (q.packets < kUpdates);
+
+  writer.join();
+}
+
 // Checks that we can acquire and release queues.
 TEST_F(PortTest, AcquireAndReleaseQueues) {
   std::unique_ptr<Port> p(dummy_port_builder->CreatePort("port1"));
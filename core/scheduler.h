@@ -238,6 +238,8 @@ class DefaultScheduler : public Scheduler {
 
     // The main scheduling, running, accounting loop.
     for (uint64_t round = 0;; ++round) {
+      current_worker.incr_rounds();
+
       // Periodic check, to mitigate expensive operations.
       if ((round & accounting_mask) == 0) {
         if (current_worker.is_pause_requested()) {
@@ -324,6 +326,8 @@ class ExperimentalScheduler : public Scheduler {
 
     // The main scheduling, running, accounting loop.
     for (uint64_t round = 0;; ++round) {
+      current_worker.incr_rounds();
+
       // Periodic check, to mitigate expensive operations.
       if ((round & accounting_mask) == 0) {
         if (current_worker.is_pause_requested()) {
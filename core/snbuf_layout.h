@@ -45,6 +45,12 @@
  *
  * Stride will be 2624B, because of mempool's per-object header which takes 64B.
  *
+ * The size of the metadata area can be overridden at build time
+ * (e.g., "METADATA_SIZE=256 make"), in which case all the fields after it
+ * are shifted accordingly. It must be a multiple of 64 (a cache line).
+ * Since the kernel module also depends on this layout, core/kmod must be
+ * built with the same value.
+ *
  * Invariants:
  *  * When packets are newly allocated, the data should be filled from _data.
  *  * The packet data may reside in the _headroom + _data areas,
@@ -52,7 +58,9 @@
  */
 #define SNBUF_MBUF 128
 #define SNBUF_IMMUTABLE 64
+#ifndef SNBUF_METADATA
 #define SNBUF_METADATA 128
+#endif
 #define SNBUF_SCRATCHPAD 64
 #define SNBUF_RESERVE (SNBUF_IMMUTABLE + SNBUF_METADATA + SNBUF_SCRATCHPAD)
 #define SNBUF_HEADROOM 128
@@ -67,4 +75,8 @@
 
 #define SNBUF_SIZE (SNBUF_DATA_OFF + SNBUF_DATA)
 
+#if SNBUF_METADATA % 64 != 0 || SNBUF_METADATA < 64 || SNBUF_METADATA > 1024
+#error "SNBUF_METADATA must be a multiple of 64, between 64 and 1024"
+#endif
+
 #endif  // BESS_SNBUFLAYOUT_H_
@@ -50,7 +50,12 @@ struct task_result Task::operator()(Context *ctx) const {
   ClearPacketBatch();
 
   // Start from the first module (task module)
-  struct task_result result = module_->RunTask(ctx, &init_batch, arg_);
+  struct task_result result;
+  if (unlikely(bess::ModuleProfiler::enabled())) {
+    result = bess::ModuleProfiler::RunTask(ctx, module_, &init_batch, arg_);
+  } else {
+    result = module_->RunTask(ctx, &init_batch, arg_);
+  }
   // next_gate_: Continuously run if modules are chained
   // igates_to_run_ : If next module connection is not chained (merged),
   // check priority to choose which module run next
@@ -81,8 +86,12 @@ struct task_result Task::operator()(Context *ctx) const {
     }
 
     Module *m = igate->module();
-    m->ProcessBatch(ctx, batch);  // process module
-    m->ProcessOGates(ctx);        // process ogates
+    if (unlikely(bess::ModuleProfiler::enabled())) {
+      bess::ModuleProfiler::ProcessBatch(ctx, m, batch);
+    } else {
+      m->ProcessBatch(ctx, batch);  // process module
+    }
+    m->ProcessOGates(ctx);  // process ogates
   }
 
   deadend(ctx, &dead_batch_);
@@ -0,0 +1,135 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "tx_buffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace bess {
+
+// Frees "cnt" packets, which may be more than PacketBatch::kMaxBurst
+static void FreeBulk(Packet **pkts, size_t cnt) {
+  while (cnt > 0) {
+    size_t n = std::min(cnt, PacketBatch::kMaxBurst);
+    Packet::Free(pkts, n);
+    pkts += n;
+    cnt -= n;
+  }
+}
+
+static uint64_t SumBytes(Packet *const *pkts, int cnt) {
+  uint64_t bytes = 0;
+  for (int i = 0; i < cnt; i++) {
+    bytes += pkts[i]->total_len();
+  }
+  return bytes;
+}
+
+size_t TxBuffer::Clear() {
+  size_t cnt = cnt_;
+  FreeBulk(pkts_.data(), cnt_);
+  cnt_ = 0;
+  return cnt;
+}
+
+int TxBuffer::Enqueue(Packet **pkts, int cnt, uint64_t now_ns) {
+  if (cnt == 0) {
+    return 0;
+  }
+
+  if (cnt_ == 0) {
+    // Start the drain timer with the first buffered packet
+    last_progress_ns_ = now_ns;
+  }
+
+  size_t n = std::min(static_cast<size_t>(cnt), pkts_.size() - cnt_);
+  std::memcpy(&pkts_[cnt_], pkts, n * sizeof(Packet *));
+  cnt_ += n;
+
+  FreeBulk(pkts + n, cnt - n);
+  return cnt - n;
+}
+
+int TxBuffer::Send(Port *port, queue_t qid, Packet **pkts, int cnt,
+                   uint64_t now_ns, uint64_t *sent_bytes, int *dropped) {
+  int sent = 0;
+
+  *sent_bytes = 0;
+  *dropped = 0;
+
+  if (cnt_ > 0) {
+    // Ports take at most PacketBatch::kMaxBurst packets per call (e.g., VPort
+    // sizes its stack arrays by it), so retry in bursts. Stop at the first one
+    // that does not go out entirely, to keep the order.
+    size_t n = 0;
+    while (n < cnt_) {
+      int burst = std::min(cnt_ - n, PacketBatch::kMaxBurst);
+      int ret = port->SendPackets(qid, &pkts_[n], burst);
+      n += std::max(ret, 0);
+      if (ret < burst) {
+        break;
+      }
+    }
+
+    if (n > 0) {
+      *sent_bytes += SumBytes(pkts_.data(), n);
+      std::memmove(pkts_.data(), &pkts_[n], (cnt_ - n) * sizeof(Packet *));
+      cnt_ -= n;
+      sent += n;
+      last_progress_ns_ = now_ns;
+    } else if (timeout_ns_ && now_ns - last_progress_ns_ > timeout_ns_) {
+      // The port seems to be stuck. Give up on the buffered packets.
+      *dropped += Clear();
+    }
+
+    if (cnt_ > 0) {
+      // New packets must not overtake the buffered ones
+      *dropped += Enqueue(pkts, cnt, now_ns);
+      return sent;
+    }
+  }
+
+  if (cnt == 0) {
+    return sent;
+  }
+
+  int n = port->SendPackets(qid, pkts, cnt);
+  *sent_bytes += SumBytes(pkts, n);
+  sent += n;
+
+  if (n < cnt) {
+    *dropped += Enqueue(pkts + n, cnt - n, now_ns);
+  }
+
+  return sent;
+}
+
+}  // namespace bess
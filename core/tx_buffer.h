@@ -0,0 +1,90 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_TX_BUFFER_H_
+#define BESS_TX_BUFFER_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "packet.h"
+#include "port.h"
+
+namespace bess {
+
+// Holds packets that a port did not accept (e.g., a full NIC TX ring), so
+// that they can be retried on the next call instead of being dropped right
+// away. One buffer per TX queue; not thread-safe.
+class TxBuffer {
+ public:
+  // Upper bound on "capacity". Far beyond any NIC TX ring, it only keeps a
+  // misconfigured buffer from hoarding the packet pool.
+  static const size_t kMaxCapacity = 8192;
+
+  TxBuffer() : pkts_(), cnt_(), timeout_ns_(), last_progress_ns_() {}
+
+  ~TxBuffer() { Clear(); }
+
+  // Holds up to "capacity" packets. Buffered packets are dropped once the
+  // port makes no progress for "timeout_ns" (0 means never).
+  void Init(size_t capacity, uint64_t timeout_ns) {
+    Clear();
+    pkts_.resize(capacity);
+    timeout_ns_ = timeout_ns;
+  }
+
+  // Sends the buffered packets, then "pkts" (in order; "cnt" may be 0). What
+  // the port does not take is buffered while there is room, and freed
+  // otherwise. Returns the number of packets sent, and their bytes in
+  // "*sent_bytes". The number of freed packets is returned in "*dropped".
+  int Send(Port *port, queue_t qid, Packet **pkts, int cnt, uint64_t now_ns,
+           uint64_t *sent_bytes, int *dropped);
+
+  // Frees all buffered packets. Returns how many there were.
+  size_t Clear();
+
+  size_t cnt() const { return cnt_; }
+  size_t capacity() const { return pkts_.size(); }
+
+ private:
+  // Appends as many of "pkts" as fit, and frees the rest. Returns the number of
+  // freed packets.
+  int Enqueue(Packet **pkts, int cnt, uint64_t now_ns);
+
+  std::vector<Packet *> pkts_;
+  size_t cnt_;
+
+  uint64_t timeout_ns_;
+  uint64_t last_progress_ns_;  // last time a packet left the buffer
+};
+
+}  // namespace bess
+
+#endif  // BESS_TX_BUFFER_H_
@@ -0,0 +1,171 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "tx_buffer.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace bess {
+namespace {
+
+// Takes up to "room" packets per call, keeping them in order
+class SlowPort : public Port {
+ public:
+  SlowPort() : Port(), room(), max_burst(), sent() {}
+
+  void DeInit() override {}
+
+  int RecvPackets(queue_t, Packet **, int) override { return 0; }
+
+  int SendPackets(queue_t, Packet **pkts, int cnt) override {
+    int n = std::min(cnt, room);
+    max_burst = std::max(max_burst, cnt);
+    sent.insert(sent.end(), pkts, pkts + n);
+    room -= n;
+    return n;
+  }
+
+  int room;
+  int max_burst;  // largest "cnt" seen
+  std::vector<Packet *> sent;
+};
+
+class TxBufferTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    for (size_t i = 0; i < kNumPkts; i++) {
+      pkts_[i] = new Packet();
+      pkts_[i]->set_total_len(100);
+    }
+  }
+
+  virtual void TearDown() {
+    for (size_t i = 0; i < kNumPkts; i++) {
+      delete pkts_[i];
+    }
+  }
+
+  static const size_t kNumPkts = 80;
+
+  SlowPort port_;
+  Packet *pkts_[kNumPkts];
+};
+
+TEST_F(TxBufferTest, RetryInOrder) {
+  TxBuffer buf;
+  uint64_t bytes;
+  int dropped;
+
+  buf.Init(16, 0);
+
+  // Only 2 out of 4 packets go out
+  port_.room = 2;
+  EXPECT_EQ(2, buf.Send(&port_, 0, pkts_, 4, 0, &bytes, &dropped));
+  EXPECT_EQ(200, bytes);
+  EXPECT_EQ(0, dropped);
+  EXPECT_EQ(2, buf.cnt());
+
+  // The port is stuck, so new packets are buffered behind the old ones
+  EXPECT_EQ(0, buf.Send(&port_, 0, pkts_ + 4, 4, 1, &bytes, &dropped));
+  EXPECT_EQ(0, dropped);
+  EXPECT_EQ(6, buf.cnt());
+
+  // Drain without new packets
+  port_.room = 3;
+  EXPECT_EQ(3, buf.Send(&port_, 0, nullptr, 0, 2, &bytes, &dropped));
+  EXPECT_EQ(300, bytes);
+  EXPECT_EQ(3, buf.cnt());
+
+  port_.room = 100;
+  EXPECT_EQ(7, buf.Send(&port_, 0, pkts_ + 8, 4, 3, &bytes, &dropped));
+  EXPECT_EQ(0, buf.cnt());
+
+  ASSERT_EQ(12, port_.sent.size());
+  for (size_t i = 0; i < port_.sent.size(); i++) {
+    EXPECT_EQ(pkts_[i], port_.sent[i]) << i;
+  }
+}
+
+TEST_F(TxBufferTest, Capacity) {
+  TxBuffer buf;
+  uint64_t bytes;
+  int dropped;
+
+  buf.Init(4, 0);
+  EXPECT_EQ(4, buf.capacity());
+
+  port_.room = 0;
+  EXPECT_EQ(0, buf.Send(&port_, 0, pkts_, 4, 0, &bytes, &dropped));
+  EXPECT_EQ(0, dropped);
+  EXPECT_EQ(4, buf.cnt());
+
+  port_.room = 4;
+  EXPECT_EQ(4, buf.Send(&port_, 0, nullptr, 0, 0, &bytes, &dropped));
+  EXPECT_EQ(0, buf.cnt());
+}
+
+// A full buffer is larger than what a port takes per call
+TEST_F(TxBufferTest, RetryInBursts) {
+  TxBuffer buf;
+  uint64_t bytes;
+  int dropped;
+
+  buf.Init(kNumPkts, 0);
+
+  port_.room = 0;
+  for (size_t i = 0; i < kNumPkts; i += PacketBatch::kMaxBurst) {
+    int cnt = std::min(kNumPkts - i, PacketBatch::kMaxBurst);
+    EXPECT_EQ(0, buf.Send(&port_, 0, pkts_ + i, cnt, 0, &bytes, &dropped));
+    EXPECT_EQ(0, dropped);
+  }
+  EXPECT_EQ(80, buf.cnt());
+
+  // Two full bursts, then a partial one ends the retry
+  port_.room = 70;
+  EXPECT_EQ(70, buf.Send(&port_, 0, nullptr, 0, 1, &bytes, &dropped));
+  EXPECT_EQ(7000, bytes);
+  EXPECT_EQ(10, buf.cnt());
+
+  port_.room = 100;
+  EXPECT_EQ(10, buf.Send(&port_, 0, nullptr, 0, 2, &bytes, &dropped));
+  EXPECT_EQ(0, buf.cnt());
+
+  EXPECT_EQ(static_cast<int>(PacketBatch::kMaxBurst), port_.max_burst);
+
+  ASSERT_EQ(80, port_.sent.size());
+  for (size_t i = 0; i < port_.sent.size(); i++) {
+    EXPECT_EQ(pkts_[i], port_.sent[i]) << i;
+  }
+}
+
+}  // namespace
+}  // namespace bess
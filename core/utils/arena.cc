@@ -0,0 +1,290 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "arena.h"
+
+#include <numaif.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace bess {
+namespace utils {
+
+// Transparent hugepages are PMD sized
+static const size_t kThpSize = 2 * 1024 * 1024;
+
+// Returns the size of the pages MAP_HUGETLB maps, which is 1GB on some
+// systems, or 0 if unknown.
+static size_t DefaultHugepageSize() {
+  static size_t size = [] {
+    FILE *fp = fopen("/proc/meminfo", "r");
+    char line[128];
+    unsigned long kb = 0;
+
+    if (!fp) {
+      return static_cast<size_t>(0);
+    }
+
+    while (fgets(line, sizeof(line), fp)) {
+      if (sscanf(line, "Hugepagesize: %lu kB", &kb) == 1) {
+        break;
+      }
+    }
+
+    fclose(fp);
+    return static_cast<size_t>(kb * 1024);
+  }();
+
+  return size;
+}
+
+static int PreferSocket(void *addr, size_t len, int socket) {
+  unsigned long nodemask;
+
+  if (socket < 0) {
+    return 0;
+  }
+
+  // mbind() only looks at maxnode - 1 bits of the mask
+  if (socket >= static_cast<int>(sizeof(nodemask) * 8 - 1)) {
+    return -EINVAL;
+  }
+
+  nodemask = 1ul << socket;
+  if (mbind(addr, len, MPOL_PREFERRED, &nodemask, sizeof(nodemask) * 8,
+            MPOL_MF_MOVE)) {
+    return -errno;
+  }
+
+  return 0;
+}
+
+Arena::~Arena() {
+  if (base_) {
+    munmap(base_, capacity_);
+  }
+}
+
+int Arena::Init(size_t capacity, int socket) {
+  void *addr;
+
+  if (base_) {
+    return -EEXIST;
+  }
+
+  if (capacity == 0) {
+    return -EINVAL;
+  }
+
+  // Explicit hugepages first. This fails if the hugetlbfs pool (which DPDK
+  // also draws from) does not have enough free pages. Pages much larger than
+  // the request (e.g., 1GB for a small table) are not worth it.
+  size_t hugepage_size = DefaultHugepageSize();
+  addr = MAP_FAILED;
+  if (hugepage_size &&
+      (hugepage_size <= kThpSize || capacity >= hugepage_size)) {
+    size_t len = align_ceil(capacity, hugepage_size);
+    addr = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (addr != MAP_FAILED) {
+      capacity = len;
+    }
+  }
+
+  if (addr != MAP_FAILED) {
+    hugepage_ = true;
+  } else {
+    // Otherwise ask for transparent hugepages on a 2MB-aligned region
+    capacity = align_ceil(capacity, kThpSize);
+    size_t len = capacity + kThpSize;
+    char *raw = static_cast<char *>(mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (raw == MAP_FAILED) {
+      return -errno;
+    }
+
+    char *aligned = reinterpret_cast<char *>(
+        align_ceil(reinterpret_cast<uintptr_t>(raw), kThpSize));
+    if (aligned > raw) {
+      munmap(raw, aligned - raw);
+    }
+    if (raw + len > aligned + capacity) {
+      munmap(aligned + capacity, raw + len - (aligned + capacity));
+    }
+
+    addr = aligned;
+    madvise(addr, capacity, MADV_HUGEPAGE);
+    hugepage_ = false;
+  }
+
+  // Not fatal; we just lose locality
+  PreferSocket(addr, capacity, socket);
+
+  // Fault everything in now rather than in the datapath
+  memset(addr, 0, capacity);
+
+  base_ = static_cast<char *>(addr);
+  capacity_ = capacity;
+
+  size_t bits = 0;
+  for (int cls = kMinClass; cls < kNumClasses; cls++) {
+    free_map_start_[cls] = bits;
+    bits += capacity_ >> cls;
+  }
+  free_map_.assign((bits + 63) / 64, 0);
+
+  // Carve the region into the largest blocks that are aligned to their size
+  // (relative to base_, which is hugepage aligned)
+  for (size_t offset = 0; offset < capacity_;) {
+    int cls = kNumClasses - 1;
+    while ((offset & ((1ul << cls) - 1)) ||
+           offset + (1ul << cls) > capacity_) {
+      cls--;
+    }
+    Push(cls, base_ + offset);
+    offset += 1ul << cls;
+  }
+
+  return 0;
+}
+
+void Arena::Push(int cls, char *block) {
+  FreeBlock *b = reinterpret_cast<FreeBlock *>(block);
+  size_t bit = free_map_start_[cls] + ((block - base_) >> cls);
+
+  b->next = free_lists_[cls];
+  b->prev = nullptr;
+  if (b->next) {
+    b->next->prev = b;
+  }
+  free_lists_[cls] = b;
+
+  free_map_[bit / 64] |= 1ul << (bit % 64);
+}
+
+void Arena::Remove(int cls, char *block) {
+  FreeBlock *b = reinterpret_cast<FreeBlock *>(block);
+  size_t bit = free_map_start_[cls] + ((block - base_) >> cls);
+
+  if (b->prev) {
+    b->prev->next = b->next;
+  } else {
+    free_lists_[cls] = b->next;
+  }
+  if (b->next) {
+    b->next->prev = b->prev;
+  }
+
+  free_map_[bit / 64] &= ~(1ul << (bit % 64));
+}
+
+void *Arena::Alloc(size_t size, size_t align) {
+  size_t block = std::max(size, kMinBlockSize);
+  int cls = SizeClass(block);
+
+  block = 1ul << cls;
+
+  // Blocks are aligned to their size (up to kMaxAlign), which covers any
+  // alignment not larger than the block itself.
+  if (base_ && align <= std::min(block, kMaxAlign) && cls < kNumClasses) {
+    int c = cls;
+    while (c < kNumClasses && !free_lists_[c]) {
+      c++;
+    }
+
+    if (c < kNumClasses) {
+      char *ptr = reinterpret_cast<char *>(free_lists_[c]);
+      Remove(c, ptr);
+
+      // Keep the lower half, and free the upper one
+      while (c > cls) {
+        c--;
+        Push(c, ptr + (1ul << c));
+      }
+
+      used_ += block;
+      peak_ = std::max(peak_, used_);
+      return ptr;
+    }
+  }
+
+  void *ptr;
+  if (posix_memalign(&ptr, std::max(align, sizeof(void *)), size)) {
+    return nullptr;
+  }
+
+  overflow_ += size;
+  return ptr;
+}
+
+void Arena::Free(void *ptr, size_t size) {
+  if (!ptr) {
+    return;
+  }
+
+  if (!Contains(ptr)) {
+    overflow_ -= size;
+    free(ptr);
+    return;
+  }
+
+  int cls = SizeClass(std::max(size, kMinBlockSize));
+  size_t offset = static_cast<char *>(ptr) - base_;
+
+  used_ -= 1ul << cls;
+
+  // Merge with the buddy for as long as it is free as a whole
+  for (; cls < kNumClasses - 1; cls++) {
+    size_t buddy = offset ^ (1ul << cls);
+    if (buddy + (1ul << cls) > capacity_ || !IsFree(cls, buddy)) {
+      break;
+    }
+    Remove(cls, base_ + buddy);
+    offset &= ~(1ul << cls);
+  }
+
+  Push(cls, base_ + offset);
+}
+
+int Arena::Migrate(int socket) {
+  if (!base_) {
+    return 0;
+  }
+
+  return PreferSocket(base_, capacity_, socket);
+}
+
+}  // namespace utils
+}  // namespace bess
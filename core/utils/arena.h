@@ -0,0 +1,212 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_ARENA_H_
+#define BESS_UTILS_ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "common.h"
+
+namespace bess {
+namespace utils {
+
+// A fixed-size memory region for module-owned data structures (flow tables,
+// hash maps, rings). The region is reserved once, at module init time, from
+// hugepages if available (falling back to transparent hugepages), so large
+// tables do not pay 4K-page TLB misses.
+//
+// Allocation is by power-of-two size classes, buddy style: a larger free block
+// is split in halves to serve a request, and a freed block merges with its
+// free buddy, so memory freed in small blocks is available to large requests
+// again. Requests that do not fit in the region are served from the general
+// heap and accounted separately, so a too-small arena only loses the TLB
+// benefit. Not thread safe: an arena has the same threading constraints as the
+// structures that use it.
+class Arena {
+ public:
+  static const size_t kMinBlockSize = 16;
+  static const size_t kMaxAlign = 4096;
+
+  Arena()
+      : base_(nullptr),
+        capacity_(0),
+        hugepage_(false),
+        used_(0),
+        peak_(0),
+        overflow_(0),
+        free_lists_(),
+        free_map_(),
+        free_map_start_() {}
+
+  ~Arena();
+
+  // Reserves at least 'capacity' bytes, placed on NUMA node 'socket' (-1 for
+  // no preference). Returns 0 on success, -errno otherwise.
+  int Init(size_t capacity, int socket);
+
+  // Returns memory for 'size' bytes aligned to 'align', or nullptr if even
+  // the heap fallback fails.
+  void *Alloc(size_t size, size_t align = alignof(std::max_align_t));
+
+  // 'size' must be the same value that was passed to Alloc()
+  void Free(void *ptr, size_t size);
+
+  // Moves the region to NUMA node 'socket'. Returns 0 or -errno.
+  int Migrate(int socket);
+
+  bool Contains(const void *ptr) const {
+    return ptr >= base_ && ptr < base_ + capacity_;
+  }
+
+  // Bytes reserved for the arena
+  size_t capacity() const { return capacity_; }
+  // Bytes currently handed out from the region (rounded to size classes)
+  size_t used() const { return used_; }
+  // High watermark of used()
+  size_t peak() const { return peak_; }
+  // Bytes currently served from the heap because the region was exhausted
+  size_t overflow() const { return overflow_; }
+  // True if the region is backed by explicit (hugetlbfs) hugepages
+  bool hugepage() const { return hugepage_; }
+
+ private:
+  static const int kNumClasses = 48;
+  static const int kMinClass = 4;  // of kMinBlockSize
+
+  struct FreeBlock {
+    FreeBlock *next;
+    FreeBlock *prev;
+  };
+
+  static_assert(sizeof(FreeBlock) <= kMinBlockSize,
+                "Free blocks must hold their header");
+
+  static int SizeClass(size_t size) {
+    return 64 - __builtin_clzll(size - 1);
+  }
+
+  // Free lists, which also keep free_map_ up to date
+  void Push(int cls, char *block);
+  void Remove(int cls, char *block);
+
+  // Is there a free block of class "cls" at "offset" from base_?
+  bool IsFree(int cls, size_t offset) const {
+    size_t bit = free_map_start_[cls] + (offset >> cls);
+    return (free_map_[bit / 64] >> (bit % 64)) & 1;
+  }
+
+  char *base_;
+  size_t capacity_;
+  bool hugepage_;
+
+  size_t used_;
+  size_t peak_;
+  size_t overflow_;
+
+  FreeBlock *free_lists_[kNumClasses];
+
+  // A bit per possible block of each class, set if it is free. Kept outside
+  // the region, since allocated blocks have no header.
+  std::vector<uint64_t> free_map_;
+  size_t free_map_start_[kNumClasses];  // first bit of each class
+
+  DISALLOW_COPY_AND_ASSIGN(Arena);
+};
+
+// A C++ allocator drawing from an Arena, e.g.,
+//
+//   std::unordered_map<K, V, H, std::equal_to<K>,
+//                      ArenaAllocator<std::pair<const K, V>>>
+//       map(0, H(), std::equal_to<K>(), ArenaAllocator<...>(arena));
+//
+// A default-constructed (null) allocator uses the general heap, so containers
+// can carry the allocator type whether or not their owner has an arena.
+template <typename T>
+class ArenaAllocator {
+ public:
+  typedef T value_type;
+  typedef std::true_type propagate_on_container_copy_assignment;
+  typedef std::true_type propagate_on_container_move_assignment;
+  typedef std::true_type propagate_on_container_swap;
+
+  ArenaAllocator(Arena *arena = nullptr) noexcept : arena_(arena) {}
+
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U> &other) noexcept
+      : arena_(other.arena()) {}
+
+  T *allocate(size_t n) {
+    void *ptr;
+    if (arena_) {
+      ptr = arena_->Alloc(n * sizeof(T), alignof(T));
+      if (!ptr) {
+        throw std::bad_alloc();
+      }
+    } else {
+      ptr = ::operator new(n * sizeof(T));
+    }
+    return static_cast<T *>(ptr);
+  }
+
+  void deallocate(T *ptr, size_t n) noexcept {
+    if (arena_) {
+      arena_->Free(ptr, n * sizeof(T));
+    } else {
+      ::operator delete(ptr);
+    }
+  }
+
+  Arena *arena() const { return arena_; }
+
+ private:
+  Arena *arena_;
+};
+
+template <typename T, typename U>
+inline bool operator==(const ArenaAllocator<T> &a,
+                       const ArenaAllocator<U> &b) {
+  return a.arena() == b.arena();
+}
+
+template <typename T, typename U>
+inline bool operator!=(const ArenaAllocator<T> &a,
+                       const ArenaAllocator<U> &b) {
+  return a.arena() != b.arena();
+}
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_ARENA_H_
@@ -0,0 +1,154 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "arena.h"
+
+#include <gtest/gtest.h>
+
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+using bess::utils::Arena;
+using bess::utils::ArenaAllocator;
+
+TEST(ArenaTest, AllocFree) {
+  Arena arena;
+  ASSERT_EQ(0, arena.Init(1, -1));
+  EXPECT_GE(arena.capacity(), 2 * 1024 * 1024);
+
+  void *a = arena.Alloc(100, 8);
+  ASSERT_NE(nullptr, a);
+  EXPECT_TRUE(arena.Contains(a));
+  EXPECT_EQ(128, arena.used());
+
+  void *b = arena.Alloc(4096, 4096);
+  ASSERT_NE(nullptr, b);
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(b) % 4096);
+
+  // Freed blocks are reused by requests of the same size class
+  arena.Free(a, 100);
+  EXPECT_EQ(4096, arena.used());
+  EXPECT_EQ(a, arena.Alloc(120, 8));
+
+  EXPECT_EQ(4096 + 128, arena.peak());
+  EXPECT_EQ(0, arena.overflow());
+}
+
+TEST(ArenaTest, Overflow) {
+  Arena arena;
+  ASSERT_EQ(0, arena.Init(1, -1));
+
+  size_t big = arena.capacity() * 2;
+  void *p = arena.Alloc(big);
+  ASSERT_NE(nullptr, p);
+  EXPECT_FALSE(arena.Contains(p));
+  EXPECT_EQ(big, arena.overflow());
+  EXPECT_EQ(0, arena.used());
+
+  arena.Free(p, big);
+  EXPECT_EQ(0, arena.overflow());
+}
+
+TEST(ArenaTest, Containers) {
+  Arena arena;
+  ASSERT_EQ(0, arena.Init(4 * 1024 * 1024, -1));
+
+  {
+    std::vector<uint64_t, ArenaAllocator<uint64_t>> v(
+        (ArenaAllocator<uint64_t>(&arena)));
+    for (uint64_t i = 0; i < 10000; i++) {
+      v.push_back(i);
+    }
+    EXPECT_TRUE(arena.Contains(v.data()));
+
+    typedef std::pair<const int, int> value_type;
+    std::map<int, int, std::less<int>, ArenaAllocator<value_type>> m(
+        (ArenaAllocator<value_type>(&arena)));
+    std::unordered_map<int, int, std::hash<int>, std::equal_to<int>,
+                       ArenaAllocator<value_type>>
+        um(0, std::hash<int>(), std::equal_to<int>(),
+           ArenaAllocator<value_type>(&arena));
+    for (int i = 0; i < 1000; i++) {
+      m[i] = i;
+      um[i] = i;
+    }
+    EXPECT_EQ(999, m[999]);
+    EXPECT_EQ(999, um[999]);
+    EXPECT_GT(arena.used(), 10000 * sizeof(uint64_t));
+  }
+
+  EXPECT_EQ(0, arena.used());
+  EXPECT_EQ(0, arena.overflow());
+}
+
+// Memory freed in small blocks must be available to large ones again
+TEST(ArenaTest, GrowShrink) {
+  Arena arena;
+  ASSERT_EQ(0, arena.Init(1, -1));
+
+  const size_t half = arena.capacity() / 2;
+  ArenaAllocator<uint64_t> alloc(&arena);
+
+  for (int i = 0; i < 10; i++) {
+    // Many small nodes, filling most of the arena
+    std::list<uint64_t, ArenaAllocator<uint64_t>> l(alloc);
+    while (arena.used() < half + half / 2) {
+      l.push_back(i);
+    }
+    l.clear();
+    EXPECT_EQ(0, arena.used());
+
+    // Then a vector that grows to half of the arena
+    std::vector<uint64_t, ArenaAllocator<uint64_t>> v(alloc);
+    while (v.size() < half / sizeof(uint64_t)) {
+      v.push_back(i);
+    }
+    EXPECT_TRUE(arena.Contains(v.data())) << i;
+    EXPECT_EQ(half, arena.used());
+
+    v.clear();
+    v.shrink_to_fit();
+    EXPECT_EQ(0, arena.used());
+  }
+
+  EXPECT_EQ(0, arena.overflow());
+}
+
+TEST(ArenaTest, NullAllocatorUsesHeap) {
+  std::vector<int, ArenaAllocator<int>> v;
+  v.resize(100);
+  EXPECT_EQ(nullptr, v.get_allocator().arena());
+}
+
+}  // namespace (unnamed)
@@ -180,6 +180,42 @@ static inline uint32_t CalculateSum(const void *buf, size_t len) {
   return static_cast<uint32_t>(sum64);
 }
 
+// Adds two 32-bit one's complement sums
+static inline uint32_t AddSum(uint32_t a, uint32_t b) {
+  uint64_t sum64 = static_cast<uint64_t>(a) + b;
+  return static_cast<uint32_t>((sum64 >> 32) + (sum64 & 0xFFFFFFFF));
+}
+
+// Returns 32-bit one's complement sum of 'len' bytes from 'buf', where 'buf'
+// starts at byte 'offset' of the checksummed data. Non-contiguous data (e.g.,
+// segments of a chained packet) can be summed piece by piece this way, and the
+// partial sums combined with AddSum().
+static inline uint32_t CalculateSumAt(const void *buf, size_t len,
+                                      size_t offset) {
+  uint32_t sum = CalculateSum(buf, len);
+
+  if (offset & 1) {
+    // Bytes at odd offsets contribute to the other half of 16-bit words
+    sum = (sum >> 16) + (sum & 0xFFFF);
+    sum = (sum >> 16) + (sum & 0xFFFF);
+    sum = ((sum & 0xFF) << 8) | (sum >> 8);
+  }
+
+  return sum;
+}
+
+// Returns 32-bit one's complement sum of the IPv4 pseudo header.
+// 'len' (L4 header + payload in bytes) is in host-order.
+static inline uint32_t CalculateIpv4PseudoHeaderSum(be32_t src, be32_t dst,
+                                                    uint8_t proto,
+                                                    uint16_t len) {
+  uint64_t sum64 = static_cast<uint64_t>(src.raw_value()) + dst.raw_value() +
+                   be16_t::swap(len) + (static_cast<uint32_t>(proto) << 8);
+
+  sum64 = (sum64 >> 32) + (sum64 & 0xFFFFFFFF);
+  return static_cast<uint32_t>(sum64 + (sum64 >> 32));
+}
+
 // Fold a 32-bit non-inverted checksum into a inverted 16-bit one,
 // which can be readily written to L3/L4 checksum field
 static inline uint16_t FoldChecksum(uint32_t cksum) {
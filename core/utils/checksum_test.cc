@@ -81,6 +81,27 @@ TEST(ChecksumTest, GenericChecksum) {
   }
 }
 
+// Tests checksum of data split into pieces at arbitrary (even or odd) offsets
+TEST(ChecksumTest, ScatteredChecksum) {
+  uint8_t buf[300];
+
+  for (int i = 0; i < 1000; i++) {
+    for (size_t j = 0; j < sizeof(buf); j++) {
+      buf[j] = rd.Get();
+    }
+
+    size_t split1 = rd.GetRange(sizeof(buf));
+    size_t split2 = split1 + rd.GetRange(sizeof(buf) - split1);
+
+    uint32_t sum = CalculateSumAt(buf, split1, 0);
+    sum = AddSum(sum, CalculateSumAt(buf + split1, split2 - split1, split1));
+    sum = AddSum(sum, CalculateSumAt(buf + split2, sizeof(buf) - split2,
+                                     split2));
+
+    EXPECT_EQ(CalculateGenericChecksum(buf, sizeof(buf)), FoldChecksum(sum));
+  }
+}
+
 // Tests IP checksum
 TEST(ChecksumTest, Ipv4NoOptChecksum) {
   char buf[1514] = {0};  // ipv4 header w/o options
@@ -302,6 +323,14 @@ TEST(ChecksumTest, TcpChecksum) {
   tcp->checksum = cksum_bess;
   EXPECT_TRUE(VerifyIpv4TcpChecksum(*ip, *tcp));
 
+  // Pseudo header sum + TCP segment sum must give the same result
+  tcp->checksum = 0;
+  uint32_t sum = CalculateIpv4PseudoHeaderSum(ip->src, ip->dst, ip->protocol,
+                                              sizeof(*tcp));
+  sum = AddSum(sum, CalculateSum(tcp, sizeof(*tcp)));
+  EXPECT_EQ(cksum_bess, FoldChecksum(sum));
+  tcp->checksum = cksum_bess;
+
   // Should not crash with incorrect IP headers
   ip->length = be16_t(39);
   EXPECT_EQ(0, CalculateIpv4TcpChecksum(*ip, *tcp));
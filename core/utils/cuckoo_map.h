@@ -39,6 +39,7 @@
 #define BESS_UTILS_CUCKOOMAP_H_
 
 #include <algorithm>
+#include <deque>
 #include <functional>
 #include <limits>
 #include <stack>
@@ -49,6 +50,7 @@
 #include <glog/logging.h>
 
 #include "../debug.h"
+#include "arena.h"
 #include "common.h"
 
 namespace bess {
@@ -147,13 +149,14 @@ class CuckooMap {
     size_t slot_idx_;
   };
 
+  // If 'arena' is given, buckets and entries are allocated from it
   CuckooMap(size_t reserve_buckets = kInitNumBucket,
-            size_t reserve_entries = kInitNumEntries)
+            size_t reserve_entries = kInitNumEntries, Arena* arena = nullptr)
       : bucket_mask_(reserve_buckets - 1),
         num_entries_(0),
-        buckets_(reserve_buckets),
-        entries_(reserve_entries),
-        free_entry_indices_() {
+        buckets_(reserve_buckets, ArenaAllocator<Bucket>(arena)),
+        entries_(reserve_entries, ArenaAllocator<Entry>(arena)),
+        free_entry_indices_(ArenaAllocator<EntryIndex>(arena)) {
     // the number of buckets must be a power of 2
     CHECK_EQ(align_ceil_pow2(reserve_buckets), reserve_buckets);
 
@@ -229,6 +232,29 @@ class CuckooMap {
     return ret;
   }
 
+  // Batched version of Find(). Sets entries[i] to the entry of keys[i], or
+  // nullptr if not exist. All keys are hashed and their buckets prefetched
+  // first, so that the bucket misses of the batch overlap.
+  void FindBulk(const K* keys, const Entry** entries, size_t n,
+                const H& hasher = H(), const E& eq = E()) const {
+    HashResult hashes[kBulkChunk];
+
+    for (size_t base = 0; base < n; base += kBulkChunk) {
+      size_t cnt = (n - base < kBulkChunk) ? n - base : kBulkChunk;
+
+      for (size_t i = 0; i < cnt; i++) {
+        hashes[i] = Hash(keys[base + i], hasher);
+        __builtin_prefetch(&buckets_[hashes[i] & bucket_mask_]);
+      }
+
+      for (size_t i = 0; i < cnt; i++) {
+        EntryIndex idx = FindWithHash(hashes[i], keys[base + i], eq);
+        entries[base + i] =
+            (idx == kInvalidEntryIdx) ? nullptr : &entries_[idx];
+      }
+    }
+  }
+
   // Remove the stored entry by the key
   // Return false if not exist.
   bool Remove(const K& key, const H& hasher = H(), const E& eq = E()) {
@@ -262,9 +288,48 @@ class CuckooMap {
     }
   }
 
+  // Visits the entries in num_buckets buckets, starting at *cursor, and
+  // removes those for which should_remove(entry) returns true. *cursor is
+  // advanced past the visited buckets (wrapping around), so that calling this
+  // repeatedly garbage-collects the whole table a few buckets at a time.
+  // Returns the number of removed entries.
+  template <typename F>
+  size_t Sweep(size_t* cursor, size_t num_buckets, F should_remove) {
+    size_t removed = 0;
+
+    for (size_t i = 0; i < num_buckets; i++) {
+      Bucket& bucket = buckets_[(*cursor + i) & bucket_mask_];
+
+      for (int slot_idx = 0; slot_idx < kEntriesPerBucket; slot_idx++) {
+        if (bucket.hash_values[slot_idx] == 0) {
+          continue;
+        }
+
+        EntryIndex idx = bucket.entry_indices[slot_idx];
+        if (should_remove(entries_[idx])) {
+          bucket.hash_values[slot_idx] = 0;
+          entries_[idx] = Entry();
+          PushFreeEntryIndex(idx);
+          num_entries_--;
+          removed++;
+        }
+      }
+    }
+
+    *cursor = (*cursor + num_buckets) & bucket_mask_;
+    return removed;
+  }
+
   // Return the number of stored entries
   size_t Count() const { return num_entries_; }
 
+  // Return the number of bytes reserved for buckets and entries
+  size_t MemoryUsage() const {
+    return buckets_.capacity() * sizeof(Bucket) +
+           entries_.capacity() * sizeof(Entry) +
+           free_entry_indices_.size() * sizeof(EntryIndex);
+  }
+
  protected:
   // Tunable macros
   static const int kInitNumBucket = 4;
@@ -277,6 +342,9 @@ class CuckooMap {
   // of insertion will grow exponentially, so be careful.
   static const int kMaxCuckooPath = 3;
 
+  // Number of keys FindBulk() hashes ahead of lookups
+  static const size_t kBulkChunk = 32;
+
   /* non-tunable macros */
   static const EntryIndex kInvalidEntryIdx =
       std::numeric_limits<EntryIndex>::max();
@@ -502,7 +570,8 @@ class CuckooMap {
 
   // Resize the space of buckets, and rehash existing entries
   void ExpandBuckets(const H& hasher, const E& eq) {
-    CuckooMap<K, V, H, E> bigger(buckets_.size() * 2, entries_.size());
+    CuckooMap<K, V, H, E> bigger(buckets_.size() * 2, entries_.size(),
+                                 buckets_.get_allocator().arena());
 
     for (const auto& e : *this) {
       // While very unlikely, this insert() may cause recursive expansion
@@ -526,11 +595,12 @@ class CuckooMap {
   size_t num_entries_;
 
   // bucket and entry arrays grow independently
-  std::vector<Bucket> buckets_;
-  std::vector<Entry> entries_;
+  std::vector<Bucket, ArenaAllocator<Bucket>> buckets_;
+  std::vector<Entry, ArenaAllocator<Entry>> entries_;
 
   // Stack of free entries
-  std::stack<EntryIndex> free_entry_indices_;
+  std::stack<EntryIndex, std::deque<EntryIndex, ArenaAllocator<EntryIndex>>>
+      free_entry_indices_;
 };
 
 }  // namespace utils
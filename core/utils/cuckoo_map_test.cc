@@ -62,6 +62,31 @@ TEST(CuckooMapTest, Find) {
   EXPECT_EQ(cuckoo.Find(4), nullptr);
 }
 
+// Test FindBulk function, with more keys than one chunk
+TEST(CuckooMapTest, FindBulk) {
+  CuckooMap<uint32_t, uint16_t> cuckoo;
+  const size_t n = 100;
+  uint32_t keys[n];
+  const CuckooMap<uint32_t, uint16_t>::Entry *entries[n];
+
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = i;
+    if (i % 3) {
+      cuckoo.Insert(i, i + 1000);
+    }
+  }
+
+  cuckoo.FindBulk(keys, entries, n);
+  for (size_t i = 0; i < n; i++) {
+    if (i % 3) {
+      ASSERT_NE(nullptr, entries[i]);
+      EXPECT_EQ(i + 1000, entries[i]->second);
+    } else {
+      EXPECT_EQ(nullptr, entries[i]);
+    }
+  }
+}
+
 // Test Remove function
 TEST(CuckooMapTest, Remove) {
   CuckooMap<uint32_t, uint16_t> cuckoo;
@@ -114,6 +139,36 @@ TEST(CuckooMapTest, Clear) {
   EXPECT_FALSE(cuckoo.Remove(2));
 }
 
+// Test Sweep function, removing odd values a few buckets at a time
+TEST(CuckooMapTest, Sweep) {
+  CuckooMap<uint32_t, uint16_t> cuckoo;
+  const uint32_t n = 1000;
+
+  for (uint32_t i = 0; i < n; i++) {
+    cuckoo.Insert(i, i);
+  }
+
+  size_t cursor = 0;
+  size_t removed = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    removed += cuckoo.Sweep(&cursor, 3, [](std::pair<uint32_t, uint16_t> &e) {
+      return e.second % 2 == 1;
+    });
+  }
+
+  EXPECT_EQ(n / 2, removed);
+  EXPECT_EQ(n / 2, cuckoo.Count());
+  for (uint32_t i = 0; i < n; i++) {
+    EXPECT_EQ(i % 2 == 0, cuckoo.Find(i) != nullptr);
+  }
+
+  // The freed entries can be reused
+  for (uint32_t i = n; i < n + n / 2; i++) {
+    ASSERT_NE(nullptr, cuckoo.Insert(i, i));
+  }
+  EXPECT_EQ(n, cuckoo.Count());
+}
+
 // Test iterators
 TEST(CuckooMapTest, Iterator) {
   CuckooMap<uint32_t, uint16_t> cuckoo;
@@ -0,0 +1,1492 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "ebpf.h"
+
+#include <rte_config.h>
+#include <rte_hash_crc.h>
+
+#include <algorithm>
+#include <bitset>
+#include <cinttypes>
+#include <cstring>
+
+#include "format.h"
+#include "time.h"
+
+namespace bess {
+namespace utils {
+namespace ebpf {
+
+namespace {
+
+using HelperFunc = uint64_t (*)(uint64_t, uint64_t, uint64_t, uint64_t,
+                                uint64_t);
+
+// What helpers expect in R1-R5
+enum ArgType : uint8_t {
+  kArgNone = 0,
+  kArgAnything,  // Any scalar
+  kArgCtx,
+  kArgMap,
+  kArgMapKey,    // key_size bytes of stack, map value or packet
+  kArgMapValue,  // value_size bytes of stack, map value or packet
+  kArgMemRead,   // Stack or map value, with its size in the next argument
+  kArgMemWrite,  // Same, filled in full by the helper even on failure
+  kArgMemSize,   // Constant, greater than 0
+  kArgAttr,      // Constant index of a metadata attribute
+};
+
+enum RetType : uint8_t {
+  kRetScalar = 0,
+  kRetMapValueOrNull,
+};
+
+struct HelperSpec {
+  int32_t id;
+  HelperFunc func;
+  RetType ret;
+  ArgType args[5];
+  bool changes_packet;  // Invalidates pointers to packet data
+};
+
+inline uint64_t Errno(int err) {
+  return static_cast<uint64_t>(static_cast<int64_t>(-err));
+}
+
+inline PacketContext *AsContext(uint64_t r) {
+  return reinterpret_cast<PacketContext *>(r);
+}
+
+uint64_t MapLookupElem(uint64_t map, uint64_t key, uint64_t, uint64_t,
+                       uint64_t) {
+  void *value = reinterpret_cast<Map *>(map)->Lookup(
+      reinterpret_cast<const void *>(key));
+  return reinterpret_cast<uintptr_t>(value);
+}
+
+uint64_t MapUpdateElem(uint64_t map, uint64_t key, uint64_t value,
+                       uint64_t flags, uint64_t) {
+  return reinterpret_cast<Map *>(map)->Update(
+      reinterpret_cast<const void *>(key),
+      reinterpret_cast<const void *>(value), flags);
+}
+
+uint64_t MapDeleteElem(uint64_t map, uint64_t key, uint64_t, uint64_t,
+                       uint64_t) {
+  return reinterpret_cast<Map *>(map)->Delete(
+      reinterpret_cast<const void *>(key));
+}
+
+uint64_t KtimeGetNs(uint64_t, uint64_t, uint64_t, uint64_t, uint64_t) {
+  return tsc_to_ns(rdtsc());
+}
+
+uint64_t SkbStoreBytes(uint64_t r1, uint64_t offset, uint64_t from,
+                       uint64_t len, uint64_t flags) {
+  PacketContext *ctx = AsContext(r1);
+  uint64_t end = offset + len;
+
+  if (flags != 0) {
+    return Errno(EINVAL);
+  }
+  if (offset > UINT16_MAX || end > ctx->len) {
+    return Errno(EFAULT);
+  }
+
+  char *head = ctx->pkt->make_writable<char *>(end);
+  uint64_t ret = 0;
+  if (head && end <= static_cast<uint64_t>(ctx->pkt->head_len())) {
+    memcpy(head + offset, reinterpret_cast<const void *>(from), len);
+  } else {
+    ret = Errno(ENOMEM);
+  }
+
+  // The data may have been moved, even on failure
+  ctx->Reset();
+  return ret;
+}
+
+uint64_t SkbLoadBytes(uint64_t r1, uint64_t offset, uint64_t to, uint64_t len,
+                      uint64_t) {
+  PacketContext *ctx = AsContext(r1);
+  void *dst = reinterpret_cast<void *>(to);
+
+  if (offset > ctx->len || len > ctx->len - offset ||
+      !ctx->pkt->CopyOut(dst, offset, len)) {
+    memset(dst, 0, len);
+    return Errno(EFAULT);
+  }
+  return 0;
+}
+
+uint64_t XdpAdjustHead(uint64_t r1, uint64_t r2, uint64_t, uint64_t,
+                       uint64_t) {
+  PacketContext *ctx = AsContext(r1);
+  bess::Packet *pkt = ctx->pkt;
+  int32_t delta = static_cast<int32_t>(r2);
+  uint64_t ret = 0;
+
+  if (delta < -UINT16_MAX || delta > static_cast<int64_t>(ctx->len)) {
+    return Errno(EINVAL);
+  }
+
+  if (delta < 0) {
+    // The headroom may be shared with other packets
+    if (!pkt->make_writable(0) || !pkt->prepend(-delta)) {
+      ret = Errno(ENOMEM);
+    }
+  } else if (delta > 0) {
+    if (!pkt->adj(delta)) {
+      ret = Errno(ENOMEM);
+    }
+  }
+
+  ctx->Reset();
+  return ret;
+}
+
+uint64_t XdpAdjustTail(uint64_t r1, uint64_t r2, uint64_t, uint64_t,
+                       uint64_t) {
+  PacketContext *ctx = AsContext(r1);
+  bess::Packet *pkt = ctx->pkt;
+  int32_t delta = static_cast<int32_t>(r2);
+
+  if (!pkt->is_linear()) {
+    return Errno(ENOTSUP);
+  }
+
+  if (delta < 0) {
+    if (-delta > pkt->head_len()) {
+      return Errno(EINVAL);
+    }
+    pkt->trim(-delta);
+  } else if (delta > 0) {
+    if (delta > UINT16_MAX) {
+      return Errno(EINVAL);
+    }
+    if (!pkt->is_head_private()) {
+      return Errno(ENOTSUP);
+    }
+    void *tail = pkt->append(delta);
+    if (!tail) {
+      return Errno(ENOMEM);
+    }
+    memset(tail, 0, delta);
+  }
+
+  ctx->Reset();
+  return 0;
+}
+
+uint64_t GetMetadata(uint64_t r1, uint64_t attr, uint64_t to, uint64_t len,
+                     uint64_t) {
+  PacketContext *ctx = AsContext(r1);
+  bess::metadata::mt_offset_t offset = ctx->attr_offsets[attr];
+
+  if (!bess::metadata::IsValidOffset(offset)) {
+    memset(reinterpret_cast<void *>(to), 0, len);
+    return Errno(ENOENT);
+  }
+
+  memcpy(reinterpret_cast<void *>(to),
+         reinterpret_cast<const void *>(ctx->pkt->metadata<uintptr_t>() +
+                                        offset),
+         len);
+  return 0;
+}
+
+uint64_t SetMetadata(uint64_t r1, uint64_t attr, uint64_t from, uint64_t len,
+                     uint64_t) {
+  PacketContext *ctx = AsContext(r1);
+  bess::metadata::mt_offset_t offset = ctx->attr_offsets[attr];
+
+  if (!bess::metadata::IsValidOffset(offset)) {
+    return Errno(ENOENT);
+  }
+
+  memcpy(reinterpret_cast<void *>(ctx->pkt->metadata<uintptr_t>() + offset),
+         reinterpret_cast<const void *>(from), len);
+  return 0;
+}
+
+const HelperSpec kHelpers[] = {
+    {kHelperMapLookupElem, MapLookupElem, kRetMapValueOrNull,
+     {kArgMap, kArgMapKey},
+     false},
+    {kHelperMapUpdateElem, MapUpdateElem, kRetScalar,
+     {kArgMap, kArgMapKey, kArgMapValue, kArgAnything},
+     false},
+    {kHelperMapDeleteElem, MapDeleteElem, kRetScalar,
+     {kArgMap, kArgMapKey},
+     false},
+    {kHelperKtimeGetNs, KtimeGetNs, kRetScalar, {}, false},
+    {kHelperSkbStoreBytes, SkbStoreBytes, kRetScalar,
+     {kArgCtx, kArgAnything, kArgMemRead, kArgMemSize, kArgAnything},
+     true},
+    {kHelperSkbLoadBytes, SkbLoadBytes, kRetScalar,
+     {kArgCtx, kArgAnything, kArgMemWrite, kArgMemSize},
+     false},
+    {kHelperXdpAdjustHead, XdpAdjustHead, kRetScalar,
+     {kArgCtx, kArgAnything},
+     true},
+    {kHelperXdpAdjustTail, XdpAdjustTail, kRetScalar,
+     {kArgCtx, kArgAnything},
+     true},
+    {kHelperGetMetadata, GetMetadata, kRetScalar,
+     {kArgCtx, kArgAttr, kArgMemWrite, kArgMemSize},
+     false},
+    {kHelperSetMetadata, SetMetadata, kRetScalar,
+     {kArgCtx, kArgAttr, kArgMemRead, kArgMemSize},
+     false},
+};
+
+const int kNumHelpers = sizeof(kHelpers) / sizeof(kHelpers[0]);
+
+// Returns the index of helper "id" in kHelpers, or -1
+int FindHelper(int32_t id) {
+  for (int i = 0; i < kNumHelpers; i++) {
+    if (kHelpers[i].id == id) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Semantics of ALU operations, shared by the interpreter and the verifier.
+// Division by zero yields 0, and modulo by zero leaves dst unchanged.
+uint64_t Alu64(uint8_t op, uint64_t dst, uint64_t src) {
+  switch (op) {
+    case kAdd:
+      return dst + src;
+    case kSub:
+      return dst - src;
+    case kMul:
+      return dst * src;
+    case kDiv:
+      return src ? dst / src : 0;
+    case kOr:
+      return dst | src;
+    case kAnd:
+      return dst & src;
+    case kLsh:
+      return dst << (src & 63);
+    case kRsh:
+      return dst >> (src & 63);
+    case kNeg:
+      return -dst;
+    case kMod:
+      return src ? dst % src : dst;
+    case kXor:
+      return dst ^ src;
+    case kMov:
+      return src;
+    case kArsh:
+      return static_cast<int64_t>(dst) >> (src & 63);
+    default:
+      return 0;
+  }
+}
+
+uint32_t Alu32(uint8_t op, uint32_t dst, uint32_t src) {
+  switch (op) {
+    case kAdd:
+      return dst + src;
+    case kSub:
+      return dst - src;
+    case kMul:
+      return dst * src;
+    case kDiv:
+      return src ? dst / src : 0;
+    case kOr:
+      return dst | src;
+    case kAnd:
+      return dst & src;
+    case kLsh:
+      return dst << (src & 31);
+    case kRsh:
+      return dst >> (src & 31);
+    case kNeg:
+      return -dst;
+    case kMod:
+      return src ? dst % src : dst;
+    case kXor:
+      return dst ^ src;
+    case kMov:
+      return src;
+    case kArsh:
+      return static_cast<int32_t>(dst) >> (src & 31);
+    default:
+      return 0;
+  }
+}
+
+// kEnd. The host is little endian, so converting to it only truncates.
+uint64_t ByteSwap(bool to_be, int32_t bits, uint64_t dst) {
+  switch (bits) {
+    case 16:
+      return to_be ? __builtin_bswap16(dst) : static_cast<uint16_t>(dst);
+    case 32:
+      return to_be ? __builtin_bswap32(dst) : static_cast<uint32_t>(dst);
+    default:
+      return to_be ? __builtin_bswap64(dst) : dst;
+  }
+}
+
+bool Cond(uint8_t op, uint64_t dst, uint64_t src) {
+  switch (op) {
+    case kJeq:
+      return dst == src;
+    case kJgt:
+      return dst > src;
+    case kJge:
+      return dst >= src;
+    case kJset:
+      return dst & src;
+    case kJne:
+      return dst != src;
+    case kJsgt:
+      return static_cast<int64_t>(dst) > static_cast<int64_t>(src);
+    case kJsge:
+      return static_cast<int64_t>(dst) >= static_cast<int64_t>(src);
+    case kJlt:
+      return dst < src;
+    case kJle:
+      return dst <= src;
+    case kJslt:
+      return static_cast<int64_t>(dst) < static_cast<int64_t>(src);
+    case kJsle:
+      return static_cast<int64_t>(dst) <= static_cast<int64_t>(src);
+    default:
+      return false;
+  }
+}
+
+template <typename T>
+inline T LoadMem(uint64_t addr) {
+  T val;
+  memcpy(&val, reinterpret_cast<const void *>(addr), sizeof(T));
+  return val;
+}
+
+template <typename T>
+inline void StoreMem(uint64_t addr, uint64_t val) {
+  T v = static_cast<T>(val);
+  memcpy(reinterpret_cast<void *>(addr), &v, sizeof(T));
+}
+
+}  // namespace
+
+HashResult Map::KeyHash::operator()(const Key &key) const {
+  return rte_hash_crc(&key, len_, 0);
+}
+
+Error Map::Init(Type type, uint32_t key_size, uint32_t value_size,
+                uint32_t max_entries) {
+  switch (type) {
+    case kArray:
+      if (key_size != sizeof(uint32_t)) {
+        return std::make_pair(EINVAL, "array maps must have 4-byte keys");
+      }
+      break;
+    case kHash:
+      if (key_size == 0 || key_size > kMaxKeySize) {
+        return std::make_pair(
+            EINVAL, Format("key size must be 1-%zu bytes", kMaxKeySize));
+      }
+      break;
+    default:
+      return std::make_pair(EINVAL, "unknown map type");
+  }
+
+  if (value_size == 0 || value_size > kMaxValueSize) {
+    return std::make_pair(
+        EINVAL, Format("value size must be 1-%zu bytes", kMaxValueSize));
+  }
+
+  if (max_entries == 0 || max_entries > kMaxEntries) {
+    return std::make_pair(
+        EINVAL, Format("max_entries must be 1-%zu", kMaxEntries));
+  }
+
+  value_words_ = (value_size + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+  if (max_entries * value_words_ * sizeof(uint64_t) > kMaxMemory) {
+    return std::make_pair(ENOMEM, "map is too large");
+  }
+
+  type_ = type;
+  key_size_ = key_size;
+  value_size_ = value_size;
+  max_entries_ = max_entries;
+  Clear();
+  return std::make_pair(0, std::string());
+}
+
+void *Map::Lookup(const void *key) {
+  if (type_ == kArray) {
+    uint32_t idx;
+    memcpy(&idx, key, sizeof(idx));
+    return (idx < max_entries_) ? value(idx) : nullptr;
+  }
+
+  auto *entry =
+      index_.Find(MakeKey(key), KeyHash(key_size_), KeyEq(key_size_));
+  return entry ? value(entry->second) : nullptr;
+}
+
+int Map::Update(const void *key, const void *val, uint64_t flags) {
+  if (flags > kMapUpdateExist) {
+    return -EINVAL;
+  }
+
+  if (type_ == kArray) {
+    uint32_t idx;
+    memcpy(&idx, key, sizeof(idx));
+    if (idx >= max_entries_) {
+      return -E2BIG;
+    }
+    if (flags == kMapUpdateNoExist) {
+      return -EEXIST;
+    }
+    // "val" may point into the map itself
+    memmove(value(idx), val, value_size_);
+    return 0;
+  }
+
+  Key k = MakeKey(key);
+  auto *entry = index_.Find(k, KeyHash(key_size_), KeyEq(key_size_));
+  if (entry) {
+    if (flags == kMapUpdateNoExist) {
+      return -EEXIST;
+    }
+    memmove(value(entry->second), val, value_size_);
+    return 0;
+  }
+
+  if (flags == kMapUpdateExist) {
+    return -ENOENT;
+  }
+  if (free_slots_.empty()) {
+    return -E2BIG;
+  }
+
+  uint32_t slot = free_slots_.back();
+  if (!index_.Insert(k, slot, KeyHash(key_size_), KeyEq(key_size_))) {
+    return -ENOMEM;
+  }
+  free_slots_.pop_back();
+  memmove(value(slot), val, value_size_);
+  return 0;
+}
+
+int Map::Delete(const void *key) {
+  if (type_ == kArray) {
+    return -EINVAL;
+  }
+
+  Key k = MakeKey(key);
+  auto *entry = index_.Find(k, KeyHash(key_size_), KeyEq(key_size_));
+  if (!entry) {
+    return -ENOENT;
+  }
+
+  free_slots_.push_back(entry->second);
+  index_.Remove(k, KeyHash(key_size_), KeyEq(key_size_));
+  return 0;
+}
+
+void Map::Clear() {
+  values_.assign(max_entries_ * value_words_, 0);
+  index_.Clear();
+  free_slots_.clear();
+
+  if (type_ == kHash) {
+    for (uint32_t i = max_entries_; i > 0; i--) {
+      free_slots_.push_back(i - 1);
+    }
+  }
+}
+
+// Abstract interpretation of a program, tracking the type of each register.
+// Jumps only go forward, so visiting the instructions in order sees every
+// predecessor of an instruction before the instruction itself. The states
+// flowing into an instruction from different paths are joined.
+class Program::Verifier {
+ public:
+  Verifier(const std::vector<Insn> &insns,
+           const std::vector<std::shared_ptr<Map>> &maps,
+           const std::vector<Attr> &attrs)
+      : insns_(insns), maps_(maps), attrs_(attrs), writes_packet_() {}
+
+  Error Verify();
+
+  bool writes_packet() const { return writes_packet_; }
+
+ private:
+  enum RegType : uint8_t {
+    kNotInit = 0,
+    kScalar,
+    kPtrCtx,
+    kPtrStack,  // Offset from the frame pointer
+    kPtrPacket,  // Offset from PacketContext::data
+    kPtrPacketEnd,
+    kPtrMap,
+    kPtrMapValue,
+    kPtrMapValueOrNull,
+  };
+
+  struct Reg {
+    RegType type;
+    bool known;     // Scalars: is "val" the value?
+    int64_t val;    // Value of known scalars, or the offset of pointers
+    uint32_t map;   // kPtrMap*: index in maps_
+    uint32_t id;    // kPtrMapValueOrNull: which lookup it came from
+
+    bool is_pointer() const { return type > kScalar; }
+  };
+
+  struct State {
+    bool reached;
+    Reg regs[kNumRegs];
+    int64_t pkt_range;  // Bytes known to be in the first segment
+    std::bitset<kStackSize> stack_init;  // Bytes written, from -kStackSize
+  };
+
+  static const int64_t kMaxOffset = 1 << 29;
+
+  static Reg Scalar() { return {kScalar, false, 0, 0, 0}; }
+  static Reg Known(uint64_t val) {
+    return {kScalar, true, static_cast<int64_t>(val), 0, 0};
+  }
+  static Reg Pointer(RegType type, int64_t off) {
+    return {type, false, off, 0, 0};
+  }
+
+  static const char *TypeName(RegType type);
+
+  Error Fail(size_t pc, const char *msg) const {
+    return std::make_pair(EINVAL, Format("insn %zu: %s", pc, msg));
+  }
+
+  template <typename... Args>
+  Error Fail(size_t pc, const char *fmt, Args... args) const {
+    return Fail(pc, Format(fmt, args...).c_str());
+  }
+
+  Error Ok() const { return std::make_pair(0, std::string()); }
+
+  // Checks the encoding of each instruction, reachable or not
+  Error CheckInsn(size_t pc, const std::vector<bool> &second_half) const;
+
+  Error CheckReadable(size_t pc, const State &st, int reg) const;
+
+  // Checks a "size"-byte access at "off" from pointer "ptr". Sets "*loaded"
+  // to the type of loaded values.
+  Error CheckMem(size_t pc, const State &st, const Reg &ptr, int64_t off,
+                 size_t size, bool write, Reg *loaded);
+
+  // Checks a memory region passed to a helper
+  Error CheckRegion(size_t pc, const State &st, int reg, uint64_t size,
+                    bool write, bool allow_packet);
+
+  // Marks the stack bytes [start, end) from the frame pointer as written
+  static void InitStack(State *st, int64_t start, int64_t end) {
+    for (int64_t i = start; i < end; i++) {
+      st->stack_init.set(i + kStackSize);
+    }
+  }
+
+  Error Alu(size_t pc, State *st);
+  Error Load(size_t pc, State *st);
+  Error Store(size_t pc, State *st);
+  Error Call(size_t pc, State *st);
+  Error Branch(size_t pc, State *st, State *taken);
+
+  // Merges "st" into the state at "pc"
+  Error Flow(size_t from, size_t pc, const State &st);
+
+  const std::vector<Insn> &insns_;
+  const std::vector<std::shared_ptr<Map>> &maps_;
+  const std::vector<Attr> &attrs_;
+
+  std::vector<State> states_;
+  bool writes_packet_;
+};
+
+const char *Program::Verifier::TypeName(RegType type) {
+  switch (type) {
+    case kNotInit:
+      return "uninitialized";
+    case kScalar:
+      return "scalar";
+    case kPtrCtx:
+      return "ctx";
+    case kPtrStack:
+      return "stack";
+    case kPtrPacket:
+      return "packet";
+    case kPtrPacketEnd:
+      return "packet_end";
+    case kPtrMap:
+      return "map";
+    case kPtrMapValue:
+      return "map_value";
+    case kPtrMapValueOrNull:
+      return "map_value_or_null";
+  }
+  return "unknown";
+}
+
+Error Program::Verifier::CheckInsn(size_t pc,
+                                   const std::vector<bool> &second_half) const {
+  const Insn &insn = insns_[pc];
+  uint8_t cls = insn.code & 0x07;
+  uint8_t op = insn.code & 0xf0;
+  size_t n = insns_.size();
+
+  if (insn.dst_reg >= kNumRegs || insn.src_reg >= kNumRegs) {
+    return Fail(pc, "invalid register");
+  }
+
+  switch (cls) {
+    case kAlu:
+    case kAlu64: {
+      if (op > kEnd || (op == kEnd && cls != kAlu)) {
+        return Fail(pc, "unknown opcode 0x%02x", insn.code);
+      }
+      if (insn.dst_reg == kFramePointer) {
+        return Fail(pc, "frame pointer is read only");
+      }
+      bool is_k = !(insn.code & kX);
+      int bits = (cls == kAlu64) ? 64 : 32;
+      if (op == kEnd) {
+        if (insn.imm != 16 && insn.imm != 32 && insn.imm != 64) {
+          return Fail(pc, "invalid byte swap width %d", insn.imm);
+        }
+      } else if (op == kNeg) {
+        if (!is_k) {
+          return Fail(pc, "unknown opcode 0x%02x", insn.code);
+        }
+      } else if (is_k && (op == kDiv || op == kMod) && insn.imm == 0) {
+        return Fail(pc, "division by zero");
+      } else if (is_k && (op == kLsh || op == kRsh || op == kArsh) &&
+                 (insn.imm < 0 || insn.imm >= bits)) {
+        return Fail(pc, "invalid shift %d", insn.imm);
+      }
+      return Ok();
+    }
+
+    case kJmp: {
+      if (op > kJsle || ((op == kJa || op == kCall || op == kExit) &&
+                         (insn.code & kX))) {
+        return Fail(pc, "unknown opcode 0x%02x", insn.code);
+      }
+      if (op == kCall) {
+        if (FindHelper(insn.imm) < 0) {
+          return Fail(pc, "unknown helper %d", insn.imm);
+        }
+        return Ok();
+      }
+      if (op == kExit) {
+        return Ok();
+      }
+      if (insn.off < 0) {
+        return Fail(pc, "backward jump");
+      }
+      size_t target = pc + 1 + insn.off;
+      if (target >= n || second_half[target]) {
+        return Fail(pc, "invalid jump target");
+      }
+      return Ok();
+    }
+
+    case kLd:
+      if (insn.code != (kLd | kDW | kImm)) {
+        return Fail(pc, "unsupported opcode 0x%02x", insn.code);
+      }
+      if (pc + 1 >= n || insns_[pc + 1].code != 0 ||
+          insns_[pc + 1].dst_reg != 0 || insns_[pc + 1].src_reg != 0 ||
+          insns_[pc + 1].off != 0) {
+        return Fail(pc, "incomplete 64-bit immediate load");
+      }
+      if (insn.dst_reg == kFramePointer) {
+        return Fail(pc, "frame pointer is read only");
+      }
+      if (insn.src_reg == kPseudoMap) {
+        if (insn.imm < 0 || static_cast<size_t>(insn.imm) >= maps_.size()) {
+          return Fail(pc, "invalid map %d", insn.imm);
+        }
+      } else if (insn.src_reg != 0) {
+        return Fail(pc, "invalid 64-bit immediate load");
+      }
+      return Ok();
+
+    case kLdx:
+      if ((insn.code & 0xe0) != kMem) {
+        return Fail(pc, "unsupported opcode 0x%02x", insn.code);
+      }
+      if (insn.dst_reg == kFramePointer) {
+        return Fail(pc, "frame pointer is read only");
+      }
+      return Ok();
+
+    case kSt:
+      if ((insn.code & 0xe0) != kMem) {
+        return Fail(pc, "unsupported opcode 0x%02x", insn.code);
+      }
+      return Ok();
+
+    case kStx:
+      if ((insn.code & 0xe0) == kXadd) {
+        if (AccessSize(insn.code) < 4) {
+          return Fail(pc, "atomic add must be 4 or 8 bytes");
+        }
+      } else if ((insn.code & 0xe0) != kMem) {
+        return Fail(pc, "unsupported opcode 0x%02x", insn.code);
+      }
+      return Ok();
+
+    default:
+      return Fail(pc, "unsupported opcode 0x%02x", insn.code);
+  }
+}
+
+Error Program::Verifier::CheckReadable(size_t pc, const State &st,
+                                       int reg) const {
+  if (st.regs[reg].type == kNotInit) {
+    return Fail(pc, "R%d is not initialized", reg);
+  }
+  return Ok();
+}
+
+Error Program::Verifier::CheckMem(size_t pc, const State &st, const Reg &ptr,
+                                  int64_t off, size_t size, bool write,
+                                  Reg *loaded) {
+  int64_t start = ptr.val + off;
+  int64_t end = start + size;
+
+  *loaded = Scalar();
+
+  switch (ptr.type) {
+    case kPtrStack:
+      if (start < -kStackSize || end > 0) {
+        return Fail(pc, "stack access out of bounds (%" PRId64 ")", start);
+      }
+      if (!write) {
+        for (int64_t i = start; i < end; i++) {
+          if (!st.stack_init.test(i + kStackSize)) {
+            return Fail(pc, "read of uninitialized stack (%" PRId64 ")", i);
+          }
+        }
+      }
+      return Ok();
+
+    case kPtrMapValue:
+      if (start < 0 || end > maps_[ptr.map]->value_size()) {
+        return Fail(pc, "map value access out of bounds (%" PRId64 ")",
+                    start);
+      }
+      return Ok();
+
+    case kPtrPacket:
+      if (start < 0 || end > st.pkt_range) {
+        return Fail(pc,
+                    "packet access out of bounds (%" PRId64 "-%" PRId64
+                    ", checked %" PRId64 ")",
+                    start, end, st.pkt_range);
+      }
+      if (write) {
+        writes_packet_ = true;
+      }
+      return Ok();
+
+    case kPtrCtx:
+      if (write) {
+        return Fail(pc, "context is read only");
+      }
+      if (start == offsetof(PacketContext, data) && size == 8) {
+        *loaded = Pointer(kPtrPacket, 0);
+      } else if (start == offsetof(PacketContext, data_end) && size == 8) {
+        *loaded = Pointer(kPtrPacketEnd, 0);
+      } else if (!(start == offsetof(PacketContext, len) && size == 4) &&
+                 !(start == offsetof(PacketContext, igate) && size == 4)) {
+        return Fail(pc, "invalid context access (%" PRId64 ")", start);
+      }
+      return Ok();
+
+    default:
+      return Fail(pc, "invalid memory access through %s",
+                  TypeName(ptr.type));
+  }
+}
+
+Error Program::Verifier::CheckRegion(size_t pc, const State &st, int reg,
+                                     uint64_t size, bool write,
+                                     bool allow_packet) {
+  const Reg &ptr = st.regs[reg];
+  Reg loaded;
+
+  if (ptr.type != kPtrStack && ptr.type != kPtrMapValue &&
+      (ptr.type != kPtrPacket || !allow_packet || write)) {
+    return Fail(pc, "R%d: %s cannot be passed to this helper", reg,
+                TypeName(ptr.type));
+  }
+  return CheckMem(pc, st, ptr, 0, size, write, &loaded);
+}
+
+Error Program::Verifier::Alu(size_t pc, State *st) {
+  const Insn &insn = insns_[pc];
+  bool is64 = (insn.code & 0x07) == kAlu64;
+  uint8_t op = insn.code & 0xf0;
+  Reg &dst = st->regs[insn.dst_reg];
+  Reg src;
+  Error err;
+
+  if (op == kEnd) {
+    src = Known(0);  // kX selects the byte order, not a source register
+  } else if (insn.code & kX) {
+    if ((err = CheckReadable(pc, *st, insn.src_reg)).first) {
+      return err;
+    }
+    src = st->regs[insn.src_reg];
+  } else if (is64) {
+    src = Known(static_cast<int64_t>(insn.imm));
+  } else {
+    src = Known(static_cast<uint32_t>(insn.imm));
+  }
+
+  if (op == kMov) {
+    if (is64) {
+      dst = src;
+    } else if (src.is_pointer()) {
+      return Fail(pc, "32-bit move of a pointer");
+    } else if (src.known) {
+      dst = Known(static_cast<uint32_t>(src.val));
+    } else {
+      dst = Scalar();
+    }
+    return Ok();
+  }
+
+  if ((err = CheckReadable(pc, *st, insn.dst_reg)).first) {
+    return err;
+  }
+
+  if (dst.is_pointer() || src.is_pointer()) {
+    if (!is64) {
+      return Fail(pc, "32-bit arithmetic on a pointer");
+    }
+
+    // Two packet pointers may be subtracted
+    if (op == kSub && dst.is_pointer() && src.is_pointer()) {
+      if ((dst.type != kPtrPacket && dst.type != kPtrPacketEnd) ||
+          (src.type != kPtrPacket && src.type != kPtrPacketEnd)) {
+        return Fail(pc, "subtraction of %s from %s", TypeName(src.type),
+                    TypeName(dst.type));
+      }
+      dst = Scalar();
+      return Ok();
+    }
+
+    // Otherwise only (pointer +/- constant) or (constant + pointer)
+    Reg ptr = dst.is_pointer() ? dst : src;
+    const Reg &scalar = dst.is_pointer() ? src : dst;
+    if ((op != kAdd && op != kSub) || (op == kSub && !dst.is_pointer()) ||
+        scalar.is_pointer()) {
+      return Fail(pc, "invalid arithmetic on a pointer");
+    }
+    if (ptr.type != kPtrCtx && ptr.type != kPtrStack &&
+        ptr.type != kPtrPacket && ptr.type != kPtrMapValue) {
+      return Fail(pc, "arithmetic on %s", TypeName(ptr.type));
+    }
+    if (!scalar.known) {
+      return Fail(pc, "variable offset on %s", TypeName(ptr.type));
+    }
+    ptr.val = (op == kAdd) ? ptr.val + scalar.val : ptr.val - scalar.val;
+    if (ptr.val < -kMaxOffset || ptr.val > kMaxOffset) {
+      return Fail(pc, "pointer offset out of range");
+    }
+    dst = ptr;
+    return Ok();
+  }
+
+  if (!dst.known || !src.known) {
+    dst = Scalar();
+  } else if (op == kEnd) {
+    dst = Known(ByteSwap(insn.code & kX, insn.imm, dst.val));
+  } else if (is64) {
+    dst = Known(Alu64(op, dst.val, src.val));
+  } else {
+    dst = Known(Alu32(op, dst.val, src.val));
+  }
+  return Ok();
+}
+
+Error Program::Verifier::Load(size_t pc, State *st) {
+  const Insn &insn = insns_[pc];
+  Reg loaded;
+  Error err;
+
+  if ((err = CheckReadable(pc, *st, insn.src_reg)).first ||
+      (err = CheckMem(pc, *st, st->regs[insn.src_reg], insn.off,
+                      AccessSize(insn.code), false, &loaded))
+          .first) {
+    return err;
+  }
+
+  st->regs[insn.dst_reg] = loaded;
+  return Ok();
+}
+
+Error Program::Verifier::Store(size_t pc, State *st) {
+  const Insn &insn = insns_[pc];
+  const Reg &ptr = st->regs[insn.dst_reg];
+  Reg loaded;
+  Error err;
+
+  if ((err = CheckReadable(pc, *st, insn.dst_reg)).first) {
+    return err;
+  }
+
+  if ((insn.code & 0x07) == kStx) {
+    if ((err = CheckReadable(pc, *st, insn.src_reg)).first) {
+      return err;
+    }
+    if (st->regs[insn.src_reg].is_pointer()) {
+      return Fail(pc, "pointers cannot be stored to memory");
+    }
+    if ((insn.code & 0xe0) == kXadd) {
+      if (ptr.type != kPtrStack && ptr.type != kPtrMapValue) {
+        return Fail(pc, "atomic add to %s", TypeName(ptr.type));
+      }
+      // Reads the old value as well
+      if ((err = CheckMem(pc, *st, ptr, insn.off, AccessSize(insn.code),
+                          false, &loaded))
+              .first) {
+        return err;
+      }
+    }
+  }
+
+  if ((err = CheckMem(pc, *st, ptr, insn.off, AccessSize(insn.code), true,
+                      &loaded))
+          .first) {
+    return err;
+  }
+
+  if (ptr.type == kPtrStack) {
+    int64_t start = ptr.val + insn.off;
+    InitStack(st, start, start + static_cast<int64_t>(AccessSize(insn.code)));
+  }
+  return Ok();
+}
+
+Error Program::Verifier::Call(size_t pc, State *st) {
+  const Insn &insn = insns_[pc];
+  const HelperSpec &spec = kHelpers[FindHelper(insn.imm)];
+  const Map *map = nullptr;
+  uint32_t map_idx = 0;
+  const Attr *attr = nullptr;
+  int written_reg = -1;  // Stack region filled by the helper, if any
+  int64_t written_size = 0;
+  Error err;
+
+  for (int i = 0; i < 5 && spec.args[i] != kArgNone; i++) {
+    int r = i + 1;
+    const Reg &reg = st->regs[r];
+
+    if ((err = CheckReadable(pc, *st, r)).first) {
+      return err;
+    }
+
+    switch (spec.args[i]) {
+      case kArgAnything:
+        if (reg.is_pointer()) {
+          return Fail(pc, "R%d must be a scalar", r);
+        }
+        break;
+
+      case kArgCtx:
+        if (reg.type != kPtrCtx || reg.val != 0) {
+          return Fail(pc, "R%d must be the context", r);
+        }
+        break;
+
+      case kArgMap:
+        if (reg.type != kPtrMap) {
+          return Fail(pc, "R%d must be a map", r);
+        }
+        map_idx = reg.map;
+        map = maps_[map_idx].get();
+        break;
+
+      case kArgMapKey:
+        err = CheckRegion(pc, *st, r, map->key_size(), false, true);
+        break;
+
+      case kArgMapValue:
+        err = CheckRegion(pc, *st, r, map->value_size(), false, true);
+        break;
+
+      case kArgMemRead:
+      case kArgMemWrite: {
+        const Reg &size = st->regs[r + 1];
+        if (size.type != kScalar || !size.known || size.val <= 0 ||
+            size.val > kStackSize) {
+          return Fail(pc, "R%d must be a constant size of 1-%d bytes", r + 1,
+                      kStackSize);
+        }
+        if (attr && static_cast<uint64_t>(size.val) > attr->size) {
+          return Fail(pc, "metadata attribute is %u bytes long", attr->size);
+        }
+        err = CheckRegion(pc, *st, r, size.val, spec.args[i] == kArgMemWrite,
+                          false);
+        if (spec.args[i] == kArgMemWrite && reg.type == kPtrStack) {
+          written_reg = r;
+          written_size = size.val;
+        }
+        break;
+      }
+
+      case kArgMemSize:
+        break;  // Checked with the preceding pointer
+
+      case kArgAttr:
+        if (reg.type != kScalar || !reg.known || reg.val < 0 ||
+            static_cast<uint64_t>(reg.val) >= attrs_.size()) {
+          return Fail(pc, "R%d must be a metadata attribute index", r);
+        }
+        attr = &attrs_[reg.val];
+        if (insn.imm == kHelperGetMetadata && !attr->readable) {
+          return Fail(pc, "metadata attribute %" PRId64 " is not readable",
+                      reg.val);
+        }
+        if (insn.imm == kHelperSetMetadata && !attr->writable) {
+          return Fail(pc, "metadata attribute %" PRId64 " is not writable",
+                      reg.val);
+        }
+        break;
+
+      default:
+        break;
+    }
+
+    if (err.first) {
+      return err;
+    }
+  }
+
+  if (written_reg >= 0) {
+    int64_t start = st->regs[written_reg].val;
+    InitStack(st, start, start + written_size);
+  }
+
+  // Caller-saved registers
+  for (int r = 1; r <= 5; r++) {
+    st->regs[r] = Reg();
+  }
+
+  if (spec.ret == kRetMapValueOrNull) {
+    st->regs[0] = Pointer(kPtrMapValueOrNull, 0);
+    st->regs[0].map = map_idx;
+    st->regs[0].id = pc + 1;
+  } else {
+    st->regs[0] = Scalar();
+  }
+
+  if (spec.changes_packet) {
+    for (Reg &reg : st->regs) {
+      if (reg.type == kPtrPacket || reg.type == kPtrPacketEnd) {
+        reg = Reg();
+      }
+    }
+    st->pkt_range = 0;
+  }
+
+  return Ok();
+}
+
+Error Program::Verifier::Branch(size_t pc, State *st, State *taken) {
+  const Insn &insn = insns_[pc];
+  uint8_t op = insn.code & 0xf0;
+  Error err;
+
+  if ((err = CheckReadable(pc, *st, insn.dst_reg)).first) {
+    return err;
+  }
+
+  Reg dst = st->regs[insn.dst_reg];
+  Reg src = Known(static_cast<int64_t>(insn.imm));
+  if (insn.code & kX) {
+    if ((err = CheckReadable(pc, *st, insn.src_reg)).first) {
+      return err;
+    }
+    src = st->regs[insn.src_reg];
+  }
+
+  *taken = *st;
+
+  if (!dst.is_pointer() && !src.is_pointer()) {
+    return Ok();
+  }
+
+  // Null check of a map lookup result
+  if (dst.type == kPtrMapValueOrNull && src.type == kScalar && src.known &&
+      src.val == 0 && (op == kJeq || op == kJne)) {
+    State *null_st = (op == kJeq) ? taken : st;
+    State *nonnull_st = (op == kJeq) ? st : taken;
+    for (int r = 0; r < kNumRegs; r++) {
+      if (st->regs[r].type == kPtrMapValueOrNull &&
+          st->regs[r].id == dst.id) {
+        null_st->regs[r] = Known(0);
+        nonnull_st->regs[r].type = kPtrMapValue;
+      }
+    }
+    return Ok();
+  }
+
+  // Bounds check of packet pointers against PacketContext::data_end
+  if ((dst.type == kPtrPacket && src.type == kPtrPacketEnd) ||
+      (dst.type == kPtrPacketEnd && src.type == kPtrPacket)) {
+    bool pkt_first = dst.type == kPtrPacket;
+    int64_t off = pkt_first ? dst.val : src.val;
+
+    // The state in which "packet + off <= data_end" holds, if any
+    State *in_bounds = nullptr;
+    switch (op) {
+      case kJgt:
+      case kJge:
+        in_bounds = pkt_first ? st : taken;
+        break;
+      case kJlt:
+      case kJle:
+        in_bounds = pkt_first ? taken : st;
+        break;
+      default:
+        break;
+    }
+
+    if (in_bounds && off > 0) {
+      in_bounds->pkt_range = std::max(in_bounds->pkt_range, off);
+    }
+    return Ok();
+  }
+
+  if (dst.type == kPtrPacket && src.type == kPtrPacket) {
+    return Ok();
+  }
+
+  // Redundant null checks
+  if (dst.is_pointer() && src.type == kScalar && src.known && src.val == 0 &&
+      (op == kJeq || op == kJne)) {
+    return Ok();
+  }
+
+  return Fail(pc, "comparison of %s with %s", TypeName(dst.type),
+              TypeName(src.type));
+}
+
+Error Program::Verifier::Flow(size_t from, size_t pc, const State &st) {
+  if (pc >= insns_.size()) {
+    return Fail(from, "falls off the end of the program");
+  }
+
+  State &to = states_[pc];
+  if (!to.reached) {
+    to = st;
+    return Ok();
+  }
+
+  for (int r = 0; r < kNumRegs; r++) {
+    Reg &a = to.regs[r];
+    const Reg &b = st.regs[r];
+
+    if (a.type != b.type) {
+      a = Reg();
+    } else if (a.type == kScalar) {
+      if (a.known && (!b.known || a.val != b.val)) {
+        a = Scalar();
+      }
+    } else if (a.val != b.val || a.map != b.map || a.id != b.id) {
+      a = Reg();
+    }
+  }
+
+  to.pkt_range = std::min(to.pkt_range, st.pkt_range);
+  to.stack_init &= st.stack_init;
+  return Ok();
+}
+
+Error Program::Verifier::Verify() {
+  size_t n = insns_.size();
+  Error err;
+
+  if (n == 0 || n > kMaxInsns) {
+    return std::make_pair(
+        EINVAL, Format("programs must have 1-%zu instructions", kMaxInsns));
+  }
+
+  std::vector<bool> second_half(n);
+  for (size_t pc = 0; pc < n; pc++) {
+    if (insns_[pc].code == (kLd | kDW | kImm)) {
+      if (pc + 1 == n) {
+        return std::make_pair(
+            EINVAL, Format("insn %zu: truncated 64-bit immediate", pc));
+      }
+      second_half[++pc] = true;
+    }
+  }
+
+  for (size_t pc = 0; pc < n; pc++) {
+    if (!second_half[pc] && (err = CheckInsn(pc, second_half)).first) {
+      return err;
+    }
+  }
+
+  states_.assign(n, State());
+  states_[0].reached = true;
+  states_[0].regs[1] = Pointer(kPtrCtx, 0);
+  states_[0].regs[kFramePointer] = Pointer(kPtrStack, 0);
+
+  for (size_t pc = 0; pc < n; pc++) {
+    if (!states_[pc].reached) {
+      continue;  // Unreachable (or the second half of a 64-bit load)
+    }
+
+    State st = states_[pc];
+    const Insn &insn = insns_[pc];
+    uint8_t op = insn.code & 0xf0;
+    size_t next = pc + 1;
+
+    switch (insn.code & 0x07) {
+      case kAlu:
+      case kAlu64:
+        err = Alu(pc, &st);
+        break;
+
+      case kLd:
+        if (insn.src_reg == kPseudoMap) {
+          st.regs[insn.dst_reg] = Pointer(kPtrMap, 0);
+          st.regs[insn.dst_reg].map = insn.imm;
+        } else {
+          st.regs[insn.dst_reg] =
+              Known(static_cast<uint32_t>(insn.imm) |
+                    static_cast<uint64_t>(insns_[pc + 1].imm) << 32);
+        }
+        next = pc + 2;
+        break;
+
+      case kLdx:
+        err = Load(pc, &st);
+        break;
+
+      case kSt:
+      case kStx:
+        err = Store(pc, &st);
+        break;
+
+      case kJmp:
+        if (op == kExit) {
+          if (st.regs[0].type != kScalar) {
+            return Fail(pc, "R0 must be a scalar on exit, not %s",
+                        TypeName(st.regs[0].type));
+          }
+          continue;
+        } else if (op == kJa) {
+          next = pc + 1 + insn.off;
+        } else if (op == kCall) {
+          err = Call(pc, &st);
+        } else {
+          State taken;
+          if ((err = Branch(pc, &st, &taken)).first ||
+              (err = Flow(pc, pc + 1 + insn.off, taken)).first) {
+            return err;
+          }
+        }
+        break;
+    }
+
+    if (err.first || (err = Flow(pc, next, st)).first) {
+      return err;
+    }
+  }
+
+  return Ok();
+}
+
+Error Program::Load(const std::vector<Insn> &insns,
+                    const std::vector<std::shared_ptr<Map>> &maps,
+                    const std::vector<Attr> &attrs, bool jit) {
+  Verifier verifier(insns, maps, attrs);
+  Error err = verifier.Verify();
+  if (err.first) {
+    return err;
+  }
+
+  Unload();
+  insns_ = insns;
+  maps_ = maps;
+  writes_packet_ = verifier.writes_packet();
+
+  for (size_t pc = 0; pc < insns_.size(); pc++) {
+    Insn &insn = insns_[pc];
+    if (insn.code == (kJmp | kCall)) {
+      insn.imm = FindHelper(insn.imm);
+    } else if (insn.code == (kLd | kDW | kImm)) {
+      if (insn.src_reg == kPseudoMap) {
+        uintptr_t addr = reinterpret_cast<uintptr_t>(maps_[insn.imm].get());
+        insn.src_reg = 0;
+        insn.imm = static_cast<uint32_t>(addr);
+        insns_[pc + 1].imm = static_cast<uint32_t>(addr >> 32);
+      }
+      pc++;
+    }
+  }
+
+  if (jit && !Compile()) {
+    return std::make_pair(ENOTSUP, "JIT is not supported on this platform");
+  }
+
+  return std::make_pair(0, std::string());
+}
+
+uint64_t Program::Interpret(PacketContext *ctx) const {
+  // Not zeroed: the verifier rejects reads of bytes not written before
+  uint64_t stack[kStackSize / sizeof(uint64_t)];
+  uint64_t reg[kNumRegs];
+  const Insn *insns = insns_.data();
+
+  reg[1] = reinterpret_cast<uintptr_t>(ctx);
+  reg[kFramePointer] = reinterpret_cast<uintptr_t>(stack + kStackSize / 8);
+
+  for (size_t pc = 0;; pc++) {
+    const Insn &insn = insns[pc];
+    uint8_t op = insn.code & 0xf0;
+    uint64_t &dst = reg[insn.dst_reg];
+
+    switch (insn.code & 0x07) {
+      case kAlu64:
+        dst = Alu64(op, dst, (insn.code & kX)
+                                 ? reg[insn.src_reg]
+                                 : static_cast<int64_t>(insn.imm));
+        break;
+
+      case kAlu:
+        if (op == kEnd) {
+          dst = ByteSwap(insn.code & kX, insn.imm, dst);
+        } else {
+          dst = Alu32(op, dst, (insn.code & kX) ? reg[insn.src_reg]
+                                                 : insn.imm);
+        }
+        break;
+
+      case kLd:
+        dst = static_cast<uint32_t>(insn.imm) |
+              static_cast<uint64_t>(insns[pc + 1].imm) << 32;
+        pc++;
+        break;
+
+      case kLdx: {
+        uint64_t addr = reg[insn.src_reg] + insn.off;
+        switch (insn.code & 0x18) {
+          case kB:
+            dst = LoadMem<uint8_t>(addr);
+            break;
+          case kH:
+            dst = LoadMem<uint16_t>(addr);
+            break;
+          case kW:
+            dst = LoadMem<uint32_t>(addr);
+            break;
+          case kDW:
+            dst = LoadMem<uint64_t>(addr);
+            break;
+        }
+        break;
+      }
+
+      case kSt:
+      case kStx: {
+        uint64_t addr = dst + insn.off;
+        uint64_t val = ((insn.code & 0x07) == kStx)
+                           ? reg[insn.src_reg]
+                           : static_cast<int64_t>(insn.imm);
+
+        if ((insn.code & 0xe0) == kXadd) {
+          if ((insn.code & 0x18) == kW) {
+            __sync_fetch_and_add(reinterpret_cast<uint32_t *>(addr),
+                                 static_cast<uint32_t>(val));
+          } else {
+            __sync_fetch_and_add(reinterpret_cast<uint64_t *>(addr), val);
+          }
+          break;
+        }
+
+        switch (insn.code & 0x18) {
+          case kB:
+            StoreMem<uint8_t>(addr, val);
+            break;
+          case kH:
+            StoreMem<uint16_t>(addr, val);
+            break;
+          case kW:
+            StoreMem<uint32_t>(addr, val);
+            break;
+          case kDW:
+            StoreMem<uint64_t>(addr, val);
+            break;
+        }
+        break;
+      }
+
+      case kJmp:
+        if (op == kExit) {
+          return reg[0];
+        } else if (op == kCall) {
+          reg[0] = kHelpers[insn.imm].func(reg[1], reg[2], reg[3], reg[4],
+                                           reg[5]);
+        } else if (op == kJa ||
+                   Cond(op, dst, (insn.code & kX)
+                                     ? reg[insn.src_reg]
+                                     : static_cast<int64_t>(insn.imm))) {
+          pc += insn.off;
+        }
+        break;
+    }
+  }
+}
+
+void *Program::HelperAddress(int idx) {
+  return reinterpret_cast<void *>(kHelpers[idx].func);
+}
+
+}  // namespace ebpf
+}  // namespace utils
+}  // namespace bess
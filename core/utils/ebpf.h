@@ -0,0 +1,371 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_EBPF_H_
+#define BESS_UTILS_EBPF_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../metadata.h"
+#include "../packet.h"
+#include "cuckoo_map.h"
+
+// An eBPF engine for running user-supplied per-packet programs: a verifier,
+// an interpreter, and an x86-64 JIT compiler.
+//
+// Programs use the Linux eBPF instruction set (without JMP32 and the legacy
+// LD_ABS/LD_IND packet loads), so they can be written in restricted C and
+// compiled with "clang -target bpf". R1 points to a PacketContext on entry,
+// and R0 holds the return value on exit.
+//
+// The verifier is a subset of the Linux one. It tracks the type of each
+// register through a single forward pass over the program and rejects any
+// program that could access memory out of bounds or fail to terminate:
+//  - Jumps must go forward, so there are no loops.
+//  - Pointers may only be moved by constant offsets. Packet bytes at
+//    variable offsets are read with the skb_load_bytes() helper.
+//  - Direct packet access must be preceded by a comparison against
+//    PacketContext::data_end, as in XDP programs.
+//  - Pointers returned by map_lookup_elem() must be checked against NULL.
+//  - Pointers may not be stored to memory (no spilling).
+//  - Stack bytes must be written before they are read, by the program or by
+//    a helper that fills them. The stack is not cleared between runs.
+namespace bess {
+namespace utils {
+namespace ebpf {
+
+using Error = std::pair<int, std::string>;
+
+// Instruction encoding
+struct Insn {
+  uint8_t code;
+  uint8_t dst_reg : 4;
+  uint8_t src_reg : 4;
+  int16_t off;
+  int32_t imm;
+};
+
+static_assert(sizeof(Insn) == 8, "eBPF instructions are 8 bytes long");
+
+// Instruction classes (code & 0x07)
+const uint8_t kLd = 0x00;
+const uint8_t kLdx = 0x01;
+const uint8_t kSt = 0x02;
+const uint8_t kStx = 0x03;
+const uint8_t kAlu = 0x04;
+const uint8_t kJmp = 0x05;
+const uint8_t kAlu64 = 0x07;
+
+// Memory access sizes (code & 0x18)
+const uint8_t kW = 0x00;
+const uint8_t kH = 0x08;
+const uint8_t kB = 0x10;
+const uint8_t kDW = 0x18;
+
+// Memory access modes (code & 0xe0)
+const uint8_t kImm = 0x00;
+const uint8_t kMem = 0x60;
+const uint8_t kXadd = 0xc0;
+
+// Source operands of ALU and jump instructions (code & 0x08)
+const uint8_t kK = 0x00;  // imm
+const uint8_t kX = 0x08;  // src_reg
+
+// ALU operations (code & 0xf0)
+const uint8_t kAdd = 0x00;
+const uint8_t kSub = 0x10;
+const uint8_t kMul = 0x20;
+const uint8_t kDiv = 0x30;
+const uint8_t kOr = 0x40;
+const uint8_t kAnd = 0x50;
+const uint8_t kLsh = 0x60;
+const uint8_t kRsh = 0x70;
+const uint8_t kNeg = 0x80;
+const uint8_t kMod = 0x90;
+const uint8_t kXor = 0xa0;
+const uint8_t kMov = 0xb0;
+const uint8_t kArsh = 0xc0;
+const uint8_t kEnd = 0xd0;  // Byte swap. kK: to little endian, kX: to big
+
+// Jump operations (code & 0xf0)
+const uint8_t kJa = 0x00;
+const uint8_t kJeq = 0x10;
+const uint8_t kJgt = 0x20;
+const uint8_t kJge = 0x30;
+const uint8_t kJset = 0x40;
+const uint8_t kJne = 0x50;
+const uint8_t kJsgt = 0x60;
+const uint8_t kJsge = 0x70;
+const uint8_t kCall = 0x80;
+const uint8_t kExit = 0x90;
+const uint8_t kJlt = 0xa0;
+const uint8_t kJle = 0xb0;
+const uint8_t kJslt = 0xc0;
+const uint8_t kJsle = 0xd0;
+
+// Returns the size of memory accesses of load and store instructions
+inline size_t AccessSize(uint8_t code) {
+  switch (code & 0x18) {
+    case kB:
+      return 1;
+    case kH:
+      return 2;
+    case kW:
+      return 4;
+    default:
+      return 8;
+  }
+}
+
+// src_reg of a 64-bit immediate load (kLd | kDW | kImm) whose imm is the
+// index of a map, rather than a constant
+const uint8_t kPseudoMap = 1;
+
+const int kNumRegs = 11;
+const int kFramePointer = 10;  // R10, read-only
+const int kStackSize = 512;
+const size_t kMaxInsns = 4096;
+
+// Helper functions, called with "call <id>". The IDs and signatures follow
+// Linux where there is a counterpart, so existing headers can be used.
+enum Helper : int32_t {
+  // void *map_lookup_elem(map, const void *key)
+  kHelperMapLookupElem = 1,
+  // int map_update_elem(map, const void *key, const void *value, u64 flags)
+  kHelperMapUpdateElem = 2,
+  // int map_delete_elem(map, const void *key)
+  kHelperMapDeleteElem = 3,
+  // u64 ktime_get_ns(void)
+  kHelperKtimeGetNs = 5,
+  // int skb_store_bytes(ctx, u32 offset, const void *from, u32 len, u64 flags)
+  kHelperSkbStoreBytes = 9,
+  // int skb_load_bytes(ctx, u32 offset, void *to, u32 len)
+  kHelperSkbLoadBytes = 26,
+  // int xdp_adjust_head(ctx, int delta). A negative delta prepends bytes.
+  kHelperXdpAdjustHead = 44,
+  // int xdp_adjust_tail(ctx, int delta). A negative delta trims bytes.
+  kHelperXdpAdjustTail = 65,
+  // int get_metadata(ctx, u32 attr, void *to, u32 len)
+  kHelperGetMetadata = 1000,
+  // int set_metadata(ctx, u32 attr, const void *from, u32 len)
+  kHelperSetMetadata = 1001,
+};
+
+// Flags of map_update_elem()
+const uint64_t kMapUpdateAny = 0;      // Create or update
+const uint64_t kMapUpdateNoExist = 1;  // Create only
+const uint64_t kMapUpdateExist = 2;    // Update only
+
+// What programs get in R1. Only the fields before "pkt" are visible to them
+// (read-only, at their exact offsets and sizes).
+struct PacketContext {
+  uint64_t data;      // Start of the packet data in the first segment
+  uint64_t data_end;  // End of the packet data in the first segment
+  uint32_t len;       // Total length of the packet
+  uint32_t igate;     // Input gate
+
+  // The rest is for helpers
+  bess::Packet *pkt;
+  const bess::metadata::mt_offset_t *attr_offsets;
+
+  // Points data and data_end at the first segment of "pkt"
+  void Reset() {
+    data = reinterpret_cast<uintptr_t>(pkt->head_data());
+    data_end = data + pkt->head_len();
+    len = pkt->total_len();
+  }
+};
+
+const int kContextSize = offsetof(PacketContext, pkt);
+
+// An array or hash table of fixed-size values, shared by programs and the
+// control plane. Values do not move while they are in the map, so programs
+// can keep pointers to them across helper calls. Not thread safe.
+class Map {
+ public:
+  enum Type {
+    kArray = 0,  // Keys are u32 indices, and all entries always exist
+    kHash,
+  };
+
+  static const size_t kMaxKeySize = 64;
+  static const size_t kMaxValueSize = 4096;
+  static const size_t kMaxEntries = 1 << 24;
+  static const size_t kMaxMemory = 1 << 30;  // For all values
+
+  Map() : type_(kArray), key_size_(), value_size_(), max_entries_() {}
+
+  Error Init(Type type, uint32_t key_size, uint32_t value_size,
+             uint32_t max_entries);
+
+  // Returns a pointer to the value of "key" (key_size() bytes), or nullptr
+  void *Lookup(const void *key);
+
+  // Returns 0 on success, or -errno
+  int Update(const void *key, const void *value, uint64_t flags);
+  int Delete(const void *key);
+
+  // Removes all entries. Array values are zeroed.
+  void Clear();
+
+  Type type() const { return type_; }
+  uint32_t key_size() const { return key_size_; }
+  uint32_t value_size() const { return value_size_; }
+  uint32_t max_entries() const { return max_entries_; }
+
+ private:
+  struct Key {
+    uint64_t words[kMaxKeySize / sizeof(uint64_t)];
+  };
+
+  class KeyHash {
+   public:
+    explicit KeyHash(size_t len) : len_(len) {}
+    HashResult operator()(const Key &key) const;
+
+   private:
+    size_t len_;
+  };
+
+  class KeyEq {
+   public:
+    explicit KeyEq(size_t len) : len_(len) {}
+    bool operator()(const Key &lhs, const Key &rhs) const {
+      return memcmp(&lhs, &rhs, len_) == 0;
+    }
+
+   private:
+    size_t len_;
+  };
+
+  Key MakeKey(const void *key) const {
+    Key k = {};
+    memcpy(&k, key, key_size_);
+    return k;
+  }
+
+  void *value(uint32_t slot) { return &values_[slot * value_words_]; }
+
+  Type type_;
+  uint32_t key_size_;
+  uint32_t value_size_;
+  uint32_t max_entries_;
+  size_t value_words_;
+
+  // Values are 8-byte aligned, max_entries_ slots of value_words_ each
+  std::vector<uint64_t> values_;
+
+  // For hash maps, the slot of each key and the slots not in use
+  CuckooMap<Key, uint32_t, KeyHash, KeyEq> index_;
+  std::vector<uint32_t> free_slots_;
+};
+
+// A verified program, ready to run
+class Program {
+ public:
+  // A metadata attribute accessible with get/set_metadata()
+  struct Attr {
+    uint32_t size;
+    bool readable;
+    bool writable;
+  };
+
+  Program() : func_(), code_size_(), writes_packet_() {}
+  ~Program() { Unload(); }
+
+  Program(const Program &) = delete;
+  Program &operator=(const Program &) = delete;
+
+  // Verifies "insns" and prepares them to run, replacing the current program
+  // if successful. Map references resolve to "maps", and attribute indices
+  // to "attrs". If "jit" is set, the program is compiled to native code.
+  Error Load(const std::vector<Insn> &insns,
+             const std::vector<std::shared_ptr<Map>> &maps,
+             const std::vector<Attr> &attrs, bool jit);
+
+  void Unload();
+
+  // Runs the program on each of "cnt" contexts, storing R0 of each run into
+  // "rets". This amortizes the entry and exit of JIT-compiled code.
+  void RunBatch(PacketContext *const *ctxs, size_t cnt, uint64_t *rets) const {
+    if (func_) {
+      func_(ctxs, cnt, rets);
+    } else {
+      for (size_t i = 0; i < cnt; i++) {
+        rets[i] = Interpret(ctxs[i]);
+      }
+    }
+  }
+
+  uint64_t Run(PacketContext *ctx) const {
+    uint64_t ret;
+    RunBatch(&ctx, 1, &ret);
+    return ret;
+  }
+
+  bool loaded() const { return !insns_.empty(); }
+  bool jitted() const { return func_ != nullptr; }
+
+  // Does the program write to packet data directly? If so, the packet must
+  // be private to the caller (see Packet::make_writable()).
+  bool writes_packet() const { return writes_packet_; }
+
+ private:
+  using JitFunc = void (*)(PacketContext *const *, size_t, uint64_t *);
+
+  class Verifier;
+
+  uint64_t Interpret(PacketContext *ctx) const;
+
+  // Returns the address of the i-th helper function
+  static void *HelperAddress(int idx);
+
+  // Compiles insns_ into func_. Returns false if not supported.
+  bool Compile();
+
+  // Verified instructions. The imm of calls is an index into the helper
+  // table, and map references are replaced by Map pointers.
+  std::vector<Insn> insns_;
+  std::vector<std::shared_ptr<Map>> maps_;
+
+  JitFunc func_;
+  size_t code_size_;
+  bool writes_packet_;
+};
+
+}  // namespace ebpf
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_EBPF_H_
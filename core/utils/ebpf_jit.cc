@@ -0,0 +1,692 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// An x86-64 JIT compiler for verified eBPF programs
+
+#include "ebpf.h"
+
+#ifdef __x86_64
+#include <sys/mman.h>
+#endif
+
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace bess {
+namespace utils {
+namespace ebpf {
+
+#ifdef __x86_64
+
+namespace {
+
+enum X86Reg : uint8_t {
+  kRax = 0,
+  kRcx,
+  kRdx,
+  kRbx,
+  kRsp,
+  kRbp,
+  kRsi,
+  kRdi,
+  kR8,
+  kR9,
+  kR10,
+  kR11,
+  kR12,
+  kR13,
+  kR14,
+  kR15,
+};
+
+// R1-R5 are the argument registers of the System V ABI, so helpers are
+// called without moving anything around. R6-R10 are callee-saved.
+const uint8_t kRegMap[kNumRegs] = {kRax, kRdi, kRsi, kRdx, kRcx, kR8,
+                                   kRbx, kR13, kR14, kR15, kRbp};
+
+// Not used by eBPF registers: R9-R11 are scratch, and R12 (callee-saved)
+// holds the index of the current context in the batch.
+const uint8_t kTmp = kR11;
+const uint8_t kIdx = kR12;
+
+// The stack frame below the saved registers, which rbp points to: the eBPF
+// stack, then the arguments of the batch function.
+const int32_t kCtxsSlot = -kStackSize - 8;
+const int32_t kCntSlot = -kStackSize - 16;
+const int32_t kRetsSlot = -kStackSize - 24;
+const int32_t kFrameSize = kStackSize + 24;
+
+// Condition codes of Jcc
+const uint8_t kCcB = 0x2;
+const uint8_t kCcAe = 0x3;
+const uint8_t kCcE = 0x4;
+const uint8_t kCcNe = 0x5;
+const uint8_t kCcBe = 0x6;
+const uint8_t kCcA = 0x7;
+const uint8_t kCcL = 0xc;
+const uint8_t kCcGe = 0xd;
+const uint8_t kCcLe = 0xe;
+const uint8_t kCcG = 0xf;
+
+class Emitter {
+ public:
+  const std::vector<uint8_t> &code() const { return code_; }
+  size_t pos() const { return code_.size(); }
+
+  void Byte(uint8_t b) { code_.push_back(b); }
+
+  void Imm16(int16_t v) { Append(&v, sizeof(v)); }
+  void Imm32(int32_t v) { Append(&v, sizeof(v)); }
+  void Imm64(uint64_t v) { Append(&v, sizeof(v)); }
+
+  // The REX prefix, if needed. "force" gives access to spl/bpl/sil/dil.
+  void Rex(bool w, uint8_t reg, uint8_t rm, bool force = false) {
+    uint8_t rex = 0x40 | (w << 3) | ((reg & 8) >> 1) | ((rm & 8) >> 3);
+    if (rex != 0x40 || force) {
+      Byte(rex);
+    }
+  }
+
+  void ModRm(uint8_t mod, uint8_t reg, uint8_t rm) {
+    Byte((mod << 6) | ((reg & 7) << 3) | (rm & 7));
+  }
+
+  // ModRM (and SIB) for [base + disp32]
+  void Mem(uint8_t reg, uint8_t base, int32_t disp) {
+    ModRm(2, reg, base);
+    if ((base & 7) == kRsp) {
+      Byte(0x24);
+    }
+    Imm32(disp);
+  }
+
+  // "opcode r/m, reg" (e.g., add, cmp, mov, test): dst = dst op src
+  void AluRR(bool w, uint8_t opcode, uint8_t dst, uint8_t src) {
+    Rex(w, src, dst);
+    Byte(opcode);
+    ModRm(3, src, dst);
+  }
+
+  // Group 1 with imm32: dst = dst op imm
+  void AluRI(bool w, uint8_t ext, uint8_t dst, int32_t imm) {
+    Rex(w, 0, dst);
+    Byte(0x81);
+    ModRm(3, ext, dst);
+    Imm32(imm);
+  }
+
+  void Mov(bool w, uint8_t dst, uint8_t src) { AluRR(w, 0x89, dst, src); }
+
+  // 32-bit moves zero-extend, and 64-bit ones sign-extend "imm"
+  void MovImm(bool w, uint8_t dst, int32_t imm) {
+    if (w) {
+      Rex(true, 0, dst);
+      Byte(0xc7);
+      ModRm(3, 0, dst);
+    } else {
+      Rex(false, 0, dst);
+      Byte(0xb8 + (dst & 7));
+    }
+    Imm32(imm);
+  }
+
+  void MovImm64(uint8_t dst, uint64_t imm) {
+    Rex(true, 0, dst);
+    Byte(0xb8 + (dst & 7));
+    Imm64(imm);
+  }
+
+  // Group 2 (shifts) by imm8 or by cl
+  void Shift(bool w, uint8_t ext, uint8_t dst, uint8_t imm) {
+    Rex(w, 0, dst);
+    Byte(0xc1);
+    ModRm(3, ext, dst);
+    Byte(imm);
+  }
+
+  void ShiftCl(bool w, uint8_t ext, uint8_t dst) {
+    Rex(w, 0, dst);
+    Byte(0xd3);
+    ModRm(3, ext, dst);
+  }
+
+  // Group 3 (test imm, neg, div)
+  void Group3(bool w, uint8_t ext, uint8_t dst) {
+    Rex(w, 0, dst);
+    Byte(0xf7);
+    ModRm(3, ext, dst);
+  }
+
+  // movzx dst32, src16
+  void Movzx16(uint8_t dst, uint8_t src) {
+    Rex(false, dst, src);
+    Byte(0x0f);
+    Byte(0xb7);
+    ModRm(3, dst, src);
+  }
+
+  // Zero-extending load
+  void Load(size_t size, uint8_t dst, uint8_t base, int32_t disp) {
+    Rex(size == 8, dst, base);
+    switch (size) {
+      case 1:
+        Byte(0x0f);
+        Byte(0xb6);
+        break;
+      case 2:
+        Byte(0x0f);
+        Byte(0xb7);
+        break;
+      default:
+        Byte(0x8b);
+        break;
+    }
+    Mem(dst, base, disp);
+  }
+
+  void Store(size_t size, uint8_t base, int32_t disp, uint8_t src) {
+    if (size == 2) {
+      Byte(0x66);
+    }
+    Rex(size == 8, src, base, size == 1);
+    Byte(size == 1 ? 0x88 : 0x89);
+    Mem(src, base, disp);
+  }
+
+  void StoreImm(size_t size, uint8_t base, int32_t disp, int32_t imm) {
+    if (size == 2) {
+      Byte(0x66);
+    }
+    Rex(size == 8, 0, base);
+    Byte(size == 1 ? 0xc6 : 0xc7);
+    Mem(0, base, disp);
+    switch (size) {
+      case 1:
+        Byte(imm);
+        break;
+      case 2:
+        Imm16(imm);
+        break;
+      default:
+        Imm32(imm);
+        break;
+    }
+  }
+
+  void Push(uint8_t reg) {
+    Rex(false, 0, reg);
+    Byte(0x50 + (reg & 7));
+  }
+
+  void Pop(uint8_t reg) {
+    Rex(false, 0, reg);
+    Byte(0x58 + (reg & 7));
+  }
+
+  // Jumps with a 32-bit displacement, to be patched later. Return the
+  // position of the displacement.
+  size_t Jmp() {
+    Byte(0xe9);
+    Imm32(0);
+    return pos() - 4;
+  }
+
+  size_t Jcc(uint8_t cc) {
+    Byte(0x0f);
+    Byte(0x80 | cc);
+    Imm32(0);
+    return pos() - 4;
+  }
+
+  // Points the jump whose displacement is at "at" to "target"
+  void Patch(size_t at, size_t target) {
+    int32_t rel = target - (at + 4);
+    memcpy(&code_[at], &rel, sizeof(rel));
+  }
+
+ private:
+  void Append(const void *p, size_t len) {
+    const uint8_t *b = static_cast<const uint8_t *>(p);
+    code_.insert(code_.end(), b, b + len);
+  }
+
+  std::vector<uint8_t> code_;
+};
+
+class Compiler {
+ public:
+  explicit Compiler(const std::vector<Insn> &insns) : insns_(insns) {}
+
+  // Returns machine code for a function with the signature of
+  // Program::JitFunc, which runs the program on each context
+  std::vector<uint8_t> Compile(void *(*helper_address)(int));
+
+ private:
+  void Alu(const Insn &insn);
+  void ShiftX(bool w, uint8_t ext, uint8_t dst, uint8_t src);
+  void Div(bool w, bool mod, uint8_t dst, const Insn &insn);
+  void ByteSwap(const Insn &insn);
+  void Branch(size_t pc, const Insn &insn);
+
+  const std::vector<Insn> &insns_;
+  Emitter e_;
+
+  // Jumps to patch: (displacement position, target instruction)
+  std::vector<std::pair<size_t, size_t>> fixups_;
+
+  // Jumps to the end of the program (for exit)
+  std::vector<size_t> exits_;
+};
+
+void Compiler::Alu(const Insn &insn) {
+  bool w = (insn.code & 0x07) == kAlu64;
+  bool x = insn.code & kX;
+  uint8_t dst = kRegMap[insn.dst_reg];
+  uint8_t src = kRegMap[insn.src_reg];
+
+  // (opcode of "op r/m, r", group 1 extension) for simple operations
+  uint8_t opcode = 0;
+  uint8_t ext = 0;
+
+  switch (insn.code & 0xf0) {
+    case kAdd:
+      opcode = 0x01, ext = 0;
+      break;
+    case kOr:
+      opcode = 0x09, ext = 1;
+      break;
+    case kAnd:
+      opcode = 0x21, ext = 4;
+      break;
+    case kSub:
+      opcode = 0x29, ext = 5;
+      break;
+    case kXor:
+      opcode = 0x31, ext = 6;
+      break;
+
+    case kMov:
+      if (x) {
+        e_.Mov(w, dst, src);
+      } else {
+        e_.MovImm(w, dst, insn.imm);
+      }
+      return;
+
+    case kMul:
+      if (x) {
+        e_.Rex(w, dst, src);
+        e_.Byte(0x0f);
+        e_.Byte(0xaf);
+        e_.ModRm(3, dst, src);
+      } else {
+        e_.Rex(w, dst, dst);
+        e_.Byte(0x69);
+        e_.ModRm(3, dst, dst);
+        e_.Imm32(insn.imm);
+      }
+      return;
+
+    case kNeg:
+      e_.Group3(w, 3, dst);
+      return;
+
+    case kLsh:
+    case kRsh:
+    case kArsh: {
+      uint8_t shift_ext = 4;
+      if ((insn.code & 0xf0) == kRsh) {
+        shift_ext = 5;
+      } else if ((insn.code & 0xf0) == kArsh) {
+        shift_ext = 7;
+      }
+      if (x) {
+        ShiftX(w, shift_ext, dst, src);
+      } else {
+        e_.Shift(w, shift_ext, dst, insn.imm);
+      }
+      return;
+    }
+
+    case kDiv:
+    case kMod:
+      Div(w, (insn.code & 0xf0) == kMod, dst, insn);
+      return;
+
+    case kEnd:
+      ByteSwap(insn);
+      return;
+  }
+
+  if (x) {
+    e_.AluRR(w, opcode, dst, src);
+  } else {
+    e_.AluRI(w, ext, dst, insn.imm);
+  }
+}
+
+// Shifts count in cl, which holds R4
+void Compiler::ShiftX(bool w, uint8_t ext, uint8_t dst, uint8_t src) {
+  if (src == kRcx) {
+    e_.ShiftCl(w, ext, dst);
+    return;
+  }
+
+  e_.Mov(true, kTmp, kRcx);
+  e_.Mov(true, kRcx, src);
+  if (dst == kRcx) {
+    e_.ShiftCl(w, ext, kTmp);
+    e_.Mov(true, kRcx, kTmp);
+  } else {
+    e_.ShiftCl(w, ext, dst);
+    e_.Mov(true, kRcx, kTmp);
+  }
+}
+
+// div uses rax and rdx, which hold R0 and R3
+void Compiler::Div(bool w, bool mod, uint8_t dst, const Insn &insn) {
+  if (insn.code & kX) {
+    e_.Mov(true, kTmp, kRegMap[insn.src_reg]);
+  } else {
+    e_.MovImm(w, kTmp, insn.imm);
+  }
+
+  e_.AluRR(w, 0x85, kTmp, kTmp);  // test
+  size_t nonzero = e_.Jcc(kCcNe);
+
+  // Division by zero yields 0, and modulo by zero leaves dst unchanged
+  if (mod) {
+    if (!w) {
+      e_.Mov(false, dst, dst);
+    }
+  } else {
+    e_.AluRR(false, 0x31, dst, dst);
+  }
+  size_t done = e_.Jmp();
+
+  e_.Patch(nonzero, e_.pos());
+  e_.Mov(true, kR10, kRax);
+  e_.Mov(true, kR9, kRdx);
+  e_.Mov(true, kRax, dst);
+  e_.AluRR(false, 0x31, kRdx, kRdx);
+  e_.Group3(w, 6, kTmp);  // div
+  e_.Mov(true, kTmp, mod ? kRdx : kRax);
+  e_.Mov(true, kRax, kR10);
+  e_.Mov(true, kRdx, kR9);
+  e_.Mov(w, dst, kTmp);
+
+  e_.Patch(done, e_.pos());
+}
+
+void Compiler::ByteSwap(const Insn &insn) {
+  uint8_t dst = kRegMap[insn.dst_reg];
+
+  if (!(insn.code & kX)) {
+    // To little endian: only truncates
+    if (insn.imm == 16) {
+      e_.Movzx16(dst, dst);
+    } else if (insn.imm == 32) {
+      e_.Mov(false, dst, dst);
+    }
+    return;
+  }
+
+  if (insn.imm == 16) {
+    // rol dst16, 8
+    e_.Byte(0x66);
+    e_.Shift(false, 0, dst, 8);
+    e_.Movzx16(dst, dst);
+  } else {
+    e_.Rex(insn.imm == 64, 0, dst);
+    e_.Byte(0x0f);
+    e_.Byte(0xc8 + (dst & 7));
+  }
+}
+
+void Compiler::Branch(size_t pc, const Insn &insn) {
+  uint8_t dst = kRegMap[insn.dst_reg];
+  uint8_t op = insn.code & 0xf0;
+  uint8_t cc;
+
+  if (op == kJset) {
+    if (insn.code & kX) {
+      e_.AluRR(true, 0x85, dst, kRegMap[insn.src_reg]);
+    } else {
+      e_.Group3(true, 0, dst);
+      e_.Imm32(insn.imm);
+    }
+  } else {
+    if (insn.code & kX) {
+      e_.AluRR(true, 0x39, dst, kRegMap[insn.src_reg]);
+    } else {
+      e_.AluRI(true, 7, dst, insn.imm);
+    }
+  }
+
+  switch (op) {
+    case kJeq:
+      cc = kCcE;
+      break;
+    case kJgt:
+      cc = kCcA;
+      break;
+    case kJge:
+      cc = kCcAe;
+      break;
+    case kJlt:
+      cc = kCcB;
+      break;
+    case kJle:
+      cc = kCcBe;
+      break;
+    case kJsgt:
+      cc = kCcG;
+      break;
+    case kJsge:
+      cc = kCcGe;
+      break;
+    case kJslt:
+      cc = kCcL;
+      break;
+    case kJsle:
+      cc = kCcLe;
+      break;
+    default:  // kJne, kJset
+      cc = kCcNe;
+      break;
+  }
+
+  fixups_.emplace_back(e_.Jcc(cc), pc + 1 + insn.off);
+}
+
+std::vector<uint8_t> Compiler::Compile(void *(*helper_address)(int)) {
+  static const uint8_t kSaved[] = {kRbp, kRbx, kR12, kR13, kR14, kR15};
+
+  // Prologue. Six pushes and the frame keep rsp 16-byte aligned for calls.
+  for (uint8_t reg : kSaved) {
+    e_.Push(reg);
+  }
+  e_.Mov(true, kRbp, kRsp);
+  e_.AluRI(true, 5, kRsp, kFrameSize);  // sub
+  e_.Store(8, kRbp, kCtxsSlot, kRdi);
+  e_.Store(8, kRbp, kCntSlot, kRsi);
+  e_.Store(8, kRbp, kRetsSlot, kRdx);
+  e_.AluRR(false, 0x31, kIdx, kIdx);
+
+  // R1 = ctxs[idx]
+  size_t loop = e_.pos();
+  e_.Rex(true, kIdx, kRbp);
+  e_.Byte(0x3b);  // cmp idx, cnt
+  e_.Mem(kIdx, kRbp, kCntSlot);
+  size_t done = e_.Jcc(kCcAe);
+
+  e_.Load(8, kRax, kRbp, kCtxsSlot);
+  e_.Mov(true, kRdi, kIdx);
+  e_.Shift(true, 4, kRdi, 3);
+  e_.AluRR(true, 0x01, kRdi, kRax);
+  e_.Load(8, kRdi, kRdi, 0);
+
+  std::vector<size_t> offsets(insns_.size());
+  for (size_t pc = 0; pc < insns_.size(); pc++) {
+    const Insn &insn = insns_[pc];
+    uint8_t op = insn.code & 0xf0;
+    uint8_t dst = kRegMap[insn.dst_reg];
+    uint8_t src = kRegMap[insn.src_reg];
+    size_t size = AccessSize(insn.code);
+
+    offsets[pc] = e_.pos();
+
+    switch (insn.code & 0x07) {
+      case kAlu:
+      case kAlu64:
+        Alu(insn);
+        break;
+
+      case kLd:
+        e_.MovImm64(dst, static_cast<uint32_t>(insn.imm) |
+                             static_cast<uint64_t>(insns_[pc + 1].imm) << 32);
+        offsets[++pc] = e_.pos();
+        break;
+
+      case kLdx:
+        e_.Load(size, dst, src, insn.off);
+        break;
+
+      case kSt:
+        e_.StoreImm(size, dst, insn.off, insn.imm);
+        break;
+
+      case kStx:
+        if ((insn.code & 0xe0) == kXadd) {
+          e_.Byte(0xf0);  // lock add
+          e_.Rex(size == 8, src, dst);
+          e_.Byte(0x01);
+          e_.Mem(src, dst, insn.off);
+        } else {
+          e_.Store(size, dst, insn.off, src);
+        }
+        break;
+
+      case kJmp:
+        if (op == kExit) {
+          exits_.push_back(e_.Jmp());
+        } else if (op == kCall) {
+          e_.MovImm64(kRax,
+                      reinterpret_cast<uintptr_t>(helper_address(insn.imm)));
+          e_.Byte(0xff);  // call rax
+          e_.ModRm(3, 2, kRax);
+        } else if (op == kJa) {
+          fixups_.emplace_back(e_.Jmp(), pc + 1 + insn.off);
+        } else {
+          Branch(pc, insn);
+        }
+        break;
+    }
+  }
+
+  for (const auto &fixup : fixups_) {
+    e_.Patch(fixup.first, offsets[fixup.second]);
+  }
+
+  // rets[idx++] = R0
+  for (size_t exit : exits_) {
+    e_.Patch(exit, e_.pos());
+  }
+  e_.Load(8, kRcx, kRbp, kRetsSlot);
+  e_.Mov(true, kRdx, kIdx);
+  e_.Shift(true, 4, kRdx, 3);
+  e_.AluRR(true, 0x01, kRcx, kRdx);
+  e_.Store(8, kRcx, 0, kRax);
+  e_.AluRI(true, 0, kIdx, 1);
+  e_.Patch(e_.Jmp(), loop);
+
+  // Epilogue
+  e_.Patch(done, e_.pos());
+  e_.Mov(true, kRsp, kRbp);
+  for (int i = sizeof(kSaved) - 1; i >= 0; i--) {
+    e_.Pop(kSaved[i]);
+  }
+  e_.Byte(0xc3);  // ret
+
+  return e_.code();
+}
+
+}  // namespace
+
+bool Program::Compile() {
+  std::vector<uint8_t> code = Compiler(insns_).Compile(HelperAddress);
+
+  void *mem = mmap(nullptr, code.size(), PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) {
+    return false;
+  }
+
+  memcpy(mem, code.data(), code.size());
+  if (mprotect(mem, code.size(), PROT_READ | PROT_EXEC) != 0) {
+    munmap(mem, code.size());
+    return false;
+  }
+
+  func_ = reinterpret_cast<JitFunc>(mem);
+  code_size_ = code.size();
+  return true;
+}
+
+void Program::Unload() {
+  if (func_) {
+    munmap(reinterpret_cast<void *>(func_), code_size_);
+    func_ = nullptr;
+    code_size_ = 0;
+  }
+
+  insns_.clear();
+  maps_.clear();
+  writes_packet_ = false;
+}
+
+#else  // __x86_64
+
+bool Program::Compile() {
+  return false;
+}
+
+void Program::Unload() {
+  insns_.clear();
+  maps_.clear();
+  writes_packet_ = false;
+}
+
+#endif  // __x86_64
+
+}  // namespace ebpf
+}  // namespace utils
+}  // namespace bess
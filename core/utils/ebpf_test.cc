@@ -0,0 +1,521 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "ebpf.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <random>
+
+#include "../packet.h"
+
+using namespace bess::utils::ebpf;
+
+namespace {
+
+Insn I(uint8_t code, int dst, int src, int16_t off, int32_t imm) {
+  Insn insn;
+  insn.code = code;
+  insn.dst_reg = dst;
+  insn.src_reg = src;
+  insn.off = off;
+  insn.imm = imm;
+  return insn;
+}
+
+// A tiny assembler
+Insn MovK(int dst, int32_t imm) {
+  return I(kAlu64 | kMov | kK, dst, 0, 0, imm);
+}
+Insn MovX(int dst, int src) { return I(kAlu64 | kMov | kX, dst, src, 0, 0); }
+Insn Alu64K(uint8_t op, int dst, int32_t imm) {
+  return I(kAlu64 | op | kK, dst, 0, 0, imm);
+}
+Insn Alu64X(uint8_t op, int dst, int src) {
+  return I(kAlu64 | op | kX, dst, src, 0, 0);
+}
+Insn JmpK(uint8_t op, int dst, int32_t imm, int16_t off) {
+  return I(kJmp | op | kK, dst, 0, off, imm);
+}
+Insn JmpX(uint8_t op, int dst, int src, int16_t off) {
+  return I(kJmp | op | kX, dst, src, off, 0);
+}
+Insn Ldx(uint8_t size, int dst, int src, int16_t off) {
+  return I(kLdx | kMem | size, dst, src, off, 0);
+}
+Insn St(uint8_t size, int dst, int16_t off, int32_t imm) {
+  return I(kSt | kMem | size, dst, 0, off, imm);
+}
+Insn Stx(uint8_t size, int dst, int16_t off, int src) {
+  return I(kStx | kMem | size, dst, src, off, 0);
+}
+Insn Call(int32_t helper) { return I(kJmp | kCall, 0, 0, 0, helper); }
+Insn Exit() { return I(kJmp | kExit, 0, 0, 0, 0); }
+
+void LdImm64(std::vector<Insn> *prog, int dst, uint64_t imm, int src = 0) {
+  prog->push_back(I(kLd | kDW | kImm, dst, src, 0, static_cast<uint32_t>(imm)));
+  prog->push_back(I(0, 0, 0, 0, imm >> 32));
+}
+
+class EbpfTest : public ::testing::Test {
+ protected:
+  // Loads "prog", expecting an error if "ok" is false
+  void Load(const std::vector<Insn> &prog, bool ok = true) {
+    for (int i = 0; i < 2; i++) {
+      Error err = progs_[i].Load(prog, maps_, attrs_, i == 1);
+      if (ok) {
+        ASSERT_EQ(0, err.first) << err.second;
+      } else {
+        ASSERT_NE(0, err.first);
+      }
+    }
+  }
+
+  // Runs the interpreted and compiled programs, which must agree
+  uint64_t Run(PacketContext *ctx) {
+    uint64_t ret = progs_[0].Run(ctx);
+    EXPECT_EQ(ret, progs_[1].Run(ctx));
+    return ret;
+  }
+
+  uint64_t Run() {
+    PacketContext ctx = {};
+    return Run(&ctx);
+  }
+
+  std::vector<std::shared_ptr<Map>> maps_;
+  std::vector<Program::Attr> attrs_;
+  Program progs_[2];  // Interpreted, JIT-compiled
+};
+
+TEST_F(EbpfTest, Alu) {
+  std::vector<Insn> prog = {
+      MovK(0, 7),
+      Alu64K(kMul, 0, 6),        // 42
+      MovK(1, -1),               // 0xffffffffffffffff
+      I(kAlu | kAdd | kK, 1, 0, 0, 1),  // 32-bit: 0
+      Alu64X(kAdd, 0, 1),        // 42
+      MovK(2, 5),
+      Alu64X(kDiv, 0, 2),        // 8
+      Alu64K(kLsh, 0, 4),        // 128
+      MovK(3, 0),
+      Alu64X(kDiv, 2, 3),        // Division by zero: 0
+      Alu64X(kOr, 0, 2),         // 128
+      Exit(),
+  };
+  Load(prog);
+  EXPECT_EQ(128, Run());
+  EXPECT_TRUE(progs_[1].jitted());
+}
+
+TEST_F(EbpfTest, ByteSwap) {
+  std::vector<Insn> prog;
+  LdImm64(&prog, 0, 0x0102030405060708);
+  prog.push_back(I(kAlu | kEnd | kX, 0, 0, 0, 32));  // to big endian
+  prog.push_back(Exit());
+  Load(prog);
+  EXPECT_EQ(0x08070605, Run());
+
+  prog[2].imm = 16;
+  Load(prog);
+  EXPECT_EQ(0x0807, Run());
+
+  prog[2].imm = 64;
+  Load(prog);
+  EXPECT_EQ(0x0807060504030201, Run());
+
+  prog[2].code = kAlu | kEnd | kK;  // to little endian
+  prog[2].imm = 16;
+  Load(prog);
+  EXPECT_EQ(0x0708, Run());
+}
+
+TEST_F(EbpfTest, Jumps) {
+  // return (int64)r1 < -1 ? 1 : (r1 > 5 ? 2 : 3), for r1 = -2 and 9
+  for (int64_t v : {-2, 9, 4}) {
+    std::vector<Insn> prog;
+    LdImm64(&prog, 1, v);
+    prog.push_back(JmpK(kJslt, 1, -1, 2));
+    prog.push_back(JmpK(kJgt, 1, 5, 3));
+    prog.push_back(I(kJmp | kJa, 0, 0, 4, 0));
+    prog.push_back(MovK(0, 1));
+    prog.push_back(Exit());
+    prog.push_back(MovK(0, 2));
+    prog.push_back(Exit());
+    prog.push_back(MovK(0, 3));
+    prog.push_back(Exit());
+    Load(prog);
+    EXPECT_EQ(v == -2 ? 1 : (v == 9 ? 2 : 3), Run()) << v;
+  }
+}
+
+TEST_F(EbpfTest, Stack) {
+  std::vector<Insn> prog = {
+      St(kDW, kFramePointer, -8, 40),
+      MovK(1, 2),
+      MovX(2, kFramePointer),
+      Alu64K(kAdd, 2, -8),
+      I(kStx | kXadd | kDW, 2, 1, 0, 0),  // Atomic add
+      Ldx(kDW, 0, kFramePointer, -8),
+      Exit(),
+  };
+  Load(prog);
+  EXPECT_EQ(42, Run());
+}
+
+TEST_F(EbpfTest, StackUninitialized) {
+  // The stack is not cleared between runs, so these could see what the
+  // previous one left there
+  std::vector<std::vector<Insn>> progs = {
+      // Read before written
+      {Ldx(kDW, 0, kFramePointer, -8), St(kDW, kFramePointer, -8, 42), Exit()},
+      // Partially written
+      {St(kW, kFramePointer, -8, 1), Ldx(kDW, 0, kFramePointer, -8), Exit()},
+      // Atomic add reads the old value
+      {MovK(1, 1), I(kStx | kXadd | kDW, kFramePointer, 1, -8, 0), MovK(0, 0),
+       Exit()},
+      // Written on one path only
+      {Ldx(kW, 2, 1, offsetof(PacketContext, len)), JmpK(kJeq, 2, 0, 1),
+       St(kDW, kFramePointer, -8, 1), Ldx(kDW, 0, kFramePointer, -8), Exit()},
+      // Passed to a helper that reads it
+      {MovK(2, 0), MovX(3, kFramePointer), Alu64K(kAdd, 3, -8), MovK(4, 8),
+       MovK(5, 0), Call(kHelperSkbStoreBytes), Exit()},
+  };
+
+  for (const auto &prog : progs) {
+    Load(prog, false);
+  }
+
+  // Helpers fill their output in full, even on failure (here, with zeros,
+  // since the offset is past the end of the packet)
+  std::vector<Insn> prog = {
+      MovK(2, 100),
+      MovX(3, kFramePointer),
+      Alu64K(kAdd, 3, -8),
+      MovK(4, 8),
+      Call(kHelperSkbLoadBytes),
+      Ldx(kDW, 0, kFramePointer, -8),
+      Exit(),
+  };
+  Load(prog);
+
+  std::unique_ptr<bess::Packet> pkt(new bess::Packet());
+  pkt->set_total_len(64);
+  pkt->set_data_len(64);
+
+  PacketContext ctx = {};
+  ctx.pkt = pkt.get();
+  ctx.len = pkt->total_len();
+  EXPECT_EQ(0, Run(&ctx));
+}
+
+TEST_F(EbpfTest, Packet) {
+  // Returns the second byte of the packet if it is at least 2 bytes long
+  std::vector<Insn> prog = {
+      Ldx(kDW, 2, 1, offsetof(PacketContext, data)),
+      Ldx(kDW, 3, 1, offsetof(PacketContext, data_end)),
+      MovK(0, 0),
+      MovX(4, 2),
+      Alu64K(kAdd, 4, 2),
+      JmpX(kJgt, 4, 3, 1),
+      Ldx(kB, 0, 2, 1),
+      Exit(),
+  };
+  Load(prog);
+
+  uint8_t data[] = {1, 2, 3};
+  PacketContext ctx = {};
+  ctx.data = reinterpret_cast<uintptr_t>(data);
+  ctx.data_end = ctx.data + sizeof(data);
+  EXPECT_EQ(2, Run(&ctx));
+
+  ctx.data_end = ctx.data + 1;
+  EXPECT_EQ(0, Run(&ctx));
+
+  // Without the bounds check
+  prog[5] = MovK(5, 0);
+  Load(prog, false);
+
+  // One byte past the checked range
+  prog[5] = JmpX(kJgt, 4, 3, 1);
+  prog[6] = Ldx(kH, 0, 2, 1);
+  Load(prog, false);
+}
+
+TEST_F(EbpfTest, LoadBytesOutOfRange) {
+  // skb_load_bytes(ctx, 0xfffffff0, fp - 32, 32): offset + len wraps around
+  std::vector<Insn> prog = {
+      I(kAlu | kMov | kK, 2, 0, 0, -16),
+      MovX(3, kFramePointer),
+      Alu64K(kAdd, 3, -32),
+      MovK(4, 32),
+      Call(kHelperSkbLoadBytes),
+      Exit(),
+  };
+  Load(prog);
+
+  std::unique_ptr<bess::Packet> pkt(new bess::Packet());
+  pkt->set_total_len(64);
+  pkt->set_data_len(64);
+
+  PacketContext ctx = {};
+  ctx.pkt = pkt.get();
+  ctx.len = pkt->total_len();
+  EXPECT_EQ(static_cast<uint64_t>(-EFAULT), Run(&ctx));
+}
+
+TEST_F(EbpfTest, Batch) {
+  std::vector<Insn> prog = {
+      Ldx(kW, 0, 1, offsetof(PacketContext, len)),
+      Exit(),
+  };
+  Load(prog);
+
+  PacketContext ctxs[3] = {};
+  PacketContext *ptrs[3];
+  for (int i = 0; i < 3; i++) {
+    ctxs[i].len = i + 10;
+    ptrs[i] = &ctxs[i];
+  }
+
+  for (const Program &p : progs_) {
+    uint64_t rets[3] = {};
+    p.RunBatch(ptrs, 3, rets);
+    EXPECT_EQ(10, rets[0]);
+    EXPECT_EQ(11, rets[1]);
+    EXPECT_EQ(12, rets[2]);
+  }
+}
+
+TEST_F(EbpfTest, MapCounter) {
+  maps_.push_back(std::make_shared<Map>());
+  ASSERT_EQ(0, maps_[0]->Init(Map::kHash, 4, 8, 16).first);
+
+  // Counts runs per input gate
+  std::vector<Insn> prog = {
+      Ldx(kW, 2, 1, offsetof(PacketContext, igate)),
+      Stx(kW, kFramePointer, -4, 2),
+      MovX(6, kFramePointer),
+      Alu64K(kAdd, 6, -4),
+  };
+  LdImm64(&prog, 1, 0, kPseudoMap);
+  prog.push_back(MovX(2, 6));
+  prog.push_back(Call(kHelperMapLookupElem));
+  prog.push_back(JmpK(kJeq, 0, 0, 4));
+  prog.push_back(MovK(1, 1));
+  prog.push_back(I(kStx | kXadd | kDW, 0, 1, 0, 0));
+  prog.push_back(MovK(0, 0));
+  prog.push_back(Exit());
+  // Not found: insert 1
+  prog.push_back(St(kDW, kFramePointer, -16, 1));
+  LdImm64(&prog, 1, 0, kPseudoMap);
+  prog.push_back(MovX(2, 6));
+  prog.push_back(MovX(3, kFramePointer));
+  prog.push_back(Alu64K(kAdd, 3, -16));
+  prog.push_back(MovK(4, kMapUpdateNoExist));
+  prog.push_back(Call(kHelperMapUpdateElem));
+  prog.push_back(MovK(0, 1));
+  prog.push_back(Exit());
+  Load(prog);
+
+  // The map is shared, so the interpreted and compiled programs see each
+  // other's updates
+  PacketContext ctx = {};
+  EXPECT_EQ(1, progs_[0].Run(&ctx));
+  EXPECT_EQ(0, progs_[1].Run(&ctx));
+  EXPECT_EQ(0, progs_[0].Run(&ctx));
+  ctx.igate = 7;
+  EXPECT_EQ(1, progs_[1].Run(&ctx));
+
+  uint32_t key = 0;
+  uint64_t *val = static_cast<uint64_t *>(maps_[0]->Lookup(&key));
+  ASSERT_NE(nullptr, val);
+  EXPECT_EQ(3, *val);
+  key = 7;
+  val = static_cast<uint64_t *>(maps_[0]->Lookup(&key));
+  ASSERT_NE(nullptr, val);
+  EXPECT_EQ(1, *val);
+
+  // Dereferencing the lookup result without a null check
+  prog[8] = MovK(3, 0);
+  Load(prog, false);
+}
+
+TEST_F(EbpfTest, Reject) {
+  std::vector<std::vector<Insn>> progs = {
+      {},
+      // Uninitialized R0
+      {Exit()},
+      // Uninitialized R2
+      {MovX(0, 2), Exit()},
+      // Backward jump
+      {MovK(0, 0), I(kJmp | kJa, 0, 0, -2, 0), Exit()},
+      // Falls off the end
+      {MovK(0, 0)},
+      // Truncated 64-bit immediate
+      {MovK(0, 0), Exit(), I(kLd | kDW | kImm, 0, 0, 0, 0)},
+      // Frame pointer is read only
+      {MovK(kFramePointer, 0), MovK(0, 0), Exit()},
+      // Stack out of bounds
+      {St(kDW, kFramePointer, -516, 0), MovK(0, 0), Exit()},
+      {St(kDW, kFramePointer, -4, 0), MovK(0, 0), Exit()},
+      // PacketContext is read only
+      {St(kW, 1, 16, 0), MovK(0, 0), Exit()},
+      // Packet access without a bounds check
+      {Ldx(kDW, 2, 1, 0), Ldx(kB, 0, 2, 0), Exit()},
+      // Returning a pointer
+      {MovX(0, 1), Exit()},
+      // Pointers may not be stored
+      {Stx(kDW, kFramePointer, -8, 1), MovK(0, 0), Exit()},
+      // Variable offset
+      {Ldx(kW, 2, 1, 16), Alu64X(kAdd, 1, 2), MovK(0, 0), Exit()},
+      // Division by zero
+      {MovK(0, 1), Alu64K(kDiv, 0, 0), Exit()},
+      // Unknown helper
+      {Call(12345), Exit()},
+      // R1 is clobbered by calls
+      {Call(kHelperKtimeGetNs), MovX(0, 1), Exit()},
+  };
+
+  for (const auto &prog : progs) {
+    Load(prog, false);
+  }
+}
+
+TEST_F(EbpfTest, HashMap) {
+  Map map;
+  ASSERT_NE(0, map.Init(Map::kHash, 0, 8, 16).first);
+  ASSERT_EQ(0, map.Init(Map::kHash, 12, 4, 2).first);
+
+  char k1[12] = "key1";
+  char k2[12] = "key2";
+  char k3[12] = "key3";
+  uint32_t v = 1;
+
+  EXPECT_EQ(nullptr, map.Lookup(k1));
+  EXPECT_EQ(-ENOENT, map.Update(k1, &v, kMapUpdateExist));
+  EXPECT_EQ(0, map.Update(k1, &v, kMapUpdateAny));
+  EXPECT_EQ(-EEXIST, map.Update(k1, &v, kMapUpdateNoExist));
+
+  void *p1 = map.Lookup(k1);
+  ASSERT_NE(nullptr, p1);
+  EXPECT_EQ(1, *static_cast<uint32_t *>(p1));
+
+  v = 2;
+  EXPECT_EQ(0, map.Update(k2, &v, kMapUpdateNoExist));
+  EXPECT_EQ(-E2BIG, map.Update(k3, &v, kMapUpdateAny));
+
+  // Values do not move
+  EXPECT_EQ(p1, map.Lookup(k1));
+
+  EXPECT_EQ(0, map.Delete(k1));
+  EXPECT_EQ(-ENOENT, map.Delete(k1));
+  EXPECT_EQ(nullptr, map.Lookup(k1));
+  EXPECT_EQ(0, map.Update(k3, &v, kMapUpdateAny));
+
+  map.Clear();
+  EXPECT_EQ(nullptr, map.Lookup(k2));
+  EXPECT_EQ(nullptr, map.Lookup(k3));
+}
+
+TEST_F(EbpfTest, ArrayMap) {
+  Map map;
+  ASSERT_NE(0, map.Init(Map::kArray, 8, 8, 16).first);
+  ASSERT_EQ(0, map.Init(Map::kArray, 4, 8, 16).first);
+
+  uint32_t idx = 3;
+  uint64_t v = 99;
+  ASSERT_NE(nullptr, map.Lookup(&idx));
+  EXPECT_EQ(0, *static_cast<uint64_t *>(map.Lookup(&idx)));
+  EXPECT_EQ(0, map.Update(&idx, &v, kMapUpdateAny));
+  EXPECT_EQ(99, *static_cast<uint64_t *>(map.Lookup(&idx)));
+  EXPECT_EQ(-EEXIST, map.Update(&idx, &v, kMapUpdateNoExist));
+  EXPECT_EQ(-EINVAL, map.Delete(&idx));
+
+  idx = 16;
+  EXPECT_EQ(nullptr, map.Lookup(&idx));
+  EXPECT_EQ(-E2BIG, map.Update(&idx, &v, kMapUpdateAny));
+}
+
+// Random ALU programs must give the same result when interpreted and
+// compiled
+TEST_F(EbpfTest, RandomAlu) {
+  static const uint8_t kOps[] = {kAdd, kSub, kMul, kDiv, kOr,  kAnd, kLsh,
+                                 kRsh, kNeg, kMod, kXor, kMov, kArsh, kEnd};
+  std::mt19937_64 rng(42);
+
+  for (int iter = 0; iter < 2000; iter++) {
+    std::vector<Insn> prog;
+    for (int r = 0; r < 10; r++) {
+      LdImm64(&prog, r, rng());
+    }
+
+    for (int i = 0; i < 20; i++) {
+      uint8_t op = kOps[rng() % (sizeof(kOps) / sizeof(kOps[0]))];
+      bool is64 = rng() % 2;
+      bool x = rng() % 2;
+      int dst = rng() % 10;
+      int src = rng() % 10;
+      int32_t imm = static_cast<int32_t>(rng());
+
+      if (op == kEnd) {
+        static const int32_t kWidths[] = {16, 32, 64};
+        prog.push_back(I(kAlu | kEnd | (x ? kX : kK), dst, 0, 0,
+                         kWidths[rng() % 3]));
+        continue;
+      }
+      if (op == kNeg) {
+        x = false;
+      }
+      if (!x && (op == kLsh || op == kRsh || op == kArsh)) {
+        imm = rng() % (is64 ? 64 : 32);
+      }
+      if (!x && (op == kDiv || op == kMod) && imm == 0) {
+        imm = 1;
+      }
+      if (x && rng() % 4 == 0) {
+        prog.push_back(MovK(src, rng() % 3));  // Small, or zero
+      }
+      prog.push_back(
+          I((is64 ? kAlu64 : kAlu) | op | (x ? kX : kK), dst, src, 0, imm));
+    }
+
+    for (int r = 1; r < 10; r++) {
+      prog.push_back(Alu64X(kXor, 0, r));
+    }
+    prog.push_back(Exit());
+
+    Load(prog);
+    Run();
+  }
+}
+
+}  // namespace
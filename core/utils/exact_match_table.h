@@ -31,6 +31,11 @@
 #ifndef BESS_UTILS_EXACT_MATCH_TABLE_H_
 #define BESS_UTILS_EXACT_MATCH_TABLE_H_
 
+#include <x86intrin.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
 #include <string>
 #include <type_traits>
 #include <vector>
@@ -163,6 +168,11 @@ class ExactMatchTable {
         total_key_size_(),
         num_fields_(),
         fields_(),
+        offset_only_(),
+        fast_width_(),
+        fast_offset_(),
+        fast_shuffle_(),
+        fast_mask_(),
         table_() {}
 
   // Add a new rule.
@@ -221,6 +231,8 @@ class ExactMatchTable {
 
   size_t Size() const { return table_.Count(); }
 
+  size_t MemoryUsage() const { return table_.MemoryUsage(); }
+
   // Extract an ExactMatchKey from `buf` based on the fields that have been
   // added to this table.
   ExactMatchKey MakeKey(const void *buf) const {
@@ -282,17 +294,26 @@ class ExactMatchTable {
   // `vals` set to `default_value`.
   void Find(const ExactMatchKey *keys, T *vals, size_t n,
             T default_value) const {
-    const auto &table = table_;
-    for (size_t i = 0; i < n; i++) {
-      const auto *entry =
-          table.Find(keys[i], ExactMatchKeyHash(total_key_size_),
-                     ExactMatchKeyEq(total_key_size_));
-      vals[i] = entry ? entry->second : default_value;
+    const size_t kChunk = PacketBatch::kMaxBurst;
+    const typename EmTable::Entry *entries[kChunk];
+
+    for (size_t base = 0; base < n; base += kChunk) {
+      size_t cnt = std::min(n - base, kChunk);
+      table_.FindBulk(keys + base, entries, cnt,
+                      ExactMatchKeyHash(total_key_size_),
+                      ExactMatchKeyEq(total_key_size_));
+      for (size_t i = 0; i < cnt; i++) {
+        vals[base + i] = entries[i] ? entries[i]->second : default_value;
+      }
     }
   }
 
   uint32_t total_key_size() const { return total_key_size_; }
 
+  // True if no field is based on a metadata attribute, i.e., keys can be
+  // made with `MakeKeys(const void**, ExactMatchKey *, size_t)`
+  bool offset_only() const { return num_fields_ > 0 && offset_only_; }
+
   // Set the `idx`th field of this table to one at offset `offset` bytes into a
   // buffer with length `size` and mask `mask`.
   // Returns 0 on success, non-zero errno on failure.
@@ -358,6 +379,16 @@ class ExactMatchTable {
 
   // Helper for public MakeKey functions
   void DoMakeKeys(ExactMatchKey *keys, const void **bufs, size_t n) const {
+#if __AVX2__
+    if (fast_width_ == 16) {
+      DoMakeKeysFast<16>(keys, bufs, n);
+      return;
+    } else if (fast_width_ == 8) {
+      DoMakeKeysFast<8>(keys, bufs, n);
+      return;
+    }
+#endif
+
     // Initialize the padding with zero.  NB: if total_key_size_ is 0,
     // this is (-1 / 8) which since C++11 is defined to be 0.  If
     // total_key_size_ == raw_key_size_, this is unnecessary, but
@@ -382,6 +413,95 @@ class ExactMatchTable {
     }
   }
 
+#if __AVX2__
+  // Makes each key with two loads and two byte shuffles, no matter how many
+  // fields there are. See UpdateFastPath().
+  template <int kWidth>
+  void DoMakeKeysFast(ExactMatchKey *keys, const void **bufs,
+                      size_t n) const {
+    const __m256i shuffle0 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(fast_shuffle_[0]));
+    const __m256i shuffle1 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(fast_shuffle_[1]));
+    const __m256i mask =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(fast_mask_));
+    const int offset0 = fast_offset_[0];
+    const int offset1 = fast_offset_[1];
+
+    for (size_t i = 0; i < n; i++) {
+      const uint8_t *buf = static_cast<const uint8_t *>(bufs[i]);
+      const __m128i *p0 = reinterpret_cast<const __m128i *>(buf + offset0);
+      const __m128i *p1 = reinterpret_cast<const __m128i *>(buf + offset1);
+      __m128i part0, part1;
+
+      if (kWidth == 16) {
+        part0 = _mm_loadu_si128(p0);
+        part1 = _mm_loadu_si128(p1);
+      } else {
+        part0 = _mm_loadl_epi64(p0);
+        part1 = _mm_loadl_epi64(p1);
+      }
+
+      __m256i key = _mm256_or_si256(
+          _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(part0), shuffle0),
+          _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(part1), shuffle1));
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(keys[i].u64_arr),
+                          _mm256_and_si256(key, mask));
+    }
+  }
+#endif
+
+  // Keys of up to 32 bytes whose fields all lie at fixed offsets within a
+  // 32-byte window can be made by DoMakeKeysFast(). The window is covered by
+  // two loads of kWidth bytes, at its start and end. A load never goes beyond
+  // the 8 bytes that DoMakeKeys() would read for the last field. Each key byte
+  // is then picked from either load with a shuffle control and masked.
+  void UpdateFastPath() {
+    offset_only_ = true;
+    fast_width_ = 0;
+
+    int begin = INT_MAX;
+    int end = 0;
+    for (size_t i = 0; i < num_fields_; i++) {
+      if (fields_[i].attr_id >= 0) {
+        offset_only_ = false;
+        return;
+      }
+      begin = std::min(begin, fields_[i].offset);
+      end = std::max(end, fields_[i].offset + 8);
+    }
+
+#if __AVX2__
+    if (num_fields_ == 0 || total_key_size_ > 32 || end - begin > 32) {
+      return;
+    }
+
+    const int width = (end - begin >= 16) ? 16 : 8;
+    fast_offset_[0] = begin;
+    fast_offset_[1] = end - width;
+
+    // 0x80: the shuffle sets the byte to 0
+    memset(fast_shuffle_, 0x80, sizeof(fast_shuffle_));
+    memset(fast_mask_, 0, sizeof(fast_mask_));
+
+    for (size_t i = 0; i < num_fields_; i++) {
+      const ExactMatchField &f = fields_[i];
+      for (int b = 0; b < f.size; b++) {
+        int src = f.offset + b;
+        int dst = f.pos + b;
+        if (src < fast_offset_[0] + width) {
+          fast_shuffle_[0][dst] = src - fast_offset_[0];
+        } else {
+          fast_shuffle_[1][dst] = src - fast_offset_[1];
+        }
+        fast_mask_[dst] = f.mask >> (b * 8);
+      }
+    }
+
+    fast_width_ = width;
+#endif
+  }
+
   // Helper for public AddField functions.
   // DoAddField inserts `field` as the `idx`th field for this table.
   // If `mt_attr_name` is set, the `offset` field of `field` will be ignored and
@@ -438,6 +558,7 @@ class ExactMatchTable {
     f->pos = raw_key_size_;
     raw_key_size_ += f->size;
     total_key_size_ = align_ceil(raw_key_size_, sizeof(uint64_t));
+    UpdateFastPath();
 
     return MakeError(0);
   }
@@ -451,6 +572,13 @@ class ExactMatchTable {
   size_t num_fields_;
   ExactMatchField fields_[MAX_FIELDS];
 
+  // Set by UpdateFastPath()
+  bool offset_only_;
+  int fast_width_;  // 0 if the fast path does not apply
+  int fast_offset_[2];
+  uint8_t fast_shuffle_[2][32];
+  uint8_t fast_mask_[32];
+
   EmTable table_;
 };
 
@@ -0,0 +1,166 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// Benchmarks for ExactMatchTable key construction and lookup.
+
+#include "exact_match_table.h"
+
+#include <benchmark/benchmark.h>
+
+#include "random.h"
+
+using bess::utils::ExactMatchField;
+using bess::utils::ExactMatchKey;
+using bess::utils::ExactMatchRuleFields;
+using bess::utils::ExactMatchTable;
+
+static const size_t kBufSize = 64;
+
+// Builds a table keyed on the IPv4 5-tuple of an untagged Ethernet frame,
+// filled with state.range(0) rules, and a batch of packets half of which hit.
+class ExactMatchTableFixture : public benchmark::Fixture {
+ public:
+  ExactMatchTableFixture() : em_(), batch_(), bufs_(), keys_(), data_() {}
+
+  virtual void SetUp(benchmark::State &state) {
+    em_ = new ExactMatchTable<uint16_t>();
+    em_->AddField(26, 4, 0, 0);  // src addr
+    em_->AddField(30, 4, 0, 1);  // dst addr
+    em_->AddField(23, 1, 0, 2);  // protocol
+    em_->AddField(34, 4, 0, 3);  // src and dst port
+
+    Random rng(0);
+    const size_t n = bess::PacketBatch::kMaxBurst;
+
+    batch_.clear();
+    for (size_t i = 0; i < n; i++) {
+      for (size_t j = 0; j < kBufSize; j++) {
+        data_[i][j] = rng.Get();
+      }
+      bufs_[i] = data_[i];
+      // Never dereferenced as a packet, see buffer_fn below
+      batch_.add(reinterpret_cast<bess::Packet *>(data_[i]));
+    }
+
+    for (int i = 0; i < state.range(0); i++) {
+      const uint8_t *buf = data_[i % n];
+      uint8_t random_buf[kBufSize];
+      if (i >= static_cast<int>(n / 2)) {
+        for (size_t j = 0; j < kBufSize; j++) {
+          random_buf[j] = rng.Get();
+        }
+        buf = random_buf;
+      }
+
+      ExactMatchRuleFields rule;
+      for (size_t j = 0; j < em_->num_fields(); j++) {
+        const ExactMatchField &f = em_->get_field(j);
+        rule.emplace_back(buf + f.offset, buf + f.offset + f.size);
+      }
+      em_->AddRule(i, rule);
+    }
+
+    em_->MakeKeys(bufs_, keys_, n);
+  }
+
+  virtual void TearDown(benchmark::State &) { delete em_; }
+
+ protected:
+  ExactMatchTable<uint16_t> *em_;
+  bess::PacketBatch batch_;
+  const void *bufs_[bess::PacketBatch::kMaxBurst];
+  ExactMatchKey keys_[bess::PacketBatch::kMaxBurst];
+  uint8_t data_[bess::PacketBatch::kMaxBurst][kBufSize];
+};
+
+// Benchmarks key construction through the per-field buffer_fn path.
+BENCHMARK_DEFINE_F(ExactMatchTableFixture, MakeKeysPerField)
+(benchmark::State &state) {
+  const auto buffer_fn = [](bess::Packet *pkt, const ExactMatchField &f) {
+    return reinterpret_cast<uint8_t *>(pkt) + f.offset;
+  };
+
+  while (state.KeepRunning()) {
+    em_->MakeKeys(&batch_, buffer_fn, keys_);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * batch_.cnt());
+}
+
+BENCHMARK_REGISTER_F(ExactMatchTableFixture, MakeKeysPerField)->Arg(1);
+
+// Benchmarks key construction from raw buffers (the AVX2 path if enabled).
+BENCHMARK_DEFINE_F(ExactMatchTableFixture, MakeKeysBuffers)
+(benchmark::State &state) {
+  while (state.KeepRunning()) {
+    em_->MakeKeys(bufs_, keys_, batch_.cnt());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * batch_.cnt());
+}
+
+BENCHMARK_REGISTER_F(ExactMatchTableFixture, MakeKeysBuffers)->Arg(1);
+
+// Benchmarks looking up a batch of keys one at a time.
+BENCHMARK_DEFINE_F(ExactMatchTableFixture, FindSingle)
+(benchmark::State &state) {
+  uint16_t vals[bess::PacketBatch::kMaxBurst];
+
+  while (state.KeepRunning()) {
+    for (int i = 0; i < batch_.cnt(); i++) {
+      vals[i] = em_->Find(keys_[i], 0xffff);
+    }
+    benchmark::DoNotOptimize(vals);
+  }
+  state.SetItemsProcessed(state.iterations() * batch_.cnt());
+}
+
+BENCHMARK_REGISTER_F(ExactMatchTableFixture, FindSingle)
+    ->RangeMultiplier(16)
+    ->Range(16, 1 << 20);
+
+// Benchmarks looking up a batch of keys with hashing and prefetching done
+// up front.
+BENCHMARK_DEFINE_F(ExactMatchTableFixture, FindBatch)
+(benchmark::State &state) {
+  uint16_t vals[bess::PacketBatch::kMaxBurst];
+
+  while (state.KeepRunning()) {
+    em_->Find(keys_, vals, batch_.cnt(), 0xffff);
+    benchmark::DoNotOptimize(vals);
+  }
+  state.SetItemsProcessed(state.iterations() * batch_.cnt());
+}
+
+BENCHMARK_REGISTER_F(ExactMatchTableFixture, FindBatch)
+    ->RangeMultiplier(16)
+    ->Range(16, 1 << 20);
+
+BENCHMARK_MAIN();
@@ -32,7 +32,9 @@
 
 #include <gtest/gtest.h>
 
+#include "bits.h"
 #include "endian.h"
+#include "random.h"
 
 using bess::utils::ExactMatchField;
 using bess::utils::ExactMatchKey;
@@ -130,6 +132,104 @@ TEST(EmTableTest, IgnoreBytesPastEnd) {
   ASSERT_EQ(0x600d, ret);
 }
 
+// Keys made from buffers (the fast path, if the field layout allows it) must
+// be identical to those made field by field through a buffer function.
+TEST(EmTableTest, MakeKeysFastPath) {
+  const size_t n = 32;
+  const size_t kBufSize = 64;
+  Random rng(42);
+
+  for (int trial = 0; trial < 1000; trial++) {
+    ExactMatchTable<uint16_t> em;
+    size_t num_fields = 1 + rng.GetRange(4);
+
+    for (size_t i = 0; i < num_fields; i++) {
+      int size = 1 + rng.GetRange(MAX_FIELD_SIZE);
+      int offset = rng.GetRange(trial % 2 ? 8 : 24);
+      uint64_t mask = 0;
+      if (rng.GetRange(2)) {
+        mask = ((static_cast<uint64_t>(rng.Get()) << 32) | rng.Get()) &
+               bess::utils::SetBitsHigh<uint64_t>(size * 8);
+      }
+      ASSERT_EQ(0, em.AddField(offset, size, mask, i).first);
+    }
+
+    uint8_t data[n][kBufSize];
+    const void *bufs[n];
+    bess::PacketBatch batch;
+    batch.clear();
+    for (size_t i = 0; i < n; i++) {
+      for (size_t j = 0; j < kBufSize; j++) {
+        data[i][j] = rng.Get();
+      }
+      bufs[i] = data[i];
+      // Never dereferenced as a packet, see buffer_fn below
+      batch.add(reinterpret_cast<bess::Packet *>(data[i]));
+    }
+
+    const auto buffer_fn = [](bess::Packet *pkt, const ExactMatchField &f) {
+      return reinterpret_cast<uint8_t *>(pkt) + f.offset;
+    };
+
+    ExactMatchKey expected[n];
+    ExactMatchKey keys[n];
+    em.MakeKeys(&batch, buffer_fn, expected);
+    em.MakeKeys(bufs, keys, n);
+
+    for (size_t i = 0; i < n; i++) {
+      ASSERT_EQ(0, memcmp(&expected[i], &keys[i], em.total_key_size()))
+          << "trial " << trial << ", key " << i;
+    }
+
+    // Batched lookups must agree with single ones
+    for (size_t i = 0; i < n; i += 2) {
+      ExactMatchRuleFields rule;
+      for (size_t j = 0; j < num_fields; j++) {
+        const ExactMatchField &f = em.get_field(j);
+        rule.emplace_back();
+        for (int k = 0; k < f.size; k++) {
+          rule.back().push_back(data[i][f.offset + k] & (f.mask >> (k * 8)));
+        }
+      }
+      ASSERT_EQ(0, em.AddRule(i, rule).first);
+    }
+
+    uint16_t vals[n];
+    em.Find(keys, vals, n, 0xDEAD);
+    for (size_t i = 0; i < n; i++) {
+      EXPECT_EQ(em.Find(keys[i], 0xDEAD), vals[i]);
+      if (i % 2 == 0) {
+        EXPECT_NE(0xDEAD, vals[i]);
+      }
+    }
+  }
+}
+
+TEST(EmTableTest, FindBulk) {
+  const size_t n = 100;  // more than one chunk
+  ExactMatchTable<uint16_t> em;
+  ASSERT_EQ(0, em.AddField(0, 4, 0, 0).first);
+
+  uint64_t bufs_data[n];
+  const void *bufs[n];
+  for (size_t i = 0; i < n; i++) {
+    bufs_data[i] = i;
+    bufs[i] = &bufs_data[i];
+    if (i % 3 == 0) {
+      uint8_t b = i;
+      ASSERT_EQ(0, em.AddRule(i + 1, {{b, 0, 0, 0}}).first);
+    }
+  }
+
+  ExactMatchKey keys[n];
+  uint16_t vals[n];
+  em.MakeKeys(bufs, keys, n);
+  em.Find(keys, vals, n, 0xDEAD);
+  for (size_t i = 0; i < n; i++) {
+    EXPECT_EQ(i % 3 == 0 ? i + 1 : 0xDEAD, vals[i]);
+  }
+}
+
 TEST(EmTableTest, FindMakeKeysPktBatch) {
   const size_t n = 2;
   ExactMatchTable<uint16_t> em;
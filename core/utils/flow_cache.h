@@ -0,0 +1,174 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_FLOW_CACHE_H_
+#define BESS_UTILS_FLOW_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "common.h"
+
+namespace bess {
+namespace utils {
+
+// An exact-match cache for memoizing the result of an expensive classifier
+// (e.g., WildcardMatch or ACL), in the spirit of the OVS microflow cache.
+// Traffic is usually dominated by a small number of long-lived flows, so
+// packets of a flow that has been classified once are served by a single
+// probe instead of a walk over all rules.
+//
+// Each key may live in one of two slots, picked by the caller-provided 32-bit
+// hash, and a colliding insertion evicts one of them. Invalidate() drops all
+// entries in O(1) by bumping a generation number, so it is cheap to call on
+// every rule update. Memory is allocated by the first Insert(), on the worker
+// that uses the cache.
+//
+// Not thread safe: keep one instance per worker.
+template <typename K, typename V, typename E = std::equal_to<K>>
+class FlowCache {
+ public:
+  static const size_t kDefaultSize = 8192;
+  static const size_t kMaxSize = 1 << 20;
+
+  // size is rounded up to a power of two, capped at kMaxSize.
+  explicit FlowCache(size_t size = kDefaultSize)
+      : entries_(),
+        size_(RoundUp(size)),
+        generation_(1),
+        victim_(),
+        hits_(),
+        misses_() {}
+
+  // Returns the cached value for the key, or nullptr if there is none.
+  const V *Find(const K &key, uint32_t hash, const E &eq = E()) {
+    if (likely(!entries_.empty())) {
+      size_t i = Index1(hash);
+      for (int way = 0; way < 2; way++) {
+        const Entry &e = entries_[i];
+        if (e.hash == hash && e.generation == generation_ && eq(e.key, key)) {
+          hits_++;
+          return &e.value;
+        }
+        i = Index2(hash, i);
+      }
+    }
+
+    misses_++;
+    return nullptr;
+  }
+
+  // Caches a value for the key. The key must not be in the cache already.
+  void Insert(const K &key, uint32_t hash, const V &val) {
+    if (unlikely(entries_.empty())) {
+      entries_.resize(size_);
+    }
+
+    size_t i1 = Index1(hash);
+    size_t i2 = Index2(hash, i1);
+
+    Entry *e;
+    if (entries_[i1].generation != generation_) {
+      e = &entries_[i1];
+    } else if (entries_[i2].generation != generation_) {
+      e = &entries_[i2];
+    } else {
+      // Both slots are taken. Alternate victims so that a pair of flows
+      // colliding on one slot does not keep evicting each other.
+      victim_ ^= 1;
+      e = victim_ ? &entries_[i2] : &entries_[i1];
+    }
+
+    e->hash = hash;
+    e->generation = generation_;
+    e->key = key;
+    e->value = val;
+  }
+
+  // Drops all cached entries.
+  void Invalidate() {
+    if (unlikely(++generation_ == 0)) {
+      // The generation number wrapped around. Stale entries could be mistaken
+      // for fresh ones, so wipe them for real.
+      for (Entry &e : entries_) {
+        e.generation = 0;
+      }
+      generation_ = 1;
+    }
+  }
+
+  void ResetStats() {
+    hits_ = 0;
+    misses_ = 0;
+  }
+
+  size_t size() const { return size_; }
+  uint64_t hits() const { return hits_; }
+  uint64_t misses() const { return misses_; }
+
+  size_t MemoryUsage() const { return entries_.capacity() * sizeof(Entry); }
+
+ private:
+  struct Entry {
+    uint32_t hash;
+    uint32_t generation;  // 0 if the entry was never used
+    K key;
+    V value;
+  };
+
+  static size_t RoundUp(size_t size) {
+    size_t ret = 2;
+    while (ret < size && ret < kMaxSize) {
+      ret <<= 1;
+    }
+    return ret;
+  }
+
+  size_t Index1(uint32_t hash) const { return hash & (size_ - 1); }
+
+  // Always different from i1: the xor operand is odd.
+  size_t Index2(uint32_t hash, size_t i1) const {
+    return (i1 ^ ((hash >> 16) | 1)) & (size_ - 1);
+  }
+
+  std::vector<Entry> entries_;
+  size_t size_;
+  uint32_t generation_;
+  int victim_;
+  uint64_t hits_;
+  uint64_t misses_;
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_FLOW_CACHE_H_
@@ -0,0 +1,116 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "flow_cache.h"
+
+#include <gtest/gtest.h>
+
+using bess::utils::FlowCache;
+
+namespace {
+
+TEST(FlowCacheTest, FindInsert) {
+  FlowCache<uint32_t, uint16_t> cache(64);
+  EXPECT_EQ(64, cache.size());
+
+  EXPECT_EQ(nullptr, cache.Find(1, 0xabcd));
+  cache.Insert(1, 0xabcd, 10);
+
+  const uint16_t *val = cache.Find(1, 0xabcd);
+  ASSERT_NE(nullptr, val);
+  EXPECT_EQ(10, *val);
+
+  // Same hash, different key
+  EXPECT_EQ(nullptr, cache.Find(2, 0xabcd));
+
+  EXPECT_EQ(1, cache.hits());
+  EXPECT_EQ(2, cache.misses());
+  cache.ResetStats();
+  EXPECT_EQ(0, cache.hits());
+  EXPECT_EQ(0, cache.misses());
+}
+
+TEST(FlowCacheTest, TwoWays) {
+  FlowCache<uint32_t, uint32_t> cache(64);
+
+  // Both hash to the same primary slot
+  cache.Insert(1, 0x10005, 1);
+  cache.Insert(2, 0x20005, 2);
+  ASSERT_NE(nullptr, cache.Find(1, 0x10005));
+  ASSERT_NE(nullptr, cache.Find(2, 0x20005));
+  EXPECT_EQ(1, *cache.Find(1, 0x10005));
+  EXPECT_EQ(2, *cache.Find(2, 0x20005));
+
+  // A third one with the same two candidate slots evicts exactly one of them
+  cache.Insert(3, 0x30005, 3);
+  ASSERT_NE(nullptr, cache.Find(3, 0x30005));
+  EXPECT_EQ(3, *cache.Find(3, 0x30005));
+  EXPECT_NE(cache.Find(1, 0x10005) == nullptr,
+            cache.Find(2, 0x20005) == nullptr);
+}
+
+TEST(FlowCacheTest, Invalidate) {
+  FlowCache<uint32_t, uint32_t> cache(1024);
+
+  for (uint32_t i = 0; i < 100; i++) {
+    cache.Insert(i, i * 2654435761u, i);
+  }
+  for (uint32_t i = 0; i < 100; i++) {
+    ASSERT_NE(nullptr, cache.Find(i, i * 2654435761u));
+  }
+
+  cache.Invalidate();
+  for (uint32_t i = 0; i < 100; i++) {
+    EXPECT_EQ(nullptr, cache.Find(i, i * 2654435761u));
+  }
+
+  cache.Insert(7, 7, 70);
+  ASSERT_NE(nullptr, cache.Find(7, 7));
+  EXPECT_EQ(70, *cache.Find(7, 7));
+}
+
+TEST(FlowCacheTest, CustomEq) {
+  struct Key {
+    uint32_t k;
+    uint32_t ignored;
+  };
+  struct KeyEq {
+    bool operator()(const Key &lhs, const Key &rhs) const {
+      return lhs.k == rhs.k;
+    }
+  };
+
+  FlowCache<Key, int, KeyEq> cache(16);
+  cache.Insert({1, 2}, 5, 42);
+  ASSERT_NE(nullptr, cache.Find({1, 3}, 5));
+  EXPECT_EQ(nullptr, cache.Find({2, 2}, 5));
+}
+
+}  // namespace
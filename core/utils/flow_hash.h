@@ -0,0 +1,98 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_FLOW_HASH_H_
+#define BESS_UTILS_FLOW_HASH_H_
+
+#include <rte_hash_crc.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "ether.h"
+#include "ip.h"
+
+namespace bess {
+namespace utils {
+
+// A 32-bit per-flow hash value, shared between modules as a metadata
+// attribute so that a packet is hashed (at most) once along the pipeline.
+// PortInc sets it from the RSS hash of the NIC if available, or with
+// FlowHash() otherwise. Readers must treat it only as an opaque value that is
+// the same for all packets of a flow entering through the same port.
+static constexpr const char *kFlowHashAttrName = "flow_hash";
+
+// Software flow hash over the IPv4 5-tuple, or the 3-tuple for fragments and
+// protocols without ports. Non-IPv4 frames are hashed over the Ethernet
+// header. Does not read beyond `len` bytes of `data`.
+inline uint32_t FlowHash(const void *data, size_t len) {
+  const uint8_t *p = static_cast<const uint8_t *>(data);
+  const Ethernet *eth = static_cast<const Ethernet *>(data);
+
+  if (len < sizeof(Ethernet)) {
+    return 0;
+  }
+
+  if (eth->ether_type != be16_t(Ethernet::Type::kIpv4) ||
+      len < sizeof(Ethernet) + sizeof(Ipv4)) {
+    uint64_t addrs;
+    uint32_t rest;
+    memcpy(&addrs, p, sizeof(addrs));
+    memcpy(&rest, p + sizeof(addrs), sizeof(rest));
+    return rte_hash_crc_8byte(addrs, rte_hash_crc_4byte(
+                                         rest, eth->ether_type.raw_value()));
+  }
+
+  const Ipv4 *ip = reinterpret_cast<const Ipv4 *>(eth + 1);
+  const size_t ip_bytes = ip->header_length << 2;
+  const uint16_t frag = ip->fragment_offset.value();
+  uint64_t addrs;
+  uint32_t ports = 0;
+
+  memcpy(&addrs, &ip->src, sizeof(addrs));  // src and dst
+
+  if (!(frag & (Ipv4::Flag::kMF | 0x1fff)) &&
+      (ip->protocol == Ipv4::Proto::kTcp || ip->protocol == Ipv4::Proto::kUdp ||
+       ip->protocol == Ipv4::Proto::kSctp ||
+       ip->protocol == Ipv4::Proto::kUdpLite) &&
+      ip_bytes >= sizeof(Ipv4) &&
+      len >= sizeof(Ethernet) + ip_bytes + sizeof(ports)) {
+    memcpy(&ports, reinterpret_cast<const uint8_t *>(ip) + ip_bytes,
+           sizeof(ports));
+  }
+
+  return rte_hash_crc_8byte(addrs, rte_hash_crc_4byte(ports, ip->protocol));
+}
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_FLOW_HASH_H_
@@ -0,0 +1,134 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "flow_hash.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "tcp.h"
+
+namespace {
+
+using bess::utils::Ethernet;
+using bess::utils::FlowHash;
+using bess::utils::Ipv4;
+using bess::utils::Tcp;
+using bess::utils::be16_t;
+using bess::utils::be32_t;
+
+struct [[gnu::packed]] TcpFrame {
+  Ethernet eth;
+  Ipv4 ip;
+  Tcp tcp;
+};
+
+TcpFrame MakeFrame(uint32_t src, uint32_t dst, uint16_t sport,
+                   uint16_t dport) {
+  TcpFrame f;
+  memset(&f, 0, sizeof(f));
+  f.eth.ether_type = be16_t(Ethernet::Type::kIpv4);
+  f.ip.version = 4;
+  f.ip.header_length = 5;
+  f.ip.protocol = Ipv4::Proto::kTcp;
+  f.ip.src = be32_t(src);
+  f.ip.dst = be32_t(dst);
+  f.tcp.src_port = be16_t(sport);
+  f.tcp.dst_port = be16_t(dport);
+  return f;
+}
+
+TEST(FlowHashTest, SameFlow) {
+  TcpFrame a = MakeFrame(0x0a000001, 0x0a000002, 1234, 80);
+  TcpFrame b = MakeFrame(0x0a000001, 0x0a000002, 1234, 80);
+
+  // Fields outside of the 5-tuple do not matter
+  b.ip.ttl = 17;
+  b.ip.id = be16_t(42);
+  b.tcp.seq_num = be32_t(1000);
+  b.eth.src_addr.bytes[0] = 0xff;
+
+  EXPECT_EQ(FlowHash(&a, sizeof(a)), FlowHash(&b, sizeof(b)));
+}
+
+TEST(FlowHashTest, DifferentFlows) {
+  TcpFrame a = MakeFrame(0x0a000001, 0x0a000002, 1234, 80);
+  TcpFrame b = MakeFrame(0x0a000001, 0x0a000002, 1235, 80);
+  TcpFrame c = MakeFrame(0x0a000001, 0x0a000003, 1234, 80);
+  TcpFrame d = MakeFrame(0x0a000001, 0x0a000002, 1234, 80);
+  d.ip.protocol = Ipv4::Proto::kUdp;
+
+  uint32_t h = FlowHash(&a, sizeof(a));
+  EXPECT_NE(h, FlowHash(&b, sizeof(b)));
+  EXPECT_NE(h, FlowHash(&c, sizeof(c)));
+  EXPECT_NE(h, FlowHash(&d, sizeof(d)));
+}
+
+TEST(FlowHashTest, Fragments) {
+  TcpFrame first = MakeFrame(0x0a000001, 0x0a000002, 1234, 80);
+  first.ip.fragment_offset = be16_t(Ipv4::Flag::kMF);
+
+  // Later fragments have no L4 header
+  TcpFrame later = MakeFrame(0x0a000001, 0x0a000002, 0xdead, 0xbeef);
+  later.ip.fragment_offset = be16_t(185);
+
+  EXPECT_EQ(FlowHash(&first, sizeof(first)), FlowHash(&later, sizeof(later)));
+}
+
+TEST(FlowHashTest, Truncated) {
+  TcpFrame a = MakeFrame(0x0a000001, 0x0a000002, 1234, 80);
+
+  // Too short to have ports: they must not be read
+  std::vector<uint8_t> buf(sizeof(Ethernet) + sizeof(Ipv4) + 2, 0);
+  memcpy(buf.data(), &a, buf.size());
+  uint32_t h = FlowHash(buf.data(), buf.size());
+  buf.push_back(0xaa);
+  buf.push_back(0xbb);
+  EXPECT_EQ(h, FlowHash(buf.data(), buf.size() - 2));
+
+  EXPECT_EQ(0, FlowHash(buf.data(), sizeof(Ethernet) - 1));
+}
+
+TEST(FlowHashTest, NonIp) {
+  TcpFrame a = MakeFrame(0x0a000001, 0x0a000002, 1234, 80);
+  TcpFrame b = a;
+  a.eth.ether_type = be16_t(Ethernet::Type::kArp);
+  b.eth.ether_type = be16_t(Ethernet::Type::kArp);
+  b.ip.src = be32_t(0x0a000009);
+
+  // Only the Ethernet header is hashed
+  EXPECT_EQ(FlowHash(&a, sizeof(a)), FlowHash(&b, sizeof(b)));
+
+  b.eth.dst_addr.bytes[5] = 1;
+  EXPECT_NE(FlowHash(&a, sizeof(a)), FlowHash(&b, sizeof(b)));
+}
+
+}  // namespace
@@ -0,0 +1,301 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "header_parser.h"
+
+#include <algorithm>
+
+#include "ether.h"
+#include "ip.h"
+
+namespace bess {
+namespace utils {
+
+namespace {
+
+const size_t kMaxVlanTags = 2;
+const size_t kMaxMplsLabels = 8;
+const size_t kMaxIpv6ExtHeaders = 8;
+
+const uint16_t kEtherTypeMplsMulticast = 0x8848;
+const uint16_t kVxlanPort = 4789;
+const size_t kVxlanHeaderLen = 8;
+
+// IPv6 extension headers (and protocols that can follow them)
+enum : uint8_t {
+  kIpv6HopByHop = 0,
+  kIpv6Routing = 43,
+  kIpv6Fragment = 44,
+  kIpv6Ah = 51,
+  kIcmpv6 = 58,
+  kIpv6NoNext = 59,
+  kIpv6DestOpts = 60,
+};
+
+inline uint16_t Load16(const uint8_t *p) {
+  return (p[0] << 8) | p[1];
+}
+
+// Minimum length of the L4 header, so that modules can read the fixed part
+// (e.g., ports) once l4_offset is set
+size_t MinL4Len(uint8_t proto) {
+  switch (proto) {
+    case Ipv4::Proto::kTcp:
+      return 20;
+    case Ipv4::Proto::kUdp:
+    case Ipv4::Proto::kUdpLite:
+    case Ipv4::Proto::kIcmp:
+    case kIcmpv6:
+      return 8;
+    case Ipv4::Proto::kSctp:
+      return 12;
+    case Ipv4::Proto::kGre:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+void ParseL4(size_t len, size_t off, HeaderInfo *info) {
+  if (len < off + MinL4Len(info->l4_proto)) {
+    info->flags |= HeaderInfo::kTruncated;
+    return;
+  }
+  info->l4_offset = off;
+}
+
+void ParseIpv4(const uint8_t *p, size_t len, size_t off, HeaderInfo *info) {
+  if (len < off + sizeof(Ipv4)) {
+    info->flags |= HeaderInfo::kTruncated;
+    return;
+  }
+
+  const Ipv4 *ip = reinterpret_cast<const Ipv4 *>(p + off);
+  size_t ip_bytes = ip->header_length << 2;
+  if (ip->version != 4 || ip_bytes < sizeof(Ipv4)) {
+    info->flags |= HeaderInfo::kMalformed;
+    return;
+  }
+  if (len < off + ip_bytes) {
+    info->flags |= HeaderInfo::kTruncated;
+    return;
+  }
+
+  info->l3_offset = off;
+  info->l4_proto = ip->protocol;
+
+  uint16_t frag = ip->fragment_offset.value();
+  if (frag & (Ipv4::Flag::kMF | 0x1fff)) {
+    info->flags |= HeaderInfo::kFragment;
+    if (frag & 0x1fff) {
+      return;
+    }
+  }
+
+  ParseL4(len, off + ip_bytes, info);
+}
+
+void ParseIpv6(const uint8_t *p, size_t len, size_t off, HeaderInfo *info) {
+  const size_t kIpv6HeaderLen = 40;
+
+  if (len < off + kIpv6HeaderLen) {
+    info->flags |= HeaderInfo::kTruncated;
+    return;
+  }
+  if ((p[off] >> 4) != 6) {
+    info->flags |= HeaderInfo::kMalformed;
+    return;
+  }
+
+  info->l3_offset = off;
+
+  uint8_t next = p[off + 6];
+  off += kIpv6HeaderLen;
+
+  for (size_t i = 0;; i++) {
+    size_t ext_bytes;
+
+    switch (next) {
+      case kIpv6HopByHop:
+      case kIpv6Routing:
+      case kIpv6DestOpts:
+      case kIpv6Fragment:
+      case kIpv6Ah:
+        break;
+      default:
+        info->l4_proto = next;
+        if (next != kIpv6NoNext) {
+          ParseL4(len, off, info);
+        }
+        return;
+    }
+
+    if (i == kMaxIpv6ExtHeaders) {
+      info->flags |= HeaderInfo::kMalformed;
+      return;
+    }
+    if (len < off + 8) {
+      info->flags |= HeaderInfo::kTruncated;
+      return;
+    }
+
+    if (next == kIpv6Fragment) {
+      info->flags |= HeaderInfo::kFragment;
+      if (Load16(p + off + 2) & 0xfff8) {
+        info->l4_proto = p[off];
+        return;
+      }
+      ext_bytes = 8;
+    } else if (next == kIpv6Ah) {
+      ext_bytes = (p[off + 1] + 2) * 4;
+    } else {
+      ext_bytes = (p[off + 1] + 1) * 8;
+    }
+
+    if (len < off + ext_bytes) {
+      info->flags |= HeaderInfo::kTruncated;
+      return;
+    }
+
+    next = p[off];
+    off += ext_bytes;
+  }
+}
+
+// Parses the Ethernet frame at p + off and everything above it
+void ParseFrame(const uint8_t *p, size_t len, size_t off, HeaderInfo *info) {
+  if (len < off + sizeof(Ethernet)) {
+    info->flags |= HeaderInfo::kTruncated;
+    return;
+  }
+
+  uint16_t type = Load16(p + off + 12);
+  off += sizeof(Ethernet);
+
+  for (size_t i = 0;
+       type == Ethernet::Type::kVlan || type == Ethernet::Type::kQinQ; i++) {
+    if (i == kMaxVlanTags) {
+      info->flags |= HeaderInfo::kMalformed;
+      return;
+    }
+    if (len < off + sizeof(Vlan)) {
+      info->flags |= HeaderInfo::kTruncated;
+      return;
+    }
+    if (!(info->flags & HeaderInfo::kVlan)) {
+      info->vlan_tci = Load16(p + off);
+      info->flags |= HeaderInfo::kVlan;
+    }
+    type = Load16(p + off + 2);
+    off += sizeof(Vlan);
+  }
+
+  if (type == Ethernet::Type::kMpls || type == kEtherTypeMplsMulticast) {
+    info->flags |= HeaderInfo::kMpls;
+    info->l3_type = type;
+
+    for (size_t i = 0;; i++) {
+      if (i == kMaxMplsLabels) {
+        info->flags |= HeaderInfo::kMalformed;
+        return;
+      }
+      // Needs the first byte of the payload as well
+      if (len < off + 5) {
+        info->flags |= HeaderInfo::kTruncated;
+        return;
+      }
+      bool bottom = p[off + 2] & 0x1;
+      off += 4;
+      if (bottom) {
+        break;
+      }
+    }
+
+    // MPLS does not say what it carries. Guess from the IP version field.
+    switch (p[off] >> 4) {
+      case 4:
+        type = Ethernet::Type::kIpv4;
+        break;
+      case 6:
+        type = Ethernet::Type::kIpv6;
+        break;
+      default:
+        return;
+    }
+  }
+
+  info->l3_type = type;
+
+  switch (type) {
+    case Ethernet::Type::kIpv4:
+      ParseIpv4(p, len, off, info);
+      break;
+    case Ethernet::Type::kIpv6:
+      ParseIpv6(p, len, off, info);
+      break;
+    default:
+      // Opaque, but modules may still want to find, e.g., an ARP header
+      info->l3_offset = off;
+      break;
+  }
+}
+
+}  // namespace
+
+void ParseHeaders(const void *data, size_t len, HeaderInfo *info,
+                  bool vxlan_inner) {
+  const uint8_t *p = static_cast<const uint8_t *>(data);
+
+  *info = HeaderInfo();
+  len = std::min<size_t>(len, UINT16_MAX);
+
+  ParseFrame(p, len, 0, info);
+
+  if (!vxlan_inner || !info->l4_offset ||
+      info->l4_proto != Ipv4::Proto::kUdp ||
+      Load16(p + info->l4_offset + 2) != kVxlanPort) {
+    return;
+  }
+
+  size_t inner = info->l4_offset + 8 + kVxlanHeaderLen;
+  uint16_t vlan_tci = info->vlan_tci;
+  uint8_t flags = info->flags;
+
+  *info = HeaderInfo();
+  info->inner_offset = inner;
+  info->vlan_tci = vlan_tci;
+  info->flags =
+      (flags & (HeaderInfo::kVlan | HeaderInfo::kMpls)) | HeaderInfo::kTunnel;
+
+  ParseFrame(p, len, inner, info);
+}
+
+}  // namespace utils
+}  // namespace bess
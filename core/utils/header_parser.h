@@ -0,0 +1,108 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_HEADER_PARSER_H_
+#define BESS_UTILS_HEADER_PARSER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace bess {
+namespace utils {
+
+// Layer offsets and protocols of a frame, found in a single pass by
+// ParseHeaders(). The Parse module stores it in the "header_info" metadata
+// attribute, so that downstream modules can jump to the headers they need
+// instead of parsing (or assuming untagged Ethernet) by themselves.
+struct HeaderInfo {
+  enum Flag : uint8_t {
+    kVlan = 1 << 0,       // one or more 802.1Q/802.1ad tags
+    kMpls = 1 << 1,       // an MPLS label stack
+    kTunnel = 1 << 2,     // offsets are of the inner frame of VXLAN
+    kFragment = 1 << 3,   // IP fragment. No L4 header unless the first one
+    kTruncated = 1 << 4,  // the frame ends before an announced header
+    kMalformed = 1 << 5,  // a header has invalid values
+    kStale = 1 << 6,      // a module added or removed headers since parsing
+  };
+
+  uint16_t l3_offset;     // 0 if none
+  uint16_t l4_offset;     // 0 if none
+  uint16_t inner_offset;  // inner Ethernet header of VXLAN, 0 if none
+  uint16_t l3_type;       // EtherType of the L3 header, in host order
+  uint16_t vlan_tci;      // of the outermost tag, in host order
+  uint8_t l4_proto;       // IP protocol, after IPv6 extension headers
+  uint8_t flags;
+
+  bool ok() const { return !(flags & (kTruncated | kMalformed)); }
+
+  // Offsets do not match the frame any more
+  bool stale() const { return flags & kStale; }
+
+  // Pointers to the headers given the start of the frame, or nullptr
+  template <typename T>
+  T *l3(void *head) const {
+    return l3_offset ? reinterpret_cast<T *>(static_cast<uint8_t *>(head) +
+                                             l3_offset)
+                     : nullptr;
+  }
+
+  template <typename T>
+  T *l4(void *head) const {
+    return l4_offset ? reinterpret_cast<T *>(static_cast<uint8_t *>(head) +
+                                             l4_offset)
+                     : nullptr;
+  }
+};
+
+static_assert(sizeof(HeaderInfo) == 12, "HeaderInfo is incorrect");
+
+// Name of the metadata attribute that holds a HeaderInfo
+static constexpr const char *kHeaderInfoAttrName = "header_info";
+
+// Walks L2-L4 of the frame at `data` (`len` bytes), through VLAN/QinQ tags,
+// MPLS labels and IPv6 extension headers. With `vxlan_inner`, the offsets
+// describe the inner frame of VXLAN (UDP port 4789) packets. Never reads
+// beyond `len` bytes; headers that do not fit are left out and flagged.
+void ParseHeaders(const void *data, size_t len, HeaderInfo *info,
+                  bool vxlan_inner = false);
+
+// For consumers of the "header_info" attribute: parses the frame again, as it
+// is now, if a module changed its layout after the Parse module.
+static inline void ReparseIfStale(const void *data, size_t len,
+                                  HeaderInfo *info) {
+  if (info->stale()) {
+    ParseHeaders(data, len, info);
+  }
+}
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_HEADER_PARSER_H_
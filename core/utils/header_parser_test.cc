@@ -0,0 +1,294 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "header_parser.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "ether.h"
+#include "ip.h"
+
+namespace {
+
+using bess::utils::Ethernet;
+using bess::utils::HeaderInfo;
+using bess::utils::Ipv4;
+using bess::utils::ParseHeaders;
+using bess::utils::ReparseIfStale;
+
+using Bytes = std::vector<uint8_t>;
+
+void Append(Bytes *frame, const Bytes &bytes) {
+  frame->insert(frame->end(), bytes.begin(), bytes.end());
+}
+
+void AppendEther(Bytes *frame, uint16_t type) {
+  frame->insert(frame->end(), 12, 0x02);
+  Append(frame, {static_cast<uint8_t>(type >> 8), static_cast<uint8_t>(type)});
+}
+
+void AppendVlan(Bytes *frame, uint16_t tci, uint16_t type) {
+  Append(frame, {static_cast<uint8_t>(tci >> 8), static_cast<uint8_t>(tci),
+                 static_cast<uint8_t>(type >> 8), static_cast<uint8_t>(type)});
+}
+
+void AppendIpv4(Bytes *frame, uint8_t proto, uint16_t frag = 0) {
+  Append(frame, {0x45, 0, 0, 0, 0, 0, static_cast<uint8_t>(frag >> 8),
+                 static_cast<uint8_t>(frag), 64, proto, 0, 0, 10, 0, 0, 1, 10,
+                 0, 0, 2});
+}
+
+void AppendIpv6(Bytes *frame, uint8_t next) {
+  Append(frame, {0x60, 0, 0, 0, 0, 0, next, 64});
+  frame->insert(frame->end(), 32, 0xfe);
+}
+
+void AppendUdp(Bytes *frame, uint16_t dst_port) {
+  Append(frame, {0x12, 0x34, static_cast<uint8_t>(dst_port >> 8),
+                 static_cast<uint8_t>(dst_port), 0, 0, 0, 0});
+}
+
+void AppendTcp(Bytes *frame) {
+  Append(frame, {0x12, 0x34, 0, 80, 0, 0, 0, 0, 0, 0, 0, 0, 0x50, 0x10, 0, 0,
+                 0, 0, 0, 0});
+}
+
+HeaderInfo Parse(const Bytes &frame, bool vxlan_inner = false) {
+  HeaderInfo info;
+  ParseHeaders(frame.data(), frame.size(), &info, vxlan_inner);
+  return info;
+}
+
+TEST(HeaderParserTest, Ipv4Tcp) {
+  Bytes frame;
+  AppendEther(&frame, Ethernet::Type::kIpv4);
+  AppendIpv4(&frame, Ipv4::Proto::kTcp);
+  AppendTcp(&frame);
+
+  HeaderInfo info = Parse(frame);
+  EXPECT_TRUE(info.ok());
+  EXPECT_EQ(0, info.flags);
+  EXPECT_EQ(Ethernet::Type::kIpv4, info.l3_type);
+  EXPECT_EQ(14, info.l3_offset);
+  EXPECT_EQ(34, info.l4_offset);
+  EXPECT_EQ(Ipv4::Proto::kTcp, info.l4_proto);
+
+  Ipv4 *ip = info.l3<Ipv4>(frame.data());
+  EXPECT_EQ(64, ip->ttl);
+}
+
+TEST(HeaderParserTest, QinQ) {
+  Bytes frame;
+  AppendEther(&frame, Ethernet::Type::kQinQ);
+  AppendVlan(&frame, 100, Ethernet::Type::kVlan);
+  AppendVlan(&frame, 200, Ethernet::Type::kIpv4);
+  AppendIpv4(&frame, Ipv4::Proto::kUdp);
+  AppendUdp(&frame, 53);
+
+  HeaderInfo info = Parse(frame);
+  EXPECT_TRUE(info.ok());
+  EXPECT_EQ(HeaderInfo::kVlan, info.flags);
+  EXPECT_EQ(100, info.vlan_tci);
+  EXPECT_EQ(22, info.l3_offset);
+  EXPECT_EQ(42, info.l4_offset);
+  EXPECT_EQ(Ipv4::Proto::kUdp, info.l4_proto);
+}
+
+TEST(HeaderParserTest, Mpls) {
+  Bytes frame;
+  AppendEther(&frame, Ethernet::Type::kMpls);
+  Append(&frame, {0, 0x10, 0x00, 64});  // label 1
+  Append(&frame, {0, 0x20, 0x01, 64});  // label 2, bottom of stack
+  AppendIpv4(&frame, Ipv4::Proto::kTcp);
+  AppendTcp(&frame);
+
+  HeaderInfo info = Parse(frame);
+  EXPECT_TRUE(info.ok());
+  EXPECT_EQ(HeaderInfo::kMpls, info.flags);
+  EXPECT_EQ(Ethernet::Type::kIpv4, info.l3_type);
+  EXPECT_EQ(22, info.l3_offset);
+  EXPECT_EQ(42, info.l4_offset);
+}
+
+TEST(HeaderParserTest, Ipv6ExtensionHeaders) {
+  Bytes frame;
+  AppendEther(&frame, Ethernet::Type::kIpv6);
+  AppendIpv6(&frame, 0);                  // hop-by-hop follows
+  Append(&frame, {60, 0, 0, 0, 0, 0, 0, 0});  // -> destination options
+  Append(&frame, {17, 1});                // -> UDP, 16 bytes
+  frame.insert(frame.end(), 14, 0);
+  AppendUdp(&frame, 53);
+
+  HeaderInfo info = Parse(frame);
+  EXPECT_TRUE(info.ok());
+  EXPECT_EQ(Ethernet::Type::kIpv6, info.l3_type);
+  EXPECT_EQ(14, info.l3_offset);
+  EXPECT_EQ(14 + 40 + 8 + 16, info.l4_offset);
+  EXPECT_EQ(Ipv4::Proto::kUdp, info.l4_proto);
+}
+
+TEST(HeaderParserTest, Fragments) {
+  Bytes first;
+  AppendEther(&first, Ethernet::Type::kIpv4);
+  AppendIpv4(&first, Ipv4::Proto::kTcp, Ipv4::Flag::kMF);
+  AppendTcp(&first);
+
+  HeaderInfo info = Parse(first);
+  EXPECT_EQ(HeaderInfo::kFragment, info.flags);
+  EXPECT_EQ(34, info.l4_offset);
+
+  Bytes later;
+  AppendEther(&later, Ethernet::Type::kIpv4);
+  AppendIpv4(&later, Ipv4::Proto::kTcp, 185);
+  later.insert(later.end(), 20, 0xaa);
+
+  info = Parse(later);
+  EXPECT_EQ(HeaderInfo::kFragment, info.flags);
+  EXPECT_EQ(14, info.l3_offset);
+  EXPECT_EQ(0, info.l4_offset);
+  EXPECT_EQ(Ipv4::Proto::kTcp, info.l4_proto);
+
+  Bytes later6;
+  AppendEther(&later6, Ethernet::Type::kIpv6);
+  AppendIpv6(&later6, 44);
+  Append(&later6, {6, 0, 0x05, 0xc8, 0, 0, 0, 1});  // offset 185
+  later6.insert(later6.end(), 20, 0xaa);
+
+  info = Parse(later6);
+  EXPECT_EQ(HeaderInfo::kFragment, info.flags);
+  EXPECT_EQ(0, info.l4_offset);
+  EXPECT_EQ(Ipv4::Proto::kTcp, info.l4_proto);
+}
+
+TEST(HeaderParserTest, Truncated) {
+  Bytes frame;
+  AppendEther(&frame, Ethernet::Type::kIpv4);
+  AppendIpv4(&frame, Ipv4::Proto::kTcp);
+  AppendTcp(&frame);
+
+  // TCP header cut short
+  HeaderInfo info;
+  ParseHeaders(frame.data(), frame.size() - 1, &info);
+  EXPECT_FALSE(info.ok());
+  EXPECT_EQ(14, info.l3_offset);
+  EXPECT_EQ(0, info.l4_offset);
+
+  // IP header cut short
+  ParseHeaders(frame.data(), 30, &info);
+  EXPECT_EQ(HeaderInfo::kTruncated, info.flags);
+  EXPECT_EQ(0, info.l3_offset);
+
+  ParseHeaders(frame.data(), 10, &info);
+  EXPECT_EQ(HeaderInfo::kTruncated, info.flags);
+}
+
+TEST(HeaderParserTest, Malformed) {
+  Bytes frame;
+  AppendEther(&frame, Ethernet::Type::kIpv4);
+  AppendIpv4(&frame, Ipv4::Proto::kTcp);
+  AppendTcp(&frame);
+  frame[14] = 0x43;  // IHL of 3
+
+  HeaderInfo info = Parse(frame);
+  EXPECT_EQ(HeaderInfo::kMalformed, info.flags);
+  EXPECT_EQ(0, info.l3_offset);
+}
+
+TEST(HeaderParserTest, OtherL3) {
+  Bytes frame;
+  AppendEther(&frame, Ethernet::Type::kArp);
+  frame.insert(frame.end(), 28, 0);
+
+  HeaderInfo info = Parse(frame);
+  EXPECT_TRUE(info.ok());
+  EXPECT_EQ(Ethernet::Type::kArp, info.l3_type);
+  EXPECT_EQ(14, info.l3_offset);
+  EXPECT_EQ(0, info.l4_offset);
+}
+
+TEST(HeaderParserTest, VxlanInner) {
+  Bytes frame;
+  AppendEther(&frame, Ethernet::Type::kVlan);
+  AppendVlan(&frame, 7, Ethernet::Type::kIpv4);
+  AppendIpv4(&frame, Ipv4::Proto::kUdp);
+  AppendUdp(&frame, 4789);
+  Append(&frame, {0x08, 0, 0, 0, 0, 0, 1, 0});  // VNI 1
+  AppendEther(&frame, Ethernet::Type::kIpv4);
+  AppendIpv4(&frame, Ipv4::Proto::kTcp);
+  AppendTcp(&frame);
+
+  // Outer headers only
+  HeaderInfo info = Parse(frame);
+  EXPECT_EQ(HeaderInfo::kVlan, info.flags);
+  EXPECT_EQ(18, info.l3_offset);
+  EXPECT_EQ(Ipv4::Proto::kUdp, info.l4_proto);
+  EXPECT_EQ(0, info.inner_offset);
+
+  info = Parse(frame, true);
+  EXPECT_TRUE(info.ok());
+  EXPECT_EQ(HeaderInfo::kVlan | HeaderInfo::kTunnel, info.flags);
+  EXPECT_EQ(7, info.vlan_tci);
+  EXPECT_EQ(18 + 20 + 8 + 8, info.inner_offset);
+  EXPECT_EQ(info.inner_offset + 14, info.l3_offset);
+  EXPECT_EQ(info.inner_offset + 34, info.l4_offset);
+  EXPECT_EQ(Ipv4::Proto::kTcp, info.l4_proto);
+}
+
+// What VLANPop does between Parse and a consumer
+TEST(HeaderParserTest, ReparseIfStale) {
+  Bytes frame;
+  AppendEther(&frame, Ethernet::Type::kVlan);
+  AppendVlan(&frame, 7, Ethernet::Type::kIpv4);
+  AppendIpv4(&frame, Ipv4::Proto::kUdp);
+  AppendUdp(&frame, 53);
+
+  HeaderInfo info = Parse(frame);
+  EXPECT_EQ(18, info.l3_offset);
+
+  // Still valid
+  ReparseIfStale(frame.data(), frame.size(), &info);
+  EXPECT_EQ(18, info.l3_offset);
+  EXPECT_EQ(HeaderInfo::kVlan, info.flags);
+
+  frame.erase(frame.begin() + 12, frame.begin() + 16);
+  info.flags |= HeaderInfo::kStale;
+  EXPECT_TRUE(info.stale());
+
+  ReparseIfStale(frame.data(), frame.size(), &info);
+  EXPECT_FALSE(info.stale());
+  EXPECT_EQ(0, info.flags);
+  EXPECT_EQ(14, info.l3_offset);
+  EXPECT_EQ(34, info.l4_offset);
+  EXPECT_EQ(Ipv4::Proto::kUdp, info.l4_proto);
+}
+
+}  // namespace
@@ -0,0 +1,161 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_MAGLEV_H_
+#define BESS_UTILS_MAGLEV_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace bess {
+namespace utils {
+
+// Consistent hashing with a Maglev lookup table (Eisenbud et al., NSDI'16).
+//
+// Every backend walks its own permutation of the table slots, derived only
+// from the backend's id, and claims the first free slot in turn. As a result,
+// adding or removing a backend moves only a small fraction of the slots that
+// belong to the other backends, and the assignment does not depend on the
+// order in which backends are listed. Weights are honored by letting a backend
+// claim slots proportionally less often than the heaviest one.
+//
+// Building the table is O(size * log size) on average and meant for the
+// control path. A lookup is a single load from a table of `size` entries.
+template <typename T>
+class MaglevTable {
+ public:
+  // Must be prime. The paper suggests at least 100 slots per backend, so this
+  // is good for up to ~650 backends.
+  static const uint32_t kDefaultSize = 65537;
+
+  struct Backend {
+    T id;
+    uint32_t weight;  // 0 takes the backend out of the rotation
+  };
+
+  explicit MaglevTable(uint32_t size = kDefaultSize) : size_(size) {}
+
+  uint32_t size() const { return size_; }
+
+  // Returns a table of size() entries that maps each slot to a backend id.
+  // Backends must have distinct ids. If no backend has a positive weight,
+  // every slot is set to `empty`.
+  std::vector<T> Build(const std::vector<Backend> &backends, T empty) const;
+
+  // Maps a 32-bit hash value to a slot in [0, size), without division.
+  static uint32_t Slot(uint32_t hash, uint32_t size) {
+    return (static_cast<uint64_t>(hash) * size) >> 32;
+  }
+
+ private:
+  // 64-bit finalizer of MurmurHash3, to spread small ids (e.g., gate numbers)
+  static uint64_t Mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+  }
+
+  uint32_t size_;
+};
+
+template <typename T>
+const uint32_t MaglevTable<T>::kDefaultSize;
+
+template <typename T>
+std::vector<T> MaglevTable<T>::Build(const std::vector<Backend> &backends,
+                                     T empty) const {
+  std::vector<T> table(size_, empty);
+
+  struct State {
+    T id;
+    uint64_t weight;
+    uint32_t offset;
+    uint32_t skip;
+    uint32_t next;    // position in the permutation
+    uint64_t filled;  // slots claimed so far
+  };
+
+  std::vector<State> states;
+  uint64_t max_weight = 0;
+  for (const Backend &b : backends) {
+    if (b.weight == 0) {
+      continue;
+    }
+    uint64_t h = Mix(static_cast<uint64_t>(b.id));
+    uint64_t h2 = Mix(h ^ 0x9e3779b97f4a7c15ull);
+    states.push_back({b.id, b.weight, static_cast<uint32_t>(h % size_),
+                      static_cast<uint32_t>(h2 % (size_ - 1)) + 1, 0, 0});
+    max_weight = std::max(max_weight, static_cast<uint64_t>(b.weight));
+  }
+
+  if (states.empty()) {
+    return table;
+  }
+
+  // Sort by id so that the result does not depend on the input order
+  std::sort(states.begin(), states.end(),
+            [](const State &a, const State &b) { return a.id < b.id; });
+
+  std::vector<bool> taken(size_, false);
+  uint32_t num_taken = 0;
+
+  for (uint64_t round = 1; num_taken < size_; round++) {
+    for (State &s : states) {
+      // A backend of weight w claims w/max_weight slots per round on average
+      if (s.filled * max_weight >= round * s.weight) {
+        continue;
+      }
+
+      uint32_t slot;
+      do {
+        slot = (s.offset + static_cast<uint64_t>(s.skip) * s.next) % size_;
+        s.next++;
+      } while (taken[slot]);
+
+      taken[slot] = true;
+      table[slot] = s.id;
+      s.filled++;
+      if (++num_taken == size_) {
+        break;
+      }
+    }
+  }
+
+  return table;
+}
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_MAGLEV_H_
@@ -0,0 +1,137 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "maglev.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+
+namespace {
+
+using bess::utils::MaglevTable;
+
+using Table = MaglevTable<uint16_t>;
+
+const uint16_t kEmpty = 0xffff;
+
+std::map<uint16_t, uint32_t> CountSlots(const std::vector<uint16_t> &table) {
+  std::map<uint16_t, uint32_t> counts;
+  for (uint16_t id : table) {
+    counts[id]++;
+  }
+  return counts;
+}
+
+uint32_t CountMoved(const std::vector<uint16_t> &a,
+                    const std::vector<uint16_t> &b) {
+  uint32_t moved = 0;
+  for (size_t i = 0; i < a.size(); i++) {
+    moved += (a[i] != b[i]);
+  }
+  return moved;
+}
+
+TEST(MaglevTest, Empty) {
+  Table maglev(251);
+  std::vector<uint16_t> table = maglev.Build({}, kEmpty);
+  ASSERT_EQ(251, table.size());
+  EXPECT_EQ(251, CountSlots(table)[kEmpty]);
+
+  table = maglev.Build({{1, 0}, {2, 0}}, kEmpty);
+  EXPECT_EQ(251, CountSlots(table)[kEmpty]);
+}
+
+TEST(MaglevTest, Slot) {
+  EXPECT_EQ(0, Table::Slot(0, 65537));
+  EXPECT_EQ(65536, Table::Slot(0xffffffff, 65537));
+  EXPECT_EQ(125, Table::Slot(0x80000000, 251));
+}
+
+TEST(MaglevTest, Balanced) {
+  Table maglev;
+  std::vector<Table::Backend> backends;
+  for (uint16_t i = 0; i < 10; i++) {
+    backends.push_back({i, 1});
+  }
+
+  std::map<uint16_t, uint32_t> counts =
+      CountSlots(maglev.Build(backends, kEmpty));
+  ASSERT_EQ(10, counts.size());
+  for (const auto &it : counts) {
+    EXPECT_NEAR(maglev.size() / 10, it.second, 1) << "backend " << it.first;
+  }
+}
+
+TEST(MaglevTest, Weighted) {
+  Table maglev;
+  std::map<uint16_t, uint32_t> counts =
+      CountSlots(maglev.Build({{0, 1}, {1, 2}, {2, 5}, {3, 0}}, kEmpty));
+  ASSERT_EQ(3, counts.size());
+  EXPECT_EQ(0, counts.count(3));
+  EXPECT_NEAR(maglev.size() * 1 / 8, counts[0], 2);
+  EXPECT_NEAR(maglev.size() * 2 / 8, counts[1], 2);
+  EXPECT_NEAR(maglev.size() * 5 / 8, counts[2], 2);
+}
+
+TEST(MaglevTest, OrderIndependent) {
+  Table maglev;
+  std::vector<uint16_t> a = maglev.Build({{3, 1}, {7, 1}, {9, 2}}, kEmpty);
+  std::vector<uint16_t> b = maglev.Build({{9, 2}, {3, 1}, {7, 1}}, kEmpty);
+  EXPECT_EQ(a, b);
+}
+
+TEST(MaglevTest, MinimalDisruption) {
+  Table maglev;
+  std::vector<Table::Backend> backends;
+  for (uint16_t i = 0; i < 20; i++) {
+    backends.push_back({i, 1});
+  }
+  std::vector<uint16_t> before = maglev.Build(backends, kEmpty);
+
+  // Removing one backend should move its own 1/20 of the slots, plus a few
+  // others. Plain modulo hashing would move ~95% of them.
+  backends.erase(backends.begin() + 7);
+  std::vector<uint16_t> after = maglev.Build(backends, kEmpty);
+
+  uint32_t moved = CountMoved(before, after);
+  EXPECT_GE(moved, maglev.size() / 20);
+  EXPECT_LT(moved, maglev.size() / 20 * 2);
+
+  for (size_t i = 0; i < before.size(); i++) {
+    EXPECT_NE(7, after[i]);
+  }
+
+  // Adding it back restores the original table
+  backends.push_back({7, 1});
+  EXPECT_EQ(before, maglev.Build(backends, kEmpty));
+}
+
+}  // namespace
@@ -83,6 +83,8 @@ static inline void mcs_unlock(mcslock_t *lock, mcslock_node_t *mynode) {
 }
 
 static inline int mcs_trylock(mcslock_t *lock, mcslock_node_t *mynode) {
+  /* mcs_unlock() looks for a successor here */
+  mynode->next = nullptr;
   return __sync_bool_compare_and_swap(&lock->tail, nullptr, mynode);
 }
 
@@ -0,0 +1,158 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "perf_counters.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <x86intrin.h>
+
+#include <cstring>
+
+#include <glog/logging.h>
+
+namespace bess {
+namespace utils {
+
+static const struct {
+  uint32_t type;
+  uint64_t config;
+  const char *name;
+} kEvents[PerfCounters::kNumEvents] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles"},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions"},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "llc_misses"},
+    {PERF_TYPE_HW_CACHE,
+     PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+     "dtlb_misses"},
+};
+
+PerfCounters::PerfCounters() {
+  for (int i = 0; i < kNumEvents; i++) {
+    fds_[i] = -1;
+    pages_[i] = nullptr;
+  }
+}
+
+int PerfCounters::Open() {
+  const long page_size = sysconf(_SC_PAGESIZE);
+  int opened = 0;
+
+  Close();
+
+  for (int i = 0; i < kNumEvents; i++) {
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = kEvents[i].type;
+    attr.config = kEvents[i].config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    // pid == 0 and cpu == -1: the calling thread, on any CPU
+    int fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fd < 0) {
+      PLOG(WARNING) << "perf_event_open(" << kEvents[i].name << ")";
+      continue;
+    }
+
+    void *page = mmap(nullptr, page_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (page != MAP_FAILED) {
+      pages_[i] = static_cast<struct perf_event_mmap_page *>(page);
+    }
+
+    fds_[i] = fd;
+    opened++;
+  }
+
+  return opened;
+}
+
+void PerfCounters::Close() {
+  const long page_size = sysconf(_SC_PAGESIZE);
+
+  for (int i = 0; i < kNumEvents; i++) {
+    if (pages_[i]) {
+      munmap(pages_[i], page_size);
+      pages_[i] = nullptr;
+    }
+    if (fds_[i] >= 0) {
+      close(fds_[i]);
+      fds_[i] = -1;
+    }
+  }
+}
+
+// The seqlock protocol is described in include/uapi/linux/perf_event.h
+uint64_t PerfCounters::ReadOne(int i) const {
+  const volatile struct perf_event_mmap_page *pc = pages_[i];
+
+  if (pc && pc->cap_user_rdpmc) {
+    uint32_t seq;
+    uint64_t count;
+
+    do {
+      seq = pc->lock;
+      __asm__ __volatile__("" : : : "memory");
+
+      uint32_t idx = pc->index;
+      count = pc->offset;
+      if (idx) {
+        uint16_t width = pc->pmc_width;
+        int64_t pmc = __rdpmc(idx - 1);
+
+        // sign-extend the counter to 64 bits
+        pmc <<= 64 - width;
+        pmc >>= 64 - width;
+        count += pmc;
+      }
+
+      __asm__ __volatile__("" : : : "memory");
+    } while (pc->lock != seq);
+
+    return count;
+  }
+
+  uint64_t count;
+  if (read(fds_[i], &count, sizeof(count)) != sizeof(count)) {
+    return 0;
+  }
+  return count;
+}
+
+const char *PerfCounters::EventName(Event e) {
+  return kEvents[e].name;
+}
+
+}  // namespace utils
+}  // namespace bess
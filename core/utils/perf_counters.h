@@ -0,0 +1,87 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_PERF_COUNTERS_H_
+#define BESS_UTILS_PERF_COUNTERS_H_
+
+#include <linux/perf_event.h>
+
+#include <cstdint>
+
+namespace bess {
+namespace utils {
+
+// Hardware performance counters of the calling thread (see perf_event_open(2)).
+// Counters are read with rdpmc in user space when the kernel allows it
+// (/sys/bus/event_source/devices/cpu/rdpmc), otherwise with read(2).
+// Only user-level events are counted.
+class PerfCounters {
+ public:
+  enum Event {
+    kCycles = 0,
+    kInstructions,
+    kLlcMisses,
+    kDtlbMisses,
+    kNumEvents,
+  };
+
+  PerfCounters();
+  ~PerfCounters() { Close(); }
+
+  // Starts counting the events of the calling thread. Events that are not
+  // supported by the CPU (or hypervisor) always read 0.
+  // Returns the number of events being counted.
+  int Open();
+  void Close();
+
+  bool available(Event e) const { return fds_[e] >= 0; }
+
+  // vals[e] = current value of event e
+  void Read(uint64_t *vals) const {
+    for (int i = 0; i < kNumEvents; i++) {
+      vals[i] = (fds_[i] >= 0) ? ReadOne(i) : 0;
+    }
+  }
+
+  static const char *EventName(Event e);
+
+ private:
+  uint64_t ReadOne(int i) const;
+
+  int fds_[kNumEvents];
+
+  // perf mmap pages for rdpmc. nullptr if not mapped.
+  struct perf_event_mmap_page *pages_[kNumEvents];
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_PERF_COUNTERS_H_
@@ -30,9 +30,12 @@
 #ifndef BESS_UTILS_TCP_FLOW_RECONSTRUCT_H_
 #define BESS_UTILS_TCP_FLOW_RECONSTRUCT_H_
 
+#include <algorithm>
+#include <map>
 #include <vector>
 
 #include "../packet.h"
+#include "arena.h"
 #include "copy.h"
 #include "ether.h"
 #include "ip.h"
@@ -45,9 +48,13 @@ namespace utils {
 class TcpFlowReconstruct {
  public:
   // Constructs a TCP flow reconstruction object that can hold initial_buflen
-  // bytes to start with.
-  explicit TcpFlowReconstruct(size_t initial_buflen = 1024)
-      : initialized_(false), init_seq_(0), buf_(initial_buflen) {}
+  // bytes to start with. Buffers are taken from 'arena' if given.
+  explicit TcpFlowReconstruct(size_t initial_buflen = 1024,
+                              Arena *arena = nullptr)
+      : initialized_(false),
+        init_seq_(0),
+        buf_(initial_buflen, ArenaAllocator<char>(arena)),
+        received_map_(SegmentMap::allocator_type(arena)) {}
 
   virtual ~TcpFlowReconstruct() {}
 
@@ -77,7 +84,11 @@ class TcpFlowReconstruct {
   //
   // Behavior is undefined the packet is not a TCP packet.
   bool InsertPacket(Packet *p) {
-    const Ethernet *eth = p->head_data<const Ethernet *>();
+    // Headers may span multiple segments. If so, they are copied to hdr_buf.
+    char hdr_buf[sizeof(Ethernet) + kMaxIpHeaderLen + kMaxTcpHeaderLen];
+    uint32_t hdr_len =
+        std::min(sizeof(hdr_buf), static_cast<size_t>(p->total_len()));
+    const Ethernet *eth = p->read<const Ethernet *>(0, hdr_len, hdr_buf);
     const Ipv4 *ip = (const Ipv4 *)(eth + 1);
     const Tcp *tcp =
         (const Tcp *)(((const char *)ip) + (ip->header_length * 4));
@@ -107,7 +118,8 @@ class TcpFlowReconstruct {
     // Wraparound is possible.
     uint32_t buf_offset = seq - init_seq_;
 
-    const char *datastart = ((const char *)tcp) + (tcp->offset * 4);
+    uint32_t data_offset =
+        sizeof(*eth) + (ip->header_length * 4) + (tcp->offset * 4);
     uint32_t datalen =
         ip->length.value() - (tcp->offset * 4) - (ip->header_length * 4);
 
@@ -122,7 +134,10 @@ class TcpFlowReconstruct {
       buf_.resize(new_buflen);
     }
 
-    bess::utils::CopyInlined(buf_.data() + buf_offset, datastart, datalen);
+    if (!p->CopyOut(buf_.data() + buf_offset, data_offset, datalen)) {
+      VLOG(1) << "Truncated packet";
+      return false;
+    }
 
     uint32_t start = buf_offset;
     uint32_t end = buf_offset + datalen;
@@ -158,6 +173,9 @@ class TcpFlowReconstruct {
   }
 
  private:
+  static const size_t kMaxIpHeaderLen = 60;
+  static const size_t kMaxTcpHeaderLen = 60;
+
   // Tracks whether the init_seq_ (and thus this object) has been initialized
   // with a SYN.
   bool initialized_;
@@ -165,13 +183,17 @@ class TcpFlowReconstruct {
   // The initial sequence number of data bytes in the TCP flow.
   uint32_t init_seq_;
 
+  using SegmentMap =
+      std::map<uint32_t, uint32_t, std::less<uint32_t>,
+               ArenaAllocator<std::pair<const uint32_t, uint32_t>>>;
+
   // A buffer (potentially with holes) of received data.
-  std::vector<char> buf_;
+  std::vector<char, ArenaAllocator<char>> buf_;
 
   // Sorted list of received segments. Segments are merged as necessary.
   // Key: offset from init_seq_
   // T: end offset of the segment
-  std::map<uint32_t, uint32_t> received_map_;
+  SegmentMap received_map_;
 
   DISALLOW_COPY_AND_ASSIGN(TcpFlowReconstruct);
 };
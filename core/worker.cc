@@ -30,8 +30,10 @@
 
 #include "worker.h"
 
+#include <linux/membarrier.h>
 #include <sched.h>
 #include <sys/eventfd.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 
 #include <glog/logging.h>
@@ -46,8 +48,10 @@
 
 #include "metadata.h"
 #include "module.h"
+#include "module_profiler.h"
 #include "opts.h"
 #include "packet.h"
+#include "packet_cache.h"
 #include "resume_hook.h"
 #include "resume_hooks/metadata.h"
 #include "scheduler.h"
@@ -62,6 +66,8 @@ int num_workers = 0;
 std::thread worker_threads[Worker::kMaxWorkers];
 Worker *volatile workers[Worker::kMaxWorkers];
 
+bool Worker::membarrier_ = false;
+
 using bess::TrafficClassBuilder;
 using namespace bess::traffic_class_initializer_types;
 using bess::ResumeHookFactory;
@@ -229,6 +235,65 @@ bool is_any_worker_running() {
   return false;
 }
 
+void synchronize_workers() {
+  uint64_t rounds[Worker::kMaxWorkers];
+
+  // Make the caller's updates visible before taking the snapshot. Workers do
+  // not fence their round updates (see Worker::incr_rounds()), so make every
+  // one of them execute a barrier too: a task that loaded the old data before
+  // it has its round counted in the snapshot, and ends before the next one.
+  if (Worker::membarrier_enabled()) {
+#if defined(__NR_membarrier) && defined(MEMBARRIER_CMD_PRIVATE_EXPEDITED)
+    PCHECK(syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0) == 0)
+        << "membarrier()";
+#endif
+  } else {
+    FULL_BARRIER();
+  }
+
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    if (workers[wid]) {
+      rounds[wid] = workers[wid]->rounds();
+    }
+  }
+
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    if (!workers[wid]) {
+      continue;
+    }
+
+    // Paused workers are not in the middle of a task. Otherwise one round
+    // boundary is enough, since the tasks after it load the new data.
+    while (workers[wid]->status() != WORKER_PAUSED &&
+           workers[wid]->status() != WORKER_FINISHED &&
+           workers[wid]->rounds() == rounds[wid]) {
+    } /* spin */
+  }
+}
+
+void Worker::InitMembarrier() {
+#if defined(__NR_membarrier) && defined(MEMBARRIER_CMD_PRIVATE_EXPEDITED)
+  static bool initialized = false;
+  if (initialized) {
+    return;
+  }
+  initialized = true;
+
+  long cmds = syscall(__NR_membarrier, MEMBARRIER_CMD_QUERY, 0);
+  if (cmds < 0 || !(cmds & MEMBARRIER_CMD_PRIVATE_EXPEDITED)) {
+    LOG(INFO) << "membarrier() is not available, workers will fence rounds";
+    return;
+  }
+
+  if (syscall(__NR_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0)) {
+    PLOG(WARNING) << "membarrier(REGISTER_PRIVATE_EXPEDITED)";
+    return;
+  }
+
+  membarrier_ = true;
+#endif
+}
+
 void Worker::SetNonWorker() {
   int socket;
 
@@ -240,6 +305,8 @@ void Worker::SetNonWorker() {
   socket_ = INT_MIN;
   fd_event_ = INT_MIN;
 
+  packet_cache_ = nullptr;
+
   // Packet pools should be available to non-worker threads.
   // (doesn't need to be NUMA-aware, so pick any)
   for (socket = 0; socket < RTE_MAX_NUMA_NODES; socket++) {
@@ -303,6 +370,11 @@ void *Worker::Run(void *_arg) {
   pframe_pool_ = bess::get_pframe_pool_socket(socket_);
   DCHECK(pframe_pool_);
 
+  packet_cache_ = bess::PacketCache::Attach(wid_, socket_, pframe_pool_,
+                                            FLAGS_packet_cache);
+
+  bess::ModuleProfiler::InitWorker(wid_);
+
   status_ = WORKER_PAUSING;
 
   STORE_BARRIER();
@@ -320,6 +392,11 @@ void *Worker::Run(void *_arg) {
             << "is quitting... (core " << core_ << ", socket " << socket_
             << ")";
 
+  packet_cache_ = nullptr;
+  bess::PacketCache::Detach(wid_);
+
+  bess::ModuleProfiler::DeinitWorker(wid_);
+
   delete scheduler_;
   delete rand_;
 
@@ -334,6 +411,9 @@ void *run_worker(void *_arg) {
 void launch_worker(int wid, int core,
                    [[maybe_unused]] const std::string &scheduler) {
   struct thread_arg arg = {.wid = wid, .core = core, .scheduler = nullptr};
+
+  // Must be decided before any worker starts counting rounds
+  Worker::InitMembarrier();
   if (scheduler == "") {
     arg.scheduler = new DefaultScheduler();
   } else if (scheduler == "experimental") {
@@ -33,6 +33,7 @@
 
 #include <glog/logging.h>
 
+#include <atomic>
 #include <cstdint>
 #include <string>
 #include <thread>
@@ -67,6 +68,7 @@ typedef enum {
 } worker_status_t;
 
 namespace bess {
+class PacketCache;
 class Scheduler;
 }  // namespace bess
 
@@ -82,6 +84,11 @@ class Worker {
    * ---------------------------------------------------------------------- */
   void SetNonWorker();
 
+  // Registers for membarrier(2), if the kernel supports it. Called before the
+  // first worker is launched. See incr_rounds().
+  static void InitMembarrier();
+  static bool membarrier_enabled() { return membarrier_; }
+
   /* ----------------------------------------------------------------------
    * functions below are invoked by worker threads
    * ---------------------------------------------------------------------- */
@@ -104,6 +111,11 @@ class Worker {
   struct rte_mempool *pframe_pool() {
     return pframe_pool_;
   }
+  void set_pframe_pool(struct rte_mempool *pool) { pframe_pool_ = pool; }
+
+  // nullptr for non-worker threads, or if disabled with --packet_cache=0
+  bess::PacketCache *packet_cache() { return packet_cache_; }
+  void set_packet_cache(bess::PacketCache *cache) { packet_cache_ = cache; }
 
   bess::Scheduler *scheduler() { return scheduler_; }
 
@@ -117,6 +129,21 @@ class Worker {
   uint64_t current_ns() const { return current_ns_; }
   void set_current_ns(uint64_t ns) { current_ns_ = ns; }
 
+  // Bumped by the scheduler loop between tasks. See synchronize_workers().
+  // The worker is the only writer, so this is a plain release store. Loads of
+  // the next round may still pass it, which synchronize_workers() makes up
+  // for with membarrier(2). Without membarrier(2), the increment is a
+  // sequentially consistent one (a locked instruction on x86) instead.
+  uint64_t rounds() const { return rounds_.load(std::memory_order_acquire); }
+  void incr_rounds() {
+    if (likely(membarrier_)) {
+      rounds_.store(rounds_.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_release);
+    } else {
+      rounds_.fetch_add(1);
+    }
+  }
+
   Random *rand() const { return rand_; }
 
  private:
@@ -129,6 +156,8 @@ class Worker {
 
   struct rte_mempool *pframe_pool_;
 
+  bess::PacketCache *packet_cache_;
+
   bess::Scheduler *scheduler_;
 
   uint64_t silent_drops_; /* packets that have been sent to a deadend */
@@ -136,6 +165,10 @@ class Worker {
   uint64_t current_tsc_;
   uint64_t current_ns_;
 
+  std::atomic<uint64_t> rounds_;
+
+  static bool membarrier_;
+
   Random *rand_;
 };
 
@@ -177,6 +210,13 @@ void destroy_all_workers();
 
 bool is_any_worker_running();
 
+/*!
+ * Blocks until every running worker has finished the task it was running at
+ * the time of the call. Once this returns, no worker can hold a pointer to
+ * data that had been unpublished before the call, so it can be freed.
+ */
+void synchronize_workers();
+
 int is_cpu_present(unsigned int core_id);
 
 static inline int is_worker_active(int wid) {
@@ -693,3 +693,19 @@ class BESS(object):
         request = bess_msg.DumpMempoolRequest()
         request.socket = socket
         return self._request('DumpMempool', request)
+
+    def create_packet_pool(self, name, data_size, count, socket=-1):
+        request = bess_msg.CreatePacketPoolRequest()
+        request.name = name
+        request.data_size = data_size
+        request.count = count
+        request.socket = socket
+        return self._request('CreatePacketPool', request)
+
+    def list_packet_pools(self):
+        return self._request('ListPacketPools')
+
+    def get_module_profile(self, reset=False):
+        request = bess_msg.GetModuleProfileRequest()
+        request.reset = reset
+        return self._request('GetModuleProfile', request)